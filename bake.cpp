@@ -0,0 +1,262 @@
+/*===-- bake.cpp --------------- Baker ------------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the offline asset baker, it bakes OBJ and glb meshes   *|
+|* to mesh caches and images to mipmapped KTX2 textures in parallel and skips *|
+|* unchanged inputs.                                                          *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Ktx2.hpp"
+#include "Log.hpp"
+#include "MappedFile.hpp"
+#include "MeshCache.hpp"
+#include "ThreadPool.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using Util::throw_if;
+
+namespace
+{
+
+constexpr auto Usage = R"(usage: baker [options] <input>...
+  inputs are OBJ or glb meshes, PNG, JPEG, TGA or BMP images,
+  or directories searched recursively for them
+  -o <dir>                   output directory, default baked
+  --position f32|f16|snorm16 position format
+  --color f32|unorm8         color format
+  --normal f32|oct16|oct8    normal format
+  --uv f32|f16               uv format
+  --interleave               keep positions interleaved with other attributes
+  --lods <count>             LOD levels including the original, 1 disables
+  --compress-indices         store indices with index codec
+  --linear                   images hold data instead of sRGB colors
+  --force                    bake unchanged inputs too)";
+
+constexpr std::array<std::string_view, 2> Mesh_Extensions  = { ".obj", ".glb" };
+constexpr std::array<std::string_view, 5> Image_Extensions = { ".png", ".jpg", ".jpeg", ".tga", ".bmp" };
+
+struct Job
+{
+  fs::path source;
+  fs::path destination;
+  std::string key;          ///< destination relative to output directory
+  bool texture;             ///< image baked to KTX2, otherwise mesh baked to mesh cache
+};
+
+auto is_mesh(const fs::path& path)
+{
+  return std::ranges::find(Mesh_Extensions, path.extension().string()) != Mesh_Extensions.end();
+}
+
+auto is_image(const fs::path& path)
+{
+  return std::ranges::find(Image_Extensions, path.extension().string()) != Image_Extensions.end();
+}
+
+template <typename Enum>
+auto parse_enum(std::string_view option, std::string_view value, std::initializer_list<std::pair<std::string_view, Enum>> names)
+{
+  for (const auto& [name, e] : names)
+    if (name == value)
+      return e;
+  throw std::runtime_error(fmt::format("invalid value {} of {}", value, option));
+}
+
+/**
+ * Manifest maps output to hash of its source content and bake options.
+ * One "<hash> <output>" per line.
+ */
+auto read_manifest(const fs::path& filename)
+{
+  std::map<std::string, uint64_t> manifest;
+  std::ifstream file(filename);
+  uint64_t hash;
+  std::string key;
+  while (file >> std::hex >> hash && std::getline(file >> std::ws, key))
+    manifest[key] = hash;
+  return manifest;
+}
+
+void write_manifest(const fs::path& filename, const std::map<std::string, uint64_t>& manifest)
+{
+  auto temporary = fs::path(filename) += ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::trunc);
+    throw_if(!file.is_open(), fmt::format("failed to open {}", temporary.string()));
+    for (const auto& [key, hash] : manifest)
+      file << fmt::format("{:016x} {}\n", hash, key);
+    throw_if(!file.good(), fmt::format("failed to write {}", temporary.string()));
+  }
+  fs::rename(temporary, filename);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  try
+  {
+    Mesh::BakeOptions options;
+    fs::path output = "baked";
+    std::vector<fs::path> inputs;
+    bool force = false;
+    bool srgb  = true;
+
+    for (int i = 1; i < argc; ++i)
+    {
+      std::string_view arg = argv[i];
+      auto value = [&]
+      {
+        throw_if(i + 1 == argc, fmt::format("missing value of {}\n{}", arg, Usage));
+        return std::string_view(argv[++i]);
+      };
+
+      if (arg == "-o")
+        output = value();
+      else if (arg == "--position")
+        options.format.position = parse_enum<Mesh::PositionFormat>(arg, value(),
+          { { "f32", Mesh::PositionFormat::Float32 }, { "f16", Mesh::PositionFormat::Float16 }, { "snorm16", Mesh::PositionFormat::SNorm16 } });
+      else if (arg == "--color")
+        options.format.color = parse_enum<Mesh::ColorFormat>(arg, value(),
+          { { "f32", Mesh::ColorFormat::Float32 }, { "unorm8", Mesh::ColorFormat::UNorm8 } });
+      else if (arg == "--normal")
+        options.format.normal = parse_enum<Mesh::NormalFormat>(arg, value(),
+          { { "f32", Mesh::NormalFormat::Float32 }, { "oct16", Mesh::NormalFormat::Octahedral16 }, { "oct8", Mesh::NormalFormat::Octahedral8 } });
+      else if (arg == "--uv")
+        options.format.uv = parse_enum<Mesh::UVFormat>(arg, value(),
+          { { "f32", Mesh::UVFormat::Float32 }, { "f16", Mesh::UVFormat::Float16 } });
+      else if (arg == "--interleave")
+        options.format.split_position = false;
+      else if (arg == "--lods")
+        options.max_lods = std::stoul(std::string(value()));
+      else if (arg == "--compress-indices")
+        options.compress_indices = true;
+      else if (arg == "--linear")
+        srgb = false;
+      else if (arg == "--force")
+        force = true;
+      else
+      {
+        throw_if(arg.starts_with("-"), fmt::format("unknown option {}\n{}", arg, Usage));
+        inputs.emplace_back(arg);
+      }
+    }
+    throw_if(inputs.empty(), Usage);
+
+    // collect jobs, outputs keep directory structure of inputs.
+    // each output has one job, jobs baking same output would race on its temporary file
+    std::vector<Job> jobs;
+    std::map<std::string, fs::path> sources;
+    auto add_job = [&](const fs::path& source, const fs::path& relative)
+    {
+      auto texture = is_image(source);
+      auto key     = fs::path(relative).replace_extension(texture ? ".ktx2" : ".mesh").generic_string();
+      auto [it, inserted] = sources.emplace(key, source);
+      if (!inserted)
+      {
+        throw_if(!fs::equivalent(it->second, source),
+                 fmt::format("{} and {} both bake to {}", it->second.string(), source.string(), key));
+        return;
+      }
+      jobs.emplace_back(source, output / key, key, texture);
+    };
+    for (const auto& input : inputs)
+    {
+      if (fs::is_directory(input))
+      {
+        for (const auto& entry : fs::recursive_directory_iterator(input))
+          if (entry.is_regular_file() && (is_mesh(entry.path()) || is_image(entry.path())))
+            add_job(entry.path(), fs::relative(entry.path(), input));
+      }
+      else
+      {
+        throw_if(!is_mesh(input) && !is_image(input),
+                 fmt::format("unsupported input {}, only OBJ or glb meshes and PNG, JPEG, TGA or BMP images can be baked", input.string()));
+        add_job(input, input.filename());
+      }
+    }
+
+    // hash of options and format version of each output kind, so changing them rebakes all outputs of that kind
+    auto mesh_settings = fmt::format("{} {} {} {} {} {} {} {}", Mesh::Cache_Version,
+                                     (int)options.format.position, (int)options.format.color, (int)options.format.normal, (int)options.format.uv,
+                                     options.format.split_position, options.max_lods, options.compress_indices);
+    auto texture_settings = fmt::format("ktx2 rgba8 {}", srgb);
+    auto mesh_seed    = Util::hash(std::as_bytes(std::span(mesh_settings)));
+    auto texture_seed = Util::hash(std::as_bytes(std::span(texture_settings)));
+
+    fs::create_directories(output);
+    auto manifest_filename = output / "manifest.txt";
+    auto manifest = read_manifest(manifest_filename);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::mutex mutex;
+    std::atomic_uint32_t baked = 0, skipped = 0, failed = 0;
+    Util::ThreadPool::instance().parallel_for(jobs.size(), [&](uint32_t i)
+    {
+      const auto& job = jobs[i];
+      try
+      {
+        auto hash = Util::hash(Util::MappedFile(job.source.string()).bytes(), job.texture ? texture_seed : mesh_seed);
+        {
+          std::lock_guard lock(mutex);
+          auto it = manifest.find(job.key);
+          if (!force && it != manifest.end() && it->second == hash && fs::exists(job.destination))
+          {
+            ++skipped;
+            return;
+          }
+        }
+
+        fs::create_directories(job.destination.parent_path());
+        if (job.texture)
+          Ktx2::bake(job.source.string(), job.destination.string(), srgb);
+        else
+          Mesh::bake_mesh(job.source.string(), job.destination.string(), options);
+        Log::info(fmt::format("baked {} -> {}", job.source.string(), job.destination.string()));
+        ++baked;
+
+        std::lock_guard lock(mutex);
+        manifest[job.key] = hash;
+      }
+      catch (const std::exception& e)
+      {
+        Log::error(fmt::format("failed to bake {}: {}", job.source.string(), e.what()));
+        ++failed;
+      }
+    });
+    write_manifest(manifest_filename, manifest);
+
+    auto duration = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start);
+    Log::info(fmt::format("{} baked, {} unchanged, {} failed in {:.2f}s", baked.load(), skipped.load(), failed.load(), duration.count()));
+    if (failed)
+      exit(EXIT_FAILURE);
+  }
+  catch (const std::exception& e)
+  {
+    Log::error(e.what());
+    exit(EXIT_FAILURE);
+  }
+}
@@ -0,0 +1,373 @@
+/*===-- bench.cpp -------------- Benchmark --------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the micro benchmarks of CPU kernels.                   *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Bvh.hpp"
+#include "Culling.hpp"
+#include "Math.hpp"
+#include "Transform.hpp"
+#include "Video.hpp"
+
+#include <fmt/format.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+constexpr uint32_t Object_Count = 1 << 20;
+constexpr uint32_t Iterations   = 50;
+constexpr uint32_t Bvh_Count    = 100'000;
+constexpr uint32_t Transform_Count = 100'000;
+constexpr uint32_t Matrix_Count    = 100'000;
+constexpr uint32_t Video_Width     = 1920;
+constexpr uint32_t Video_Height    = 1080;
+
+constexpr Util::Isa Isas[] = { Util::Isa::Scalar, Util::Isa::SSE, Util::Isa::AVX2, Util::Isa::NEON };
+
+auto isa_name(Util::Isa isa)
+{
+  switch (isa)
+  {
+  case Util::Isa::AVX2: return "avx2";
+  case Util::Isa::SSE:  return "sse";
+  case Util::Isa::NEON: return "neon";
+  default:              return "scalar";
+  }
+}
+
+/**
+ * Run func for iterations and print throughput.
+ */
+template <typename Func>
+void measure(std::string_view name, uint32_t count, Func&& func)
+{
+  uint32_t result = func();
+  auto start = std::chrono::high_resolution_clock::now();
+  for (uint32_t i = 0; i < Iterations; ++i)
+    result = func();
+  auto duration = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / Iterations;
+  fmt::println("{:<24} {:>8.3f}ms {:>10.0f} objects/ms  result {}", name, duration, count / duration, result);
+}
+
+void bench_culling()
+{
+  // objects scattered around camera, about a quarter of them visible
+  std::mt19937 random(42);
+  std::uniform_real_distribution<float> position(-100.f, 100.f), size(.1f, 2.f);
+  Culling::Spheres spheres;
+  Culling::Boxes   boxes;
+  for (uint32_t i = 0; i < Object_Count; ++i)
+  {
+    glm::vec3 center(position(random), position(random), position(random));
+    auto radius = size(random);
+    spheres.add(center, radius);
+    boxes.add(center - glm::vec3(radius), center + glm::vec3(radius));
+  }
+
+  auto view     = glm::lookAt(glm::vec3(0.f), glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, 0.f, 1.f));
+  auto proj     = glm::perspective(glm::radians(90.f), 16.f / 9.f, .1f, 150.f);
+  auto frustum  = Culling::extract_frustum(proj * view);
+  std::vector<uint32_t> visible(Object_Count);
+
+  fmt::println("frustum culling of {} objects", Object_Count);
+  for (auto isa : Isas)
+  {
+    if (!Util::is_supported(isa))
+      continue;
+    measure(fmt::format("spheres {}", isa_name(isa)), Object_Count, [&] { return Culling::cull(frustum, spheres, visible, isa); });
+    measure(fmt::format("boxes {}",   isa_name(isa)), Object_Count, [&] { return Culling::cull(frustum, boxes,   visible, isa); });
+  }
+}
+
+/**
+ * Print duration of func.
+ */
+template <typename Func>
+void time(std::string_view name, Func&& func)
+{
+  auto start = std::chrono::high_resolution_clock::now();
+  func();
+  fmt::println("{:<24} {:>8.3f}ms", name, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+}
+
+void bench_bvh()
+{
+  // clustered objects in a large scene, camera sees a small part of it
+  std::mt19937 random(42);
+  std::uniform_real_distribution<float> cluster(-1000.f, 1000.f), offset(-20.f, 20.f), size(.1f, 2.f);
+  Culling::Bvh bvh;
+  Culling::Boxes boxes;
+  std::vector<Mesh::Bounds> bounds;
+  glm::vec3 center;
+  for (uint32_t i = 0; i < Bvh_Count; ++i)
+  {
+    if (i % 100 == 0)
+      center = glm::vec3(cluster(random), cluster(random), cluster(random) * .05f);
+    auto position = center + glm::vec3(offset(random), offset(random), offset(random));
+    auto extent   = glm::vec3(size(random));
+    bounds.push_back({ position - extent, position + extent });
+    boxes.add(bounds.back().min, bounds.back().max);
+    bvh.insert(bounds.back());
+  }
+
+  auto view    = glm::lookAt(glm::vec3(0.f), glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, 0.f, 1.f));
+  auto proj    = glm::perspective(glm::radians(60.f), 16.f / 9.f, .1f, 500.f);
+  auto frustum = Culling::extract_frustum(proj * view);
+  std::vector<uint32_t> visible(Bvh_Count), result;
+
+  fmt::println("bvh of {} objects", Bvh_Count);
+  time("build", [&] { bvh.build(); });
+  measure("cull bvh", Bvh_Count, [&]
+  {
+    result.clear();
+    bvh.cull(frustum, result);
+    return (uint32_t)result.size();
+  });
+  measure("cull linear", Bvh_Count, [&] { return Culling::cull(frustum, boxes, visible); });
+  measure("pick", Bvh_Count, [&]
+  {
+    return bvh.pick(glm::vec3(0.f), glm::vec3(1.f, .01f, .01f)).value_or(Culling::Bvh::Hit{}).id;
+  });
+  measure("query", Bvh_Count, [&]
+  {
+    result.clear();
+    bvh.query({ glm::vec3(-100.f), glm::vec3(100.f) }, result);
+    return (uint32_t)result.size();
+  });
+
+  std::uniform_int_distribution<uint32_t> object(0, Bvh_Count - 1);
+  for (uint32_t i = 0; i < Bvh_Count / 10; ++i)
+  {
+    auto id = object(random);
+    auto move = glm::vec3(offset(random), offset(random), 0.f) * .1f;
+    bvh.update(id, { bounds[id].min + move, bounds[id].max + move });
+  }
+  time("refit 10% moved", [&] { bvh.refit(); });
+  time("rebuild async", [&]
+  {
+    bvh.rebuild_async();
+    while (bvh.rebuilding())
+      bvh.refit();
+  });
+}
+
+// whether float kernel results agree within rounding of different operation orders
+bool near(float a, float b)
+{
+  return std::abs(a - b) <= 1e-4f * std::max(1.f, std::abs(b));
+}
+
+bool near(const glm::mat4& a, const glm::mat4& b)
+{
+  for (int column = 0; column < 4; ++column)
+    for (int row = 0; row < 4; ++row)
+      if (!near(a[column][row], b[column][row]))
+        return false;
+  return true;
+}
+
+bool near(const Mesh::Bounds& a, const Mesh::Bounds& b)
+{
+  for (int axis = 0; axis < 3; ++axis)
+    if (!near(a.min[axis], b.min[axis]) || !near(a.max[axis], b.max[axis]))
+      return false;
+  return true;
+}
+
+/**
+ * Check results of a kernel against reference and print first mismatch.
+ */
+template <typename T>
+bool check(std::string_view name, const std::vector<T>& result, const std::vector<T>& reference)
+{
+  auto [mismatch, _] = std::ranges::mismatch(result, reference, [](const T& a, const T& b) { return near(a, b); });
+  if (mismatch == result.end())
+    return true;
+  fmt::println("{} mismatches reference at {}", name, mismatch - result.begin());
+  return false;
+}
+
+bool bench_math()
+{
+  // random affine matrices and unit boxes, about 6MB of matrices per batch
+  std::mt19937 random(42);
+  std::uniform_real_distribution<float> value(-1.f, 1.f);
+  std::vector<glm::mat4>    a(Matrix_Count), b(Matrix_Count), result(Matrix_Count);
+  std::vector<Mesh::Bounds> bounds(Matrix_Count), transformed(Matrix_Count);
+  for (uint32_t i = 0; i < Matrix_Count; ++i)
+  {
+    auto translation = glm::vec3(value(random), value(random), value(random)) * 100.f;
+    a[i] = glm::translate(glm::mat4(1.f), translation) * glm::scale(glm::mat4(1.f), glm::vec3(2.f + value(random)));
+    b[i] = glm::translate(glm::mat4(1.f), -translation);
+    bounds[i] = { glm::vec3(-1.f), glm::vec3(1.f) };
+  }
+  auto view_projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, .1f, 500.f) *
+                         glm::lookAt(glm::vec3(0.f), glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, 0.f, 1.f));
+
+  // references of glm, every kernel must match them before it is timed
+  std::vector<glm::mat4>    products(Matrix_Count), premultiplied(Matrix_Count), inverses(Matrix_Count);
+  std::vector<Mesh::Bounds> boxes(Matrix_Count);
+  for (uint32_t i = 0; i < Matrix_Count; ++i)
+  {
+    products[i]      = a[i] * b[i];
+    premultiplied[i] = view_projection * a[i];
+    inverses[i]      = glm::inverse(a[i]);
+    boxes[i]         = { glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest()) };
+    for (uint32_t corner = 0; corner < 8; ++corner)
+    {
+      auto point = glm::vec3(a[i] * glm::vec4(corner & 1 ? bounds[i].max.x : bounds[i].min.x,
+                                              corner & 2 ? bounds[i].max.y : bounds[i].min.y,
+                                              corner & 4 ? bounds[i].max.z : bounds[i].min.z, 1.f));
+      boxes[i] = { glm::min(boxes[i].min, point), glm::max(boxes[i].max, point) };
+    }
+  }
+
+  fmt::println("math of {} matrices", Matrix_Count);
+  auto valid = true;
+  for (auto isa : Isas)
+  {
+    if (!Util::is_supported(isa) || isa == Util::Isa::SSE)
+      continue;
+    Math::multiply(a, b, result, isa);
+    auto matches = check(fmt::format("multiply {}", isa_name(isa)), result, products);
+    Math::multiply(view_projection, a, result, isa);
+    matches = check(fmt::format("premultiply {}", isa_name(isa)), result, premultiplied) && matches;
+    Math::inverse_affine(a, result, isa);
+    matches = check(fmt::format("inverse affine {}", isa_name(isa)), result, inverses) && matches;
+    Math::transform_bounds(a, bounds, transformed, isa);
+    matches = check(fmt::format("transform bounds {}", isa_name(isa)), transformed, boxes) && matches;
+    if (!matches)
+    {
+      valid = false;
+      continue;
+    }
+
+    measure(fmt::format("multiply {}", isa_name(isa)), Matrix_Count, [&]
+    {
+      Math::multiply(a, b, result, isa);
+      return Matrix_Count;
+    });
+    measure(fmt::format("premultiply {}", isa_name(isa)), Matrix_Count, [&]
+    {
+      Math::multiply(view_projection, a, result, isa);
+      return Matrix_Count;
+    });
+    measure(fmt::format("inverse affine {}", isa_name(isa)), Matrix_Count, [&]
+    {
+      Math::inverse_affine(a, result, isa);
+      return Matrix_Count;
+    });
+    measure(fmt::format("transform bounds {}", isa_name(isa)), Matrix_Count, [&]
+    {
+      Math::transform_bounds(a, bounds, transformed, isa);
+      return Matrix_Count;
+    });
+  }
+  return valid;
+}
+
+void bench_transforms()
+{
+  // breadth first hierarchy of nodes with eight adjacent children each
+  std::mt19937 random(42);
+  Scene::Transforms transforms;
+  for (uint32_t i = 0; i < Transform_Count; ++i)
+    transforms.create(glm::translate(glm::mat4(1.f), glm::vec3(1.f)), i < 8 ? Scene::No_Parent : i / 8);
+
+  fmt::println("transforms of {} nodes", Transform_Count);
+  std::uniform_int_distribution<uint32_t> node(0, Transform_Count - 1);
+  auto move = glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, 1.f));
+  for (auto count : { Transform_Count, Transform_Count / 100, Transform_Count / 10000 })
+    measure(fmt::format("update {} dirty", count), Transform_Count, [&]
+    {
+      for (uint32_t i = 0; i < count; ++i)
+        transforms.set_local(node(random), move);
+      auto [first, last] = transforms.update();
+      return last - first;
+    });
+}
+
+/**
+ * Check that kernel of isa writes the bytes of scalar kernel, odd sizes cover
+ * tails of vector loops and unpaired last row and column.
+ */
+bool check_video(Util::Isa isa)
+{
+  constexpr std::pair<uint32_t, uint32_t> Sizes[] = { { 1, 1 }, { 3, 5 }, { 37, 9 }, { 131, 67 } };
+  std::mt19937 random(7);
+  for (auto [width, height] : Sizes)
+    for (auto order : { Video::PixelOrder::BGRA, Video::PixelOrder::RGBA })
+    {
+      std::vector<std::byte> pixels((size_t)width * height * 4);
+      for (auto& pixel : pixels)
+        pixel = (std::byte)random();
+      std::vector<uint8_t> expected(Video::get_yuv420_size(width, height)), actual(expected.size());
+      Video::convert_yuv420(pixels, width, height, order, expected, Util::Isa::Scalar);
+      Video::convert_yuv420(pixels, width, height, order, actual, isa);
+      if (actual != expected)
+      {
+        fmt::println("convert {} mismatches scalar at {}x{}", isa_name(isa), width, height);
+        return false;
+      }
+    }
+  return true;
+}
+
+bool bench_video()
+{
+  // random BGRA frame, about 8MB per conversion
+  std::mt19937 random(42);
+  std::vector<std::byte> pixels((size_t)Video_Width * Video_Height * 4);
+  for (auto& pixel : pixels)
+    pixel = (std::byte)random();
+  std::vector<uint8_t> yuv(Video::get_yuv420_size(Video_Width, Video_Height));
+
+  fmt::println("yuv 4:2:0 of {}x{} pixels", Video_Width, Video_Height);
+  auto valid = true;
+  for (auto isa : Isas)
+  {
+    if (!Util::is_supported(isa) || isa == Util::Isa::SSE)
+      continue;
+    if (isa != Util::Isa::Scalar && !check_video(isa))
+    {
+      valid = false;
+      continue;
+    }
+    measure(fmt::format("convert {}", isa_name(isa)), Video_Width * Video_Height, [&]
+    {
+      Video::convert_yuv420(pixels, Video_Width, Video_Height, Video::PixelOrder::BGRA, yuv, isa);
+      return (uint32_t)yuv[yuv.size() / 2];
+    });
+  }
+  return valid;
+}
+
+}
+
+int main()
+{
+  // kernels mismatching reference results are reported and not timed
+  bench_culling();
+  bench_bvh();
+  auto math_valid = bench_math();
+  bench_transforms();
+  auto video_valid = bench_video();
+  return math_valid && video_valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
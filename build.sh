@@ -5,3 +5,7 @@ cmake --build build
 
 glslc -fshader-stage=vertex shader/vertex.glsl -o shader/vertex.spv
 glslc -fshader-stage=fragment shader/fragment.glsl -o shader/fragment.spv
+glslc -fshader-stage=vertex shader/depth.glsl -o shader/depth.spv
+glslc -fshader-stage=compute shader/hiz.glsl -o shader/hiz.spv
+glslc -fshader-stage=compute shader/occlusion.glsl -o shader/occlusion.spv
+glslc -fshader-stage=compute shader/mip.glsl -o shader/mip.spv
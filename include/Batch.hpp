@@ -0,0 +1,87 @@
+/*===-- include/Batch.hpp ------ Static Batching --------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare the merge of small static glTF primitives into batches *|
+|* sharing vertex and index ranges.                                           *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#include "Gltf.hpp"
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Mesh
+{
+
+  /**
+   * Primitives with more vertices are drawn alone,
+   * batching copies vertices of every node instancing a primitive.
+   */
+  constexpr uint32_t Max_Batch_Primitive_Vertices = 16384;
+
+  /**
+   * Index range of a primitive in batch, culled on its own.
+   */
+  struct Submesh
+  {
+    uint32_t  first_index;
+    uint32_t  index_count;
+    glm::vec4 sphere;      ///< bounding sphere in space of batch
+  };
+
+  /**
+   * Static primitives of same vertex formats and material merged into one draw.
+   * Vertices are transformed by their nodes, so batch needs no transform of its own.
+   */
+  struct Batch
+  {
+    std::array<VkFormat, 4>               formats;      ///< format of each location, VK_FORMAT_UNDEFINED if missing
+    int32_t                               material;
+    uint32_t                              vertex_count = 0;
+    std::array<std::vector<std::byte>, 4> streams;      ///< tightly packed vertices of each present location
+    std::vector<uint32_t>                 indices;      ///< indices of submeshes rebased to batch vertices
+    std::vector<Submesh>                  submeshes;
+  };
+
+  /**
+   * Check whether primitive can be merged into batch.
+   * It must be indexed, have float positions and float or missing other attributes,
+   * and be at most Max_Batch_Primitive_Vertices vertices.
+   *
+   * @param primitive glTF primitive.
+   * @return true if batchable.
+   */
+  bool is_batchable(const Primitive& primitive);
+
+  /**
+   * Merge batchable primitives of every node by vertex formats and material.
+   * Other primitives are left for the caller to draw alone.
+   *
+   * @param file glb file.
+   * @return batches in order of their first primitive.
+   */
+  auto merge_static(const GlbFile& file) -> std::vector<Batch>;
+
+  /**
+   * Merge every primitive of every node into one mesh in world space, for baking.
+   * Attributes of any format are converted to Mesh::Vertex, missing colors are white,
+   * missing normals and uvs are zero, non indexed primitives get sequential indices.
+   *
+   * @param file glb file.
+   * @return merged mesh.
+   */
+  auto merge_mesh(const GlbFile& file) -> MeshData;
+
+}
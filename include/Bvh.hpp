@@ -0,0 +1,152 @@
+/*===-- include/Bvh.hpp -------- Bounding Volume Hierarchy ----------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare the dynamic bounding volume hierarchy of scene         *|
+|* objects, used by frustum culling, picking and range queries.               *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#include "Culling.hpp"
+#include "Mesh.hpp"
+
+#include <future>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace Culling
+{
+
+  /**
+   * Bounding volume hierarchy over axis aligned boxes of objects.
+   * Moved objects are refitted incrementally, the tree is rebuilt with SAH synchronously
+   * or on a worker thread, owners start the latter when degradation() shows refitting grew its cost.
+   * Objects inserted after the last build are tested linearly until next build.
+   */
+  class Bvh final
+  {
+  public:
+    struct Hit
+    {
+      uint32_t id;
+      float    distance; ///< distance along ray to entry of box
+    };
+
+    /**
+     * Add object.
+     *
+     * @param bounds finite bounding box.
+     * @return object id, ids of removed objects are reused.
+     */
+    uint32_t insert(const Mesh::Bounds& bounds);
+
+    /**
+     * Move object, takes effect in tree after refit.
+     *
+     * @param id object id.
+     * @param bounds finite bounding box.
+     */
+    void update(uint32_t id, const Mesh::Bounds& bounds);
+
+    /**
+     * Remove object.
+     *
+     * @param id object id.
+     */
+    void remove(uint32_t id);
+
+    /**
+     * Build tree of all objects with binned SAH.
+     */
+    void build();
+
+    /**
+     * Start building tree on a worker thread from current bounds.
+     * The tree is swapped in by the first refit after the build completes,
+     * objects changed in the meantime are refitted.
+     */
+    void rebuild_async();
+
+    /**
+     * Install completed asynchronous build, then propagate bounds of moved objects to root.
+     */
+    void refit();
+
+    /**
+     * Get visible objects.
+     *
+     * @param frustum frustum in space of bounds.
+     * @param visible visible object ids are appended.
+     */
+    void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+    /**
+     * Get objects whose bounding box overlaps range.
+     *
+     * @param range range.
+     * @param result object ids are appended.
+     */
+    void query(const Mesh::Bounds& range, std::vector<uint32_t>& result) const;
+
+    /**
+     * Get nearest object whose bounding box is hit by ray.
+     *
+     * @param origin ray origin.
+     * @param direction ray direction.
+     * @param max_distance max distance along direction.
+     * @return hit object, empty if none.
+     */
+    auto pick(const glm::vec3& origin, const glm::vec3& direction,
+              float max_distance = std::numeric_limits<float>::max()) const -> std::optional<Hit>;
+
+    /**
+     * Get SAH cost of tree relative to its cost right after last build.
+     * Cost is surface area of all nodes over that of root, refitting moved objects apart grows it.
+     *
+     * @return 1 for a fresh tree, larger as refitting degrades it.
+     */
+    auto degradation() const -> float;
+
+    auto node_count()  const noexcept { return (uint32_t)_tree.nodes.size(); }
+    auto rebuilding()  const noexcept { return _rebuild.valid(); }
+
+  private:
+    struct Node
+    {
+      Mesh::Bounds bounds;
+      uint32_t     left;       ///< index of left child, right child follows, 0 if leaf
+      uint32_t     begin, end; ///< range of items in subtree
+    };
+
+    struct Tree
+    {
+      std::vector<Node>     nodes;
+      std::vector<uint32_t> items;   ///< object ids in depth first order
+      std::vector<uint32_t> parents; ///< parent of each node
+    };
+
+    static Tree build_tree(std::span<const Mesh::Bounds> bounds, std::vector<uint32_t> ids);
+    void install(Tree&& tree);
+    auto leaf_bounds(const Node& node) const -> Mesh::Bounds;
+
+    std::vector<Mesh::Bounds> _bounds;   ///< bounds of each object, empty if removed
+    std::vector<uint8_t>      _alive;
+    std::vector<uint32_t>     _free;     ///< ids of removed objects
+    std::vector<uint32_t>     _leaf_of;  ///< leaf node of each object, -1 if not in tree
+    std::vector<uint32_t>     _pending;  ///< alive objects not in tree
+    std::vector<uint32_t>     _dirty;    ///< objects in tree changed since last refit
+    std::vector<uint32_t>     _changed;  ///< objects changed during asynchronous build
+    Tree                      _tree;
+    std::future<Tree>         _rebuild;
+    double                    _area_sum   = 0.0; ///< surface area of all nodes, kept up to date by refit
+    double                    _build_cost = 0.0; ///< cost when tree was installed
+  };
+
+}
@@ -0,0 +1,119 @@
+/*===-- include/Culling.hpp ----- Culling ---------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare the frustum culling of bounding volumes stored in      *|
+|* structure of arrays, tested several at a time with SIMD.                   *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#include "Util.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace Culling
+{
+
+  using Util::Isa;
+  using Util::get_isa;
+
+  /**
+   * Six normalized planes, points inside have non-negative distance to every plane.
+   */
+  struct Frustum
+  {
+    std::array<glm::vec4, 6> planes; ///< xyz is normal, w is distance to origin
+  };
+
+  /**
+   * Extract frustum from view projection matrix with Vulkan depth range [0, 1].
+   * Planes are in the space transformed by the matrix, e.g. object space if it includes model.
+   *
+   * @param matrix view projection matrix.
+   * @return frustum.
+   */
+  Frustum extract_frustum(const glm::mat4& matrix);
+
+  /**
+   * Bounding spheres in structure of arrays.
+   */
+  struct Spheres
+  {
+    std::vector<float> x, y, z, radius;
+
+    auto size() const noexcept { return (uint32_t)x.size(); }
+
+    void add(const glm::vec3& center, float r)
+    {
+      x.emplace_back(center.x);
+      y.emplace_back(center.y);
+      z.emplace_back(center.z);
+      radius.emplace_back(r);
+    }
+
+    void clear() noexcept
+    {
+      x.clear(); y.clear(); z.clear(); radius.clear();
+    }
+  };
+
+  /**
+   * Axis aligned bounding boxes in structure of arrays, stored as center and half extent.
+   */
+  struct Boxes
+  {
+    std::vector<float> x, y, z, extent_x, extent_y, extent_z;
+
+    auto size() const noexcept { return (uint32_t)x.size(); }
+
+    void add(const glm::vec3& min, const glm::vec3& max)
+    {
+      auto center = (min + max) * .5f;
+      auto extent = (max - min) * .5f;
+      x.emplace_back(center.x);
+      y.emplace_back(center.y);
+      z.emplace_back(center.z);
+      extent_x.emplace_back(extent.x);
+      extent_y.emplace_back(extent.y);
+      extent_z.emplace_back(extent.z);
+    }
+
+    void clear() noexcept
+    {
+      x.clear(); y.clear(); z.clear(); extent_x.clear(); extent_y.clear(); extent_z.clear();
+    }
+  };
+
+  /**
+   * Test spheres against frustum.
+   *
+   * @param frustum frustum.
+   * @param spheres bounding spheres.
+   * @param visible receive indices of visible spheres in ascending order, size at least spheres.size().
+   * @param isa instruction set, must be supported by CPU.
+   * @return number of visible spheres.
+   */
+  uint32_t cull(const Frustum& frustum, const Spheres& spheres, std::span<uint32_t> visible, Isa isa = get_isa());
+
+  /**
+   * Test boxes against frustum.
+   *
+   * @param frustum frustum.
+   * @param boxes bounding boxes.
+   * @param visible receive indices of visible boxes in ascending order, size at least boxes.size().
+   * @param isa instruction set, must be supported by CPU.
+   * @return number of visible boxes.
+   */
+  uint32_t cull(const Frustum& frustum, const Boxes& boxes, std::span<uint32_t> visible, Isa isa = get_isa());
+
+}
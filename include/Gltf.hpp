@@ -0,0 +1,129 @@
+/*===-- include/Gltf.hpp ------- glTF -------------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare the zero copy glTF 2.0 binary (.glb) loader.           *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#include "MappedFile.hpp"
+#include "Mesh.hpp"
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Mesh
+{
+
+  /**
+   * Strided view of accessor data in a buffer view of glb file.
+   */
+  struct Accessor
+  {
+    uint32_t buffer_view; ///< index of buffer view
+    uint32_t offset;      ///< byte offset in buffer view
+    uint32_t stride;      ///< byte stride between elements
+    uint32_t count;       ///< number of elements
+    VkFormat format;      ///< element format
+  };
+
+  /**
+   * Triangle list of a glTF mesh.
+   */
+  struct Primitive
+  {
+    std::array<std::optional<Accessor>, 4> attributes; ///< indexed by location of Mesh::Vertex
+    std::optional<Accessor>                indices;    ///< empty if primitive is not indexed
+    VkIndexType                            index_type = VK_INDEX_TYPE_UINT32;
+    int32_t                                material   = -1;
+    Bounds                                 bounds     = {}; ///< of positions before node transform
+  };
+
+  /**
+   * glTF mesh.
+   */
+  struct GltfMesh
+  {
+    std::vector<Primitive> primitives;
+  };
+
+  /**
+   * Node referencing a mesh, the transform is already resolved to world space.
+   */
+  struct GltfNode
+  {
+    glm::mat4 transform;
+    uint32_t  mesh;
+  };
+
+  /**
+   * Encoded image, embedded in a buffer view or an external file.
+   */
+  struct GltfImage
+  {
+    std::optional<uint32_t> buffer_view; ///< index of buffer view holding image
+    std::string             path;        ///< file resolved against directory of glb, empty if embedded or a data URI
+  };
+
+  /**
+   * Material, only its base color texture is read.
+   */
+  struct GltfMaterial
+  {
+    int32_t base_color_image = -1; ///< index of image, -1 if untextured
+  };
+
+  /**
+   * glTF binary file.
+   * Buffer views point into the mapped file, so they are valid as long as this object lives.
+   */
+  class GlbFile final
+  {
+  public:
+    /**
+     * Load glb file.
+     * Only the embedded binary buffer is supported.
+     *
+     * @param filename glb file name.
+     * @throw std::runtime_error if failed to read or parse file.
+     */
+    GlbFile(std::string_view filename);
+
+    /**
+     * Get data of buffer view.
+     *
+     * @param index index of buffer view.
+     * @return data in mapped file.
+     */
+    auto buffer_view(uint32_t index) const -> std::span<const std::byte> { return _buffer_views[index]; }
+
+    auto buffer_view_count() const noexcept { return (uint32_t)_buffer_views.size(); }
+    auto& meshes()    const noexcept { return _meshes; }
+    auto& nodes()     const noexcept { return _nodes; }
+    auto& images()    const noexcept { return _images; }
+    auto& materials() const noexcept { return _materials; }
+    auto  material_count() const noexcept { return (uint32_t)_materials.size(); }
+
+  private:
+    Util::MappedFile                        _file;
+    std::vector<std::span<const std::byte>> _buffer_views;
+    std::vector<GltfMesh>                   _meshes;
+    std::vector<GltfNode>                   _nodes;
+    std::vector<GltfImage>                  _images;
+    std::vector<GltfMaterial>               _materials;
+  };
+
+}
@@ -0,0 +1,146 @@
+/*===-- include/ImageTracker.hpp ----- Image Tracker ----------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare synchronization state of resources and the tracker of  *|
+|* image layouts and accesses per subresource, which batches transitions into *|
+|* single barriers.                                                           *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Vulkan
+{
+
+  /**
+   * Synchronization scope of a use of resource, layout is ignored by buffers.
+   */
+  struct Access
+  {
+    VkPipelineStageFlags2 stage  = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2        access = VK_ACCESS_2_NONE;
+    VkImageLayout         layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  };
+
+  /**
+   * Accesses writing memory, uses with any of them wait for every use before them.
+   */
+  constexpr VkAccessFlags2 Write_Access = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+                                          VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                          VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+  /**
+   * Accumulated synchronization of resource or subresource between its uses.
+   */
+  struct SyncState
+  {
+    VkPipelineStageFlags2 write_stage    = VK_PIPELINE_STAGE_2_NONE; ///< stage of last write
+    VkAccessFlags2        write_access   = VK_ACCESS_2_NONE;
+    VkPipelineStageFlags2 read_stage     = VK_PIPELINE_STAGE_2_NONE; ///< stages reading since last write
+    VkPipelineStageFlags2 visible_stage  = VK_PIPELINE_STAGE_2_NONE; ///< stages last write is visible to
+    VkAccessFlags2        visible_access = VK_ACCESS_2_NONE;
+    VkImageLayout         layout         = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    /**
+     * Advance state to next use, reads only wait for writes not yet visible to them,
+     * writes and layout transitions wait for every use before them.
+     *
+     * @param access     next use.
+     * @param transition whether use changes layout to its own.
+     * @return scopes barrier before use must cover, dst stage is none if no barrier is needed.
+     */
+    auto use(const Access& access, bool transition) -> VkMemoryBarrier2;
+  };
+
+  /**
+   * Tracker of layout, stages and accesses of every level and layer of images.
+   * Uses queue barriers only for subresources needing them, flush records all queued ones
+   * in one vkCmdPipelineBarrier2, with neighboring subresources of same state merged into one range.
+   * It is not thread safe, use one tracker per command buffer.
+   */
+  class ImageTracker final
+  {
+  public:
+    /**
+     * Start tracking image, all its subresources are in same state.
+     *
+     * @param image   image.
+     * @param aspect  aspects barriers cover, both of depth stencil formats.
+     * @param levels  mip levels.
+     * @param layers  array layers.
+     * @param visible layout, stages and accesses subresources are already visible to.
+     */
+    void track(VkImage image, VkImageAspectFlags aspect, uint32_t levels, uint32_t layers, const Access& visible = {});
+
+    /**
+     * Stop tracking image.
+     *
+     * @param image image.
+     */
+    void forget(VkImage image);
+
+    /**
+     * Declare use of subresources, barrier is queued if any of them needs one.
+     * Subresources used again before flush must keep layout of first use.
+     *
+     * @param image       tracked image.
+     * @param access      stages, accesses and layout of use.
+     * @param level       first mip level.
+     * @param level_count mip levels, VK_REMAINING_MIP_LEVELS for all after first.
+     * @param layer       first array layer.
+     * @param layer_count array layers, VK_REMAINING_ARRAY_LAYERS for all after first.
+     * @throw std::runtime_error if image is not tracked or pending subresource changes layout again.
+     */
+    void use(VkImage image, const Access& access, uint32_t level = 0, uint32_t level_count = VK_REMAINING_MIP_LEVELS,
+             uint32_t layer = 0, uint32_t layer_count = VK_REMAINING_ARRAY_LAYERS);
+
+    /**
+     * Record queued barriers in one call, nothing is recorded if none is queued.
+     *
+     * @param command_buffer command buffer.
+     */
+    void flush(VkCommandBuffer command_buffer);
+
+    /**
+     * Get current layout of subresource.
+     *
+     * @param image tracked image.
+     * @param level mip level.
+     * @param layer array layer.
+     * @return layout, including queued transitions.
+     */
+    auto layout(VkImage image, uint32_t level = 0, uint32_t layer = 0) const -> VkImageLayout;
+
+  private:
+    struct Subresource
+    {
+      SyncState state;
+      uint32_t  barrier = -1; ///< queued barrier covering it
+    };
+
+    struct Image
+    {
+      VkImageAspectFlags       aspect;
+      uint32_t                 levels;
+      uint32_t                 layers;
+      std::vector<Subresource> subresources; ///< level changes fastest
+    };
+
+    std::unordered_map<VkImage, Image>               _images;
+    std::vector<VkImageMemoryBarrier2>               _barriers;
+    std::vector<std::pair<VkImage, uint32_t>>        _pending;  ///< subresources covered by queued barriers
+  };
+
+}
@@ -0,0 +1,97 @@
+/*===-- include/Json.hpp ------- Json -------------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare the minimal JSON document used by asset loaders.       *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace Json
+{
+
+  /**
+   * JSON value, read only after parsed.
+   */
+  class Value
+  {
+  public:
+    using Array  = std::vector<Value>;
+    using Object = std::map<std::string, Value, std::less<>>;
+
+    Value() = default;
+    Value(bool b)              : _value(b)                      {}
+    Value(double number)       : _value(number)                 {}
+    Value(std::string string)  : _value(std::move(string))      {}
+    Value(Array array)         : _value(std::move(array))       {}
+    Value(Object object)       : _value(std::move(object))      {}
+
+    auto is_null()   const noexcept { return std::holds_alternative<std::monostate>(_value); }
+    auto is_number() const noexcept { return std::holds_alternative<double>(_value); }
+    auto is_string() const noexcept { return std::holds_alternative<std::string>(_value); }
+    auto is_array()  const noexcept { return std::holds_alternative<Array>(_value); }
+    auto is_object() const noexcept { return std::holds_alternative<Object>(_value); }
+
+    /**
+     * Get member of object.
+     *
+     * @param key member name.
+     * @return member, or null value if not object or member not exist.
+     */
+    auto operator[](std::string_view key) const -> const Value&;
+
+    /**
+     * Get element of array.
+     *
+     * @param index element index.
+     * @return element, or null value if not array or out of range.
+     */
+    auto operator[](size_t index) const -> const Value&;
+
+    /**
+     * Check whether object has member.
+     *
+     * @param key member name.
+     * @return true if object has member.
+     */
+    auto contains(std::string_view key) const -> bool;
+
+    /**
+     * Get number of elements of array or members of object.
+     *
+     * @return size, 0 for other types.
+     */
+    auto size() const -> size_t;
+
+    auto as_bool(bool fallback = false)               const -> bool;
+    auto as_number(double fallback = 0.0)             const -> double;
+    auto as_int(int64_t fallback = 0)                 const -> int64_t;
+    auto as_string(std::string_view fallback = "")    const -> std::string_view;
+    auto as_array()                                   const -> const Array&;
+    auto as_object()                                  const -> const Object&;
+
+  private:
+    std::variant<std::monostate, bool, double, std::string, Array, Object> _value;
+  };
+
+  /**
+   * Parse JSON text.
+   *
+   * @param text JSON text.
+   * @return root value.
+   * @throw std::runtime_error if text is invalid JSON or nested deeper than 256 levels.
+   */
+  Value parse(std::string_view text);
+
+}
@@ -0,0 +1,145 @@
+/*===-- include/Ktx2.hpp ------- Ktx2 -------------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare the reader of KTX2 textures, block compressed payloads *|
+|* are read as is and Basis Universal ones are transcoded.                    *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace basist
+{
+  class ktx2_transcoder;
+}
+
+namespace Ktx2
+{
+
+  /**
+   * Formats Basis Universal textures are transcoded to, in order of preference.
+   */
+  enum class Target
+  {
+    BC7,
+    ASTC_4x4,
+    ETC2,
+    BC3,
+    RGBA8,
+  };
+
+  /**
+   * Get format of textures transcoded to target.
+   *
+   * @param target transcode target.
+   * @param srgb   whether texels are sRGB encoded colors.
+   * @return format.
+   */
+  VkFormat get_format(Target target, bool srgb) noexcept;
+
+  /**
+   * Check identifier of KTX2 file.
+   *
+   * @param data content of file.
+   * @return whether data is KTX2.
+   */
+  bool is_ktx2(std::span<const std::byte> data) noexcept;
+
+  /**
+   * Decode image, generate its full mip chain by a box filter and write it as KTX2 file of RGBA8 levels,
+   * which loader uploads as they are. Colors of sRGB images are filtered in linear space.
+   * The file is written to a temporary name first, so readers never see a partial file.
+   *
+   * @param source      image file stb_image decodes.
+   * @param destination KTX2 file name.
+   * @param srgb        whether texels are sRGB encoded colors.
+   * @throw std::runtime_error if failed to decode source or write destination.
+   */
+  void bake(std::string_view source, std::string_view destination, bool srgb);
+
+  /**
+   * Reader of 2D KTX2 textures and all their stored mip levels.
+   * Payloads of BCn, ETC2, EAC, ASTC or RGBA8 formats are read as is, Zstandard supercompression included,
+   * Basis Universal payloads of undefined format are transcoded to target.
+   * Levels are packed one after another, each aligned to 16 bytes which covers block size of every format.
+   */
+  class Reader final
+  {
+  public:
+    /**
+     * Parse header and level index, data must outlive reader.
+     *
+     * @param data   content of KTX2 file.
+     * @param name   name of texture in errors.
+     * @param target format Basis Universal payloads are transcoded to.
+     * @param srgb   whether transcoded texels are sRGB encoded colors, stored formats keep their own.
+     * @throw std::runtime_error if file is invalid, not 2D, of unsupported format or asks to generate levels of a compressed one.
+     */
+    Reader(std::span<const std::byte> data, std::string_view name, Target target, bool srgb);
+
+    ~Reader();
+
+    Reader(const Reader&)            = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    /**
+     * Write all levels.
+     *
+     * @param result size() bytes.
+     * @throw std::runtime_error if result is too small, or decompression or transcoding fails.
+     */
+    void read(std::span<std::byte> result) const;
+
+    auto format() const noexcept { return _format; }
+    auto extent() const noexcept { return _extent; }
+    auto levels() const noexcept { return (uint32_t)_offsets.size(); }
+    auto size()   const noexcept { return _size; }
+
+    /**
+     * @return whether file stores level 0 of an uncompressed format only and asks loader to generate the others.
+     */
+    auto generate_levels() const noexcept { return _generate_levels; }
+
+    /**
+     * @param level mip level.
+     * @return offset of level in result of read.
+     */
+    auto offset(uint32_t level) const noexcept { return _offsets[level]; }
+
+  private:
+    struct Level
+    {
+      uint64_t offset;
+      uint64_t length;
+      uint64_t uncompressed_length;
+    };
+
+    std::span<const std::byte>               _data;
+    std::string                              _name;
+    Target                                   _target;
+    VkFormat                                 _format = VK_FORMAT_UNDEFINED;
+    VkExtent2D                               _extent = {};
+    uint32_t                                 _supercompression = 0;
+    bool                                     _generate_levels  = false;
+    std::vector<Level>                       _levels;
+    std::vector<VkDeviceSize>                _offsets;
+    VkDeviceSize                             _size = 0;
+    std::unique_ptr<basist::ktx2_transcoder> _transcoder; ///< only for Basis Universal payloads
+  };
+
+}
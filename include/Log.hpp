@@ -12,6 +12,7 @@
 #pragma once
 
 #include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
 
 #include <string_view>
 
@@ -21,6 +22,7 @@ namespace Log
   {
     friend void error(std::string_view msg);
     friend void info(std::string_view msg);
+    friend void use_stderr();
 
     static Log& instance() noexcept
     {
@@ -42,6 +44,12 @@ namespace Log
     {
       spdlog::info(msg.data());
     }
+
+    void use_stderr()
+    {
+      spdlog::set_default_logger(spdlog::stderr_color_mt("stderr"));
+      spdlog::set_pattern("%^%L:%$ %v");
+    }
   };
 
   /**
@@ -63,4 +71,13 @@ namespace Log
   {
     Log::instance().info(msg);
   }
+
+  /**
+   * Log to standard error instead of standard output, e.g. when standard output
+   * carries data.
+   */
+  inline void use_stderr()
+  {
+    Log::instance().use_stderr();
+  }
 }
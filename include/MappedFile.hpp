@@ -0,0 +1,52 @@
+/*===-- include/MappedFile.hpp ----- Mapped File --------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare the read only memory mapped file.                      *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+namespace Util
+{
+
+  /**
+   * Map whole file into memory as read only.
+   */
+  class MappedFile final
+  {
+  public:
+    /**
+     * Map file.
+     *
+     * @param filename file name.
+     * @throw std::runtime_error if failed to open or map file.
+     */
+    MappedFile(std::string_view filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    auto data() const noexcept { return _data; }
+    auto size() const noexcept { return _size; }
+
+    auto bytes() const noexcept { return std::span<const std::byte>(_data, _size); }
+    auto text()  const noexcept { return std::string_view(reinterpret_cast<const char*>(_data), _size); }
+
+  private:
+    const std::byte* _data = nullptr;
+    size_t           _size = 0;
+  };
+
+}
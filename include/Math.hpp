@@ -0,0 +1,80 @@
+/*===-- include/Math.hpp ------- Math -------------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare the batch kernels of matrix math with scalar, AVX2 and *|
+|* NEON paths.                                                                *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#include "Mesh.hpp"
+#include "Util.hpp"
+
+#include <glm/glm.hpp>
+
+#include <span>
+
+namespace Math
+{
+
+  using Util::Isa;
+  using Util::get_isa;
+
+  /**
+   * Multiply matrices pairwise, result[i] = a[i] * b[i].
+   * SSE has no dedicated kernel and runs scalar path.
+   *
+   * @param a left matrices.
+   * @param b right matrices, same size as a.
+   * @param result products, same size as b, may alias a or b.
+   * @param isa instruction set.
+   */
+  void multiply(std::span<const glm::mat4> a, std::span<const glm::mat4> b, std::span<glm::mat4> result, Isa isa = get_isa());
+
+  /**
+   * Premultiply matrices, result[i] = a * b[i], e.g. view projection of world matrices.
+   *
+   * @param a left matrix.
+   * @param b right matrices.
+   * @param result products, same size as b, may alias b.
+   * @param isa instruction set.
+   */
+  void multiply(const glm::mat4& a, std::span<const glm::mat4> b, std::span<glm::mat4> result, Isa isa = get_isa());
+
+  /**
+   * Invert affine matrices, whose last row is (0, 0, 0, 1).
+   *
+   * @param matrices invertible affine matrices.
+   * @param result inverses, same size as matrices, may alias matrices.
+   * @param isa instruction set.
+   */
+  void inverse_affine(std::span<const glm::mat4> matrices, std::span<glm::mat4> result, Isa isa = get_isa());
+
+  /**
+   * Transform boxes pairwise and bound the results with axis aligned boxes.
+   *
+   * @param matrices affine matrices, same size as bounds.
+   * @param bounds finite boxes.
+   * @param result transformed boxes, same size as bounds, may alias bounds.
+   * @param isa instruction set.
+   */
+  void transform_bounds(std::span<const glm::mat4> matrices, std::span<const Mesh::Bounds> bounds,
+                        std::span<Mesh::Bounds> result, Isa isa = get_isa());
+
+  /**
+   * Transform boxes by one matrix and bound the results with axis aligned boxes.
+   *
+   * @param matrix affine matrix.
+   * @param bounds finite boxes.
+   * @param result transformed boxes, same size as bounds, may alias bounds.
+   * @param isa instruction set.
+   */
+  void transform_bounds(const glm::mat4& matrix, std::span<const Mesh::Bounds> bounds,
+                        std::span<Mesh::Bounds> result, Isa isa = get_isa());
+
+}
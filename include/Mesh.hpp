@@ -0,0 +1,436 @@
+/*===-- include/Mesh.hpp ------- Mesh -------------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare the mesh data and mesh loaders.                        *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace Mesh
+{
+
+  /**
+   * Vertex input layout of pipeline, attribute location follows Mesh::Vertex.
+   */
+  struct VertexLayout
+  {
+    std::vector<VkVertexInputBindingDescription>   bindings;
+    std::vector<VkVertexInputAttributeDescription> attributes;
+
+    bool operator==(const VertexLayout& other) const;
+
+    /**
+     * Get layout with only position attribute and its binding, for depth only pipelines.
+     * Position must be at binding 0, so vertex buffers of the full layout can be bound unchanged.
+     *
+     * @return position layout.
+     */
+    VertexLayout get_position_layout() const;
+  };
+
+  /**
+   * Vertex of mesh.
+   */
+  struct Vertex
+  {
+    glm::vec3 position; ///< location 0
+    glm::vec3 color;    ///< location 1
+    glm::vec3 normal;   ///< location 2
+    glm::vec2 uv;       ///< location 3
+
+    static constexpr auto get_attribute_descriptions() -> std::array<VkVertexInputAttributeDescription, 4>
+    {
+      return
+      {
+        VkVertexInputAttributeDescription
+        {
+          .location = 0,
+          .binding  = 0,
+          .format   = VK_FORMAT_R32G32B32_SFLOAT,
+          .offset   = offsetof(Vertex, position),
+        },
+        VkVertexInputAttributeDescription
+        {
+          .location = 1,
+          .binding  = 0,
+          .format   = VK_FORMAT_R32G32B32_SFLOAT,
+          .offset   = offsetof(Vertex, color),
+        },
+        VkVertexInputAttributeDescription
+        {
+          .location = 2,
+          .binding  = 0,
+          .format   = VK_FORMAT_R32G32B32_SFLOAT,
+          .offset   = offsetof(Vertex, normal),
+        },
+        VkVertexInputAttributeDescription
+        {
+          .location = 3,
+          .binding  = 0,
+          .format   = VK_FORMAT_R32G32_SFLOAT,
+          .offset   = offsetof(Vertex, uv),
+        },
+      };
+    }
+
+    static constexpr auto get_binding_description()
+    {
+      return VkVertexInputBindingDescription
+      {
+        .binding   = 0,
+        .stride    = sizeof(Vertex),
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+      };
+    }
+
+    static auto get_layout()
+    {
+      auto attributes = get_attribute_descriptions();
+      return VertexLayout
+      {
+        .bindings   = { get_binding_description() },
+        .attributes = { attributes.begin(), attributes.end() },
+      };
+    }
+  };
+
+  /**
+   * Axis aligned bounding box.
+   */
+  struct Bounds
+  {
+    glm::vec3 min;
+    glm::vec3 max;
+  };
+
+  enum class PositionFormat { Float32, Float16, SNorm16 };
+  enum class ColorFormat    { Float32, UNorm8 };
+  enum class NormalFormat   { Float32, Octahedral16, Octahedral8 };
+  enum class UVFormat       { Float32, Float16 };
+
+  /**
+   * Storage format of each vertex attribute.
+   * SNorm16 positions are normalized to bounds of mesh and dequantized by the draw transform,
+   * octahedral normals are two signed normalized components decoded in vertex shader,
+   * normals of SNorm16 positions are stored scaled by extent so the dequantize transform keeps them right.
+   */
+  struct VertexFormat
+  {
+    PositionFormat position = PositionFormat::Float32;
+    ColorFormat    color    = ColorFormat::Float32;
+    NormalFormat   normal   = NormalFormat::Float32;
+    UVFormat       uv       = UVFormat::Float32;
+    bool           split_position = true; ///< positions in own stream at binding 0, others interleaved at binding 1
+
+    bool operator==(const VertexFormat&) const = default;
+  };
+
+  /**
+   * Vertex layout generated from vertex format.
+   * Streams are stored one after another, each starts at 16-byte aligned offset.
+   */
+  struct PackedLayout
+  {
+    VertexFormat            format;
+    uint32_t                stride;   ///< bytes per vertex of all streams
+    std::array<uint32_t, 4> offsets;  ///< byte offset of each attribute in its stream, indexed by location
+    std::vector<uint32_t>   strides;  ///< stride of each stream, indexed by binding
+    VertexLayout            layout;
+
+    /**
+     * Get byte offset of stream.
+     *
+     * @param binding binding of stream.
+     * @param vertex_count number of vertices.
+     * @return byte offset from the first stream.
+     */
+    VkDeviceSize get_stream_offset(uint32_t binding, uint32_t vertex_count) const;
+
+    /**
+     * Get byte size of all streams.
+     *
+     * @param vertex_count number of vertices.
+     * @return byte size.
+     */
+    VkDeviceSize get_size(uint32_t vertex_count) const;
+  };
+
+  /**
+   * Cluster of triangles small enough to have 8-bit local indices.
+   */
+  struct Meshlet
+  {
+    uint32_t vertex_offset;   ///< first element in MeshletData::vertices
+    uint32_t triangle_offset; ///< first element in MeshletData::triangles
+    uint32_t vertex_count;
+    uint32_t triangle_count;
+  };
+
+  /**
+   * Meshlets of a mesh.
+   */
+  struct MeshletData
+  {
+    std::vector<Meshlet>  meshlets;
+    std::vector<uint32_t> vertices;  ///< mesh vertex index of each meshlet vertex
+    std::vector<uint8_t>  triangles; ///< local indices into meshlet vertices, 3 per triangle
+  };
+
+  /**
+   * Indexed triangle list.
+   */
+  struct MeshData
+  {
+    std::vector<Vertex>   vertices;
+    std::vector<uint32_t> indices;
+  };
+
+  /**
+   * Destination of loaded mesh, usually mapped stage buffers.
+   */
+  struct MeshSpans
+  {
+    std::span<Vertex>   vertices;
+    std::span<uint32_t> indices;
+  };
+
+  /**
+   * Provide destination memory for loader after the final vertex and index count is known.
+   * Returned spans must have at least vertex_count and index_count elements.
+   */
+  using MeshAllocator = std::function<MeshSpans(uint32_t vertex_count, uint32_t index_count)>;
+
+  /**
+   * Level of detail, a range of triangles in the index buffer of a mesh.
+   */
+  struct Lod
+  {
+    uint32_t first_index;
+    uint32_t index_count;
+    float    error;       ///< max distance of simplified surface to original, in mesh units
+  };
+
+  /**
+   * Post transform vertex cache efficiency of index buffer.
+   */
+  struct VertexCacheStatistics
+  {
+    float acmr; ///< average cache miss ratio, transformed vertices per triangle
+    float atvr; ///< average transformed vertex ratio, transformed vertices per vertex
+  };
+
+  /**
+   * Get the builtin quad.
+   *
+   * @return quad mesh.
+   */
+  MeshData quad();
+
+  /**
+   * Load Wavefront OBJ file.
+   * The file is mapped and parsed in parallel, vertices are deduplicated
+   * and written straight into the memory returned by allocate.
+   *
+   * @param filename OBJ file name.
+   * @param allocate provide destination memory.
+   * @return bounds of positions, so callers need not read back destination memory.
+   * @throw std::runtime_error if failed to read or parse file.
+   */
+  Bounds load_obj(std::string_view filename, const MeshAllocator& allocate);
+
+  /**
+   * Load Wavefront OBJ file into mesh data.
+   *
+   * @param filename OBJ file name.
+   * @return mesh data.
+   * @throw std::runtime_error if failed to read or parse file.
+   */
+  MeshData load_obj(std::string_view filename);
+
+  /**
+   * Simulate FIFO post transform vertex cache.
+   *
+   * @param indices triangle list.
+   * @param vertex_count number of vertices.
+   * @param cache_size number of cache entries.
+   * @return cache statistics.
+   */
+  VertexCacheStatistics analyze_vertex_cache(std::span<const uint32_t> indices, uint32_t vertex_count, uint32_t cache_size = 16);
+
+  /**
+   * Reorder triangles to reuse post transform vertex cache, using Forsyth's algorithm.
+   *
+   * @param indices triangle list, reordered in place.
+   * @param vertex_count number of vertices.
+   */
+  void optimize_vertex_cache(std::span<uint32_t> indices, uint32_t vertex_count);
+
+  /**
+   * Reorder clusters of cache optimized triangles to reduce overdraw, like Tipsify.
+   * Clusters are split where vertex cache restarts, outward facing clusters are drawn first.
+   *
+   * @param indices cache optimized triangle list, reordered in place.
+   * @param vertices vertices.
+   * @param threshold max ACMR degradation allowed when splitting clusters.
+   */
+  void optimize_overdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices, float threshold = 1.05f);
+
+  /**
+   * Reorder vertices by first use in index buffer, unused vertices are removed.
+   *
+   * @param vertices vertices, reordered in place.
+   * @param indices triangle list, remapped in place.
+   * @return number of used vertices.
+   */
+  uint32_t optimize_vertex_fetch(std::span<Vertex> vertices, std::span<uint32_t> indices);
+
+  /**
+   * Run vertex cache, overdraw and vertex fetch optimization.
+   *
+   * @param mesh mesh, optimized in place.
+   * @return cache statistics before and after optimization.
+   */
+  std::pair<VertexCacheStatistics, VertexCacheStatistics> optimize(MeshData& mesh);
+
+  /**
+   * Run vertex cache, overdraw and vertex fetch optimization on memory the mesh was loaded into.
+   *
+   * @param mesh mesh, optimized in place, vertices shrink to the used ones.
+   * @return cache statistics before and after optimization.
+   */
+  std::pair<VertexCacheStatistics, VertexCacheStatistics> optimize(MeshSpans& mesh);
+
+  /**
+   * Simplify triangle list by quadric error edge collapse, vertices are collapsed onto
+   * neighbours so the result still indexes the original vertices.
+   * Border, non-manifold and attribute seam vertices never move.
+   *
+   * @param vertices vertices.
+   * @param indices triangle list.
+   * @param target_index_count stop when reaching this index count.
+   * @param target_error stop when any collapse would move the surface further, in mesh units.
+   * @param result_error if not null, receive max error of the result.
+   * @return simplified triangle list.
+   */
+  std::vector<uint32_t> simplify(std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+                                 uint32_t target_index_count, float target_error, float* result_error = nullptr);
+
+  /**
+   * Generate LOD chain, each level simplified from the previous one.
+   * Run after optimize, new levels are cache optimized and appended to mesh indices.
+   *
+   * @param mesh mesh, indices are extended.
+   * @param max_lods max number of levels including the original.
+   * @param ratio index count ratio of each level to the previous one.
+   * @return levels from finest to coarsest, first one is the original.
+   */
+  std::vector<Lod> generate_lods(MeshData& mesh, uint32_t max_lods = 4, float ratio = 0.5f);
+
+  /**
+   * Generate LOD chain into fixed memory, the chain ends early at a level that doesn't fit.
+   *
+   * @param vertices vertices.
+   * @param indices original triangle list in its first index_count elements, levels are written after it.
+   * @param index_count number of original indices.
+   * @param max_lods max number of levels including the original.
+   * @param ratio index count ratio of each level to the previous one.
+   * @return levels from finest to coarsest, first one is the original.
+   */
+  std::vector<Lod> generate_lods(std::span<const Vertex> vertices, std::span<uint32_t> indices, uint32_t index_count,
+                                 uint32_t max_lods = 4, float ratio = 0.5f);
+
+  /**
+   * Get bounding box of vertices.
+   *
+   * @param vertices vertices.
+   * @return bounding box.
+   */
+  Bounds compute_bounds(std::span<const Vertex> vertices);
+
+  /**
+   * Generate stream layout and attribute descriptions of vertex format.
+   *
+   * @param format vertex format.
+   * @return packed layout.
+   */
+  PackedLayout get_packed_layout(const VertexFormat& format);
+
+  /**
+   * Quantize vertices into packed layout.
+   *
+   * @param vertices vertices.
+   * @param layout packed layout.
+   * @param dst destination, at least layout.get_size(vertices.size()) bytes.
+   * @return transform to dequantize positions, identity unless positions are normalized.
+   */
+  glm::mat4 quantize(std::span<const Vertex> vertices, const PackedLayout& layout, std::byte* dst);
+
+  /**
+   * Get smallest index type able to address vertices, primitive restart is not used.
+   *
+   * @param vertex_count number of vertices.
+   * @return VK_INDEX_TYPE_UINT16 or VK_INDEX_TYPE_UINT32.
+   */
+  VkIndexType get_index_type(uint32_t vertex_count);
+
+  /**
+   * Get size of index type.
+   *
+   * @param type index type.
+   * @return size in bytes.
+   */
+  uint32_t get_index_size(VkIndexType type);
+
+  /**
+   * Write indices with index type.
+   *
+   * @param indices indices.
+   * @param type index type, all indices must fit.
+   * @param dst destination, at least get_index_size(type) * indices.size() bytes.
+   */
+  void pack_indices(std::span<const uint32_t> indices, VkIndexType type, std::byte* dst);
+
+  /**
+   * Split triangle list into meshlets in index order, run after vertex cache optimization for good locality.
+   *
+   * @param indices triangle list.
+   * @param max_vertices max vertices per meshlet, at most 256.
+   * @param max_triangles max triangles per meshlet.
+   * @return meshlets.
+   */
+  MeshletData build_meshlets(std::span<const uint32_t> indices, uint32_t max_vertices = 64, uint32_t max_triangles = 124);
+
+  /**
+   * Compress indices with delta, zigzag and varint coding.
+   * Cache optimized index buffers usually cost one or two bytes per index.
+   *
+   * @param indices indices.
+   * @return encoded bytes.
+   */
+  std::vector<uint8_t> encode_indices(std::span<const uint32_t> indices);
+
+  /**
+   * Decompress indices encoded by encode_indices.
+   *
+   * @param data encoded bytes.
+   * @param indices destination, size must be the number of encoded indices.
+   * @throw std::runtime_error if data is truncated or corrupted.
+   */
+  void decode_indices(std::span<const uint8_t> data, std::span<uint32_t> indices);
+
+}
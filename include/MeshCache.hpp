@@ -0,0 +1,167 @@
+/*===-- include/MeshCache.hpp ----- Mesh Cache ----------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare the preprocessed binary mesh cache, which is mapped    *|
+|* and uploaded section by section without parsing.                           *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#include "Mesh.hpp"
+#include "MappedFile.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace Mesh
+{
+
+  constexpr std::array<char, 4> Cache_Magic   = { 'M', 'S', 'H', 'C' };
+  constexpr uint32_t            Cache_Version = 3;
+  constexpr uint64_t            Cache_Align   = 64; ///< alignment of sections in file
+
+  enum class SectionType     : uint32_t { Vertices, Indices, Meshlets, MeshletVertices, MeshletTriangles, Lods };
+  enum class SectionEncoding : uint32_t { Raw, IndexCodec };
+
+  /**
+   * Entry of section table, which follows the header.
+   */
+  struct CacheSection
+  {
+    SectionType     type;
+    SectionEncoding encoding;
+    uint64_t        offset;   ///< byte offset in file
+    uint64_t        size;     ///< byte size in file
+  };
+
+  static_assert(sizeof(CacheSection) == 24 && offsetof(CacheSection, offset) == 8, "section table layout is on disk");
+
+  /**
+   * Header at the start of cache file.
+   * Fields have fixed widths and no padding, so the file is the same whatever compiler baked it.
+   */
+  struct CacheHeader
+  {
+    std::array<char, 4>    magic;
+    uint32_t               version;
+    uint64_t               checksum;        ///< hash of fields except checksum, then section table
+    uint8_t                position_format; ///< PositionFormat of packed vertices
+    uint8_t                color_format;    ///< ColorFormat
+    uint8_t                normal_format;   ///< NormalFormat
+    uint8_t                uv_format;       ///< UVFormat
+    uint8_t                split_position;
+    std::array<uint8_t, 3> reserved;        ///< zero
+    uint32_t               index_type;      ///< VkIndexType of raw indices, and of indices in geometry buffer
+    uint32_t               vertex_count;
+    uint32_t               index_count;     ///< indices of all LODs
+    uint32_t               section_count;
+    glm::mat4              transform;       ///< dequantization transform of vertices
+    Bounds                 bounds;
+
+    auto format() const noexcept
+    {
+      return VertexFormat
+      {
+        .position       = (PositionFormat)position_format,
+        .color          = (ColorFormat)color_format,
+        .normal         = (NormalFormat)normal_format,
+        .uv             = (UVFormat)uv_format,
+        .split_position = split_position != 0,
+      };
+    }
+
+    void set_format(const VertexFormat& format) noexcept
+    {
+      position_format = (uint8_t)format.position;
+      color_format    = (uint8_t)format.color;
+      normal_format   = (uint8_t)format.normal;
+      uv_format       = (uint8_t)format.uv;
+      split_position  = format.split_position;
+    }
+
+    auto get_index_type() const noexcept { return (VkIndexType)index_type; }
+  };
+
+  static_assert(sizeof(CacheHeader) == 128 && offsetof(CacheHeader, index_type) == 24 &&
+                offsetof(CacheHeader, transform) == 40 && offsetof(CacheHeader, bounds) == 104, "header layout is on disk");
+
+  /**
+   * Options of baking mesh into cache.
+   */
+  struct BakeOptions
+  {
+    VertexFormat format;                  ///< storage format of vertices
+    uint32_t     max_lods         = 4;    ///< LOD levels including the original, 1 disables
+    bool         compress_indices = false; ///< store indices with index codec, smaller file but decoded at load
+  };
+
+  /**
+   * Load, optimize and simplify OBJ or glb file, then write it into cache file.
+   * Primitives of all glb nodes are merged into one mesh in world space.
+   * The file is written to a temporary name first, so readers never see a partial file.
+   *
+   * @param source OBJ or glb file name.
+   * @param destination cache file name.
+   * @param options bake options.
+   * @throw std::runtime_error if failed to load source or write destination.
+   */
+  void bake_mesh(std::string_view source, std::string_view destination, const BakeOptions& options = {});
+
+  /**
+   * Mapped mesh cache file.
+   * Sections point into the mapped file, so they are valid as long as this object lives.
+   */
+  class MeshCache final
+  {
+  public:
+    /**
+     * Map and validate cache file.
+     *
+     * @param filename cache file name.
+     * @throw std::runtime_error if file is not a valid cache of current version.
+     */
+    MeshCache(std::string_view filename);
+
+    auto& header() const noexcept { return *_header; }
+
+    /**
+     * Get data of section.
+     *
+     * @param type section type.
+     * @return data in mapped file, empty if absent.
+     */
+    auto section(SectionType type) const -> std::span<const std::byte>;
+
+    /**
+     * Write indices of all LODs with header index type.
+     *
+     * @param dst destination, at least get_index_size(index_type) * index_count bytes, 4-byte aligned.
+     * @throw std::runtime_error if compressed indices are corrupted.
+     */
+    void read_indices(std::byte* dst) const;
+
+    /**
+     * Get LODs, first one is the original mesh, ranges are validated at construction.
+     *
+     * @return LODs.
+     */
+    auto lods() const -> std::vector<Lod>;
+
+  private:
+    auto find(SectionType type) const -> const CacheSection*;
+
+    Util::MappedFile                  _file;
+    const CacheHeader*                _header = nullptr;
+    std::span<const CacheSection>     _sections;
+  };
+
+}
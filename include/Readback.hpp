@@ -0,0 +1,100 @@
+/*===-- include/Readback.hpp ----- Readback -------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare the ring of host cached buffers rendered images are    *|
+|* copied to and delivered from once their frame completed.                   *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include "VmaUsage.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace Vulkan
+{
+
+  /**
+   * Image read back from GPU.
+   */
+  struct ReadbackFrame
+  {
+    std::span<const std::byte> data;   ///< rows tightly packed, only valid during callback
+    VkExtent2D                 extent;
+    VkFormat                   format;
+    uint64_t                   frame;  ///< number of frame it was rendered in
+  };
+
+  using ReadbackCallback = std::function<void(const ReadbackFrame&)>;
+
+  /**
+   * Ring of host cached buffers with one slot per frame in flight.
+   * Each frame copies an image into its slot, the slot is read only after fence of that frame
+   * signaled on its next use, so capture never waits for GPU.
+   */
+  class Readback final
+  {
+  public:
+    /**
+     * Create buffers of ring.
+     *
+     * @param allocator  allocator of buffers.
+     * @param format     format of images, 4 bytes per texel.
+     * @param max_extent largest extent of images.
+     * @param frames     frames in flight, one slot each.
+     * @param callback   receives images in order they were rendered.
+     * @throw std::runtime_error if format is unsupported or failed to create buffers.
+     */
+    Readback(VmaAllocator allocator, VkFormat format, VkExtent2D max_extent, uint32_t frames, ReadbackCallback callback);
+    ~Readback();
+
+    Readback(const Readback&)            = delete;
+    Readback& operator=(const Readback&) = delete;
+
+    /**
+     * Record copy of image into slot and make it visible to host.
+     *
+     * @param command_buffer command buffer.
+     * @param slot           index of frame in flight.
+     * @param image          image in transfer source layout.
+     * @param extent         area copied from top left of image.
+     * @param frame          number of frame.
+     */
+    void record(VkCommandBuffer command_buffer, uint32_t slot, VkImage image, VkExtent2D extent, uint64_t frame);
+
+    /**
+     * Deliver image of slot to callback if it has one, fence of its frame must have signaled.
+     *
+     * @param slot index of frame in flight.
+     */
+    void deliver(uint32_t slot);
+
+  private:
+    struct Slot
+    {
+      VkBuffer      buffer     = VK_NULL_HANDLE;
+      VmaAllocation allocation = VK_NULL_HANDLE;
+      const void*   mapped     = nullptr;
+      VkExtent2D    extent     = {};
+      uint64_t      frame      = 0;
+      bool          pending    = false;
+    };
+
+    VmaAllocator      _allocator;
+    VkFormat          _format;
+    ReadbackCallback  _callback;
+    std::vector<Slot> _slots;
+  };
+
+}
@@ -0,0 +1,299 @@
+/*===-- include/RenderGraph.hpp ----- Render Graph ------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare the frame render graph, which derives barriers, culls  *|
+|* unused passes and aliases memory of transient images from the resources    *|
+|* passes declare.                                                            *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include "VmaUsage.h"
+#include "ImageTracker.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Vulkan
+{
+
+  /**
+   * Index of resource in render graph.
+   */
+  using ResourceId = uint32_t;
+
+  constexpr ResourceId No_Resource = -1;
+
+  /**
+   * Image owned by render graph, its memory is aliased with images of disjoint lifetime.
+   */
+  struct ImageDesc
+  {
+    VkFormat              format;
+    VkExtent2D            extent;
+    uint32_t              levels  = 1;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    VkImageUsageFlags     usage;  ///< transient attachments get own lazily allocated memory instead
+  };
+
+  /**
+   * Attachment of graphics pass.
+   */
+  struct Attachment
+  {
+    ResourceId          image;
+    VkAttachmentLoadOp  load    = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    VkAttachmentStoreOp store   = VK_ATTACHMENT_STORE_OP_STORE;
+    VkClearValue        clear   = {};
+    ResourceId          resolve = No_Resource; ///< single sample image multisampled color is averaged into
+  };
+
+  /**
+   * Frame as passes declaring the resources they read and write.
+   * Compile culls passes whose results are never used, inserts one batch of barriers
+   * before each pass and aliases memory of owned images.
+   * Every pass records into its own secondary command buffer, so they are recorded in parallel.
+   */
+  class RenderGraph final
+  {
+  public:
+    using Record = std::function<void(VkCommandBuffer)>;
+
+    /**
+     * Pass of graph, graphics pass if it has attachments, it renders to their whole extent by default.
+     */
+    class Pass
+    {
+    public:
+      /**
+       * Declare read of resource.
+       *
+       * @param resource resource.
+       * @param access   stages, accesses and layout of read.
+       * @return this pass.
+       */
+      Pass& read(ResourceId resource, const Access& access);
+
+      /**
+       * Declare write of resource, accesses may include reads.
+       *
+       * @param resource resource.
+       * @param access   stages, accesses and layout of write.
+       * @return this pass.
+       */
+      Pass& write(ResourceId resource, const Access& access);
+
+      /**
+       * Add color attachment, its accesses are declared here.
+       *
+       * @param attachment attachment.
+       * @return this pass.
+       */
+      Pass& color(const Attachment& attachment);
+
+      /**
+       * Set depth attachment, its accesses are declared here.
+       *
+       * @param attachment attachment.
+       * @return this pass.
+       */
+      Pass& depth(const Attachment& attachment);
+
+      /**
+       * Render to top left area of attachments instead of their whole extent.
+       *
+       * @param extent extent of area, read at every execution.
+       * @return this pass.
+       */
+      Pass& render_area(const VkExtent2D* extent);
+
+    private:
+      friend class RenderGraph;
+
+      struct Use
+      {
+        ResourceId resource;
+        Access     access;
+      };
+
+      /**
+       * Image barrier of compiled pass, image is looked up at execution since imported ones change.
+       */
+      struct ImageBarrier
+      {
+        ResourceId            resource;
+        VkImageMemoryBarrier2 barrier;
+      };
+
+      std::string               _name;
+      Record                    _record;
+      std::vector<Use>          _uses;
+      std::vector<Attachment>   _colors;
+      std::optional<Attachment> _depth;
+      const VkExtent2D*         _area = nullptr;
+
+      // compiled
+      bool                         _culled = false;
+      VkMemoryBarrier2             _memory_barrier;  ///< buffers and images keeping layout, none if masks are 0
+      std::vector<ImageBarrier>    _image_barriers;
+      std::vector<VkFormat>        _color_formats;   ///< inherited by secondary command buffers
+      VkFormat                     _depth_format = VK_FORMAT_UNDEFINED;
+      VkSampleCountFlagBits        _samples      = VK_SAMPLE_COUNT_1_BIT;
+      VkExtent2D                   _extent       = {};
+      std::vector<VkCommandPool>   _command_pools;   ///< per frame
+      std::vector<VkCommandBuffer> _command_buffers; ///< secondary, per frame
+
+      bool is_graphics() const noexcept { return !_colors.empty() || _depth; }
+    };
+
+    /**
+     * Create empty graph.
+     *
+     * @param device       logical device.
+     * @param allocator    allocator of owned images.
+     * @param queue_family queue family of command buffers.
+     * @param frames       frames in flight, each has its own command buffers.
+     */
+    RenderGraph(VkDevice device, VmaAllocator allocator, uint32_t queue_family, uint32_t frames);
+    ~RenderGraph();
+
+    RenderGraph(const RenderGraph&)            = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    /**
+     * Declare image owned by graph, created by compile.
+     * Its content is undefined at first use in every frame.
+     *
+     * @param name name in log.
+     * @param desc image description.
+     * @return resource.
+     */
+    auto create_image(std::string_view name, const ImageDesc& desc) -> ResourceId;
+
+    /**
+     * Declare image created outside graph, its handles are set before execution.
+     * Imported resources outlive the frame, so passes writing them are never culled.
+     *
+     * @param name    name in log.
+     * @param format  format.
+     * @param extent  extent.
+     * @param initial state at start of frame, e.g. after acquire.
+     * @param final   state after frame, e.g. present layout.
+     * @return resource.
+     */
+    auto import_image(std::string_view name, VkFormat format, VkExtent2D extent, const Access& initial, const Access& final) -> ResourceId;
+
+    /**
+     * Declare buffer created outside graph, it keeps state of last frame between frames.
+     * Buffers are synchronized by global memory barriers, so no handle is needed.
+     *
+     * @param name name in log.
+     * @return resource.
+     */
+    auto import_buffer(std::string_view name) -> ResourceId;
+
+    /**
+     * Set handles of imported image.
+     *
+     * @param resource imported image.
+     * @param image    image.
+     * @param view     view of attachment.
+     */
+    void set_image(ResourceId resource, VkImage image, VkImageView view);
+
+    /**
+     * Add pass, passes execute in order added.
+     * Returned reference is only valid until next pass is added.
+     *
+     * @param name   name in log.
+     * @param record records commands of pass, called from worker threads.
+     * @return pass to declare its resources.
+     */
+    auto add_pass(std::string_view name, Record record) -> Pass&;
+
+    /**
+     * Cull passes, allocate owned images and compute barriers.
+     *
+     * @throw std::runtime_error if failed to create image or command buffers.
+     */
+    void compile();
+
+    /**
+     * Record passes in parallel and execute them with their barriers.
+     * Previous submission of frame must have completed.
+     *
+     * @param command_buffer primary command buffer.
+     * @param frame          index of frame in flight.
+     */
+    void execute(VkCommandBuffer command_buffer, uint32_t frame);
+
+    /**
+     * Get image of resource.
+     *
+     * @param resource image.
+     * @return image.
+     */
+    auto image(ResourceId resource) const { return _resources[resource].image; }
+
+    /**
+     * Get view of all levels of resource, only depth aspect of depth stencil formats.
+     *
+     * @param resource image.
+     * @return view.
+     */
+    auto view(ResourceId resource) const { return _resources[resource].view; }
+
+  private:
+    struct Resource
+    {
+      std::string           name;
+      bool                  is_image;
+      bool                  imported;
+      ImageDesc             desc;
+      std::optional<Access> initial;   ///< state at start of frame, else state at end of last frame
+      Access                final;     ///< imported image is transitioned to its layout if defined
+      VkImage               image      = VK_NULL_HANDLE;
+      VkImageView           view       = VK_NULL_HANDLE;
+      VmaAllocation         allocation = VK_NULL_HANDLE; ///< only of transient attachments
+      VkDeviceSize          offset     = 0;              ///< in aliased memory
+      VkDeviceSize          size       = 0;
+      uint32_t              first      = -1;             ///< first and last pass using it
+      uint32_t              last       = 0;
+    };
+
+    void cull();
+    void allocate();
+    auto simulate(std::vector<SyncState> states) -> std::vector<SyncState>;
+    void create_command_buffers();
+    void record_barriers(VkCommandBuffer command_buffer, const VkMemoryBarrier2& memory_barrier,
+                         const std::vector<Pass::ImageBarrier>& image_barriers);
+    auto attachment_info(const Attachment& attachment, VkImageLayout layout) const -> VkRenderingAttachmentInfo;
+
+    VkDevice      _device;
+    VmaAllocator  _allocator;
+    uint32_t      _queue_family;
+    uint32_t      _frames;
+    VmaAllocation _memory = VK_NULL_HANDLE; ///< aliased memory of owned images
+
+    std::vector<Resource>           _resources;
+    std::vector<Pass>               _passes;
+    std::vector<uint32_t>           _live;           ///< indices of passes not culled
+    std::vector<Pass::ImageBarrier> _final_barriers; ///< transitions of imported images after last pass
+
+    // scratch of execution
+    std::vector<VkImageMemoryBarrier2>     _barriers;
+    std::vector<VkRenderingAttachmentInfo> _attachments;
+  };
+
+}
@@ -0,0 +1,191 @@
+/*===-- include/Texture.hpp ----- Texture ---------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare the textures decoded on the thread pool and uploaded   *|
+|* with their mip levels by command buffers of frames.                        *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include "Ktx2.hpp"
+#include "VmaUsage.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Vulkan
+{
+
+  class ImageTracker;
+
+  /**
+   * Sampled 2D textures in slots of a descriptor array.
+   * Images are decoded on thread pool straight into staging buffers, frames upload those
+   * finished so far with their own command buffer, so loading never stalls rendering.
+   * Mip levels are generated on GPU by the same command buffer, a blit chain if format can be
+   * filtered linearly, otherwise a single dispatch compute downsample.
+   * KTX2 textures keep their stored format and levels, Basis Universal ones are transcoded on
+   * thread pool to the best block compressed format device samples.
+   * Slot 0 is white, every slot shows it until its own image is uploaded.
+   */
+  class Textures final
+  {
+  public:
+    /**
+     * Create white texture and sampler, and downsample pipeline if a format can not be blitted.
+     *
+     * @param physical_device device whose format features choose how mip levels are generated
+     *                        and what Basis Universal textures are transcoded to.
+     * @param device          logical device.
+     * @param allocator       allocator of images and staging buffers.
+     * @param capacity        slots of descriptor array, white texture included.
+     * @param frames          frames in flight, each has own descriptor set.
+     * @throw std::runtime_error if failed to create white texture, sampler or downsample pipeline.
+     */
+    Textures(VkPhysicalDevice physical_device, VkDevice device, VmaAllocator allocator, uint32_t capacity, uint32_t frames);
+
+    /**
+     * Wait for decodes in flight and destroy textures, GPU must be idle.
+     */
+    ~Textures();
+
+    Textures(const Textures&)            = delete;
+    Textures& operator=(const Textures&) = delete;
+
+    /**
+     * Decode image file in background.
+     *
+     * @param filename PNG, JPEG, BMP, TGA, GIF, PSD, HDR, PNM or KTX2 file.
+     * @param srgb     whether texels are sRGB encoded colors, formats stored in KTX2 files keep their own.
+     * @return slot of texture, 0 if all slots are used.
+     */
+    uint32_t load(std::string_view filename, bool srgb);
+
+    /**
+     * Decode encoded image in background, it is copied so it can be released at once.
+     *
+     * @param encoded content of image file.
+     * @param name    name of image in logs.
+     * @param srgb    whether texels are sRGB encoded colors, formats stored in KTX2 files keep their own.
+     * @return slot of texture, 0 if all slots are used.
+     */
+    uint32_t load(std::span<const std::byte> encoded, std::string_view name, bool srgb);
+
+    /**
+     * Record upload of textures decoded so far and generation of their mip levels,
+     * within a budget of bytes and of textures per frame.
+     * Fence of frame must have signaled, staging buffers of its last upload are released here.
+     *
+     * @param command_buffer command buffer of frame.
+     * @param frame          index of frame in flight.
+     */
+    void upload(VkCommandBuffer command_buffer, uint32_t frame);
+
+    /**
+     * Write descriptors of textures uploaded since last write to set of frame,
+     * first write of set fills every slot. Set must not be in use by GPU.
+     *
+     * @param set     descriptor set of frame.
+     * @param binding combined image sampler array of capacity descriptors.
+     * @param frame   index of frame in flight.
+     */
+    void write_descriptors(VkDescriptorSet set, uint32_t binding, uint32_t frame);
+
+    auto capacity() const noexcept { return _capacity; }
+    auto size()     const noexcept { return (uint32_t)_textures.size(); }
+
+  private:
+    enum class MipMode
+    {
+      None,
+      Blit,
+      Compute,
+    };
+
+    /**
+     * Decoded image in staging buffer and its destination image, created on worker thread.
+     */
+    struct Staged
+    {
+      VkBuffer                  buffer            = VK_NULL_HANDLE;
+      VmaAllocation             buffer_allocation = VK_NULL_HANDLE;
+      VkImage                   image             = VK_NULL_HANDLE;
+      VmaAllocation             image_allocation  = VK_NULL_HANDLE;
+      VkImageView               view              = VK_NULL_HANDLE;
+      VkExtent2D                extent            = {};
+      uint32_t                  levels            = 1;
+      MipMode                   mode              = MipMode::None;
+      bool                      srgb              = false;
+      VkDeviceSize              size              = 0;
+      std::vector<VkDeviceSize> offsets;           ///< offset of each level in staging buffer, generated levels are absent
+      std::vector<VkImageView>  level_views;       ///< unorm storage view of each level for compute downsample
+    };
+
+    /**
+     * What last submission of a frame still reads.
+     */
+    struct Frame
+    {
+      std::vector<Staged> uploads;
+      VkDescriptorPool    pool                = VK_NULL_HANDLE; ///< sets of compute downsample
+      VkBuffer            counters            = VK_NULL_HANDLE; ///< finished workgroups of each downsample
+      VmaAllocation       counters_allocation = VK_NULL_HANDLE;
+    };
+
+    struct Texture
+    {
+      VkImage       image      = VK_NULL_HANDLE;
+      VmaAllocation allocation = VK_NULL_HANDLE;
+      VkImageView   view       = VK_NULL_HANDLE;
+    };
+
+    auto stage(std::span<const std::byte> encoded, std::string_view name, bool srgb) -> Staged;
+    auto stage(std::span<const uint8_t> pixels, VkExtent2D extent, bool srgb) -> Staged;
+    auto stage(const Ktx2::Reader& reader, std::string_view name, bool srgb) -> Staged;
+    static auto get_levels(MipMode mode, VkExtent2D extent) -> uint32_t;
+    auto create_staging_buffer(Staged& staged, VkDeviceSize size) -> std::span<std::byte>;
+    void create_image(Staged& staged, VkFormat format);
+    void destroy(const Staged& staged);
+    void release(const Staged& staged);
+    bool reserve();
+    void create_mip_pipeline();
+    void record_blits(VkCommandBuffer command_buffer, std::span<const Staged> uploads, ImageTracker& tracker);
+    void record_downsample(VkCommandBuffer command_buffer, Frame& frame, std::span<const Staged> uploads);
+
+    VkPhysicalDevice _physical_device;
+    VkDevice         _device;
+    VmaAllocator     _allocator;
+    uint32_t         _capacity;
+    VkSampler        _sampler          = VK_NULL_HANDLE;
+    VkImageView      _white            = VK_NULL_HANDLE;            ///< view of slot 0, descriptors use it before it is uploaded
+    Ktx2::Target     _transcode_target = Ktx2::Target::RGBA8;
+
+    std::array<MipMode, 2> _mip_modes;                            ///< indexed by whether texture is srgb
+    VkDescriptorSetLayout  _mip_set_layout      = VK_NULL_HANDLE;
+    VkPipelineLayout       _mip_pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline             _mip_pipeline        = VK_NULL_HANDLE;
+
+    std::vector<Texture>                                  _textures;   ///< every slot in use, image is null until uploaded
+    std::vector<std::pair<uint32_t, std::future<Staged>>> _pending;    ///< slots being decoded or waiting for upload
+    std::vector<uint32_t>                                 _uploaded;   ///< slots in upload order
+    std::vector<uint32_t>                                 _written;    ///< uploaded slots written to set of each frame, -1 if set is unwritten
+    std::vector<Frame>                                    _frames;
+    std::chrono::steady_clock::time_point                 _load_start; ///< first load since nothing was pending
+  };
+
+}
@@ -0,0 +1,95 @@
+/*===-- include/ThreadPool.hpp ----- Thread Pool --------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare the thread pool used by parallel loaders.              *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Util
+{
+
+  /**
+   * Fixed size worker threads consume tasks from single queue.
+   */
+  class ThreadPool final
+  {
+  public:
+    /**
+     * Create worker threads.
+     *
+     * @param count number of worker threads, 0 means hardware concurrency.
+     */
+    ThreadPool(uint32_t count = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&)            = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Get the process wide thread pool.
+     *
+     * @return thread pool.
+     */
+    static ThreadPool& instance();
+
+    /**
+     * Get number of worker threads.
+     *
+     * @return number of worker threads.
+     */
+    auto size() const noexcept { return (uint32_t)_workers.size(); }
+
+    /**
+     * Submit a task.
+     *
+     * @param func task.
+     * @return future of task result.
+     */
+    template <typename Func>
+    auto submit(Func&& func) -> std::future<std::invoke_result_t<Func>>
+    {
+      auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Func>()>>(std::forward<Func>(func));
+      auto future = task->get_future();
+      push([task] { (*task)(); });
+      return future;
+    }
+
+    /**
+     * Run func(i) for i in [0, count) on worker threads and wait them complete.
+     * The caller runs indices not yet taken by workers, so it can be nested in tasks,
+     * and never runs unrelated queued tasks, e.g. a render thread never picks up a texture decode.
+     * Exception of any task is rethrown after all tasks completed.
+     *
+     * @param count number of tasks.
+     * @param func task, called with index of task.
+     */
+    void parallel_for(uint32_t count, const std::function<void(uint32_t)>& func);
+
+  private:
+    void push(std::function<void()> task);
+    void work();
+
+  private:
+    std::vector<std::jthread>         _workers;
+    std::queue<std::function<void()>> _tasks;
+    std::mutex                        _mutex;
+    std::condition_variable           _condition;
+    bool                              _stop = false;
+  };
+
+}
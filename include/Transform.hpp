@@ -0,0 +1,99 @@
+/*===-- include/Transform.hpp ----- Transform Hierarchy -------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare the hierarchy of transforms stored in structure of     *|
+|* arrays, world matrices are updated for dirty subtrees only.                *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace Scene
+{
+
+  constexpr uint32_t No_Parent = std::numeric_limits<uint32_t>::max();
+
+  /**
+   * Transforms of scene nodes in structure of arrays.
+   * Parents are stored before children, so one linear pass updates world matrices.
+   * Transforms are referred by stable ids, their storage indices change when reparented.
+   */
+  class Transforms final
+  {
+  public:
+    /**
+     * Add transform as last child of parent.
+     *
+     * @param local transform relative to parent.
+     * @param parent id of parent, No_Parent if root.
+     * @return id of transform.
+     * @throw std::runtime_error if parent does not exist.
+     */
+    uint32_t create(const glm::mat4& local = glm::mat4(1.f), uint32_t parent = No_Parent);
+
+    /**
+     * Set transform relative to parent, world matrices of subtree are updated by next update.
+     *
+     * @param id transform id.
+     * @param local transform relative to parent.
+     */
+    void set_local(uint32_t id, const glm::mat4& local);
+
+    /**
+     * Move transform and its subtree under parent, storage is reordered if parent is after it.
+     *
+     * @param id transform id.
+     * @param parent id of new parent, No_Parent if root.
+     * @throw std::runtime_error if parent is in subtree of transform.
+     */
+    void set_parent(uint32_t id, uint32_t parent);
+
+    /**
+     * Recompute world matrices of dirty transforms and their descendants.
+     *
+     * @return storage index range [first, last) of changed world matrices, empty if none.
+     */
+    auto update() -> std::pair<uint32_t, uint32_t>;
+
+    auto size()                const noexcept { return (uint32_t)_local.size(); }
+    auto index(uint32_t id)    const noexcept { return _index[id]; }
+    auto local(uint32_t id)    const noexcept -> const glm::mat4& { return _local[_index[id]]; }
+    auto world(uint32_t id)    const noexcept -> const glm::mat4& { return _world[_index[id]]; }
+    auto worlds()              const noexcept { return std::span<const glm::mat4>(_world); }
+
+  private:
+    /**
+     * Reorder storage depth first so parents precede children again.
+     */
+    void sort();
+
+    void mark_dirty(uint32_t index) noexcept
+    {
+      _dirty[index] = true;
+      _first_dirty  = std::min(_first_dirty, index);
+    }
+
+    // indexed by storage index
+    std::vector<glm::mat4> _local;
+    std::vector<glm::mat4> _world;
+    std::vector<uint32_t>  _parent;                ///< storage index of parent, No_Parent if root
+    std::vector<uint8_t>   _dirty;                 ///< local changed since last update
+    std::vector<uint32_t>  _id;                    ///< id of each storage index
+    std::vector<uint32_t>  _index;                 ///< storage index of each id
+    uint32_t               _first_dirty = No_Parent; ///< transforms before are clean
+  };
+
+}
@@ -0,0 +1,96 @@
+/*===-- include/Util.hpp ------- Util -------------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare the common utilities.                                  *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+
+namespace Util
+{
+
+  /**
+   * Throw runtime error if condition is true.
+   *
+   * @param b condition.
+   * @param msg error message.
+   * @throw std::runtime_error if b is true.
+   */
+  inline void throw_if(bool b, std::string_view msg)
+  {
+    if (b) throw std::runtime_error(msg.data());
+  }
+
+  /**
+   * Align size up to alignment.
+   *
+   * @param size size.
+   * @param alignment alignment, must be power of two.
+   * @return aligned size.
+   */
+  template <typename T>
+  constexpr T align_up(T size, T alignment)
+  {
+    return (size + alignment - 1) & ~(alignment - 1);
+  }
+
+  /**
+   * FNV-1a hash of bytes.
+   *
+   * @param data bytes.
+   * @param seed hash to continue from.
+   * @return 64-bit hash.
+   */
+  constexpr uint64_t hash(std::span<const std::byte> data, uint64_t seed = 0xcbf29ce484222325)
+  {
+    for (auto byte : data)
+      seed = (seed ^ (uint64_t)byte) * 0x100000001b3;
+    return seed;
+  }
+
+  /**
+   * Instruction set of SIMD kernels.
+   */
+  enum class Isa { Scalar, SSE, AVX2, NEON };
+
+  /**
+   * Get best instruction set supported by current CPU.
+   *
+   * @return instruction set.
+   */
+  inline Isa get_isa()
+  {
+#if defined(__x86_64__) || defined(_M_X64)
+    static auto isa = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? Isa::AVX2 : Isa::SSE;
+    return isa;
+#elif defined(__aarch64__)
+    return Isa::NEON;
+#else
+    return Isa::Scalar;
+#endif
+  }
+
+  /**
+   * Check if kernels of instruction set can run on current CPU.
+   *
+   * @param isa instruction set.
+   * @return true if supported.
+   */
+  inline bool is_supported(Isa isa)
+  {
+    auto best = get_isa();
+    return isa == Isa::Scalar || isa == best || (isa == Isa::SSE && best == Isa::AVX2);
+  }
+
+}
@@ -0,0 +1,141 @@
+/*===-- include/Video.hpp ------ Video ------------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This header declare the conversion of rendered frames to YUV 4:2:0 and the *|
+|* writer streaming them to a Y4M file or pipe on its own thread.             *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#pragma once
+
+#include "Util.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace Video
+{
+
+  using Util::Isa;
+  using Util::get_isa;
+
+  /**
+   * Byte order of 8 bit four channel pixels.
+   */
+  enum class PixelOrder
+  {
+    BGRA,
+    RGBA,
+  };
+
+  /**
+   * Get size of 4:2:0 planes, a full resolution luma plane followed by two
+   * chroma planes of half width and height rounded up.
+   *
+   * @param width width in pixels.
+   * @param height height in pixels.
+   * @return size in bytes.
+   */
+  constexpr auto get_yuv420_size(uint32_t width, uint32_t height) noexcept
+  {
+    return (size_t)width * height + 2 * (size_t)((width + 1) / 2) * ((height + 1) / 2);
+  }
+
+  /**
+   * Convert pixels to BT.601 limited range YUV 4:2:0, chroma of each 2x2 block
+   * is the average of its pixels. Alpha is ignored.
+   * SSE has no dedicated kernel and runs scalar path.
+   *
+   * @param pixels tightly packed rows of width * height pixels.
+   * @param width width in pixels.
+   * @param height height in pixels.
+   * @param order byte order of pixels.
+   * @param result Y, U and V planes, get_yuv420_size(width, height) bytes.
+   * @param isa instruction set.
+   * @throw std::runtime_error if size of pixels or result mismatches.
+   */
+  void convert_yuv420(std::span<const std::byte> pixels, uint32_t width, uint32_t height, PixelOrder order,
+                      std::span<uint8_t> result, Isa isa = get_isa());
+
+  /**
+   * Writer of raw YUV 4:2:0 video in YUV4MPEG2 format, which ffmpeg and most
+   * players read directly. Frames are copied into a bounded queue and
+   * converted and written on a dedicated thread, so push only blocks when the
+   * writer falls behind by the whole queue.
+   */
+  class Y4mWriter final
+  {
+  public:
+    /**
+     * Open the output and start the writer thread.
+     *
+     * @param path output file, "-" writes to standard output.
+     * @param width width of frames in pixels.
+     * @param height height of frames in pixels.
+     * @param fps frame rate stored in header, frames are assumed evenly spaced.
+     * @param order byte order of frame pixels.
+     * @param capacity frames queued before push blocks.
+     * @throw std::runtime_error if output can not be opened or arguments are invalid.
+     */
+    Y4mWriter(std::string_view path, uint32_t width, uint32_t height, uint32_t fps, PixelOrder order, uint32_t capacity = 4);
+
+    /**
+     * Write queued frames and stop the writer thread.
+     */
+    ~Y4mWriter();
+
+    Y4mWriter(const Y4mWriter&)            = delete;
+    Y4mWriter& operator=(const Y4mWriter&) = delete;
+
+    /**
+     * Queue a frame, blocks while queue is full.
+     * Frames are dropped once a write failed.
+     *
+     * @param pixels tightly packed rows of width * height pixels.
+     * @throw std::runtime_error if size of pixels mismatches.
+     */
+    void push(std::span<const std::byte> pixels);
+
+    /**
+     * Get number of frames written so far.
+     *
+     * @return number of frames.
+     */
+    auto frames() const noexcept { return _written.load(std::memory_order_relaxed); }
+
+  private:
+    void write();
+
+  private:
+    std::ofstream _file;
+    std::ostream* _output;
+    uint32_t      _width;
+    uint32_t      _height;
+    PixelOrder    _order;
+    uint32_t      _capacity;
+
+    std::mutex                          _mutex;
+    std::condition_variable             _queued;     ///< signals frame queued or stop
+    std::condition_variable             _freed;      ///< signals frame taken by writer
+    std::deque<std::vector<std::byte>>  _queue;      ///< frames in push order
+    std::vector<std::vector<std::byte>> _free;       ///< buffers of written frames reused by push
+    bool                                _stop = false;
+    std::atomic<bool>                   _failed = false;
+    std::atomic<uint64_t>               _written = 0;
+    std::jthread                        _thread;     ///< last member, joined before the rest is destroyed
+  };
+
+}
@@ -14,11 +14,25 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include "VmaUsage.h"
-
+#include "Mesh.hpp"
+#include "Bvh.hpp"
+#include "Culling.hpp"
+#include "Transform.hpp"
+#include "RenderGraph.hpp"
+#include "Readback.hpp"
+#include "Texture.hpp"
+#include "Video.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
 #include <string_view>
 #include <optional>
 #include <vector>
 #include <array>
+#include <span>
+#include <functional>
+#include <memory>
 
 namespace Vulkan
 {
@@ -57,6 +71,20 @@ namespace Vulkan
     uint32_t height;                         ///< height of window
     std::string_view title;                  ///< title of window
     std::optional<ApplicationInfo> app_info; ///< application information, can be empty.
+    std::string_view mesh;                   ///< OBJ, glb or baked .mesh file to render, builtin quad if empty.
+    bool optimize_mesh = true;               ///< optimize index buffer of OBJ at load time.
+    Mesh::VertexFormat vertex_format;        ///< storage format of OBJ vertices.
+    uint32_t max_lods = 4;                   ///< LOD levels generated for optimized OBJ, 1 disables.
+    float lod_error   = 1.f;                 ///< max screen space error of selected LOD in pixels.
+    bool depth_prepass = false;              ///< draw depth before color, so only the nearest surface is shaded.
+    uint32_t samples   = 1;                  ///< MSAA samples 1, 2, 4 or 8, clamped to device limits.
+    float target_frame_time = 0.f;           ///< GPU milliseconds per frame dynamic resolution keeps, 0 renders at window resolution.
+    float min_render_scale  = 0.5f;          ///< lowest render resolution relative to window.
+    float max_render_scale  = 1.f;           ///< highest render resolution relative to window, up to 2.
+    ReadbackCallback readback;               ///< receives every presented image some frames later, no readback if empty.
+    bool readback_scene = false;             ///< read back scene before scaling to window, only with dynamic resolution.
+    std::string_view record;                 ///< Y4M file presented images are recorded to, "-" pipes to standard output and logs to standard error, no recording if empty.
+    uint32_t record_fps = 60;                ///< frame rate stored in recording, frames are assumed evenly spaced.
   };
   
   /**
@@ -78,6 +106,16 @@ namespace Vulkan
     void test();
   
   private:
+    /**
+     * Kind of graphics pass draws are recorded in, each has its own pipelines.
+     */
+    enum class DrawPass
+    {
+      Occlusion, ///< single sample depth of phase one, source of Hi-Z pyramid
+      Prepass,   ///< depth before color in main pass
+      Color,     ///< shading in main pass
+    };
+
     void init_window(uint32_t width, uint32_t height, std::string_view title);
     void init_vulkan(const VulkanCreateInfo& info);
   
@@ -88,20 +126,37 @@ namespace Vulkan
     void create_logical_device();
     void create_swapchain();
     void create_image_views();
-    void create_render_pass();
+    void create_depth_resources();
+    void create_render_graph();
     void create_destriptor_set_layout();
     void create_pipeline();
-    void create_framebuffer(); 
+    auto create_graphics_pipeline(const Mesh::VertexLayout& layout, DrawPass pass) -> VkPipeline;
+    auto get_pipeline(const Mesh::VertexLayout& layout, bool depth_only = false) -> uint32_t;
+    auto create_compute_pipeline(std::string_view filename, VkPipelineLayout layout) -> VkPipeline;
     void create_command_pool();
     void create_command_buffers();
     void create_buffers();
+    void create_mesh_buffers();
+    void load_obj();
+    void load_glb();
+    void load_cache();
     void create_descriptor_pool();
     void create_descriptor_sets();
     void create_sync_objects();
+    void create_timestamp_pool();
+    void create_recorder();
 
     void draw();
     void update_uniform_buffers(uint32_t current_frame);
+    void update_render_extent();
     void record_command_buffer(VkCommandBuffer command_buffer, uint32_t image_index);
+    void record_draw_state(VkCommandBuffer command_buffer);
+    void record_draws(VkCommandBuffer command_buffer, std::span<const uint32_t> draws, uint32_t phase, DrawPass pass);
+    void record_occlusion(VkCommandBuffer command_buffer, uint32_t phase);
+    void record_hiz(VkCommandBuffer command_buffer);
+    void record_upscale(VkCommandBuffer command_buffer);
+    void record_readback(VkCommandBuffer command_buffer, ResourceId source);
+    void submit_commands(const std::function<void(VkCommandBuffer)>& record);
 
     static VkResult vkCreateDebugUtilsMessengerEXT(
       VkInstance                                  instance,
@@ -147,14 +202,52 @@ namespace Vulkan
 
     std::vector<VkImageView> _swapchain_image_views;
 
-    VkRenderPass _render_pass = VK_NULL_HANDLE;
+    // occlusion pass draws depth of phase one, main pass draws both phases to swapchain,
+    // with MSAA main pass has transient attachments in lazily allocated memory and resolves color
+    // to swapchain at end of rendering, so samples stay in tile memory
+    std::unique_ptr<RenderGraph> _graph;
+    ResourceId                   _swapchain_resource;
+    ResourceId                   _depth_resource;   ///< single sample, also loaded by main pass without MSAA
+    ResourceId                   _hiz_resource;
+    ResourceId                   _scene_resource;   ///< color scaled to swapchain with dynamic resolution
+    VkFormat                     _depth_format = VK_FORMAT_UNDEFINED; ///< fastest supported format
+    VkSampleCountFlagBits        _samples      = VK_SAMPLE_COUNT_1_BIT;
+
+    // dynamic resolution renders scene to top left area of images allocated for highest scale,
+    // area follows GPU time measured by timestamps of every frame and is scaled to swapchain by one blit
+    float                                 _target_frame_time = 0.f; ///< milliseconds, 0 disables
+    float                                 _min_render_scale  = 1.f;
+    float                                 _max_render_scale  = 1.f;
+    float                                 _render_scale      = 1.f;
+    float                                 _gpu_frame_time    = 0.f; ///< smoothed milliseconds
+    float                                 _timestamp_period  = 0.f; ///< nanoseconds per tick
+    uint64_t                              _timestamp_mask    = 0;   ///< valid bits of timestamps
+    VkQueryPool                           _timestamp_pool    = VK_NULL_HANDLE; ///< begin and end of every frame in flight
+    std::array<bool, Max_Frame_Number>    _timestamps_written{};
+    VkFilter                              _upscale_filter    = VK_FILTER_LINEAR;
+    VkExtent2D                            _render_extent;            ///< area scene is rendered to this frame
+    VkExtent2D                            _max_render_extent;        ///< extent of scene images
+
+    ReadbackCallback          _readback_callback;
+    bool                      _readback_scene;
+    std::unique_ptr<Readback> _readback;          ///< ring of images copied at end of frame
+
+    // base color textures of draws, slot is push constant of draw
+    static constexpr uint32_t Max_Textures = 1024;
+    uint32_t                  _texture_capacity = 1; ///< slots of descriptor array, bounded by device limits
+    std::unique_ptr<Textures> _textures;
+
+    std::string                       _record;
+    uint32_t                          _record_fps;
+    std::unique_ptr<Video::Y4mWriter> _recorder;  ///< fed by readback callback
 
     VkDescriptorSetLayout _descriptor_set_layout = VK_NULL_HANDLE;
 
-    VkPipeline       _pipeline        = VK_NULL_HANDLE;
-    VkPipelineLayout _pipeline_layout = VK_NULL_HANDLE;
-
-    std::vector<VkFramebuffer> _swapchain_framebuffers;
+    // pipelines of different vertex layouts share the pipeline layout
+    std::vector<std::pair<Mesh::VertexLayout, VkPipeline>> _pipelines;
+    std::vector<std::pair<Mesh::VertexLayout, VkPipeline>> _depth_pipelines; ///< position only, occlusion pass
+    std::vector<VkPipeline>                                _prepass_pipelines; ///< same layouts as _depth_pipelines, null without prepass
+    VkPipelineLayout                                       _pipeline_layout = VK_NULL_HANDLE;
 
     VkCommandPool _command_pool = VK_NULL_HANDLE;
 
@@ -165,27 +258,164 @@ namespace Vulkan
     // VkBuffer      _buffer         = VK_NULL_HANDLE;
     // VmaAllocation _vma_allocation = VK_NULL_HANDLE;
 
-    // HACK: create seperate buffer...
-    VkBuffer      _vertex_buffer            = VK_NULL_HANDLE;
-    VmaAllocation _vertex_buffer_allocation = VK_NULL_HANDLE;
-    VkBuffer      _index_buffer             = VK_NULL_HANDLE;
-    VmaAllocation _index_buffer_allocation  = VK_NULL_HANDLE;
+    /**
+     * Draw of a primitive, vertex and index data are in the geometry buffer.
+     */
+    struct DrawCommand
+    {
+      uint32_t                  pipeline;       ///< index of _pipelines
+      uint32_t                  depth_pipeline; ///< index of _depth_pipelines and _prepass_pipelines, binds only vertex_offsets[0]
+      std::vector<VkDeviceSize> vertex_offsets; ///< offset of each vertex binding
+      VkDeviceSize              index_offset;
+      VkIndexType               index_type;
+      bool                      indexed;
+      uint32_t                  transform;      ///< id in _transforms, index of its matrices in instance buffer is push constant
+      int32_t                   material;       ///< material index, -1 if none
+      uint32_t                  texture;        ///< slot of base color in _textures, 0 is white
+      std::vector<Mesh::Lod>    lods;           ///< index ranges of levels, empty if only one, only with single submesh
+      uint32_t                  first_submesh;  ///< index of _submeshes, also first indirect command of draw
+      uint32_t                  submesh_count;  ///< 1 unless draw is a static batch, non-indexed draws have 1
+    };
+
+    /**
+     * Culled part of draw, batches have one per merged primitive.
+     * Indexed draws issue indirect commands of all their submeshes at once,
+     * frustum culled submeshes have empty commands.
+     */
+    struct Submesh
+    {
+      uint32_t  draw;        ///< index of _draws
+      uint32_t  first_index; ///< replaced by selected level if draw has LODs
+      uint32_t  count;       ///< index count, or vertex count if draw is not indexed
+      glm::vec4 sphere;      ///< bounding sphere of culling and LOD selection, in space of model, draws are its children
+    };
+
+    std::string              _mesh_filename;
+    bool                     _optimize_mesh;
+    Mesh::VertexFormat       _vertex_format;
+    uint32_t                 _max_lods;
+    float                    _lod_error;
+    bool                     _depth_prepass;
+    std::vector<DrawCommand> _draws;
+    std::vector<Submesh>     _submeshes;
+    Culling::Bvh             _submesh_bvh;       ///< boxes around spheres of submeshes, ids are submesh indices
+    std::vector<glm::vec4>   _submesh_spheres;   ///< sphere of each submesh at load
+    std::vector<glm::mat4>   _draw_placements;   ///< inverse local transform of each draw at load
+    std::vector<glm::mat4>   _draw_locals;       ///< local transform of each draw at last refit
+    std::vector<uint32_t>    _visible_submeshes; ///< indices of submeshes passing frustum culling, ascending
+    std::vector<uint32_t>    _visible_draws;     ///< indices of draws with visible submeshes, front to back
+    std::vector<float>       _draw_distances;    ///< distance of nearest visible submesh of draw, sort key
+    uint32_t                 _max_draw_indirect_count = 1; ///< 1 without multi draw indirect
+
+    /**
+     * Add draw and its submeshes.
+     *
+     * @param draw      draw, its submesh range is set here.
+     * @param submeshes submeshes of draw, their draw index is set here.
+     */
+    void add_draw(DrawCommand&& draw, std::span<const Submesh> submeshes);
+
+    /**
+     * Move spheres of submeshes whose draw transform changed relative to model and refit BVH,
+     * which is rebuilt on a worker thread once refitting degraded it.
+     * Draws are children of model, so rotating model moves none of them.
+     *
+     * @param first first storage index of changed world matrices.
+     * @param last  storage index after last changed world matrix.
+     */
+    void refit_submeshes(uint32_t first, uint32_t last);
+
+    Scene::Transforms        _transforms;
+    uint32_t                 _model_transform; ///< root of draw transforms, rotated every frame
+
+    /**
+     * Select coarsest LOD of submesh within screen space error of current camera.
+     *
+     * @param submesh submesh of indexed draw.
+     * @return index range to draw.
+     */
+    Mesh::Lod select_lod(const Submesh& submesh) const;
+
+    // camera of current frame for LOD selection
+    glm::mat4 _camera_view        = glm::mat4(1.f); ///< model view matrix
+    glm::mat4 _camera_projection  = glm::mat4(1.f);
+    float     _camera_pixel_scale = 1.f;            ///< pixels per unit at distance 1
+
+    // vertices and indices of all meshes
+    VkBuffer      _geometry_buffer            = VK_NULL_HANDLE;
+    VmaAllocation _geometry_buffer_allocation = VK_NULL_HANDLE;
     std::array<VkBuffer, Max_Frame_Number>      _uniform_buffers;
     // std::array<VmaAllocation, Max_Frame_Number> _uniform_buffer_allocations;
     VkDeviceMemory                              _uniform_buffers_memory;
     std::array<void*, Max_Frame_Number>         _uniform_buffers_mapped;
 
+    // clip matrices of transforms followed by inverses of their world matrices for normals,
+    // each frame only rewrites ranges changed since its last use, or all when camera moved
+    std::array<VkBuffer, Max_Frame_Number>                     _instance_buffers;
+    std::array<VmaAllocation, Max_Frame_Number>                _instance_buffer_allocations;
+    std::array<void*, Max_Frame_Number>                        _instance_buffers_mapped;
+    std::array<std::pair<uint32_t, uint32_t>, Max_Frame_Number> _instance_dirty;
+    std::array<glm::mat4, Max_Frame_Number>                    _instance_view_projections{}; ///< camera of last write
+
     VkDescriptorPool                              _descriptor_pool = VK_NULL_HANDLE;
     std::array<VkDescriptorSet, Max_Frame_Number> _descriptor_sets;
 
+    /**
+     * Two phase occlusion culling of submeshes of indexed draws.
+     * Phase one draws what was visible last frame, its depth is reduced to Hi-Z pyramid,
+     * phase two tests bounding spheres against the pyramid and draws newly visible ones.
+     * Compute writes instance count of indirect commands, occluded submeshes have no vertex work.
+     */
+    std::vector<VkImageView>     _hiz_level_views;                       ///< single level of pyramid, written by downsample
+    VkExtent2D                   _hiz_extent;                            ///< level 0, power of two covering half of swapchain
+    uint32_t                     _hiz_levels           = 0;
+    VkSampler                    _hiz_sampler          = VK_NULL_HANDLE; ///< nearest sampler of depth and pyramid
+    VkDescriptorSetLayout        _hiz_descriptor_set_layout       = VK_NULL_HANDLE;
+    VkDescriptorSetLayout        _occlusion_descriptor_set_layout = VK_NULL_HANDLE;
+    VkPipelineLayout             _hiz_pipeline_layout             = VK_NULL_HANDLE;
+    VkPipelineLayout             _occlusion_pipeline_layout       = VK_NULL_HANDLE;
+    VkPipeline                   _hiz_pipeline                    = VK_NULL_HANDLE;
+    VkPipeline                   _occlusion_pipeline              = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> _hiz_descriptor_sets;                   ///< per level
+    std::array<VkDescriptorSet, Max_Frame_Number> _occlusion_descriptor_sets;
+
+    // bounding spheres of submeshes, each frame only rewrites ranges moved since its last use
+    std::array<VkBuffer, Max_Frame_Number>                      _sphere_buffers;
+    std::array<VmaAllocation, Max_Frame_Number>                 _sphere_buffer_allocations;
+    std::array<void*, Max_Frame_Number>                         _sphere_buffers_mapped;
+    std::array<std::pair<uint32_t, uint32_t>, Max_Frame_Number> _sphere_dirty;
+
+    VkBuffer      _visibility_buffer            = VK_NULL_HANDLE; ///< 1 if submesh passed phase two of last frame
+    VmaAllocation _visibility_buffer_allocation = VK_NULL_HANDLE;
+
+    // commands of phase one then phase two per submesh, LOD ranges are written by host
+    std::array<VkBuffer, Max_Frame_Number>      _indirect_buffers;
+    std::array<VmaAllocation, Max_Frame_Number> _indirect_buffer_allocations;
+    std::array<void*, Max_Frame_Number>         _indirect_buffers_mapped;
+
     std::array<VkSemaphore, Max_Frame_Number> _image_available_semaphores;
     std::array<VkSemaphore, Max_Frame_Number> _render_finished_semaphores;
     std::array<VkFence, Max_Frame_Number>     _in_flight_fences;
 
     uint32_t _current_frame = 0;
+    uint64_t _frame_number  = 0;
+
+    /**
+     * Host visible buffer persistently mapped as transfer source,
+     * memory may be non coherent so writers flush it before the copy.
+     * Random access ones are host cached, so data can be processed in place before upload.
+     */
+    struct StageBuffer
+    {
+      VkBuffer      buffer     = VK_NULL_HANDLE;
+      VmaAllocation allocation = VK_NULL_HANDLE;
+      void*         mapped     = nullptr;
+    };
 
     // HACK: tmp func
-  void* bad_create_buffer(VkBuffer& buf, VmaAllocation& al, uint32_t size, const void* dst, VkBufferUsageFlags usage, bool use_gpu = true);
+  auto create_stage_buffer(VkDeviceSize size, bool random_access = false) -> StageBuffer;
+  void destroy_stage_buffer(const StageBuffer& stage);
+  void create_device_buffer(VkBuffer& buffer, VmaAllocation& allocation, VkDeviceSize size, VkBufferUsageFlags usage);
   void copy_buffer(VkBuffer src, VkBuffer dst, VkDeviceSize size) 
   {
     // create temporary command buffer to transfer data from stage buffer to device local buffer
@@ -0,0 +1,30 @@
+#version 450
+
+layout(location = 0) in vec3 in_position;
+
+layout(binding = 0) uniform UniformBufferObject
+{
+  mat4 view;
+  mat4 proj;
+  mat4 model_view;
+  uint instance_count;
+} ubo;
+
+// clip matrices, view projection premultiplied on host, then inverse world matrices
+layout(std430, binding = 1) readonly buffer InstanceBuffer
+{
+  mat4 matrices[];
+} instances;
+
+layout(push_constant) uniform PushConstant
+{
+  uint instance;
+} push;
+
+// prepass and color pass must produce identical depth for equal depth test
+invariant gl_Position;
+
+void main()
+{
+  gl_Position = instances.matrices[push.instance] * vec4(in_position, 1.0);
+}
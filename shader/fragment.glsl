@@ -1,9 +1,27 @@
 #version 450
 
+// slots of texture array, set from device limits
+layout(constant_id = 0) const uint Texture_Count = 1;
+
+layout(binding = 2) uniform sampler2D textures[Texture_Count];
+
+layout(push_constant) uniform PushConstant
+{
+  uint instance;
+  uint texture;
+} push;
+
+// wrapped diffuse from a fixed direction, so faces turned away are dimmed but never black
+const vec3 Light_Direction = normalize(vec3(0.4, 1.0, 0.6));
+
 layout(location = 0) out vec4 outColor;
 layout(location = 0) in  vec3 fragColor;
+layout(location = 1) in  vec2 fragUV;
+layout(location = 2) in  vec3 fragNormal;
 
 void main()
 {
-  outColor = vec4(fragColor, 1.0);
+  // base color is vertex color times texture, slot 0 is white, meshes without normals are unlit
+  float light = dot(fragNormal, fragNormal) > 0.0 ? 0.5 + 0.5 * dot(normalize(fragNormal), Light_Direction) : 1.0;
+  outColor = vec4(fragColor * light, 1.0) * texture(textures[push.texture], fragUV);
 }
@@ -0,0 +1,35 @@
+#version 450
+
+// each texel of a level is the farthest depth of the 2x2 texels below it,
+// level 0 reduces rendered area of depth buffer, reads are clamped to edge of valid area below
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 0) uniform sampler2D depth;
+layout(binding = 1, r32f) uniform readonly image2D source;
+layout(binding = 2, r32f) uniform writeonly image2D destination;
+
+layout(push_constant) uniform PushConstant
+{
+  ivec2 extent; // valid area of level below
+  uint  level;
+} push;
+
+float load(ivec2 position)
+{
+  position = min(position, push.extent - 1);
+  if (push.level == 0)
+    return texelFetch(depth, position, 0).r;
+  return imageLoad(source, position).r;
+}
+
+void main()
+{
+  ivec2 position = ivec2(gl_GlobalInvocationID.xy);
+  if (any(greaterThanEqual(position, imageSize(destination))))
+    return;
+
+  ivec2 base = position * 2;
+  float farthest = max(max(load(base), load(base + ivec2(1, 0))),
+                       max(load(base + ivec2(0, 1)), load(base + ivec2(1, 1))));
+  imageStore(destination, position, vec4(farthest));
+}
@@ -0,0 +1,127 @@
+#version 450
+
+// single pass downsample of every mip level, like AMD's SPD: each workgroup reduces a 64x64 tile
+// of level 0 down to level 6, the last workgroup to finish reduces level 6 down to the smallest level.
+// views are unorm, colors of srgb images are averaged in linear space,
+// reads are clamped to edge of level below so odd sizes keep their last row and column
+layout(local_size_x = 256) in;
+
+layout(binding = 0, rgba8) uniform coherent image2D mips[13];
+
+layout(std430, binding = 1) coherent buffer Counters
+{
+  uint counters[]; // workgroups finished of each image, reset by last one
+};
+
+layout(push_constant) uniform PushConstant
+{
+  uint levels;  // mip levels of image, level 0 included
+  uint srgb;
+  uint counter; // index of counter of image
+} push;
+
+shared vec4 tile[16][16];
+shared bool is_last;
+
+// views are indexed by constants, so no dynamic indexing feature is needed
+#define LEVELS(X) X(0) X(1) X(2) X(3) X(4) X(5) X(6) X(7) X(8) X(9) X(10) X(11) X(12)
+
+ivec2 level_size(uint level)
+{
+  #define SIZE(i) case i: return imageSize(mips[i]);
+  switch (level) { LEVELS(SIZE) }
+  return ivec2(1);
+}
+
+vec4 load(uint level, ivec2 position)
+{
+  vec4 color = vec4(0);
+  #define LOAD(i) case i: color = imageLoad(mips[i], position); break;
+  switch (level) { LEVELS(LOAD) }
+  if (push.srgb != 0)
+    color.rgb = mix(color.rgb / 12.92, pow((color.rgb + 0.055) / 1.055, vec3(2.4)), greaterThan(color.rgb, vec3(0.04045)));
+  return color;
+}
+
+void store(uint level, ivec2 position, vec4 color)
+{
+  if (level >= push.levels || any(greaterThanEqual(position, level_size(level))))
+    return;
+  if (push.srgb != 0)
+    color.rgb = mix(color.rgb * 12.92, 1.055 * pow(color.rgb, vec3(1 / 2.4)) - 0.055, greaterThan(color.rgb, vec3(0.0031308)));
+  #define STORE(i) case i: imageStore(mips[i], position, color); break;
+  switch (level) { LEVELS(STORE) }
+}
+
+// offset of second texel of 2x2 below position, 0 where it is past the edge
+ivec2 second(uint level, ivec2 position)
+{
+  return min(position * 2 + 1, level_size(level) - 1) - position * 2;
+}
+
+// reduce 64x64 texels of source from origin to levels source + 1 to source + 6
+void downsample(uint source, ivec2 origin)
+{
+  uint  index    = gl_LocalInvocationIndex;
+  ivec2 local    = ivec2(index % 16, index / 16);
+  ivec2 position = origin / 4 + local;
+
+  // source + 1: 2x2 texels per invocation kept in registers
+  vec4 colors[2][2];
+  for (int y = 0; y < 2; ++y)
+    for (int x = 0; x < 2; ++x)
+    {
+      ivec2 below = position * 2 + ivec2(x, y);
+      ivec2 edge  = level_size(source) - 1;
+      ivec2 base  = below * 2;
+      colors[y][x] = (load(source, min(base, edge))                   + load(source, min(base + ivec2(1, 0), edge)) +
+                      load(source, min(base + ivec2(0, 1), edge))     + load(source, min(base + 1, edge))) * 0.25;
+      store(source + 1, below, colors[y][x]);
+    }
+
+  // source + 2: one texel per invocation
+  ivec2 offset = second(source + 1, position);
+  vec4  color  = (colors[0][0] + colors[0][offset.x] + colors[offset.y][0] + colors[offset.y][offset.x]) * 0.25;
+  store(source + 2, position, color);
+  tile[local.y][local.x] = color;
+
+  // source + 3 to source + 6 through shared memory, a quarter of invocations each step
+  for (uint level = 3, size = 8; level <= 6; ++level, size /= 2)
+  {
+    barrier();
+    bool active = index < size * size;
+    local    = ivec2(index % size, index / size);
+    position = (origin >> level) + local;
+    if (active)
+    {
+      offset = second(source + level - 1, position);
+      ivec2 base = local * 2;
+      color = (tile[base.y][base.x]            + tile[base.y][base.x + offset.x] +
+               tile[base.y + offset.y][base.x] + tile[base.y + offset.y][base.x + offset.x]) * 0.25;
+      store(source + level, position, color);
+    }
+    barrier();
+    if (active)
+      tile[local.y][local.x] = color;
+  }
+}
+
+void main()
+{
+  downsample(0, ivec2(gl_WorkGroupID.xy) * 64);
+  if (push.levels <= 7)
+    return;
+
+  // level 6 of an image up to 4096 fits one tile
+  memoryBarrierImage();
+  barrier();
+  if (gl_LocalInvocationIndex == 0)
+    is_last = atomicAdd(counters[push.counter], 1) == gl_NumWorkGroups.x * gl_NumWorkGroups.y - 1;
+  barrier();
+  if (!is_last)
+    return;
+
+  downsample(6, ivec2(0));
+  if (gl_LocalInvocationIndex == 0)
+    counters[push.counter] = 0;
+}
@@ -0,0 +1,104 @@
+#version 450
+
+// one invocation per submesh, phase 0 draws what was visible last frame, phase 1 tests submeshes against the Hi-Z pyramid
+// built from depth of phase 0 and draws only the newly visible ones
+layout(local_size_x = 64) in;
+
+layout(binding = 0) uniform UniformBufferObject
+{
+  mat4 view;
+  mat4 proj;
+  mat4 model_view;
+} ubo;
+
+layout(std430, binding = 1) readonly buffer SphereBuffer
+{
+  vec4 spheres[];
+};
+
+layout(std430, binding = 2) buffer VisibilityBuffer
+{
+  uint visibility[];
+};
+
+struct DrawIndexedIndirectCommand
+{
+  uint index_count;
+  uint instance_count;
+  uint first_index;
+  int  vertex_offset;
+  uint first_instance;
+};
+
+// commands of phase 0 followed by commands of phase 1
+layout(std430, binding = 3) buffer CommandBuffer
+{
+  DrawIndexedIndirectCommand commands[];
+};
+
+layout(binding = 4) uniform sampler2D hiz;
+
+layout(push_constant) uniform PushConstant
+{
+  vec2 extent;
+  uint phase;
+} push;
+
+bool is_visible(vec4 sphere)
+{
+  if (isinf(sphere.w))
+    return true;
+
+  // screen rectangle and nearest depth of view space box around sphere
+  vec3  center = (ubo.model_view * vec4(sphere.xyz, 1.0)).xyz;
+  float scale  = max(max(length(ubo.model_view[0].xyz), length(ubo.model_view[1].xyz)), length(ubo.model_view[2].xyz));
+  float radius = sphere.w * scale;
+  vec2  low    = vec2(1.0);
+  vec2  high   = vec2(-1.0);
+  float nearest = 1.0;
+  for (int i = 0; i < 8; ++i)
+  {
+    vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+    vec4 clip   = ubo.proj * vec4(corner, 1.0);
+    // box crosses plane of camera
+    if (clip.w <= 0.0)
+      return true;
+    vec3 ndc = clip.xyz / clip.w;
+    low     = min(low, ndc.xy);
+    high    = max(high, ndc.xy);
+    nearest = min(nearest, ndc.z);
+  }
+  if (any(lessThan(high, vec2(-1.0))) || any(greaterThan(low, vec2(1.0))))
+    return false;
+
+  // texel of level L covers 2^(L+1) pixels, choose level where rectangle covers at most 2x2 texels
+  ivec2 size  = ivec2(push.extent) - 1;
+  ivec2 first = clamp(ivec2((low  * 0.5 + 0.5) * push.extent), ivec2(0), size);
+  ivec2 last  = clamp(ivec2((high * 0.5 + 0.5) * push.extent), ivec2(0), size);
+  int   level = clamp(findMSB(max(last.x - first.x, last.y - first.y)), 0, textureQueryLevels(hiz) - 1);
+  ivec2 limit = textureSize(hiz, level) - 1;
+  first = min(first >> (level + 1), limit);
+  last  = min(last  >> (level + 1), limit);
+
+  float farthest = max(max(texelFetch(hiz, first, level).r, texelFetch(hiz, ivec2(last.x, first.y), level).r),
+                       max(texelFetch(hiz, ivec2(first.x, last.y), level).r, texelFetch(hiz, last, level).r));
+  return nearest <= farthest;
+}
+
+void main()
+{
+  uint submesh = gl_GlobalInvocationID.x;
+  uint count   = spheres.length();
+  if (submesh >= count)
+    return;
+
+  if (push.phase == 0)
+  {
+    commands[submesh].instance_count = visibility[submesh];
+    return;
+  }
+
+  uint visible = is_visible(spheres[submesh]) ? 1 : 0;
+  commands[count + submesh].instance_count = visible & (1 - visibility[submesh]);
+  visibility[submesh] = visible;
+}
@@ -1,19 +1,56 @@
 #version 450
 
-layout(location = 0) in vec2 in_position;
+// normals are two octahedral components, set from vertex format of pipeline
+layout(constant_id = 0) const bool Octahedral_Normal = false;
+
+layout(location = 0) in vec3 in_position;
 layout(location = 1) in vec3 in_color;
+layout(location = 2) in vec3 in_normal;
+layout(location = 3) in vec2 in_uv;
 
 layout(binding = 0) uniform UniformBufferObject
 {
-  mat4 model;
   mat4 view;
   mat4 proj;
+  mat4 model_view;
+  uint instance_count;
 } ubo;
 
+// clip matrices, view projection premultiplied on host, then inverse world matrices
+layout(std430, binding = 1) readonly buffer InstanceBuffer
+{
+  mat4 matrices[];
+} instances;
+
+layout(push_constant) uniform PushConstant
+{
+  uint instance;
+} push;
+
+// prepass and color pass must produce identical depth for equal depth test
+invariant gl_Position;
+
 layout(location = 0) out vec3 fragment_color;
+layout(location = 1) out vec2 fragment_uv;
+layout(location = 2) out vec3 fragment_normal;
+
+// inverse of octahedral mapping, lower hemisphere is folded back from corners of square
+vec3 decode_octahedral(vec2 p)
+{
+  vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+  if (n.z < 0.0)
+    n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+  return n;
+}
 
 void main()
 {
-  gl_Position = ubo.proj * ubo.view * ubo.model * vec4(in_position, 0.0, 1.0);
+  gl_Position = instances.matrices[push.instance] * vec4(in_position, 1.0);
   fragment_color = in_color;
+  fragment_uv    = in_uv;
+
+  // world may scale non-uniformly, quantized normals are stored scaled by dequantization to match,
+  // row vector times inverse world is the inverse transpose normal matrix computed on host
+  vec3 normal = Octahedral_Normal ? decode_octahedral(in_normal.xy) : in_normal;
+  fragment_normal = normal * mat3(instances.matrices[ubo.instance_count + push.instance]);
 }
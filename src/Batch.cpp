@@ -0,0 +1,240 @@
+/*===-- src/Batch.cpp ---------- Static Batching --------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the merge of static glTF primitives, vertices are      *|
+|* transformed to space of batch and indices rebased.                         *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Batch.hpp"
+#include "Mesh.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <type_traits>
+
+namespace
+{
+
+/**
+ * Get size of float vertex format, 0 if format can't be batched.
+ */
+uint32_t get_format_size(VkFormat format)
+{
+  switch (format)
+  {
+  case VK_FORMAT_R32G32_SFLOAT:       return 8;
+  case VK_FORMAT_R32G32B32_SFLOAT:    return 12;
+  case VK_FORMAT_R32G32B32A32_SFLOAT: return 16;
+  default:                            return 0;
+  }
+}
+
+template <typename T>
+auto read(std::span<const std::byte> data, uint32_t offset)
+{
+  T value;
+  std::memcpy(&value, data.data() + offset, sizeof(T));
+  return value;
+}
+
+template <typename T>
+void read_components(std::span<const std::byte> data, uint32_t offset, uint32_t count, glm::vec4& value)
+{
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    auto component = read<T>(data, offset + i * (uint32_t)sizeof(T));
+    // normalized integers, the most negative signed value also maps to -1
+    if constexpr (std::is_floating_point_v<T>)
+      value[i] = component;
+    else
+      value[i] = std::max((float)component / std::numeric_limits<T>::max(), -1.f);
+  }
+}
+
+/**
+ * Read element of any vertex format as floats, missing components are 0 and alpha 1.
+ */
+glm::vec4 read_element(std::span<const std::byte> data, VkFormat format, uint32_t offset)
+{
+  glm::vec4 value(0.f, 0.f, 0.f, 1.f);
+  switch (format)
+  {
+  case VK_FORMAT_R32_SFLOAT:          read_components<float>(data, offset, 1, value);    break;
+  case VK_FORMAT_R32G32_SFLOAT:       read_components<float>(data, offset, 2, value);    break;
+  case VK_FORMAT_R32G32B32_SFLOAT:    read_components<float>(data, offset, 3, value);    break;
+  case VK_FORMAT_R32G32B32A32_SFLOAT: read_components<float>(data, offset, 4, value);    break;
+  case VK_FORMAT_R8_UNORM:            read_components<uint8_t>(data, offset, 1, value);  break;
+  case VK_FORMAT_R8G8_UNORM:          read_components<uint8_t>(data, offset, 2, value);  break;
+  case VK_FORMAT_R8G8B8A8_UNORM:      read_components<uint8_t>(data, offset, 4, value);  break;
+  case VK_FORMAT_R8_SNORM:            read_components<int8_t>(data, offset, 1, value);   break;
+  case VK_FORMAT_R8G8_SNORM:          read_components<int8_t>(data, offset, 2, value);   break;
+  case VK_FORMAT_R8G8B8A8_SNORM:      read_components<int8_t>(data, offset, 4, value);   break;
+  case VK_FORMAT_R16_UNORM:           read_components<uint16_t>(data, offset, 1, value); break;
+  case VK_FORMAT_R16G16_UNORM:        read_components<uint16_t>(data, offset, 2, value); break;
+  case VK_FORMAT_R16G16B16A16_UNORM:  read_components<uint16_t>(data, offset, 4, value); break;
+  case VK_FORMAT_R16_SNORM:           read_components<int16_t>(data, offset, 1, value);  break;
+  case VK_FORMAT_R16G16_SNORM:        read_components<int16_t>(data, offset, 2, value);  break;
+  case VK_FORMAT_R16G16B16A16_SNORM:  read_components<int16_t>(data, offset, 4, value);  break;
+  default:                                                                               break;
+  }
+  return value;
+}
+
+uint32_t read_index(std::span<const std::byte> data, VkIndexType type, uint32_t offset)
+{
+  switch (type)
+  {
+  case VK_INDEX_TYPE_UINT8_EXT: return (uint32_t)data[offset];
+  case VK_INDEX_TYPE_UINT16:    return read<uint16_t>(data, offset);
+  default:                      return read<uint32_t>(data, offset);
+  }
+}
+
+}
+
+namespace Mesh
+{
+
+bool is_batchable(const Primitive& primitive)
+{
+  // position and normal are transformed, so they must be 3 floats
+  const auto& position = primitive.attributes[0];
+  const auto& normal   = primitive.attributes[2];
+  if (!primitive.indices || !position || position->format != VK_FORMAT_R32G32B32_SFLOAT ||
+      position->count > Max_Batch_Primitive_Vertices || (normal && normal->format != VK_FORMAT_R32G32B32_SFLOAT))
+    return false;
+  return std::ranges::all_of(primitive.attributes, [](const auto& attribute)
+  {
+    return !attribute || get_format_size(attribute->format) != 0;
+  });
+}
+
+auto merge_static(const GlbFile& file) -> std::vector<Batch>
+{
+  std::vector<Batch> batches;
+  for (const auto& node : file.nodes())
+  {
+    auto normal_matrix = glm::mat3(glm::transpose(glm::inverse(node.transform)));
+    for (const auto& primitive : file.meshes()[node.mesh].primitives)
+    {
+      if (!is_batchable(primitive))
+        continue;
+
+      std::array<VkFormat, 4> formats;
+      std::ranges::transform(primitive.attributes, formats.begin(), [](const auto& attribute)
+      {
+        return attribute ? attribute->format : VK_FORMAT_UNDEFINED;
+      });
+      auto it = std::ranges::find_if(batches, [&](const auto& batch)
+      {
+        return batch.formats == formats && batch.material == primitive.material;
+      });
+      if (it == batches.end())
+      {
+        it = batches.emplace(batches.end());
+        it->formats  = formats;
+        it->material = primitive.material;
+      }
+      auto& batch = *it;
+
+      // positions and normals are transformed to space of batch, other attributes are copied
+      auto count  = primitive.attributes[0]->count;
+      auto bounds = Bounds{ glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest()) };
+      for (uint32_t location = 0; location < primitive.attributes.size(); ++location)
+      {
+        const auto& attribute = primitive.attributes[location];
+        if (!attribute)
+          continue;
+        auto  size   = get_format_size(attribute->format);
+        auto  data   = file.buffer_view(attribute->buffer_view);
+        auto& stream = batch.streams[location];
+        auto  first  = stream.size();
+        stream.resize(first + (size_t)size * count);
+        auto  dst    = stream.data() + first;
+        for (uint32_t i = 0; i < count; ++i, dst += size)
+        {
+          auto offset = attribute->offset + i * attribute->stride;
+          if (location == 0)
+          {
+            auto position = glm::vec3(node.transform * glm::vec4(read<glm::vec3>(data, offset), 1.f));
+            bounds.min = glm::min(bounds.min, position);
+            bounds.max = glm::max(bounds.max, position);
+            std::memcpy(dst, &position, size);
+          }
+          else if (location == 2)
+          {
+            auto normal = glm::normalize(normal_matrix * read<glm::vec3>(data, offset));
+            std::memcpy(dst, &normal, size);
+          }
+          else
+            std::memcpy(dst, data.data() + offset, size);
+        }
+      }
+
+      const auto& indices = *primitive.indices;
+      auto data = file.buffer_view(indices.buffer_view);
+      batch.submeshes.emplace_back(Submesh
+      {
+        .first_index = (uint32_t)batch.indices.size(),
+        .index_count = indices.count,
+        .sphere      = glm::vec4((bounds.min + bounds.max) * 0.5f, glm::length(bounds.max - bounds.min) * 0.5f),
+      });
+      for (uint32_t i = 0; i < indices.count; ++i)
+        batch.indices.emplace_back(batch.vertex_count + read_index(data, primitive.index_type, indices.offset + i * indices.stride));
+      batch.vertex_count += count;
+    }
+  }
+  return batches;
+}
+
+auto merge_mesh(const GlbFile& file) -> MeshData
+{
+  MeshData mesh;
+  for (const auto& node : file.nodes())
+  {
+    auto normal_matrix = glm::mat3(glm::transpose(glm::inverse(node.transform)));
+    for (const auto& primitive : file.meshes()[node.mesh].primitives)
+    {
+      // primitives without positions draw nothing
+      if (!primitive.attributes[0])
+        continue;
+
+      auto first = (uint32_t)mesh.vertices.size();
+      auto count = primitive.attributes[0]->count;
+      auto get   = [&](uint32_t location, uint32_t i)
+      {
+        const auto& attribute = *primitive.attributes[location];
+        return read_element(file.buffer_view(attribute.buffer_view), attribute.format, attribute.offset + i * attribute.stride);
+      };
+      for (uint32_t i = 0; i < count; ++i)
+        mesh.vertices.emplace_back(Vertex
+        {
+          .position = glm::vec3(node.transform * glm::vec4(glm::vec3(get(0, i)), 1.f)),
+          .color    = primitive.attributes[1] ? glm::vec3(get(1, i)) : glm::vec3(1.f),
+          .normal   = primitive.attributes[2] ? glm::normalize(normal_matrix * glm::vec3(get(2, i))) : glm::vec3(0.f),
+          .uv       = primitive.attributes[3] ? glm::vec2(get(3, i)) : glm::vec2(0.f),
+        });
+
+      if (!primitive.indices)
+      {
+        for (uint32_t i = 0; i < count; ++i)
+          mesh.indices.emplace_back(first + i);
+        continue;
+      }
+      const auto& indices = *primitive.indices;
+      auto data = file.buffer_view(indices.buffer_view);
+      for (uint32_t i = 0; i < indices.count; ++i)
+        mesh.indices.emplace_back(first + read_index(data, primitive.index_type, indices.offset + i * indices.stride));
+    }
+  }
+  return mesh;
+}
+
+}
@@ -0,0 +1,496 @@
+/*===-- src/Bvh.cpp ------------ Bounding Volume Hierarchy ----------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the binned SAH build, refit and traversal of the       *|
+|* bounding volume hierarchy.                                                 *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Bvh.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+using Mesh::Bounds;
+
+constexpr uint32_t Invalid       = std::numeric_limits<uint32_t>::max();
+constexpr uint32_t Bin_Count     = 16;
+constexpr uint32_t Leaf_Size     = 4;  ///< nodes of at most this many objects are never split
+constexpr uint32_t Max_Leaf_Size = 16; ///< nodes of more objects are split even if SAH prefers leaf
+
+const Bounds Empty
+{
+  .min = glm::vec3( std::numeric_limits<float>::max()),
+  .max = glm::vec3(-std::numeric_limits<float>::max()),
+};
+
+auto merge(const Bounds& a, const Bounds& b)
+{
+  return Bounds{ glm::min(a.min, b.min), glm::max(a.max, b.max) };
+}
+
+auto surface_area(const Bounds& b)
+{
+  auto d = b.max - b.min;
+  if (d.x < 0.f || d.y < 0.f || d.z < 0.f)
+    return 0.f;
+  return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+auto centroid(const Bounds& b)
+{
+  return (b.min + b.max) * .5f;
+}
+
+auto overlap(const Bounds& a, const Bounds& b)
+{
+  return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+         a.min.y <= b.max.y && a.max.y >= b.min.y &&
+         a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+auto contain(const Bounds& outer, const Bounds& inner)
+{
+  return outer.min.x <= inner.min.x && outer.max.x >= inner.max.x &&
+         outer.min.y <= inner.min.y && outer.max.y >= inner.max.y &&
+         outer.min.z <= inner.min.z && outer.max.z >= inner.max.z;
+}
+
+constexpr uint32_t Outside = Invalid;
+
+/**
+ * Test box against planes in mask.
+ *
+ * @return planes still intersecting box, Outside if box is outside any plane.
+ */
+auto test_planes(const Culling::Frustum& frustum, const Bounds& bounds, uint32_t mask)
+{
+  auto center = centroid(bounds);
+  auto extent = (bounds.max - bounds.min) * .5f;
+  for (uint32_t i = 0; i < 6; ++i)
+  {
+    if (!(mask & (1u << i)))
+      continue;
+    const auto& plane = frustum.planes[i];
+    auto distance = glm::dot(glm::vec3(plane), center) + plane.w;
+    auto radius   = glm::dot(glm::abs(glm::vec3(plane)), extent);
+    if (distance + radius < 0.f)
+      return Outside;
+    if (distance - radius >= 0.f)
+      mask &= ~(1u << i);
+  }
+  return mask;
+}
+
+/**
+ * Slab test of ray and box.
+ *
+ * @return distance to entry, negative if missed.
+ */
+auto intersect(const Bounds& bounds, const glm::vec3& origin, const glm::vec3& inverse_direction, float max_distance)
+{
+  auto t0 = (bounds.min - origin) * inverse_direction;
+  auto t1 = (bounds.max - origin) * inverse_direction;
+  auto near = glm::min(t0, t1), far = glm::max(t0, t1);
+  auto entry = std::max({ near.x, near.y, near.z, 0.f });
+  auto exit  = std::min({ far.x, far.y, far.z, max_distance });
+  return entry <= exit ? entry : -1.f;
+}
+
+}
+
+namespace Culling
+{
+
+uint32_t Bvh::insert(const Bounds& bounds)
+{
+  uint32_t id;
+  if (_free.empty())
+  {
+    id = _bounds.size();
+    _bounds.emplace_back();
+    _alive.emplace_back();
+    _leaf_of.emplace_back(Invalid);
+  }
+  else
+  {
+    id = _free.back();
+    _free.pop_back();
+  }
+  _bounds[id] = bounds;
+  _alive[id]  = true;
+
+  // reused id may still have a leaf, then it is just moved
+  if (_leaf_of[id] != Invalid)
+    _dirty.emplace_back(id);
+  else
+    _pending.emplace_back(id);
+  if (rebuilding())
+    _changed.emplace_back(id);
+  return id;
+}
+
+void Bvh::update(uint32_t id, const Bounds& bounds)
+{
+  _bounds[id] = bounds;
+  if (_leaf_of[id] != Invalid)
+    _dirty.emplace_back(id);
+  if (rebuilding())
+    _changed.emplace_back(id);
+}
+
+void Bvh::remove(uint32_t id)
+{
+  _bounds[id] = Empty;
+  _alive[id]  = false;
+  _free.emplace_back(id);
+  if (_leaf_of[id] != Invalid)
+    _dirty.emplace_back(id);
+  else
+    std::erase(_pending, id);
+  if (rebuilding())
+    _changed.emplace_back(id);
+}
+
+void Bvh::build()
+{
+  if (rebuilding())
+    _rebuild.get();
+  _changed.clear();
+
+  std::vector<uint32_t> ids;
+  for (uint32_t id = 0; id < _alive.size(); ++id)
+    if (_alive[id])
+      ids.emplace_back(id);
+  install(build_tree(_bounds, std::move(ids)));
+}
+
+void Bvh::rebuild_async()
+{
+  if (rebuilding())
+    return;
+  _changed.clear();
+
+  std::vector<uint32_t> ids;
+  for (uint32_t id = 0; id < _alive.size(); ++id)
+    if (_alive[id])
+      ids.emplace_back(id);
+  _rebuild = Util::ThreadPool::instance().submit([bounds = _bounds, ids = std::move(ids)]() mutable
+  {
+    return build_tree(bounds, std::move(ids));
+  });
+}
+
+void Bvh::install(Tree&& tree)
+{
+  _tree = std::move(tree);
+  _area_sum = 0.0;
+  for (const auto& node : _tree.nodes)
+    _area_sum += surface_area(node.bounds);
+  _build_cost = _tree.nodes.empty() ? 0.0 : _area_sum / surface_area(_tree.nodes[0].bounds);
+  std::ranges::fill(_leaf_of, Invalid);
+  for (uint32_t i = 0; i < _tree.nodes.size(); ++i)
+    if (const auto& node = _tree.nodes[i]; node.left == 0)
+      for (auto item = node.begin; item < node.end; ++item)
+        _leaf_of[_tree.items[item]] = i;
+
+  _pending.clear();
+  for (uint32_t id = 0; id < _alive.size(); ++id)
+    if (_alive[id] && _leaf_of[id] == Invalid)
+      _pending.emplace_back(id);
+
+  // tree was built from bounds before these changes
+  _dirty.clear();
+  for (auto id : _changed)
+    if (_leaf_of[id] != Invalid)
+      _dirty.emplace_back(id);
+  _changed.clear();
+}
+
+auto Bvh::leaf_bounds(const Node& node) const -> Bounds
+{
+  auto bounds = Empty;
+  for (auto item = node.begin; item < node.end; ++item)
+    bounds = merge(bounds, _bounds[_tree.items[item]]);
+  return bounds;
+}
+
+void Bvh::refit()
+{
+  if (rebuilding() && _rebuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    install(_rebuild.get());
+
+  // walk to root, stop where bounds no longer change
+  for (auto id : _dirty)
+    for (auto i = _leaf_of[id]; i != Invalid; i = _tree.parents[i])
+    {
+      auto& node   = _tree.nodes[i];
+      auto  bounds = node.left == 0 ? leaf_bounds(node)
+                                    : merge(_tree.nodes[node.left].bounds, _tree.nodes[node.left + 1].bounds);
+      if (bounds.min == node.bounds.min && bounds.max == node.bounds.max)
+        break;
+      _area_sum  += surface_area(bounds) - surface_area(node.bounds);
+      node.bounds = bounds;
+    }
+  _dirty.clear();
+}
+
+auto Bvh::degradation() const -> float
+{
+  if (_tree.nodes.empty() || _build_cost <= 0.0)
+    return 1.f;
+  auto root = surface_area(_tree.nodes[0].bounds);
+  return root > 0.f ? (float)(_area_sum / root / _build_cost) : 1.f;
+}
+
+auto Bvh::build_tree(std::span<const Bounds> bounds, std::vector<uint32_t> ids) -> Tree
+{
+  Tree tree;
+  if (ids.empty())
+    return tree;
+
+  // partition copies instead of ids, so passes over a node read memory sequentially
+  struct Primitive
+  {
+    Bounds    bounds;
+    glm::vec3 centroid;
+    uint32_t  id;
+  };
+  std::vector<Primitive> primitives;
+  primitives.reserve(ids.size());
+  for (auto id : ids)
+    primitives.emplace_back(bounds[id], centroid(bounds[id]), id);
+
+  // binary tree of n leaves at most has 2n - 1 nodes, so references stay valid
+  tree.nodes.reserve(ids.size() * 2);
+  tree.parents.reserve(ids.size() * 2);
+  tree.nodes.emplace_back(Empty, 0, 0, (uint32_t)ids.size());
+  tree.parents.emplace_back(Invalid);
+
+  std::vector<uint32_t> stack{ 0 };
+  while (!stack.empty())
+  {
+    auto  index = stack.back();
+    auto& node  = tree.nodes[index];
+    stack.pop_back();
+
+    auto range = Empty;
+    for (auto i = node.begin; i < node.end; ++i)
+    {
+      const auto& primitive = primitives[i];
+      node.bounds = merge(node.bounds, primitive.bounds);
+      range = merge(range, { primitive.centroid, primitive.centroid });
+    }
+    auto count = node.end - node.begin;
+    if (count <= Leaf_Size)
+      continue;
+
+    // binned SAH, cost of split is sum of child areas weighted by object counts
+    auto best_cost  = std::numeric_limits<float>::max();
+    auto best_axis  = Invalid;
+    auto best_split = 0u;
+    auto bin_count  = std::min(Bin_Count, count); // small nodes have few candidate splits
+    for (uint32_t axis = 0; axis < 3; ++axis)
+    {
+      auto extent = range.max[axis] - range.min[axis];
+      if (extent <= 0.f)
+        continue;
+
+      Bounds   bin_bounds[Bin_Count];
+      uint32_t bin_counts[Bin_Count]{};
+      std::fill_n(bin_bounds, bin_count, Empty);
+      auto scale = bin_count / extent;
+      for (auto i = node.begin; i < node.end; ++i)
+      {
+        auto bin = std::min(bin_count - 1, (uint32_t)((primitives[i].centroid[axis] - range.min[axis]) * scale));
+        bin_bounds[bin] = merge(bin_bounds[bin], primitives[i].bounds);
+        ++bin_counts[bin];
+      }
+
+      float left_costs[Bin_Count];
+      auto  left = Empty;
+      auto  left_count = 0u;
+      for (uint32_t i = 0; i + 1 < bin_count; ++i)
+      {
+        left = merge(left, bin_bounds[i]);
+        left_count += bin_counts[i];
+        left_costs[i + 1] = surface_area(left) * left_count;
+      }
+      auto right = Empty;
+      auto right_count = 0u;
+      for (auto i = bin_count - 1; i > 0; --i)
+      {
+        right = merge(right, bin_bounds[i]);
+        right_count += bin_counts[i];
+        auto cost = left_costs[i] + surface_area(right) * right_count;
+        if (right_count < count && right_count > 0 && cost < best_cost)
+        {
+          best_cost  = cost;
+          best_axis  = axis;
+          best_split = i;
+        }
+      }
+    }
+
+    auto leaf_cost = surface_area(node.bounds) * count;
+    if (count <= Max_Leaf_Size && (best_axis == Invalid || best_cost >= leaf_cost))
+      continue;
+
+    // all centroids equal, any split is as good
+    auto middle = node.begin + count / 2;
+    if (best_axis != Invalid)
+    {
+      auto scale = bin_count / (range.max[best_axis] - range.min[best_axis]);
+      middle = std::partition(primitives.begin() + node.begin, primitives.begin() + node.end, [&](const auto& primitive)
+      {
+        return std::min(bin_count - 1, (uint32_t)((primitive.centroid[best_axis] - range.min[best_axis]) * scale)) < best_split;
+      }) - primitives.begin();
+    }
+
+    node.left = tree.nodes.size();
+    auto begin = node.begin, end = node.end;
+    tree.nodes.emplace_back(Empty, 0, begin, middle);
+    tree.nodes.emplace_back(Empty, 0, middle, end);
+    tree.parents.emplace_back(index);
+    tree.parents.emplace_back(index);
+    stack.emplace_back(tree.nodes.size() - 2);
+    stack.emplace_back(tree.nodes.size() - 1);
+  }
+
+  tree.items = std::move(ids);
+  for (uint32_t i = 0; i < primitives.size(); ++i)
+    tree.items[i] = primitives[i].id;
+  return tree;
+}
+
+void Bvh::cull(const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+  constexpr uint32_t All_Planes = 0x3F;
+
+  for (auto id : _pending)
+    if (test_planes(frustum, _bounds[id], All_Planes) != Outside)
+      visible.emplace_back(id);
+  if (_tree.nodes.empty())
+    return;
+
+  // planes a node is fully inside are skipped for its subtree
+  std::vector<std::pair<uint32_t, uint32_t>> stack{ { 0, All_Planes } };
+  while (!stack.empty())
+  {
+    auto [index, planes] = stack.back();
+    stack.pop_back();
+    const auto& node = _tree.nodes[index];
+
+    auto mask = test_planes(frustum, node.bounds, planes);
+    if (mask == Outside)
+      continue;
+    if (mask == 0 || node.left == 0)
+    {
+      for (auto i = node.begin; i < node.end; ++i)
+      {
+        auto id = _tree.items[i];
+        if (_alive[id] && (mask == 0 || test_planes(frustum, _bounds[id], mask) != Outside))
+          visible.emplace_back(id);
+      }
+      continue;
+    }
+    stack.emplace_back(node.left + 1, mask);
+    stack.emplace_back(node.left, mask);
+  }
+}
+
+void Bvh::query(const Bounds& range, std::vector<uint32_t>& result) const
+{
+  for (auto id : _pending)
+    if (overlap(range, _bounds[id]))
+      result.emplace_back(id);
+  if (_tree.nodes.empty())
+    return;
+
+  std::vector<uint32_t> stack{ 0 };
+  while (!stack.empty())
+  {
+    const auto& node = _tree.nodes[stack.back()];
+    stack.pop_back();
+    if (!overlap(range, node.bounds))
+      continue;
+
+    auto inside = contain(range, node.bounds);
+    if (inside || node.left == 0)
+    {
+      for (auto i = node.begin; i < node.end; ++i)
+      {
+        auto id = _tree.items[i];
+        if (_alive[id] && (inside || overlap(range, _bounds[id])))
+          result.emplace_back(id);
+      }
+      continue;
+    }
+    stack.emplace_back(node.left + 1);
+    stack.emplace_back(node.left);
+  }
+}
+
+auto Bvh::pick(const glm::vec3& origin, const glm::vec3& direction, float max_distance) const -> std::optional<Hit>
+{
+  auto inverse = glm::vec3(1.f) / direction;
+  std::optional<Hit> hit;
+  auto nearest = max_distance;
+
+  for (auto id : _pending)
+    if (auto t = intersect(_bounds[id], origin, inverse, nearest); t >= 0.f)
+    {
+      hit = Hit{ id, t };
+      nearest = t;
+    }
+  if (_tree.nodes.empty())
+    return hit;
+
+  // visit nearer child first, skip nodes entered beyond nearest hit
+  std::vector<std::pair<uint32_t, float>> stack;
+  if (auto t = intersect(_tree.nodes[0].bounds, origin, inverse, nearest); t >= 0.f)
+    stack.emplace_back(0, t);
+  while (!stack.empty())
+  {
+    auto [index, entry] = stack.back();
+    stack.pop_back();
+    if (entry > nearest)
+      continue;
+
+    const auto& node = _tree.nodes[index];
+    if (node.left == 0)
+    {
+      for (auto i = node.begin; i < node.end; ++i)
+      {
+        auto id = _tree.items[i];
+        if (auto t = _alive[id] ? intersect(_bounds[id], origin, inverse, nearest) : -1.f; t >= 0.f)
+        {
+          hit = Hit{ id, t };
+          nearest = t;
+        }
+      }
+      continue;
+    }
+
+    auto t0 = intersect(_tree.nodes[node.left].bounds,     origin, inverse, nearest);
+    auto t1 = intersect(_tree.nodes[node.left + 1].bounds, origin, inverse, nearest);
+    std::pair<uint32_t, float> near{ node.left, t0 }, far{ node.left + 1, t1 };
+    if (t1 >= 0.f && (t0 < 0.f || t1 < t0))
+      std::swap(near, far);
+    if (far.second >= 0.f)
+      stack.emplace_back(far);
+    if (near.second >= 0.f)
+      stack.emplace_back(near);
+  }
+  return hit;
+}
+
+}
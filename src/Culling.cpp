@@ -0,0 +1,215 @@
+/*===-- src/Culling.cpp -------- Culling ----------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the scalar, SSE and AVX2 frustum culling kernels and   *|
+|* their runtime dispatch.                                                    *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Culling.hpp"
+
+#include <bit>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define CULLING_X86 1
+#endif
+
+namespace
+{
+
+using namespace Culling;
+
+/**
+ * Plane components broadcast for SIMD, each array has six planes.
+ */
+struct Planes
+{
+  float a[6], b[6], c[6], d[6];
+  float abs_a[6], abs_b[6], abs_c[6];
+
+  Planes(const Frustum& frustum)
+  {
+    for (uint32_t i = 0; i < 6; ++i)
+    {
+      a[i] = frustum.planes[i].x;
+      b[i] = frustum.planes[i].y;
+      c[i] = frustum.planes[i].z;
+      d[i] = frustum.planes[i].w;
+      abs_a[i] = std::abs(a[i]);
+      abs_b[i] = std::abs(b[i]);
+      abs_c[i] = std::abs(c[i]);
+    }
+  }
+};
+
+/**
+ * Scalar test of volumes in [begin, end), radius of box is its projected extent on plane normal.
+ */
+template <bool Box>
+auto cull_scalar(const Planes& p, const float* x, const float* y, const float* z,
+                 const float* rx, const float* ry, const float* rz,
+                 uint32_t begin, uint32_t end, uint32_t* visible)
+{
+  uint32_t count = 0;
+  for (auto i = begin; i < end; ++i)
+  {
+    bool inside = true;
+    for (uint32_t j = 0; j < 6; ++j)
+    {
+      auto distance = p.a[j] * x[i] + p.b[j] * y[i] + p.c[j] * z[i] + p.d[j];
+      auto radius   = Box ? p.abs_a[j] * rx[i] + p.abs_b[j] * ry[i] + p.abs_c[j] * rz[i] : rx[i];
+      inside &= distance > -radius;
+    }
+    visible[count] = i;
+    count += inside;
+  }
+  return count;
+}
+
+/**
+ * Append set bits of mask as indices from base.
+ */
+inline auto compact(uint32_t mask, uint32_t base, uint32_t* visible)
+{
+  uint32_t count = 0;
+  while (mask)
+  {
+    visible[count++] = base + std::countr_zero(mask);
+    mask &= mask - 1;
+  }
+  return count;
+}
+
+#ifdef CULLING_X86
+
+template <bool Box>
+auto cull_sse(const Planes& p, const float* x, const float* y, const float* z,
+              const float* rx, const float* ry, const float* rz,
+              uint32_t size, uint32_t* visible)
+{
+  uint32_t count = 0, i = 0;
+  for (; i + 4 <= size; i += 4)
+  {
+    auto vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+    auto vrx = _mm_loadu_ps(rx + i);
+    __m128 vry, vrz;
+    if constexpr (Box)
+    {
+      vry = _mm_loadu_ps(ry + i);
+      vrz = _mm_loadu_ps(rz + i);
+    }
+
+    auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (uint32_t j = 0; j < 6; ++j)
+    {
+      auto distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.a[j]), vx), _mm_mul_ps(_mm_set1_ps(p.b[j]), vy)),
+                                 _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.c[j]), vz), _mm_set1_ps(p.d[j])));
+      auto radius = vrx;
+      if constexpr (Box)
+        radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.abs_a[j]), vrx), _mm_mul_ps(_mm_set1_ps(p.abs_b[j]), vry)),
+                            _mm_mul_ps(_mm_set1_ps(p.abs_c[j]), vrz));
+      // distance > -radius  <=>  distance + radius > 0
+      inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+    }
+    count += compact(_mm_movemask_ps(inside), i, visible + count);
+  }
+  return count + cull_scalar<Box>(p, x, y, z, rx, ry, rz, i, size, visible + count);
+}
+
+template <bool Box>
+__attribute__((target("avx2,fma")))
+auto cull_avx2(const Planes& p, const float* x, const float* y, const float* z,
+               const float* rx, const float* ry, const float* rz,
+               uint32_t size, uint32_t* visible)
+{
+  uint32_t count = 0, i = 0;
+  for (; i + 8 <= size; i += 8)
+  {
+    auto vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i), vz = _mm256_loadu_ps(z + i);
+    auto vrx = _mm256_loadu_ps(rx + i);
+    __m256 vry, vrz;
+    if constexpr (Box)
+    {
+      vry = _mm256_loadu_ps(ry + i);
+      vrz = _mm256_loadu_ps(rz + i);
+    }
+
+    auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (uint32_t j = 0; j < 6; ++j)
+    {
+      auto distance = _mm256_fmadd_ps(_mm256_set1_ps(p.a[j]), vx,
+                      _mm256_fmadd_ps(_mm256_set1_ps(p.b[j]), vy,
+                      _mm256_fmadd_ps(_mm256_set1_ps(p.c[j]), vz, _mm256_set1_ps(p.d[j]))));
+      auto radius = vrx;
+      if constexpr (Box)
+        radius = _mm256_fmadd_ps(_mm256_set1_ps(p.abs_a[j]), vrx,
+                 _mm256_fmadd_ps(_mm256_set1_ps(p.abs_b[j]), vry, _mm256_mul_ps(_mm256_set1_ps(p.abs_c[j]), vrz)));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_GT_OQ));
+    }
+    count += compact(_mm256_movemask_ps(inside), i, visible + count);
+  }
+  return count + cull_scalar<Box>(p, x, y, z, rx, ry, rz, i, size, visible + count);
+}
+
+#endif
+
+template <bool Box>
+auto dispatch(const Frustum& frustum, const float* x, const float* y, const float* z,
+              const float* rx, const float* ry, const float* rz,
+              uint32_t size, uint32_t* visible, Isa isa)
+{
+  Planes planes(frustum);
+#ifdef CULLING_X86
+  if (isa == Isa::AVX2)
+    return cull_avx2<Box>(planes, x, y, z, rx, ry, rz, size, visible);
+  if (isa == Isa::SSE)
+    return cull_sse<Box>(planes, x, y, z, rx, ry, rz, size, visible);
+#endif
+  return cull_scalar<Box>(planes, x, y, z, rx, ry, rz, 0, size, visible);
+}
+
+}
+
+namespace Culling
+{
+
+Frustum extract_frustum(const glm::mat4& m)
+{
+  // rows of matrix, clip space satisfies -w <= x, y <= w and 0 <= z <= w
+  auto row = [&](uint32_t i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+  Frustum frustum
+  {
+    .planes =
+    {
+      row(3) + row(0),
+      row(3) - row(0),
+      row(3) + row(1),
+      row(3) - row(1),
+      row(2),
+      row(3) - row(2),
+    },
+  };
+  for (auto& plane : frustum.planes)
+    plane /= glm::length(glm::vec3(plane));
+  return frustum;
+}
+
+uint32_t cull(const Frustum& frustum, const Spheres& spheres, std::span<uint32_t> visible, Isa isa)
+{
+  return dispatch<false>(frustum, spheres.x.data(), spheres.y.data(), spheres.z.data(),
+                         spheres.radius.data(), nullptr, nullptr, spheres.size(), visible.data(), isa);
+}
+
+uint32_t cull(const Frustum& frustum, const Boxes& boxes, std::span<uint32_t> visible, Isa isa)
+{
+  return dispatch<true>(frustum, boxes.x.data(), boxes.y.data(), boxes.z.data(),
+                        boxes.extent_x.data(), boxes.extent_y.data(), boxes.extent_z.data(), boxes.size(), visible.data(), isa);
+}
+
+}
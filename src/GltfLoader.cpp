@@ -0,0 +1,386 @@
+/*===-- src/GltfLoader.cpp ----- glTF Loader ------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the zero copy glTF 2.0 binary (.glb) loader.           *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Gltf.hpp"
+#include "Json.hpp"
+#include "Util.hpp"
+
+#include <glm/gtc/quaternion.hpp>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+
+namespace
+{
+
+using namespace Mesh;
+using Util::throw_if;
+
+constexpr uint32_t Glb_Magic      = 0x46546C67; // "glTF"
+constexpr uint32_t Glb_Version    = 2;
+constexpr uint32_t Chunk_Type_Json = 0x4E4F534A; // "JSON"
+constexpr uint32_t Chunk_Type_Bin  = 0x004E4942; // "BIN\0"
+
+constexpr uint32_t Mode_Triangles = 4;
+
+enum ComponentType : uint32_t
+{
+  Byte          = 5120,
+  UnsignedByte  = 5121,
+  Short         = 5122,
+  UnsignedShort = 5123,
+  UnsignedInt   = 5125,
+  Float         = 5126,
+};
+
+template <typename T>
+auto read(std::span<const std::byte> bytes, size_t offset)
+{
+  T value;
+  memcpy(&value, bytes.data() + offset, sizeof(T));
+  return value;
+}
+
+auto get_component_size(uint32_t type)
+{
+  switch (type)
+  {
+  case Byte:
+  case UnsignedByte:  return 1u;
+  case Short:
+  case UnsignedShort: return 2u;
+  case UnsignedInt:
+  case Float:         return 4u;
+  }
+  return 0u;
+}
+
+/**
+ * Convert component value to float, normalized integers are mapped to [0, 1] or [-1, 1].
+ */
+auto to_float(double value, uint32_t component_type)
+{
+  switch (component_type)
+  {
+  case Byte:          return std::max((float)value / 127.f,   -1.f);
+  case UnsignedByte:  return (float)value / 255.f;
+  case Short:         return std::max((float)value / 32767.f, -1.f);
+  case UnsignedShort: return (float)value / 65535.f;
+  }
+  return (float)value;
+}
+
+auto read_component(std::span<const std::byte> bytes, size_t offset, uint32_t component_type)
+{
+  switch (component_type)
+  {
+  case Byte:          return to_float(read<int8_t>(bytes, offset),   component_type);
+  case UnsignedByte:  return to_float(read<uint8_t>(bytes, offset),  component_type);
+  case Short:         return to_float(read<int16_t>(bytes, offset),  component_type);
+  case UnsignedShort: return to_float(read<uint16_t>(bytes, offset), component_type);
+  }
+  return read<float>(bytes, offset);
+}
+
+auto get_component_count(std::string_view type)
+{
+  if (type == "SCALAR") return 1u;
+  if (type == "VEC2")   return 2u;
+  if (type == "VEC3")   return 3u;
+  if (type == "VEC4")   return 4u;
+  return 0u;
+}
+
+/**
+ * Get vertex format of accessor, only float and normalized integer are valid vertex attributes.
+ */
+auto get_vertex_format(uint32_t component_type, uint32_t count, bool normalized)
+{
+  constexpr VkFormat Undefined = VK_FORMAT_UNDEFINED;
+  constexpr VkFormat Floats[]  = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+  constexpr VkFormat UNorm8[]  = { VK_FORMAT_R8_UNORM,   VK_FORMAT_R8G8_UNORM,    Undefined,                   VK_FORMAT_R8G8B8A8_UNORM      };
+  constexpr VkFormat SNorm8[]  = { VK_FORMAT_R8_SNORM,   VK_FORMAT_R8G8_SNORM,    Undefined,                   VK_FORMAT_R8G8B8A8_SNORM      };
+  constexpr VkFormat UNorm16[] = { VK_FORMAT_R16_UNORM,  VK_FORMAT_R16G16_UNORM,  Undefined,                   VK_FORMAT_R16G16B16A16_UNORM  };
+  constexpr VkFormat SNorm16[] = { VK_FORMAT_R16_SNORM,  VK_FORMAT_R16G16_SNORM,  Undefined,                   VK_FORMAT_R16G16B16A16_SNORM  };
+
+  if (count < 1 || count > 4)
+    return Undefined;
+  if (component_type == Float)
+    return Floats[count - 1];
+  if (!normalized)
+    return Undefined;
+  switch (component_type)
+  {
+  case UnsignedByte:  return UNorm8[count - 1];
+  case Byte:          return SNorm8[count - 1];
+  case UnsignedShort: return UNorm16[count - 1];
+  case Short:         return SNorm16[count - 1];
+  }
+  return Undefined;
+}
+
+auto get_local_transform(const Json::Value& node)
+{
+  if (node.contains("matrix"))
+  {
+    glm::mat4 matrix;
+    for (uint32_t i = 0; i < 16; ++i)
+      matrix[i / 4][i % 4] = (float)node["matrix"][i].as_number();
+    return matrix;
+  }
+
+  auto& t = node["translation"];
+  auto& r = node["rotation"];
+  auto& s = node["scale"];
+  glm::vec3 translation(t[0].as_number(), t[1].as_number(), t[2].as_number());
+  glm::quat rotation((float)r[3].as_number(1.0), (float)r[0].as_number(), (float)r[1].as_number(), (float)r[2].as_number());
+  glm::vec3 scale(s[0].as_number(1.0), s[1].as_number(1.0), s[2].as_number(1.0));
+
+  auto matrix = glm::mat4_cast(rotation);
+  matrix[0] *= scale.x;
+  matrix[1] *= scale.y;
+  matrix[2] *= scale.z;
+  matrix[3]  = glm::vec4(translation, 1.f);
+  return matrix;
+}
+
+}
+
+namespace Mesh
+{
+
+GlbFile::GlbFile(std::string_view filename)
+  : _file(filename)
+{
+  auto bytes = _file.bytes();
+
+  // header
+  throw_if(bytes.size() < 20, fmt::format("{}: file too small", filename));
+  throw_if(read<uint32_t>(bytes, 0) != Glb_Magic, fmt::format("{}: not a glb file", filename));
+  throw_if(read<uint32_t>(bytes, 4) != Glb_Version, fmt::format("{}: unsupported glb version", filename));
+  bytes = bytes.first(std::min<size_t>(read<uint32_t>(bytes, 8), bytes.size()));
+
+  // chunks
+  std::string_view json_text;
+  std::span<const std::byte> bin;
+  for (size_t offset = 12; offset + 8 <= bytes.size();)
+  {
+    auto length = read<uint32_t>(bytes, offset);
+    auto type   = read<uint32_t>(bytes, offset + 4);
+    throw_if(offset + 8 + length > bytes.size(), fmt::format("{}: chunk out of range", filename));
+    auto data = bytes.subspan(offset + 8, length);
+    if (type == Chunk_Type_Json)
+      json_text = { reinterpret_cast<const char*>(data.data()), data.size() };
+    else if (type == Chunk_Type_Bin && bin.empty())
+      bin = data;
+    offset += 8 + Util::align_up<size_t>(length, 4);
+  }
+  throw_if(json_text.empty(), fmt::format("{}: missing JSON chunk", filename));
+
+  auto json = Json::parse(json_text);
+
+  // buffers, only the embedded binary chunk is supported
+  auto& buffers = json["buffers"];
+  for (size_t i = 0; i < buffers.size(); ++i)
+    throw_if(i > 0 || buffers[i].contains("uri"),
+             fmt::format("{}: external buffers are not supported", filename));
+
+  // buffer views
+  for (const auto& view : json["bufferViews"].as_array())
+  {
+    auto offset = view["byteOffset"].as_int();
+    auto length = view["byteLength"].as_int(-1);
+    throw_if(view["buffer"].as_int() != 0 || offset < 0 || length < 0 ||
+             (size_t)offset > bin.size() || (size_t)length > bin.size() - (size_t)offset,
+             fmt::format("{}: buffer view out of range", filename));
+    _buffer_views.emplace_back(bin.subspan((size_t)offset, (size_t)length));
+  }
+
+  // accessors
+  auto& accessors = json["accessors"];
+  auto get_accessor = [&](const Json::Value& index, bool is_index) -> Accessor
+  {
+    auto& accessor = accessors[(size_t)index.as_int(-1)];
+    throw_if(accessor.is_null() || !accessor.contains("bufferView") || accessor.contains("sparse"),
+             fmt::format("{}: unsupported accessor", filename));
+
+    auto view_index     = (uint32_t)accessor["bufferView"].as_int();
+    auto component_type = (uint32_t)accessor["componentType"].as_int();
+    auto count          = get_component_count(accessor["type"].as_string());
+    auto element_size   = get_component_size(component_type) * count;
+    auto& view          = json["bufferViews"][view_index];
+
+    Accessor result
+    {
+      .buffer_view = view_index,
+      .offset      = (uint32_t)accessor["byteOffset"].as_int(),
+      .stride      = (uint32_t)view["byteStride"].as_int(element_size),
+      .count       = (uint32_t)accessor["count"].as_int(),
+      .format      = VK_FORMAT_UNDEFINED,
+    };
+
+    if (is_index)
+    {
+      throw_if(count != 1 || (component_type != UnsignedByte && component_type != UnsignedShort && component_type != UnsignedInt),
+               fmt::format("{}: invalid index accessor", filename));
+      result.format = component_type == UnsignedByte  ? VK_FORMAT_R8_UINT  :
+                      component_type == UnsignedShort ? VK_FORMAT_R16_UINT : VK_FORMAT_R32_UINT;
+    }
+    else
+    {
+      result.format = get_vertex_format(component_type, count, accessor["normalized"].as_bool());
+      throw_if(result.format == VK_FORMAT_UNDEFINED, fmt::format("{}: unsupported vertex attribute format", filename));
+    }
+
+    throw_if(view_index >= _buffer_views.size() ||
+             (result.count > 0 && result.offset + (size_t)result.stride * (result.count - 1) + element_size > _buffer_views[view_index].size()),
+             fmt::format("{}: accessor out of range", filename));
+    return result;
+  };
+
+  // bounds of POSITION are its min and max, which glTF requires, files omitting them are scanned
+  auto get_bounds = [&](const Json::Value& index, const Accessor& position)
+  {
+    auto& accessor       = accessors[(size_t)index.as_int()];
+    auto  component_type = (uint32_t)accessor["componentType"].as_int();
+    auto& min            = accessor["min"];
+    auto& max            = accessor["max"];
+    throw_if(accessor["type"].as_string() != "VEC3", fmt::format("{}: POSITION is not VEC3", filename));
+    Bounds bounds
+    {
+      .min = glm::vec3( std::numeric_limits<float>::max()),
+      .max = glm::vec3(-std::numeric_limits<float>::max()),
+    };
+    if (min.size() == 3 && max.size() == 3)
+    {
+      for (uint32_t i = 0; i < 3; ++i)
+      {
+        bounds.min[i] = to_float(min[i].as_number(), component_type);
+        bounds.max[i] = to_float(max[i].as_number(), component_type);
+      }
+      return bounds;
+    }
+
+    auto data = _buffer_views[position.buffer_view];
+    auto size = get_component_size(component_type);
+    for (uint32_t i = 0; i < position.count; ++i)
+      for (uint32_t c = 0; c < 3; ++c)
+      {
+        auto value = read_component(data, position.offset + (size_t)i * position.stride + c * size, component_type);
+        bounds.min[c] = std::min(bounds.min[c], value);
+        bounds.max[c] = std::max(bounds.max[c], value);
+      }
+    return bounds;
+  };
+
+  // meshes
+  constexpr std::array<std::string_view, 4> Attribute_Names = { "POSITION", "COLOR_0", "NORMAL", "TEXCOORD_0" };
+  for (const auto& mesh : json["meshes"].as_array())
+  {
+    auto& gltf_mesh = _meshes.emplace_back();
+    for (const auto& primitive : mesh["primitives"].as_array())
+    {
+      // points and lines are not rendered
+      if (primitive["mode"].as_int(Mode_Triangles) != Mode_Triangles)
+        continue;
+
+      Primitive result;
+      for (uint32_t i = 0; i < Attribute_Names.size(); ++i)
+        if (auto& attribute = primitive["attributes"][Attribute_Names[i]]; !attribute.is_null())
+          result.attributes[i] = get_accessor(attribute, false);
+      throw_if(!result.attributes[0], fmt::format("{}: primitive without POSITION", filename));
+      result.bounds = get_bounds(primitive["attributes"]["POSITION"], *result.attributes[0]);
+
+      if (primitive.contains("indices"))
+      {
+        result.indices    = get_accessor(primitive["indices"], true);
+        result.index_type = result.indices->format == VK_FORMAT_R8_UINT  ? VK_INDEX_TYPE_UINT8_EXT :
+                            result.indices->format == VK_FORMAT_R16_UINT ? VK_INDEX_TYPE_UINT16    : VK_INDEX_TYPE_UINT32;
+      }
+      result.material = (int32_t)primitive["material"].as_int(-1);
+      gltf_mesh.primitives.emplace_back(result);
+    }
+  }
+
+  // images, data URIs are not supported and leave image without source
+  for (const auto& image : json["images"].as_array())
+  {
+    auto& result = _images.emplace_back();
+    if (image.contains("bufferView"))
+    {
+      auto view = (uint32_t)image["bufferView"].as_int();
+      throw_if(view >= _buffer_views.size(), fmt::format("{}: image buffer view out of range", filename));
+      result.buffer_view = view;
+    }
+    else if (auto uri = image["uri"].as_string(); !uri.empty() && !uri.starts_with("data:"))
+      result.path = (std::filesystem::path(filename).parent_path() / uri).string();
+  }
+
+  // materials, base color texture is resolved to its image,
+  // KTX2 image of KHR_texture_basisu is preferred over fallback source which may be absent
+  auto& textures = json["textures"];
+  for (const auto& material : json["materials"].as_array())
+  {
+    auto& result  = _materials.emplace_back();
+    auto& texture = material["pbrMetallicRoughness"]["baseColorTexture"];
+    if (texture.is_null())
+      continue;
+    auto& source = textures[(size_t)texture["index"].as_int(-1)];
+    auto  image  = source["extensions"]["KHR_texture_basisu"]["source"].as_int(source["source"].as_int(-1));
+    if (image >= 0 && image < (int64_t)_images.size())
+      result.base_color_image = (int32_t)image;
+  }
+
+  // nodes, resolve world transform from roots of default scene
+  auto& nodes = json["nodes"];
+  std::vector<std::pair<uint32_t, glm::mat4>> stack;
+  auto& scene = json["scenes"][(size_t)json["scene"].as_int(0)];
+  if (scene.is_null())
+  {
+    // no scene, every node which is not a child is root
+    std::vector<bool> is_child(nodes.size());
+    for (const auto& node : nodes.as_array())
+      for (const auto& child : node["children"].as_array())
+        if ((size_t)child.as_int() < is_child.size())
+          is_child[child.as_int()] = true;
+    for (uint32_t i = 0; i < nodes.size(); ++i)
+      if (!is_child[i])
+        stack.emplace_back(i, glm::mat4(1.f));
+  }
+  else
+    for (const auto& root : scene["nodes"].as_array())
+      stack.emplace_back((uint32_t)root.as_int(), glm::mat4(1.f));
+
+  // glTF node hierarchy is a forest, bound the walk to survive bad files
+  size_t visited = 0;
+  while (!stack.empty())
+  {
+    auto [index, parent] = stack.back();
+    stack.pop_back();
+    auto& node = nodes[index];
+    throw_if(node.is_null() || ++visited > nodes.size(), fmt::format("{}: invalid node hierarchy", filename));
+
+    auto transform = parent * get_local_transform(node);
+    if (node.contains("mesh"))
+    {
+      auto mesh = (uint32_t)node["mesh"].as_int();
+      throw_if(mesh >= _meshes.size(), fmt::format("{}: mesh index out of range", filename));
+      _nodes.emplace_back(GltfNode{ transform, mesh });
+    }
+    for (const auto& child : node["children"].as_array())
+      stack.emplace_back((uint32_t)child.as_int(), transform);
+  }
+}
+
+}
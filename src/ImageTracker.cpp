@@ -0,0 +1,229 @@
+/*===-- src/ImageTracker.cpp ----- Image Tracker --------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement state transitions of resources and the per subresource *|
+|* image tracker batching barriers.                                           *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "ImageTracker.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+
+using Util::throw_if;
+
+namespace Vulkan
+{
+
+auto SyncState::use(const Access& access, bool transition) -> VkMemoryBarrier2
+{
+  VkMemoryBarrier2 barrier
+  {
+    .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+  };
+  auto write = access.access & Write_Access;
+  if (transition || write)
+  {
+    // layout transition writes memory too, so it waits for reads like writes do
+    if (transition || write_stage || read_stage)
+    {
+      barrier.srcStageMask  = write_stage | read_stage;
+      barrier.srcAccessMask = write_access;
+      barrier.dstStageMask  = access.stage;
+      barrier.dstAccessMask = access.access;
+    }
+    *this =
+    {
+      .write_stage    = access.stage,
+      .write_access   = write,
+      .read_stage     = write ? VK_PIPELINE_STAGE_2_NONE : access.stage,
+      .visible_stage  = access.stage,
+      .visible_access = access.access,
+      .layout         = transition ? access.layout : layout,
+    };
+  }
+  else
+  {
+    // barrier makes write visible to all its access types in all its stages,
+    // so it covers earlier readers too to keep visibility a product of both masks
+    if (write_stage && ((access.stage & ~visible_stage) || (access.access & ~visible_access)))
+    {
+      visible_stage        |= access.stage;
+      visible_access       |= access.access;
+      barrier.srcStageMask  = write_stage;
+      barrier.srcAccessMask = write_access;
+      barrier.dstStageMask  = visible_stage;
+      barrier.dstAccessMask = visible_access;
+    }
+    read_stage |= access.stage;
+  }
+  return barrier;
+}
+
+void ImageTracker::track(VkImage image, VkImageAspectFlags aspect, uint32_t levels, uint32_t layers, const Access& visible)
+{
+  SyncState state
+  {
+    .visible_stage  = visible.stage,
+    .visible_access = visible.access,
+    .layout         = visible.layout,
+  };
+  _images[image] =
+  {
+    .aspect       = aspect,
+    .levels       = levels,
+    .layers       = layers,
+    .subresources = std::vector<Subresource>(levels * layers, { .state = state }),
+  };
+}
+
+void ImageTracker::forget(VkImage image)
+{
+  _images.erase(image);
+}
+
+void ImageTracker::use(VkImage image, const Access& access, uint32_t level, uint32_t level_count, uint32_t layer, uint32_t layer_count)
+{
+  auto it = _images.find(image);
+  throw_if(it == _images.end(), "image is not tracked");
+  auto& tracked = it->second;
+  level_count = std::min(level_count, tracked.levels - level);
+  layer_count = std::min(layer_count, tracked.layers - layer);
+
+  for (auto l = layer; l < layer + layer_count; ++l)
+  {
+    auto first = (uint32_t)_barriers.size();
+    for (auto m = level; m < level + level_count; ++m)
+    {
+      auto  index       = l * tracked.levels + m;
+      auto& subresource = tracked.subresources[index];
+      auto& state       = subresource.state;
+
+      // used again before flush, queued barrier is widened to cover both uses
+      if (subresource.barrier != (uint32_t)-1)
+      {
+        auto& barrier = _barriers[subresource.barrier];
+        throw_if(access.layout != barrier.newLayout,
+                 fmt::format("subresource changes layout from {} to {} before flush", (int)barrier.newLayout, (int)access.layout));
+        barrier.dstStageMask  |= access.stage;
+        barrier.dstAccessMask |= access.access;
+        if (auto write = access.access & Write_Access)
+        {
+          state.write_stage   |= access.stage;
+          state.write_access  |= write;
+          state.visible_stage  = access.stage;
+          state.visible_access = access.access;
+        }
+        else
+        {
+          state.read_stage     |= access.stage;
+          state.visible_stage  |= access.stage;
+          state.visible_access |= access.access;
+        }
+        continue;
+      }
+
+      auto old_layout = state.layout;
+      auto transition = access.layout != old_layout;
+      auto scopes     = state.use(access, transition);
+      if (!transition && !scopes.dstStageMask)
+        continue;
+
+      // extend barrier of level below if it has same scopes
+      if (_barriers.size() > first)
+      {
+        auto& last = _barriers.back();
+        if (last.subresourceRange.baseMipLevel + last.subresourceRange.levelCount == m &&
+            last.srcStageMask == scopes.srcStageMask && last.srcAccessMask == scopes.srcAccessMask &&
+            last.dstStageMask == scopes.dstStageMask && last.dstAccessMask == scopes.dstAccessMask &&
+            last.oldLayout == old_layout && last.newLayout == access.layout)
+        {
+          ++last.subresourceRange.levelCount;
+          subresource.barrier = (uint32_t)_barriers.size() - 1;
+          _pending.emplace_back(image, index);
+          continue;
+        }
+      }
+      _barriers.emplace_back(VkImageMemoryBarrier2
+      {
+        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask        = scopes.srcStageMask,
+        .srcAccessMask       = scopes.srcAccessMask,
+        .dstStageMask        = scopes.dstStageMask,
+        .dstAccessMask       = scopes.dstAccessMask,
+        .oldLayout           = old_layout,
+        .newLayout           = access.layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = image,
+        .subresourceRange    =
+        {
+          .aspectMask     = tracked.aspect,
+          .baseMipLevel   = m,
+          .levelCount     = 1,
+          .baseArrayLayer = l,
+          .layerCount     = 1,
+        },
+      });
+      subresource.barrier = (uint32_t)_barriers.size() - 1;
+      _pending.emplace_back(image, index);
+    }
+
+    // layer needing one barrier over same levels as layer before is merged into its barrier
+    if (_barriers.size() == first + 1 && first > 0)
+    {
+      auto& last     = _barriers[first];
+      auto& previous = _barriers[first - 1];
+      if (previous.image == image &&
+          previous.subresourceRange.baseArrayLayer + previous.subresourceRange.layerCount == l &&
+          previous.subresourceRange.baseMipLevel == last.subresourceRange.baseMipLevel &&
+          previous.subresourceRange.levelCount == last.subresourceRange.levelCount &&
+          previous.srcStageMask == last.srcStageMask && previous.srcAccessMask == last.srcAccessMask &&
+          previous.dstStageMask == last.dstStageMask && previous.dstAccessMask == last.dstAccessMask &&
+          previous.oldLayout == last.oldLayout && previous.newLayout == last.newLayout)
+      {
+        ++previous.subresourceRange.layerCount;
+        _barriers.pop_back();
+        for (auto m = level; m < level + level_count; ++m)
+          if (auto& subresource = tracked.subresources[l * tracked.levels + m]; subresource.barrier == first)
+            subresource.barrier = first - 1;
+      }
+    }
+  }
+}
+
+void ImageTracker::flush(VkCommandBuffer command_buffer)
+{
+  if (_barriers.empty())
+    return;
+
+  VkDependencyInfo dependency
+  {
+    .sType                   = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+    .imageMemoryBarrierCount = (uint32_t)_barriers.size(),
+    .pImageMemoryBarriers    = _barriers.data(),
+  };
+  vkCmdPipelineBarrier2(command_buffer, &dependency);
+  _barriers.clear();
+
+  for (auto [image, index] : _pending)
+    if (auto it = _images.find(image); it != _images.end())
+      it->second.subresources[index].barrier = -1;
+  _pending.clear();
+}
+
+auto ImageTracker::layout(VkImage image, uint32_t level, uint32_t layer) const -> VkImageLayout
+{
+  auto it = _images.find(image);
+  throw_if(it == _images.end(), "image is not tracked");
+  return it->second.subresources[layer * it->second.levels + level].state.layout;
+}
+
+}
@@ -0,0 +1,166 @@
+/*===-- src/Index.cpp ---------- Index Buffer -----------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the index width selection, meshlet building and index  *|
+|* compression.                                                               *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Mesh.hpp"
+#include "Util.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+
+using Util::throw_if;
+
+constexpr uint32_t Invalid = std::numeric_limits<uint32_t>::max();
+
+auto zigzag(int32_t v)
+{
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+auto unzigzag(uint32_t v)
+{
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+}
+
+namespace Mesh
+{
+
+VkIndexType get_index_type(uint32_t vertex_count)
+{
+  return vertex_count <= std::numeric_limits<uint16_t>::max() + 1u ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+uint32_t get_index_size(VkIndexType type)
+{
+  return type == VK_INDEX_TYPE_UINT16 ? 2 : type == VK_INDEX_TYPE_UINT32 ? 4 : 1;
+}
+
+void pack_indices(std::span<const uint32_t> indices, VkIndexType type, std::byte* dst)
+{
+  if (type == VK_INDEX_TYPE_UINT32)
+  {
+    memcpy(dst, indices.data(), indices.size_bytes());
+    return;
+  }
+
+  // write through local block, dst is usually write combined memory
+  uint16_t block[1024];
+  for (size_t i = 0; i < indices.size(); i += std::size(block))
+  {
+    auto count = std::min(indices.size() - i, std::size(block));
+    for (size_t j = 0; j < count; ++j)
+      block[j] = (uint16_t)indices[i + j];
+    memcpy(dst + i * sizeof(uint16_t), block, count * sizeof(uint16_t));
+  }
+}
+
+MeshletData build_meshlets(std::span<const uint32_t> indices, uint32_t max_vertices, uint32_t max_triangles)
+{
+  throw_if(max_vertices < 3 || max_vertices > 256 || max_triangles == 0, "invalid meshlet limits");
+
+  MeshletData data;
+  std::vector<uint32_t> local_index; // mesh vertex to index in current meshlet
+  Meshlet meshlet{};
+
+  auto finish = [&]
+  {
+    if (meshlet.triangle_count == 0)
+      return;
+    for (auto i = meshlet.vertex_offset; i < data.vertices.size(); ++i)
+      local_index[data.vertices[i]] = Invalid;
+    data.meshlets.emplace_back(meshlet);
+    meshlet = Meshlet
+    {
+      .vertex_offset   = (uint32_t)data.vertices.size(),
+      .triangle_offset = (uint32_t)data.triangles.size(),
+      .vertex_count    = 0,
+      .triangle_count  = 0,
+    };
+  };
+
+  for (size_t t = 0; t + 2 < indices.size(); t += 3)
+  {
+    uint32_t new_vertices = 0;
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+      if (indices[t + i] >= local_index.size())
+        local_index.resize(indices[t + i] + 1, Invalid);
+      if (local_index[indices[t + i]] == Invalid)
+        ++new_vertices;
+    }
+    if (meshlet.vertex_count + new_vertices > max_vertices || meshlet.triangle_count == max_triangles)
+      finish();
+
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+      auto& local = local_index[indices[t + i]];
+      if (local == Invalid)
+      {
+        local = meshlet.vertex_count++;
+        data.vertices.emplace_back(indices[t + i]);
+      }
+      data.triangles.emplace_back((uint8_t)local);
+    }
+    ++meshlet.triangle_count;
+  }
+  finish();
+
+  return data;
+}
+
+std::vector<uint8_t> encode_indices(std::span<const uint32_t> indices)
+{
+  std::vector<uint8_t> data;
+  data.reserve(indices.size() * 2);
+  uint32_t last = 0;
+  for (auto index : indices)
+  {
+    // neighbouring indices of optimized buffer are close, delta is small
+    auto v = zigzag((int32_t)(index - last));
+    last = index;
+    while (v >= 0x80)
+    {
+      data.emplace_back((uint8_t)(v | 0x80));
+      v >>= 7;
+    }
+    data.emplace_back((uint8_t)v);
+  }
+  return data;
+}
+
+void decode_indices(std::span<const uint8_t> data, std::span<uint32_t> indices)
+{
+  size_t pos = 0;
+  uint32_t last = 0;
+  for (auto& index : indices)
+  {
+    uint32_t v = 0;
+    for (uint32_t shift = 0;; shift += 7)
+    {
+      throw_if(pos == data.size() || shift > 28, "corrupted index data");
+      auto byte = data[pos++];
+      v |= (uint32_t)(byte & 0x7F) << shift;
+      if (!(byte & 0x80))
+        break;
+    }
+    last += (uint32_t)unzigzag(v);
+    index = last;
+  }
+  throw_if(pos != data.size(), "corrupted index data");
+}
+
+}
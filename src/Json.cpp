@@ -0,0 +1,321 @@
+/*===-- src/Json.cpp ----------- Json -------------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the minimal JSON parser.                               *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Json.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+
+#include <charconv>
+
+namespace
+{
+
+using namespace Json;
+using Util::throw_if;
+
+const Value           Null;
+const Value::Array    Empty_Array;
+const Value::Object   Empty_Object;
+
+// deepest nesting of arrays and objects, bounds recursion on hostile input
+constexpr size_t Max_Depth = 256;
+
+/**
+ * Recursive descent parser.
+ */
+struct Parser
+{
+  std::string_view text;
+  size_t           pos   = 0;
+  size_t           depth = 0;
+
+  auto error(std::string_view what)
+  {
+    throw_if(true, fmt::format("json: {} at offset {}", what, pos));
+  }
+
+  void skip_space()
+  {
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+      ++pos;
+  }
+
+  auto peek()
+  {
+    skip_space();
+    if (pos == text.size())
+      error("unexpected end");
+    return text[pos];
+  }
+
+  void expect(char c)
+  {
+    if (peek() != c)
+      error(fmt::format("expect '{}'", c));
+    ++pos;
+  }
+
+  void expect(std::string_view word)
+  {
+    if (text.substr(pos, word.size()) != word)
+      error(fmt::format("expect '{}'", word));
+    pos += word.size();
+  }
+
+  auto parse_hex4()
+  {
+    uint32_t code;
+    auto [ptr, ec] = std::from_chars(text.data() + pos, text.data() + std::min(pos + 4, text.size()), code, 16);
+    if (ec != std::errc() || ptr != text.data() + pos + 4)
+      error("invalid unicode escape");
+    pos += 4;
+    return code;
+  }
+
+  static void append_utf8(std::string& s, uint32_t code)
+  {
+    if (code < 0x80)
+      s += (char)code;
+    else if (code < 0x800)
+    {
+      s += (char)(0xC0 | (code >> 6));
+      s += (char)(0x80 | (code & 0x3F));
+    }
+    else if (code < 0x10000)
+    {
+      s += (char)(0xE0 | (code >> 12));
+      s += (char)(0x80 | ((code >> 6) & 0x3F));
+      s += (char)(0x80 | (code & 0x3F));
+    }
+    else
+    {
+      s += (char)(0xF0 | (code >> 18));
+      s += (char)(0x80 | ((code >> 12) & 0x3F));
+      s += (char)(0x80 | ((code >> 6) & 0x3F));
+      s += (char)(0x80 | (code & 0x3F));
+    }
+  }
+
+  auto parse_string()
+  {
+    expect('"');
+    std::string s;
+    while (true)
+    {
+      if (pos == text.size())
+        error("unterminated string");
+      auto c = text[pos++];
+      if (c == '"')
+        break;
+      if (c != '\\')
+      {
+        s += c;
+        continue;
+      }
+      if (pos == text.size())
+        error("unterminated string");
+      switch (text[pos++])
+      {
+      case '"':  s += '"';  break;
+      case '\\': s += '\\'; break;
+      case '/':  s += '/';  break;
+      case 'b':  s += '\b'; break;
+      case 'f':  s += '\f'; break;
+      case 'n':  s += '\n'; break;
+      case 'r':  s += '\r'; break;
+      case 't':  s += '\t'; break;
+      case 'u':
+      {
+        auto code = parse_hex4();
+        // surrogate pair
+        if (code >= 0xD800 && code < 0xDC00 && text.substr(pos, 2) == "\\u")
+        {
+          pos += 2;
+          auto low = parse_hex4();
+          code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        }
+        append_utf8(s, code);
+        break;
+      }
+      default:
+        error("invalid escape");
+      }
+    }
+    return s;
+  }
+
+  auto parse_number()
+  {
+    double number;
+    auto [ptr, ec] = std::from_chars(text.data() + pos, text.data() + text.size(), number);
+    if (ec != std::errc())
+      error("invalid number");
+    pos = ptr - text.data();
+    return number;
+  }
+
+  Value parse_value()
+  {
+    if (++depth > Max_Depth)
+      error("nesting too deep");
+    auto value = parse_element();
+    --depth;
+    return value;
+  }
+
+  Value parse_element()
+  {
+    switch (peek())
+    {
+    case '{':
+    {
+      ++pos;
+      Value::Object object;
+      if (peek() == '}')
+      {
+        ++pos;
+        return object;
+      }
+      while (true)
+      {
+        skip_space();
+        auto key = parse_string();
+        expect(':');
+        object.insert_or_assign(std::move(key), parse_value());
+        if (peek() == '}')
+        {
+          ++pos;
+          return object;
+        }
+        expect(',');
+      }
+    }
+    case '[':
+    {
+      ++pos;
+      Value::Array array;
+      if (peek() == ']')
+      {
+        ++pos;
+        return array;
+      }
+      while (true)
+      {
+        array.emplace_back(parse_value());
+        if (peek() == ']')
+        {
+          ++pos;
+          return array;
+        }
+        expect(',');
+      }
+    }
+    case '"':
+      return parse_string();
+    case 't':
+      expect("true");
+      return true;
+    case 'f':
+      expect("false");
+      return false;
+    case 'n':
+      expect("null");
+      return {};
+    default:
+      return parse_number();
+    }
+  }
+};
+
+}
+
+namespace Json
+{
+
+auto Value::operator[](std::string_view key) const -> const Value&
+{
+  if (auto object = std::get_if<Object>(&_value))
+    if (auto it = object->find(key); it != object->end())
+      return it->second;
+  return Null;
+}
+
+auto Value::operator[](size_t index) const -> const Value&
+{
+  if (auto array = std::get_if<Array>(&_value))
+    if (index < array->size())
+      return (*array)[index];
+  return Null;
+}
+
+auto Value::contains(std::string_view key) const -> bool
+{
+  if (auto object = std::get_if<Object>(&_value))
+    return object->find(key) != object->end();
+  return false;
+}
+
+auto Value::size() const -> size_t
+{
+  if (auto array = std::get_if<Array>(&_value))
+    return array->size();
+  if (auto object = std::get_if<Object>(&_value))
+    return object->size();
+  return 0;
+}
+
+auto Value::as_bool(bool fallback) const -> bool
+{
+  auto b = std::get_if<bool>(&_value);
+  return b ? *b : fallback;
+}
+
+auto Value::as_number(double fallback) const -> double
+{
+  auto number = std::get_if<double>(&_value);
+  return number ? *number : fallback;
+}
+
+auto Value::as_int(int64_t fallback) const -> int64_t
+{
+  auto number = std::get_if<double>(&_value);
+  return number ? (int64_t)*number : fallback;
+}
+
+auto Value::as_string(std::string_view fallback) const -> std::string_view
+{
+  auto string = std::get_if<std::string>(&_value);
+  return string ? std::string_view(*string) : fallback;
+}
+
+auto Value::as_array() const -> const Array&
+{
+  auto array = std::get_if<Array>(&_value);
+  return array ? *array : Empty_Array;
+}
+
+auto Value::as_object() const -> const Object&
+{
+  auto object = std::get_if<Object>(&_value);
+  return object ? *object : Empty_Object;
+}
+
+Value parse(std::string_view text)
+{
+  Parser parser{ .text = text };
+  auto value = parser.parse_value();
+  parser.skip_space();
+  throw_if(parser.pos != text.size(), fmt::format("json: trailing characters at offset {}", parser.pos));
+  return value;
+}
+
+}
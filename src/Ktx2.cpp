@@ -0,0 +1,382 @@
+/*===-- src/Ktx2.cpp ----------- Ktx2 -------------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the reader of KTX2 textures, block compressed payloads *|
+|* are read as is and Basis Universal ones are transcoded, and the baker of   *|
+|* mipmapped RGBA8 KTX2 files.                                                *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Ktx2.hpp"
+#include "MappedFile.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+#include <stb_image.h>
+#include <transcoder/basisu_transcoder.h>
+#include <zstd/zstd.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+namespace
+{
+
+using Util::throw_if;
+
+constexpr std::array<uint8_t, 12> Identifier{ 0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n' };
+
+constexpr uint32_t Supercompression_None      = 0;
+constexpr uint32_t Supercompression_Zstandard = 2;
+
+// levels start on multiples of largest block, 16 bytes of BC7, ETC2 RGBA and ASTC
+constexpr VkDeviceSize Level_Alignment = 16;
+
+struct Header
+{
+  uint8_t  identifier[12];
+  uint32_t vk_format;
+  uint32_t type_size;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t layer_count;
+  uint32_t face_count;
+  uint32_t level_count;
+  uint32_t supercompression_scheme;
+  uint32_t dfd_byte_offset;
+  uint32_t dfd_byte_length;
+  uint32_t kvd_byte_offset;
+  uint32_t kvd_byte_length;
+  uint64_t sgd_byte_offset;
+  uint64_t sgd_byte_length;
+};
+static_assert(sizeof(Header) == 80);
+
+struct Block
+{
+  uint32_t width;
+  uint32_t height;
+  uint32_t bytes;
+};
+
+// block of formats read as is, none for others
+auto get_block(VkFormat format) -> std::optional<Block>
+{
+  if (format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB)
+    return Block{ 1, 1, 4 };
+  if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK)
+  {
+    // BC1 and BC4 blocks are 8 bytes, others 16
+    bool half = format <= VK_FORMAT_BC1_RGBA_SRGB_BLOCK ||
+                format == VK_FORMAT_BC4_UNORM_BLOCK || format == VK_FORMAT_BC4_SNORM_BLOCK;
+    return Block{ 4, 4, half ? 8u : 16u };
+  }
+  if (format >= VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && format <= VK_FORMAT_EAC_R11G11_SNORM_BLOCK)
+  {
+    // ETC2 RGBA and EAC RG11 blocks are 16 bytes, others 8
+    bool full = format == VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK || format == VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK ||
+                format == VK_FORMAT_EAC_R11G11_UNORM_BLOCK    || format == VK_FORMAT_EAC_R11G11_SNORM_BLOCK;
+    return Block{ 4, 4, full ? 16u : 8u };
+  }
+  if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK)
+  {
+    // unorm and srgb of each footprint are adjacent
+    constexpr std::array<std::pair<uint32_t, uint32_t>, 14> Footprints
+    {{
+      { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+      { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 },
+    }};
+    auto [width, height] = Footprints[(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2];
+    return Block{ width, height, 16 };
+  }
+  return std::nullopt;
+}
+
+auto get_transcoder_format(Ktx2::Target target)
+{
+  switch (target)
+  {
+  case Ktx2::Target::BC7:
+    return basist::transcoder_texture_format::cTFBC7_RGBA;
+  case Ktx2::Target::ASTC_4x4:
+    return basist::transcoder_texture_format::cTFASTC_4x4_RGBA;
+  case Ktx2::Target::ETC2:
+    return basist::transcoder_texture_format::cTFETC2_RGBA;
+  case Ktx2::Target::BC3:
+    return basist::transcoder_texture_format::cTFBC3_RGBA;
+  default:
+    return basist::transcoder_texture_format::cTFRGBA32;
+  }
+}
+
+// blocks or pixels of transcoded level
+auto get_transcoded_count(const basist::ktx2_transcoder& transcoder, uint32_t level, basist::transcoder_texture_format format)
+{
+  basist::ktx2_image_level_info info;
+  throw_if(!transcoder.get_image_level_info(info, level, 0, 0), fmt::format("failed to get level {} of Basis Universal texture", level));
+  return basist::basis_transcoder_format_is_uncompressed(format) ? info.m_orig_width * info.m_orig_height : info.m_total_blocks;
+}
+
+auto align(VkDeviceSize size)
+{
+  return (size + Level_Alignment - 1) & ~(Level_Alignment - 1);
+}
+
+float to_linear(uint8_t value)
+{
+  auto c = value / 255.f;
+  return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+uint8_t to_unorm(float value, bool srgb)
+{
+  if (srgb)
+    value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+  return (uint8_t)std::lround(std::clamp(value, 0.f, 1.f) * 255.f);
+}
+
+// box filter of 2x2 texels, last texel of odd row or column pairs with itself
+auto downsample(const std::vector<float>& texels, VkExtent2D extent)
+{
+  auto width  = std::max(extent.width / 2, 1u);
+  auto height = std::max(extent.height / 2, 1u);
+  std::vector<float> result((size_t)width * height * 4);
+  for (uint32_t y = 0; y < height; ++y)
+    for (uint32_t x = 0; x < width; ++x)
+    {
+      auto x0 = 2 * x, x1 = std::min(x0 + 1, extent.width - 1);
+      auto y0 = 2 * y, y1 = std::min(y0 + 1, extent.height - 1);
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        auto texel = [&](uint32_t tx, uint32_t ty) { return texels[((size_t)ty * extent.width + tx) * 4 + c]; };
+        result[((size_t)y * width + x) * 4 + c] = (texel(x0, y0) + texel(x1, y0) + texel(x0, y1) + texel(x1, y1)) * 0.25f;
+      }
+    }
+  return result;
+}
+
+// basic data format descriptor of RGBA8, one 8-bit sample per channel, alpha stays linear in sRGB files
+auto get_rgba8_descriptor(bool srgb)
+{
+  constexpr uint32_t Block_Size = 24 + 4 * 16;
+  std::vector<uint32_t> descriptor
+  {
+    4 + Block_Size,                          // total size
+    0,                                       // Khronos vendor, basic descriptor type
+    2 | Block_Size << 16,                    // version 1.3
+    1 | 1 << 8 | (srgb ? 2u : 1u) << 16,     // RGBSDA color model, BT.709 primaries, transfer function
+    0,                                       // 1x1 texel blocks
+    4,                                       // bytes of plane 0
+    0,
+  };
+  constexpr std::array<uint32_t, 4> Channels = { 0, 1, 2, 15 };
+  for (uint32_t i = 0; i < Channels.size(); ++i)
+  {
+    auto linear = Channels[i] == 15 && srgb ? 0x10u : 0u;
+    descriptor.insert(descriptor.end(), { i * 8 | 7u << 16 | (Channels[i] | linear) << 24, 0u, 0u, 255u });
+  }
+  return descriptor;
+}
+
+}
+
+namespace Ktx2
+{
+
+VkFormat get_format(Target target, bool srgb) noexcept
+{
+  switch (target)
+  {
+  case Target::BC7:
+    return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+  case Target::ASTC_4x4:
+    return srgb ? VK_FORMAT_ASTC_4x4_SRGB_BLOCK : VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+  case Target::ETC2:
+    return srgb ? VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK : VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK;
+  case Target::BC3:
+    return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+  default:
+    return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+  }
+}
+
+bool is_ktx2(std::span<const std::byte> data) noexcept
+{
+  return data.size() >= Identifier.size() && std::memcmp(data.data(), Identifier.data(), Identifier.size()) == 0;
+}
+
+void bake(std::string_view source, std::string_view destination, bool srgb)
+{
+  Util::MappedFile file(source);
+  int width, height, channels;
+  std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> pixels(
+    stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.data()), (int)file.size(), &width, &height, &channels, 4),
+    stbi_image_free);
+  throw_if(pixels == nullptr, fmt::format("failed to decode {}: {}", source, stbi_failure_reason()));
+
+  // each level is filtered from floats of the previous one, so rounding doesn't accumulate down the chain
+  std::array<float, 256> linear;
+  for (uint32_t i = 0; i < linear.size(); ++i)
+    linear[i] = srgb ? to_linear((uint8_t)i) : i / 255.f;
+  auto extent = VkExtent2D{ (uint32_t)width, (uint32_t)height };
+  auto size   = (size_t)width * height * 4;
+  std::vector<float> texels(size);
+  for (size_t i = 0; i < size; ++i)
+    texels[i] = i % 4 == 3 ? pixels.get()[i] / 255.f : linear[pixels.get()[i]];
+  std::vector<std::vector<uint8_t>> levels{ { pixels.get(), pixels.get() + size } };
+  for (auto count = (uint32_t)std::bit_width(std::max(extent.width, extent.height)); levels.size() < count;)
+  {
+    texels = downsample(texels, extent);
+    extent = { std::max(extent.width / 2, 1u), std::max(extent.height / 2, 1u) };
+    auto& level = levels.emplace_back(texels.size());
+    for (size_t i = 0; i < texels.size(); ++i)
+      level[i] = to_unorm(texels[i], srgb && i % 4 != 3);
+  }
+
+  // level index lists level 0 first while data stores smallest level first, RGBA8 levels stay 4-byte aligned
+  auto descriptor = get_rgba8_descriptor(srgb);
+  Header header{};
+  std::memcpy(header.identifier, Identifier.data(), Identifier.size());
+  header.vk_format       = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+  header.type_size       = 1;
+  header.pixel_width     = (uint32_t)width;
+  header.pixel_height    = (uint32_t)height;
+  header.face_count      = 1;
+  header.level_count     = (uint32_t)levels.size();
+  header.dfd_byte_offset = (uint32_t)(sizeof(Header) + levels.size() * 3 * sizeof(uint64_t));
+  header.dfd_byte_length = (uint32_t)(descriptor.size() * sizeof(uint32_t));
+  std::vector<std::array<uint64_t, 3>> index(levels.size()); ///< offset, length and uncompressed length of each level
+  uint64_t offset = header.dfd_byte_offset + header.dfd_byte_length;
+  for (auto level = levels.size(); level-- > 0;)
+  {
+    index[level] = { offset, levels[level].size(), levels[level].size() };
+    offset += levels[level].size();
+  }
+
+  auto temporary = fmt::format("{}.tmp", destination);
+  {
+    std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+    throw_if(!output.is_open(), fmt::format("failed to open {}", temporary));
+    auto write = [&](std::span<const std::byte> data)
+    {
+      output.write(reinterpret_cast<const char*>(data.data()), data.size());
+    };
+    write(std::as_bytes(std::span(&header, 1)));
+    write(std::as_bytes(std::span(index)));
+    write(std::as_bytes(std::span(descriptor)));
+    for (auto level = levels.size(); level-- > 0;)
+      write(std::as_bytes(std::span(levels[level])));
+    throw_if(!output.good(), fmt::format("failed to write {}", temporary));
+  }
+  std::filesystem::rename(temporary, destination);
+}
+
+Reader::Reader(std::span<const std::byte> data, std::string_view name, Target target, bool srgb)
+  : _data(data),
+    _name(name),
+    _target(target)
+{
+  throw_if(!is_ktx2(data) || data.size() < sizeof(Header), fmt::format("{}: not a KTX2 file", name));
+  Header header;
+  std::memcpy(&header, data.data(), sizeof(header));
+  throw_if(header.pixel_width == 0 || header.pixel_height == 0 || header.pixel_depth > 1 ||
+           header.layer_count > 1 || header.face_count != 1,
+           fmt::format("{}: only 2D textures are supported", name));
+  _extent = { header.pixel_width, header.pixel_height };
+
+  // Basis Universal, ETC1S with BasisLZ or UASTC optionally with Zstandard, transcoder parses everything
+  if (header.vk_format == VK_FORMAT_UNDEFINED)
+  {
+    static std::once_flag init;
+    std::call_once(init, basist::basisu_transcoder_init);
+    _transcoder = std::make_unique<basist::ktx2_transcoder>();
+    throw_if(!_transcoder->init(data.data(), (uint32_t)data.size()) || !_transcoder->start_transcoding(),
+             fmt::format("{}: invalid Basis Universal texture", name));
+    _format = get_format(target, srgb);
+    auto format = get_transcoder_format(target);
+    for (uint32_t level = 0; level < _transcoder->get_levels(); ++level)
+    {
+      _offsets.emplace_back(_size);
+      _size = align(_size + (VkDeviceSize)get_transcoded_count(*_transcoder, level, format) * basist::basis_get_bytes_per_block_or_pixel(format));
+    }
+    return;
+  }
+
+  _format = (VkFormat)header.vk_format;
+  auto block = get_block(_format);
+  throw_if(!block, fmt::format("{}: format {} is not supported", name, header.vk_format));
+  _supercompression = header.supercompression_scheme;
+  throw_if(_supercompression != Supercompression_None && _supercompression != Supercompression_Zstandard,
+           fmt::format("{}: supercompression scheme {} is not supported", name, _supercompression));
+
+  // level count 0 asks loader to generate levels below stored level 0, which only uncompressed formats allow
+  _generate_levels = header.level_count == 0;
+  throw_if(_generate_levels && _format != VK_FORMAT_R8G8B8A8_UNORM && _format != VK_FORMAT_R8G8B8A8_SRGB,
+           fmt::format("{}: levels of format {} can't be generated", name, header.vk_format));
+  auto levels = std::max(header.level_count, 1u);
+  throw_if(levels > (uint32_t)std::bit_width(std::max(_extent.width, _extent.height)),
+           fmt::format("{}: {} levels are more than a full chain", name, levels));
+  throw_if(data.size() < sizeof(Header) + levels * sizeof(Level), fmt::format("{}: truncated level index", name));
+  _levels.resize(levels);
+  std::memcpy(_levels.data(), data.data() + sizeof(Header), levels * sizeof(Level));
+  for (uint32_t level = 0; level < levels; ++level)
+  {
+    const auto& [offset, length, uncompressed_length] = _levels[level];
+    auto width  = std::max(_extent.width >> level, 1u);
+    auto height = std::max(_extent.height >> level, 1u);
+    auto size   = (VkDeviceSize)((width + block->width - 1) / block->width) *
+                  ((height + block->height - 1) / block->height) * block->bytes;
+    throw_if(offset > data.size() || length > data.size() - offset, fmt::format("{}: level {} is out of file", name, level));
+    auto stored = _supercompression == Supercompression_None ? length : uncompressed_length;
+    throw_if(stored != size, fmt::format("{}: level {} has {} bytes instead of {}", name, level, stored, size));
+    _offsets.emplace_back(_size);
+    _size = align(_size + size);
+  }
+}
+
+Reader::~Reader() = default;
+
+void Reader::read(std::span<std::byte> result) const
+{
+  throw_if(result.size() < _size, fmt::format("{}: {} bytes are too few for {}", _name, result.size(), _size));
+
+  if (_transcoder)
+  {
+    auto format = get_transcoder_format(_target);
+    for (uint32_t level = 0; level < levels(); ++level)
+      throw_if(!_transcoder->transcode_image_level(level, 0, 0, result.data() + _offsets[level],
+                                                   get_transcoded_count(*_transcoder, level, format), format),
+               fmt::format("{}: failed to transcode level {}", _name, level));
+    return;
+  }
+
+  for (uint32_t level = 0; level < levels(); ++level)
+  {
+    const auto& [offset, length, uncompressed_length] = _levels[level];
+    auto source      = _data.data() + offset;
+    auto destination = result.data() + _offsets[level];
+    if (_supercompression == Supercompression_None)
+    {
+      std::memcpy(destination, source, length);
+      continue;
+    }
+    auto size = ZSTD_decompress(destination, uncompressed_length, source, length);
+    throw_if(ZSTD_isError(size) || size != uncompressed_length,
+             fmt::format("{}: failed to decompress level {}", _name, level));
+  }
+}
+
+}
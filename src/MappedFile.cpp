@@ -0,0 +1,79 @@
+/*===-- src/MappedFile.cpp ----- Mapped File ------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the read only memory mapped file.                      *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "MappedFile.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utility>
+
+namespace Util
+{
+
+MappedFile::MappedFile(std::string_view filename)
+{
+  auto fd = open(std::string(filename).c_str(), O_RDONLY);
+  throw_if(fd == -1, fmt::format("failed to open {}", filename));
+
+  struct stat st;
+  if (fstat(fd, &st) == -1)
+  {
+    close(fd);
+    throw_if(true, fmt::format("failed to get size of {}", filename));
+  }
+  _size = st.st_size;
+
+  // mmap of zero length is invalid, empty file just has no data
+  if (_size > 0)
+  {
+    auto data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    throw_if(data == MAP_FAILED, fmt::format("failed to map {}", filename));
+    // loaders walk the file front to back, start read ahead early
+    madvise(data, _size, MADV_SEQUENTIAL);
+    madvise(data, _size, MADV_WILLNEED);
+    _data = static_cast<const std::byte*>(data);
+  }
+  else
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+  if (_data)
+    munmap(const_cast<std::byte*>(_data), _size);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+  : _data(std::exchange(other._data, nullptr)),
+    _size(std::exchange(other._size, 0))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if (this != &other)
+  {
+    if (_data)
+      munmap(const_cast<std::byte*>(_data), _size);
+    _data = std::exchange(other._data, nullptr);
+    _size = std::exchange(other._size, 0);
+  }
+  return *this;
+}
+
+}
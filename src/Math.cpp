@@ -0,0 +1,365 @@
+/*===-- src/Math.cpp ----------- Math -------------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the batch kernels of matrix math.                      *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Math.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define MATH_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define MATH_NEON 1
+#endif
+
+namespace
+{
+
+using Math::Isa;
+using Mesh::Bounds;
+
+// kernels read matrices as 16 column major floats and boxes as 6 floats
+static_assert(sizeof(glm::mat4) == 16 * sizeof(float));
+static_assert(sizeof(Bounds)    == 6 * sizeof(float));
+
+auto floats(const void* p) { return static_cast<const float*>(p); }
+auto floats(void* p)       { return static_cast<float*>(p); }
+
+/*
+ * Left operand of kernels is a[i * step], step 0 broadcasts single matrix.
+ */
+
+void multiply_scalar(const glm::mat4* a, uint32_t step, const glm::mat4* b, glm::mat4* result, uint32_t size)
+{
+  for (uint32_t i = 0; i < size; ++i)
+    result[i] = a[i * step] * b[i];
+}
+
+void inverse_affine_scalar(const glm::mat4* matrices, glm::mat4* result, uint32_t begin, uint32_t end)
+{
+  for (auto i = begin; i < end; ++i)
+  {
+    const auto& m = matrices[i];
+    glm::vec3 c0(m[0]), c1(m[1]), c2(m[2]), t(m[3]);
+
+    // rows of inverse are cross products of columns divided by determinant
+    auto r0 = glm::cross(c1, c2), r1 = glm::cross(c2, c0), r2 = glm::cross(c0, c1);
+    auto inverse_determinant = 1.f / glm::dot(c0, r0);
+    r0 *= inverse_determinant;
+    r1 *= inverse_determinant;
+    r2 *= inverse_determinant;
+    result[i] = glm::mat4(glm::vec4(r0.x, r1.x, r2.x, 0.f),
+                          glm::vec4(r0.y, r1.y, r2.y, 0.f),
+                          glm::vec4(r0.z, r1.z, r2.z, 0.f),
+                          glm::vec4(-glm::dot(r0, t), -glm::dot(r1, t), -glm::dot(r2, t), 1.f));
+  }
+}
+
+void transform_bounds_scalar(const glm::mat4* matrices, uint32_t step, const Bounds* bounds, Bounds* result, uint32_t size)
+{
+  for (uint32_t i = 0; i < size; ++i)
+  {
+    // center is transformed, extent is projected on absolute axes
+    const auto& m = matrices[i * step];
+    auto center = (bounds[i].min + bounds[i].max) * .5f;
+    auto extent = (bounds[i].max - bounds[i].min) * .5f;
+    auto c = glm::vec3(m * glm::vec4(center, 1.f));
+    auto e = glm::abs(glm::vec3(m[0])) * extent.x + glm::abs(glm::vec3(m[1])) * extent.y + glm::abs(glm::vec3(m[2])) * extent.z;
+    result[i] = { c - e, c + e };
+  }
+}
+
+#ifdef MATH_X86
+
+/**
+ * Two columns of product, columns of left matrix are in both halves.
+ */
+__attribute__((target("avx2,fma")))
+inline __m256 multiply_columns_avx2(const __m256 (&a)[4], __m256 b)
+{
+  auto r = _mm256_mul_ps(a[0], _mm256_permute_ps(b, 0x00));
+  r = _mm256_fmadd_ps(a[1], _mm256_permute_ps(b, 0x55), r);
+  r = _mm256_fmadd_ps(a[2], _mm256_permute_ps(b, 0xAA), r);
+  return _mm256_fmadd_ps(a[3], _mm256_permute_ps(b, 0xFF), r);
+}
+
+__attribute__((target("avx2,fma")))
+void multiply_avx2(const glm::mat4* a, uint32_t step, const glm::mat4* b, glm::mat4* result, uint32_t size)
+{
+  for (uint32_t i = 0; i < size; ++i)
+  {
+    auto pa = floats(&a[i * step]);
+    __m256 columns[4];
+    for (uint32_t j = 0; j < 4; ++j)
+      columns[j] = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(pa + j * 4));
+    auto r01 = multiply_columns_avx2(columns, _mm256_loadu_ps(floats(&b[i])));
+    auto r23 = multiply_columns_avx2(columns, _mm256_loadu_ps(floats(&b[i]) + 8));
+    _mm256_storeu_ps(floats(&result[i]), r01);
+    _mm256_storeu_ps(floats(&result[i]) + 8, r23);
+  }
+}
+
+/**
+ * Cross product of xyz in both halves, w of inputs must be 0.
+ */
+__attribute__((target("avx2,fma")))
+inline __m256 cross_avx2(__m256 a, __m256 b)
+{
+  constexpr int Yzx = _MM_SHUFFLE(3, 0, 2, 1);
+  auto t = _mm256_fmsub_ps(a, _mm256_permute_ps(b, Yzx), _mm256_mul_ps(_mm256_permute_ps(a, Yzx), b));
+  return _mm256_permute_ps(t, Yzx);
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256 load_avx2(const float* lower, const float* upper)
+{
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(lower)), _mm_loadu_ps(upper), 1);
+}
+
+__attribute__((target("avx2,fma")))
+inline void store_avx2(float* lower, float* upper, __m256 value)
+{
+  _mm_storeu_ps(lower, _mm256_castps256_ps128(value));
+  _mm_storeu_ps(upper, _mm256_extractf128_ps(value, 1));
+}
+
+__attribute__((target("avx2,fma")))
+void inverse_affine_avx2(const glm::mat4* matrices, glm::mat4* result, uint32_t size)
+{
+  // two matrices per iteration, one in each half
+  uint32_t i = 0;
+  for (; i + 2 <= size; i += 2)
+  {
+    auto p0 = floats(&matrices[i]), p1 = floats(&matrices[i + 1]);
+    auto c0 = load_avx2(p0, p1), c1 = load_avx2(p0 + 4, p1 + 4), c2 = load_avx2(p0 + 8, p1 + 8), t = load_avx2(p0 + 12, p1 + 12);
+    auto r0 = cross_avx2(c1, c2), r1 = cross_avx2(c2, c0), r2 = cross_avx2(c0, c1);
+
+    // determinant summed into every lane of each half
+    auto d = _mm256_mul_ps(c0, r0);
+    d = _mm256_add_ps(d, _mm256_permute_ps(d, _MM_SHUFFLE(2, 3, 0, 1)));
+    d = _mm256_add_ps(d, _mm256_permute_ps(d, _MM_SHUFFLE(1, 0, 3, 2)));
+    auto inverse_determinant = _mm256_div_ps(_mm256_set1_ps(1.f), d);
+    r0 = _mm256_mul_ps(r0, inverse_determinant);
+    r1 = _mm256_mul_ps(r1, inverse_determinant);
+    r2 = _mm256_mul_ps(r2, inverse_determinant);
+
+    // transpose rows to columns, w of rows is 0
+    auto zero = _mm256_setzero_ps();
+    auto t0 = _mm256_unpacklo_ps(r0, r1), t1 = _mm256_unpackhi_ps(r0, r1);
+    auto t2 = _mm256_unpacklo_ps(r2, zero), t3 = _mm256_unpackhi_ps(r2, zero);
+    auto x = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    auto y = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    auto z = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    auto w = _mm256_fmadd_ps(x, _mm256_permute_ps(t, 0x00),
+             _mm256_fmadd_ps(y, _mm256_permute_ps(t, 0x55), _mm256_mul_ps(z, _mm256_permute_ps(t, 0xAA))));
+    w = _mm256_sub_ps(_mm256_setr_ps(0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 1.f), w);
+
+    auto out0 = floats(&result[i]), out1 = floats(&result[i + 1]);
+    store_avx2(out0,      out1,      x);
+    store_avx2(out0 + 4,  out1 + 4,  y);
+    store_avx2(out0 + 8,  out1 + 8,  z);
+    store_avx2(out0 + 12, out1 + 12, w);
+  }
+  inverse_affine_scalar(matrices, result, i, size);
+}
+
+__attribute__((target("avx2,fma")))
+void transform_bounds_avx2(const glm::mat4* matrices, uint32_t step, const Bounds* bounds, Bounds* result, uint32_t size)
+{
+  // lower half computes center, upper half computes extent with absolute columns
+  auto six   = _mm256_setr_epi32(-1, -1, -1, -1, -1, -1, 0, 0);
+  auto sign  = _mm256_setr_ps(1.f, 1.f, 1.f, 1.f, -1.f, -1.f, -1.f, -1.f);
+  auto mask  = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  auto mins  = _mm256_setr_epi32(0, 1, 2, 2, 0, 1, 2, 2);
+  auto maxs  = _mm256_setr_epi32(3, 4, 5, 5, 3, 4, 5, 5);
+  auto pack  = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 6, 6);
+
+  for (uint32_t i = 0; i < size; ++i)
+  {
+    auto pm = floats(&matrices[i * step]);
+    __m256 m[3];
+    for (uint32_t j = 0; j < 3; ++j)
+    {
+      auto c = _mm_loadu_ps(pm + j * 4);
+      m[j] = _mm256_insertf128_ps(_mm256_castps128_ps256(c), _mm_and_ps(c, mask), 1);
+    }
+    auto m3 = _mm256_castps128_ps256(_mm_loadu_ps(pm + 12));
+    m3 = _mm256_insertf128_ps(m3, _mm_setzero_ps(), 1);
+
+    // (max + min) / 2 in lower half, (max - min) / 2 in upper half
+    auto box = _mm256_maskload_ps(floats(&bounds[i]), six);
+    auto ce  = _mm256_mul_ps(_mm256_fmadd_ps(_mm256_permutevar8x32_ps(box, mins), sign, _mm256_permutevar8x32_ps(box, maxs)), _mm256_set1_ps(.5f));
+    auto r = _mm256_fmadd_ps(m[0], _mm256_permutevar8x32_ps(ce, _mm256_setr_epi32(0, 0, 0, 0, 4, 4, 4, 4)),
+             _mm256_fmadd_ps(m[1], _mm256_permutevar8x32_ps(ce, _mm256_setr_epi32(1, 1, 1, 1, 5, 5, 5, 5)),
+             _mm256_fmadd_ps(m[2], _mm256_permutevar8x32_ps(ce, _mm256_setr_epi32(2, 2, 2, 2, 6, 6, 6, 6)), m3)));
+
+    auto center = _mm256_castps256_ps128(r), extent = _mm256_extractf128_ps(r, 1);
+    auto bound  = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_sub_ps(center, extent)), _mm_add_ps(center, extent), 1);
+    _mm256_maskstore_ps(floats(&result[i]), six, _mm256_permutevar8x32_ps(bound, pack));
+  }
+}
+
+#endif
+
+#ifdef MATH_NEON
+
+void multiply_neon(const glm::mat4* a, uint32_t step, const glm::mat4* b, glm::mat4* result, uint32_t size)
+{
+  for (uint32_t i = 0; i < size; ++i)
+  {
+    auto pa = floats(&a[i * step]);
+    auto a0 = vld1q_f32(pa), a1 = vld1q_f32(pa + 4), a2 = vld1q_f32(pa + 8), a3 = vld1q_f32(pa + 12);
+    float32x4_t columns[4];
+    for (uint32_t j = 0; j < 4; ++j)
+    {
+      auto column = vld1q_f32(floats(&b[i]) + j * 4);
+      auto r = vmulq_laneq_f32(a0, column, 0);
+      r = vfmaq_laneq_f32(r, a1, column, 1);
+      r = vfmaq_laneq_f32(r, a2, column, 2);
+      columns[j] = vfmaq_laneq_f32(r, a3, column, 3);
+    }
+    for (uint32_t j = 0; j < 4; ++j)
+      vst1q_f32(floats(&result[i]) + j * 4, columns[j]);
+  }
+}
+
+/**
+ * Cross product of xyz, w of result is 0.
+ */
+inline float32x4_t cross_neon(float32x4_t a, float32x4_t b)
+{
+  auto yzx = [](float32x4_t v) { return vcopyq_laneq_f32(vextq_f32(v, v, 1), 2, v, 0); };
+  auto t = vsubq_f32(vmulq_f32(a, yzx(b)), vmulq_f32(yzx(a), b));
+  return vsetq_lane_f32(0.f, yzx(t), 3);
+}
+
+void inverse_affine_neon(const glm::mat4* matrices, glm::mat4* result, uint32_t size)
+{
+  for (uint32_t i = 0; i < size; ++i)
+  {
+    auto pm = floats(&matrices[i]);
+    auto c0 = vld1q_f32(pm), c1 = vld1q_f32(pm + 4), c2 = vld1q_f32(pm + 8), t = vld1q_f32(pm + 12);
+    auto r0 = cross_neon(c1, c2), r1 = cross_neon(c2, c0), r2 = cross_neon(c0, c1);
+    auto inverse_determinant = 1.f / vaddvq_f32(vmulq_f32(c0, r0));
+    r0 = vmulq_n_f32(r0, inverse_determinant);
+    r1 = vmulq_n_f32(r1, inverse_determinant);
+    r2 = vmulq_n_f32(r2, inverse_determinant);
+
+    // transpose rows to columns
+    auto p = vtrnq_f32(r0, r1);
+    auto q = vtrnq_f32(r2, vdupq_n_f32(0.f));
+    auto x = vcombine_f32(vget_low_f32(p.val[0]),  vget_low_f32(q.val[0]));
+    auto y = vcombine_f32(vget_low_f32(p.val[1]),  vget_low_f32(q.val[1]));
+    auto z = vcombine_f32(vget_high_f32(p.val[0]), vget_high_f32(q.val[0]));
+    auto w = vfmaq_laneq_f32(vfmaq_laneq_f32(vmulq_laneq_f32(x, t, 0), y, t, 1), z, t, 2);
+    w = vsubq_f32(vsetq_lane_f32(1.f, vdupq_n_f32(0.f), 3), w);
+
+    auto pr = floats(&result[i]);
+    vst1q_f32(pr,      x);
+    vst1q_f32(pr + 4,  y);
+    vst1q_f32(pr + 8,  z);
+    vst1q_f32(pr + 12, w);
+  }
+}
+
+void transform_bounds_neon(const glm::mat4* matrices, uint32_t step, const Bounds* bounds, Bounds* result, uint32_t size)
+{
+  for (uint32_t i = 0; i < size; ++i)
+  {
+    auto pm = floats(&matrices[i * step]);
+    auto m0 = vld1q_f32(pm), m1 = vld1q_f32(pm + 4), m2 = vld1q_f32(pm + 8), m3 = vld1q_f32(pm + 12);
+
+    // w lanes are ignored, loads stay inside the box
+    auto pb  = floats(&bounds[i]);
+    auto min = vld1q_f32(pb);
+    auto max = vcombine_f32(vld1_f32(pb + 3), vld1_dup_f32(pb + 5));
+    auto center = vmulq_n_f32(vaddq_f32(min, max), .5f);
+    auto extent = vmulq_n_f32(vsubq_f32(max, min), .5f);
+    auto c = vfmaq_laneq_f32(vfmaq_laneq_f32(vfmaq_laneq_f32(m3, m0, center, 0), m1, center, 1), m2, center, 2);
+    auto e = vfmaq_laneq_f32(vfmaq_laneq_f32(vmulq_laneq_f32(vabsq_f32(m0), extent, 0), vabsq_f32(m1), extent, 1), vabsq_f32(m2), extent, 2);
+    auto lower = vsubq_f32(c, e), upper = vaddq_f32(c, e);
+
+    // 4th lane of lower lands on max.x and is overwritten by upper
+    auto pr = floats(&result[i]);
+    vst1q_f32(pr, lower);
+    vst1_f32(pr + 3, vget_low_f32(upper));
+    vst1q_lane_f32(pr + 5, upper, 2);
+  }
+}
+
+#endif
+
+void multiply(const glm::mat4* a, uint32_t step, const glm::mat4* b, glm::mat4* result, uint32_t size, Isa isa)
+{
+#ifdef MATH_X86
+  if (isa == Isa::AVX2)
+    return multiply_avx2(a, step, b, result, size);
+#endif
+#ifdef MATH_NEON
+  if (isa == Isa::NEON)
+    return multiply_neon(a, step, b, result, size);
+#endif
+  multiply_scalar(a, step, b, result, size);
+}
+
+void transform_bounds(const glm::mat4* matrices, uint32_t step, const Bounds* bounds, Bounds* result, uint32_t size, Isa isa)
+{
+#ifdef MATH_X86
+  if (isa == Isa::AVX2)
+    return transform_bounds_avx2(matrices, step, bounds, result, size);
+#endif
+#ifdef MATH_NEON
+  if (isa == Isa::NEON)
+    return transform_bounds_neon(matrices, step, bounds, result, size);
+#endif
+  transform_bounds_scalar(matrices, step, bounds, result, size);
+}
+
+}
+
+namespace Math
+{
+
+void multiply(std::span<const glm::mat4> a, std::span<const glm::mat4> b, std::span<glm::mat4> result, Isa isa)
+{
+  ::multiply(a.data(), 1, b.data(), result.data(), b.size(), isa);
+}
+
+void multiply(const glm::mat4& a, std::span<const glm::mat4> b, std::span<glm::mat4> result, Isa isa)
+{
+  ::multiply(&a, 0, b.data(), result.data(), b.size(), isa);
+}
+
+void inverse_affine(std::span<const glm::mat4> matrices, std::span<glm::mat4> result, Isa isa)
+{
+#ifdef MATH_X86
+  if (isa == Isa::AVX2)
+    return inverse_affine_avx2(matrices.data(), result.data(), matrices.size());
+#endif
+#ifdef MATH_NEON
+  if (isa == Isa::NEON)
+    return inverse_affine_neon(matrices.data(), result.data(), matrices.size());
+#endif
+  inverse_affine_scalar(matrices.data(), result.data(), 0, matrices.size());
+}
+
+void transform_bounds(std::span<const glm::mat4> matrices, std::span<const Mesh::Bounds> bounds,
+                      std::span<Mesh::Bounds> result, Isa isa)
+{
+  ::transform_bounds(matrices.data(), 1, bounds.data(), result.data(), bounds.size(), isa);
+}
+
+void transform_bounds(const glm::mat4& matrix, std::span<const Mesh::Bounds> bounds,
+                      std::span<Mesh::Bounds> result, Isa isa)
+{
+  ::transform_bounds(&matrix, 0, bounds.data(), result.data(), bounds.size(), isa);
+}
+
+}
@@ -0,0 +1,75 @@
+/*===-- src/Mesh.cpp ----------- Mesh -------------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the common mesh functions.                             *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Mesh.hpp"
+
+#include <algorithm>
+
+namespace Mesh
+{
+
+bool VertexLayout::operator==(const VertexLayout& other) const
+{
+  return std::ranges::equal(bindings, other.bindings, [](const auto& l, const auto& r)
+         {
+           return l.binding == r.binding && l.stride == r.stride && l.inputRate == r.inputRate;
+         }) &&
+         std::ranges::equal(attributes, other.attributes, [](const auto& l, const auto& r)
+         {
+           return l.location == r.location && l.binding == r.binding && l.format == r.format && l.offset == r.offset;
+         });
+}
+
+VertexLayout VertexLayout::get_position_layout() const
+{
+  VertexLayout layout;
+  auto position = std::ranges::find(attributes, 0u, &VkVertexInputAttributeDescription::location);
+  if (position == attributes.end())
+    return layout;
+  layout.attributes.emplace_back(*position);
+  auto binding = std::ranges::find(bindings, position->binding, &VkVertexInputBindingDescription::binding);
+  if (binding != bindings.end())
+    layout.bindings.emplace_back(*binding);
+  return layout;
+}
+
+MeshData quad()
+{
+  return
+  {
+    .vertices =
+    {
+      { { -.5f, -.5f, 0.f }, { 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 0.f } },
+      { {  .5f, -.5f, 0.f }, { 0.f, 1.f, 0.f }, { 0.f, 0.f, 1.f }, { 1.f, 0.f } },
+      { {  .5f,  .5f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 0.f, 1.f }, { 1.f, 1.f } },
+      { { -.5f,  .5f, 0.f }, { 1.f, 1.f, 1.f }, { 0.f, 0.f, 1.f }, { 0.f, 1.f } },
+    },
+    .indices =
+    {
+      0, 1, 2,
+      0, 2, 3,
+    },
+  };
+}
+
+MeshData load_obj(std::string_view filename)
+{
+  MeshData mesh;
+  load_obj(filename, [&mesh](uint32_t vertex_count, uint32_t index_count)
+  {
+    mesh.vertices.resize(vertex_count);
+    mesh.indices.resize(index_count);
+    return MeshSpans{ mesh.vertices, mesh.indices };
+  });
+  return mesh;
+}
+
+}
@@ -0,0 +1,234 @@
+/*===-- src/MeshCache.cpp ------ Mesh Cache -------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the baking and loading of the binary mesh cache.       *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "MeshCache.hpp"
+#include "Batch.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+
+using namespace Mesh;
+using Util::throw_if;
+
+/**
+ * Hash of header fields except checksum, followed by section table.
+ * Fields are hashed one by one, so bytes outside them never reach the hash.
+ */
+auto compute_checksum(const CacheHeader& header, std::span<const CacheSection> sections)
+{
+  auto hash = Util::hash(std::as_bytes(std::span(header.magic)));
+  auto add  = [&](const auto& value)
+  {
+    hash = Util::hash(std::as_bytes(std::span(&value, 1)), hash);
+  };
+  add(header.version);
+  add(header.position_format);
+  add(header.color_format);
+  add(header.normal_format);
+  add(header.uv_format);
+  add(header.split_position);
+  add(header.reserved);
+  add(header.index_type);
+  add(header.vertex_count);
+  add(header.index_count);
+  add(header.section_count);
+  add(header.transform);
+  add(header.bounds.min);
+  add(header.bounds.max);
+  for (const auto& section : sections)
+  {
+    add(section.type);
+    add(section.encoding);
+    add(section.offset);
+    add(section.size);
+  }
+  return hash;
+}
+
+template <typename T>
+auto as_bytes(const std::vector<T>& data)
+{
+  return std::as_bytes(std::span(data));
+}
+
+}
+
+namespace Mesh
+{
+
+void bake_mesh(std::string_view source, std::string_view destination, const BakeOptions& options)
+{
+  // glb nodes are merged in world space, a cache holds one mesh
+  auto mesh = source.ends_with(".glb") ? merge_mesh(GlbFile(source)) : load_obj(source);
+  optimize(mesh);
+  auto lods     = options.max_lods > 1 ? generate_lods(mesh, options.max_lods) : std::vector<Lod>{};
+  auto meshlets = build_meshlets(std::span(mesh.indices).first(lods.empty() ? mesh.indices.size() : lods.front().index_count));
+
+  auto packed   = get_packed_layout(options.format);
+  auto vertices = std::vector<std::byte>(packed.get_size(mesh.vertices.size()));
+  // value initialized, so reserved bytes are zero in file
+  CacheHeader header{};
+  header.magic        = Cache_Magic;
+  header.version      = Cache_Version;
+  header.set_format(options.format);
+  header.index_type   = get_index_type(mesh.vertices.size());
+  header.vertex_count = (uint32_t)mesh.vertices.size();
+  header.index_count  = (uint32_t)mesh.indices.size();
+  header.transform    = quantize(mesh.vertices, packed, vertices.data());
+  header.bounds       = compute_bounds(mesh.vertices);
+
+  std::vector<std::byte> indices;
+  auto index_encoding = options.compress_indices ? SectionEncoding::IndexCodec : SectionEncoding::Raw;
+  if (options.compress_indices)
+  {
+    auto encoded = encode_indices(mesh.indices);
+    indices.resize(encoded.size());
+    memcpy(indices.data(), encoded.data(), encoded.size());
+  }
+  else
+  {
+    indices.resize((size_t)get_index_size(header.get_index_type()) * mesh.indices.size());
+    pack_indices(mesh.indices, header.get_index_type(), indices.data());
+  }
+
+  std::vector<std::pair<CacheSection, std::span<const std::byte>>> sections
+  {
+    { { SectionType::Vertices,         SectionEncoding::Raw, 0, 0 }, vertices                   },
+    { { SectionType::Indices,          index_encoding,       0, 0 }, indices                    },
+    { { SectionType::Meshlets,         SectionEncoding::Raw, 0, 0 }, as_bytes(meshlets.meshlets)  },
+    { { SectionType::MeshletVertices,  SectionEncoding::Raw, 0, 0 }, as_bytes(meshlets.vertices)  },
+    { { SectionType::MeshletTriangles, SectionEncoding::Raw, 0, 0 }, as_bytes(meshlets.triangles) },
+    { { SectionType::Lods,             SectionEncoding::Raw, 0, 0 }, as_bytes(lods)               },
+  };
+
+  // sections follow the section table at aligned offsets
+  std::vector<CacheSection> table;
+  auto offset = Util::align_up<uint64_t>(sizeof(CacheHeader) + sizeof(CacheSection) * sections.size(), Cache_Align);
+  for (auto& [section, data] : sections)
+  {
+    section.offset = offset;
+    section.size   = data.size();
+    table.emplace_back(section);
+    offset = Util::align_up<uint64_t>(offset + data.size(), Cache_Align);
+  }
+  header.section_count = table.size();
+  header.checksum      = compute_checksum(header, table);
+
+  auto temporary = fmt::format("{}.tmp", destination);
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    throw_if(!file.is_open(), fmt::format("failed to open {}", temporary));
+
+    const char padding[Cache_Align]{};
+    auto write = [&](std::span<const std::byte> data)
+    {
+      file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    };
+    write(std::as_bytes(std::span(&header, 1)));
+    write(std::as_bytes(std::span(table)));
+    for (const auto& [section, data] : sections)
+    {
+      file.write(padding, section.offset - file.tellp());
+      write(data);
+    }
+    throw_if(!file.good(), fmt::format("failed to write {}", temporary));
+  }
+  std::filesystem::rename(temporary, destination);
+}
+
+MeshCache::MeshCache(std::string_view filename)
+  : _file(filename)
+{
+  throw_if(_file.size() < sizeof(CacheHeader), fmt::format("{} is not a mesh cache", filename));
+  _header = reinterpret_cast<const CacheHeader*>(_file.data());
+  throw_if(_header->magic != Cache_Magic, fmt::format("{} is not a mesh cache", filename));
+  throw_if(_header->version != Cache_Version,
+           fmt::format("{} has cache version {}, expect {}, bake it again", filename, _header->version, Cache_Version));
+  throw_if(sizeof(CacheHeader) + sizeof(CacheSection) * (uint64_t)_header->section_count > _file.size(),
+           fmt::format("{} is truncated", filename));
+
+  _sections = { reinterpret_cast<const CacheSection*>(_file.data() + sizeof(CacheHeader)), _header->section_count };
+  throw_if(compute_checksum(*_header, _sections) != _header->checksum, fmt::format("{} has wrong checksum", filename));
+  for (const auto& section : _sections)
+    throw_if(section.offset % Cache_Align || section.offset > _file.size() || section.size > _file.size() - section.offset,
+             fmt::format("{} is truncated", filename));
+
+  throw_if(_header->position_format > (uint8_t)PositionFormat::SNorm16 || _header->color_format > (uint8_t)ColorFormat::UNorm8 ||
+           _header->normal_format > (uint8_t)NormalFormat::Octahedral8 || _header->uv_format > (uint8_t)UVFormat::Float16 ||
+           (_header->index_type != VK_INDEX_TYPE_UINT16 && _header->index_type != VK_INDEX_TYPE_UINT32),
+           fmt::format("{} has unknown vertex or index format", filename));
+  auto packed = get_packed_layout(_header->format());
+  throw_if(section(SectionType::Vertices).size() != packed.get_size(_header->vertex_count),
+           fmt::format("{} has wrong vertex section size", filename));
+  auto indices = find(SectionType::Indices);
+  throw_if(!indices || (indices->encoding == SectionEncoding::Raw &&
+                        indices->size != (uint64_t)get_index_size(_header->get_index_type()) * _header->index_count),
+           fmt::format("{} has wrong index section size", filename));
+
+  // LOD ranges are drawn directly, a corrupt table must not reach past index buffer
+  auto lods = section(SectionType::Lods);
+  throw_if(lods.size() % sizeof(Lod), fmt::format("{} has wrong LOD section size", filename));
+  for (const auto& lod : this->lods())
+    throw_if((uint64_t)lod.first_index + lod.index_count > _header->index_count,
+             fmt::format("{} has LOD out of index range", filename));
+}
+
+auto MeshCache::find(SectionType type) const -> const CacheSection*
+{
+  auto it = std::ranges::find(_sections, type, &CacheSection::type);
+  return it == _sections.end() ? nullptr : &*it;
+}
+
+auto MeshCache::section(SectionType type) const -> std::span<const std::byte>
+{
+  auto section = find(type);
+  if (!section)
+    return {};
+  return _file.bytes().subspan(section->offset, section->size);
+}
+
+void MeshCache::read_indices(std::byte* dst) const
+{
+  auto data = section(SectionType::Indices);
+  if (find(SectionType::Indices)->encoding == SectionEncoding::Raw)
+  {
+    memcpy(dst, data.data(), data.size());
+    return;
+  }
+
+  auto encoded = std::span(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+  if (_header->index_type == VK_INDEX_TYPE_UINT32)
+    decode_indices(encoded, { reinterpret_cast<uint32_t*>(dst), _header->index_count });
+  else
+  {
+    std::vector<uint32_t> indices(_header->index_count);
+    decode_indices(encoded, indices);
+    pack_indices(indices, _header->get_index_type(), dst);
+  }
+}
+
+auto MeshCache::lods() const -> std::vector<Lod>
+{
+  auto data = section(SectionType::Lods);
+  std::vector<Lod> lods(data.size() / sizeof(Lod));
+  memcpy(lods.data(), data.data(), lods.size() * sizeof(Lod));
+  return lods;
+}
+
+}
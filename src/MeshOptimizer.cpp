@@ -0,0 +1,337 @@
+/*===-- src/MeshOptimizer.cpp ----- Mesh Optimizer ------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the vertex cache, overdraw and vertex fetch            *|
+|* optimization of index buffers.                                             *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Mesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+
+using namespace Mesh;
+
+constexpr uint32_t Invalid      = std::numeric_limits<uint32_t>::max();
+constexpr uint32_t Cache_Size   = 32; ///< cache size of scoring, larger than hardware is better
+constexpr uint32_t Fifo_Size    = 16; ///< cache size of cluster split
+
+/**
+ * Score of vertex in Forsyth's algorithm.
+ */
+auto get_vertex_score(int32_t cache_position, uint32_t live_triangles)
+{
+  if (live_triangles == 0)
+    return -1.f;
+
+  float score = 0.f;
+  if (cache_position >= 0)
+  {
+    // last triangle vertices are scored fixed to avoid reusing them directly
+    if (cache_position < 3)
+      score = 0.75f;
+    else
+      score = std::pow(1.f - (cache_position - 3) * (1.f / (Cache_Size - 3)), 1.5f);
+  }
+  // prefer vertices with less remaining triangles to finish them quickly
+  return score + 2.f * std::pow((float)live_triangles, -0.5f);
+}
+
+/**
+ * FIFO cache simulation, count misses of triangle.
+ */
+class FifoCache
+{
+public:
+  FifoCache(uint32_t vertex_count, uint32_t size)
+    : _timestamps(vertex_count, 0), _size(size), _time(size + 1)
+  {
+  }
+
+  auto access(uint32_t vertex)
+  {
+    if (_time - _timestamps[vertex] <= _size)
+      return 0u;
+    _timestamps[vertex] = _time++;
+    return 1u;
+  }
+
+  auto access(const uint32_t* triangle)
+  {
+    return access(triangle[0]) + access(triangle[1]) + access(triangle[2]);
+  }
+
+  void reset()
+  {
+    // move time far enough to evict every vertex
+    _time += _size + 1;
+  }
+
+private:
+  std::vector<uint32_t> _timestamps;
+  uint32_t              _size;
+  uint32_t              _time;
+};
+
+}
+
+namespace Mesh
+{
+
+VertexCacheStatistics analyze_vertex_cache(std::span<const uint32_t> indices, uint32_t vertex_count, uint32_t cache_size)
+{
+  FifoCache cache(vertex_count, cache_size);
+  uint32_t misses = 0;
+  for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    misses += cache.access(&indices[i]);
+
+  return
+  {
+    .acmr = indices.empty()  ? 0.f : (float)misses / (indices.size() / 3),
+    .atvr = vertex_count == 0 ? 0.f : (float)misses / vertex_count,
+  };
+}
+
+void optimize_vertex_cache(std::span<uint32_t> indices, uint32_t vertex_count)
+{
+  auto triangle_count = (uint32_t)(indices.size() / 3);
+  if (triangle_count == 0)
+    return;
+
+  // triangles adjacent to vertex, the first live_triangles[v] entries are not emitted yet
+  std::vector<uint32_t> live_triangles(vertex_count, 0);
+  for (auto index : indices)
+    ++live_triangles[index];
+  std::vector<uint32_t> offsets(vertex_count + 1, 0);
+  std::inclusive_scan(live_triangles.begin(), live_triangles.end(), offsets.begin() + 1);
+  std::vector<uint32_t> adjacency(triangle_count * 3);
+  {
+    auto cursors = offsets;
+    for (uint32_t i = 0; i < triangle_count * 3; ++i)
+      adjacency[cursors[indices[i]]++] = i / 3;
+  }
+
+  std::vector<int32_t> cache_positions(vertex_count, -1);
+  std::vector<float>   vertex_scores(vertex_count);
+  for (uint32_t v = 0; v < vertex_count; ++v)
+    vertex_scores[v] = get_vertex_score(-1, live_triangles[v]);
+
+  std::vector<float> triangle_scores(triangle_count);
+  std::vector<bool>  emitted(triangle_count, false);
+  for (uint32_t t = 0; t < triangle_count; ++t)
+    triangle_scores[t] = vertex_scores[indices[t * 3]] + vertex_scores[indices[t * 3 + 1]] + vertex_scores[indices[t * 3 + 2]];
+
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+
+  std::vector<uint32_t> cache, new_cache;
+  cache.reserve(Cache_Size + 3);
+  new_cache.reserve(Cache_Size + 3);
+
+  auto best = (uint32_t)(std::max_element(triangle_scores.begin(), triangle_scores.end()) - triangle_scores.begin());
+  uint32_t cursor = 0;
+  while (best != Invalid)
+  {
+    // emit triangle and remove it from adjacency of its vertices
+    emitted[best] = true;
+    const auto triangle = &indices[best * 3];
+    result.insert(result.end(), triangle, triangle + 3);
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+      auto v     = triangle[i];
+      auto begin = adjacency.begin() + offsets[v];
+      auto end   = begin + live_triangles[v];
+      std::iter_swap(std::find(begin, end, best), end - 1);
+      --live_triangles[v];
+    }
+
+    // move triangle vertices to front of LRU cache
+    new_cache.assign(triangle, triangle + 3);
+    for (auto v : cache)
+      if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+        new_cache.emplace_back(v);
+    std::swap(cache, new_cache);
+
+    // update scores of vertices in cache and evicted vertices
+    for (uint32_t i = 0; i < cache.size(); ++i)
+    {
+      auto v = cache[i];
+      cache_positions[v] = i < Cache_Size ? (int32_t)i : -1;
+      auto score = get_vertex_score(cache_positions[v], live_triangles[v]);
+      auto delta = score - vertex_scores[v];
+      vertex_scores[v] = score;
+      for (uint32_t j = 0; j < live_triangles[v]; ++j)
+        triangle_scores[adjacency[offsets[v] + j]] += delta;
+    }
+    if (cache.size() > Cache_Size)
+      cache.resize(Cache_Size);
+
+    // best triangle adjacent to cache
+    best = Invalid;
+    float best_score = 0.f;
+    for (auto v : cache)
+      for (uint32_t j = 0; j < live_triangles[v]; ++j)
+      {
+        auto t = adjacency[offsets[v] + j];
+        if (triangle_scores[t] > best_score)
+        {
+          best       = t;
+          best_score = triangle_scores[t];
+        }
+      }
+
+    // cache has no live triangle, continue with next triangle in input order
+    if (best == Invalid)
+    {
+      while (cursor < triangle_count && emitted[cursor])
+        ++cursor;
+      if (cursor < triangle_count)
+        best = cursor;
+    }
+  }
+
+  std::ranges::copy(result, indices.begin());
+}
+
+void optimize_overdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices, float threshold)
+{
+  auto triangle_count = (uint32_t)(indices.size() / 3);
+  if (triangle_count == 0)
+    return;
+
+  // hard boundaries, where every vertex of triangle misses the cache
+  std::vector<uint32_t> clusters;
+  {
+    FifoCache cache(vertices.size(), Fifo_Size);
+    for (uint32_t t = 0; t < triangle_count; ++t)
+      if (cache.access(&indices[t * 3]) == 3)
+        clusters.emplace_back(t);
+  }
+  clusters.emplace_back(triangle_count);
+
+  // soft boundaries, split hard cluster wherever restarting cache costs little
+  std::vector<uint32_t> soft_clusters;
+  {
+    FifoCache cache(vertices.size(), Fifo_Size);
+    for (uint32_t c = 0; c + 1 < clusters.size(); ++c)
+    {
+      auto begin = clusters[c], end = clusters[c + 1];
+
+      cache.reset();
+      uint32_t misses = 0;
+      for (auto t = begin; t < end; ++t)
+        misses += cache.access(&indices[t * 3]);
+      auto cluster_acmr = (float)misses / (end - begin);
+
+      cache.reset();
+      soft_clusters.emplace_back(begin);
+      uint32_t running_misses = 0, running_count = 0;
+      for (auto t = begin; t < end; ++t)
+      {
+        running_misses += cache.access(&indices[t * 3]);
+        ++running_count;
+        if (t + 1 < end && (float)running_misses / running_count <= cluster_acmr * threshold)
+        {
+          cache.reset();
+          soft_clusters.emplace_back(t + 1);
+          running_misses = running_count = 0;
+        }
+      }
+    }
+  }
+  soft_clusters.emplace_back(triangle_count);
+
+  // center of mesh
+  glm::vec3 mesh_center(0.f);
+  for (auto index : indices)
+    mesh_center += vertices[index].position;
+  mesh_center /= (float)indices.size();
+
+  // sort clusters, outward facing and far from center first
+  struct Cluster
+  {
+    uint32_t begin, end;
+    float    sort_key;
+  };
+  std::vector<Cluster> sorted;
+  sorted.reserve(soft_clusters.size() - 1);
+  for (uint32_t c = 0; c + 1 < soft_clusters.size(); ++c)
+  {
+    glm::vec3 center(0.f), normal(0.f);
+    float area_sum = 0.f;
+    for (auto t = soft_clusters[c]; t < soft_clusters[c + 1]; ++t)
+    {
+      auto& p0 = vertices[indices[t * 3]].position;
+      auto& p1 = vertices[indices[t * 3 + 1]].position;
+      auto& p2 = vertices[indices[t * 3 + 2]].position;
+      auto  n  = glm::cross(p1 - p0, p2 - p0);
+      auto area = glm::length(n);
+      center   += (p0 + p1 + p2) * (area / 3.f);
+      normal   += n;
+      area_sum += area;
+    }
+    auto normal_length = glm::length(normal);
+    center = area_sum > 0.f ? center / area_sum : vertices[indices[soft_clusters[c] * 3]].position;
+    sorted.emplace_back(Cluster
+    {
+      .begin    = soft_clusters[c],
+      .end      = soft_clusters[c + 1],
+      .sort_key = normal_length > 0.f ? glm::dot(center - mesh_center, normal / normal_length) : 0.f,
+    });
+  }
+  std::ranges::stable_sort(sorted, std::greater(), &Cluster::sort_key);
+
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+  for (const auto& cluster : sorted)
+    result.insert(result.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+  std::ranges::copy(result, indices.begin());
+}
+
+uint32_t optimize_vertex_fetch(std::span<Vertex> vertices, std::span<uint32_t> indices)
+{
+  std::vector<uint32_t> remap(vertices.size(), Invalid);
+  std::vector<Vertex>   result;
+  result.reserve(vertices.size());
+  for (auto& index : indices)
+  {
+    if (remap[index] == Invalid)
+    {
+      remap[index] = (uint32_t)result.size();
+      result.emplace_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+  std::ranges::copy(result, vertices.begin());
+  return (uint32_t)result.size();
+}
+
+std::pair<VertexCacheStatistics, VertexCacheStatistics> optimize(MeshData& mesh)
+{
+  MeshSpans spans{ mesh.vertices, mesh.indices };
+  auto statistics = optimize(spans);
+  mesh.vertices.resize(spans.vertices.size());
+  return statistics;
+}
+
+std::pair<VertexCacheStatistics, VertexCacheStatistics> optimize(MeshSpans& mesh)
+{
+  auto before = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+  optimize_vertex_cache(mesh.indices, mesh.vertices.size());
+  optimize_overdraw(mesh.indices, mesh.vertices);
+  mesh.vertices = mesh.vertices.first(optimize_vertex_fetch(mesh.vertices, mesh.indices));
+  auto after = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+  return { before, after };
+}
+
+}
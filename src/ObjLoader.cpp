@@ -0,0 +1,408 @@
+/*===-- src/ObjLoader.cpp ------ OBJ Loader -------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the parallel Wavefront OBJ loader.                     *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Mesh.hpp"
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <limits>
+
+namespace
+{
+
+using namespace Mesh;
+using Util::throw_if;
+
+constexpr int32_t  Missing_Index  = std::numeric_limits<int32_t>::min();
+constexpr uint32_t Min_Chunk_Size = 1 << 20;
+
+/**
+ * Face corner of OBJ, index of position, uv and normal.
+ * Negative indices of OBJ are relative to vertices before the face, so they are
+ * stored relative to begin of chunk and fixed up after all chunks are parsed.
+ */
+struct Corner
+{
+  std::array<int32_t, 3> index;
+  uint8_t                relative; ///< bit i set if index[i] is relative to chunk
+};
+
+struct Chunk
+{
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> colors;
+  std::vector<glm::vec2> uvs;
+  std::vector<glm::vec3> normals;
+  std::vector<Corner>    corners;
+};
+
+struct Parser
+{
+  const char* begin;
+  const char* p;
+  const char* end;
+  std::string_view filename;
+
+  auto error(std::string_view what)
+  {
+    throw_if(true, fmt::format("{}: {} at offset {}", filename, what, p - begin));
+  }
+
+  void skip_space()
+  {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+      ++p;
+  }
+
+  void skip_line()
+  {
+    p = std::find(p, end, '\n');
+    if (p < end)
+      ++p;
+  }
+
+  auto at_line_end()
+  {
+    skip_space();
+    return p == end || *p == '\n' || *p == '#';
+  }
+
+  auto parse_float()
+  {
+    skip_space();
+    // from_chars not accept leading plus
+    if (p < end && *p == '+')
+      ++p;
+    float value;
+    auto [ptr, ec] = std::from_chars(p, end, value);
+    if (ec != std::errc())
+      error("invalid number");
+    p = ptr;
+    return value;
+  }
+
+  auto parse_vec3()
+  {
+    // components must be parsed in order
+    glm::vec3 v;
+    v.x = parse_float();
+    v.y = parse_float();
+    v.z = parse_float();
+    return v;
+  }
+
+  auto parse_int()
+  {
+    int32_t value;
+    auto [ptr, ec] = std::from_chars(p, end, value);
+    if (ec != std::errc() || value == 0)
+      error("invalid index");
+    p = ptr;
+    return value;
+  }
+
+  auto parse_corner(const Chunk& chunk)
+  {
+    Corner corner
+    {
+      .index    = { Missing_Index, Missing_Index, Missing_Index },
+      .relative = 0,
+    };
+    const size_t counts[] = { chunk.positions.size(), chunk.uvs.size(), chunk.normals.size() };
+
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+      // p, p/t, p//n, p/t/n
+      if (i > 0)
+      {
+        if (p == end || *p != '/')
+          break;
+        ++p;
+        if (p < end && *p == '/')
+          continue;
+      }
+      auto index = parse_int();
+      if (index > 0)
+        corner.index[i] = index - 1;
+      else
+      {
+        corner.index[i]   = (int32_t)counts[i] + index;
+        corner.relative  |= 1 << i;
+      }
+    }
+    return corner;
+  }
+
+  void parse(Chunk& chunk)
+  {
+    std::vector<Corner> polygon;
+    while (p < end)
+    {
+      skip_space();
+      if (p == end)
+        break;
+
+      if (*p == 'v' && p + 1 < end)
+      {
+        ++p;
+        switch (*p)
+        {
+        case ' ':
+        case '\t':
+        {
+          chunk.positions.emplace_back(parse_vec3());
+          // vertex color extension: v x y z r g b
+          if (!at_line_end())
+            chunk.colors.emplace_back(parse_vec3());
+          else
+            chunk.colors.emplace_back(1.f);
+          break;
+        }
+        case 't':
+        {
+          ++p;
+          auto u = parse_float();
+          auto v = parse_float();
+          // OBJ origin is bottom left, Vulkan is top left
+          chunk.uvs.emplace_back(u, 1.f - v);
+          break;
+        }
+        case 'n':
+        {
+          ++p;
+          chunk.normals.emplace_back(parse_vec3());
+          break;
+        }
+        }
+      }
+      else if (*p == 'f' && p + 1 < end && (p[1] == ' ' || p[1] == '\t'))
+      {
+        ++p;
+        polygon.clear();
+        while (!at_line_end())
+          polygon.emplace_back(parse_corner(chunk));
+        if (polygon.size() < 3)
+          error("face has less than 3 vertices");
+        // triangulate polygon as fan
+        for (size_t i = 2; i < polygon.size(); ++i)
+        {
+          chunk.corners.emplace_back(polygon[0]);
+          chunk.corners.emplace_back(polygon[i - 1]);
+          chunk.corners.emplace_back(polygon[i]);
+        }
+      }
+      skip_line();
+    }
+  }
+};
+
+/**
+ * Split text into line aligned chunks.
+ */
+auto split_chunks(std::string_view text, uint32_t max_count)
+{
+  auto count = std::clamp((uint32_t)(text.size() / Min_Chunk_Size), 1u, max_count);
+  std::vector<std::string_view> chunks;
+  size_t begin = 0;
+  for (uint32_t i = 1; i <= count && begin < text.size(); ++i)
+  {
+    size_t end = text.size();
+    if (i < count)
+    {
+      end = text.find('\n', std::max(begin, text.size() / count * i));
+      end = end == std::string_view::npos ? text.size() : end + 1;
+    }
+    chunks.emplace_back(text.substr(begin, end - begin));
+    begin = end;
+  }
+  return chunks;
+}
+
+/**
+ * Open addressing hash map from corner to vertex index.
+ */
+class CornerMap
+{
+public:
+  CornerMap(size_t count)
+    : _slots(std::bit_ceil(std::max<size_t>(count * 2, 16)), 0),
+      _mask(_slots.size() - 1)
+  {
+    _corners.reserve(count);
+  }
+
+  /**
+   * Get vertex index of corner, insert it if not exist.
+   */
+  auto insert(const Corner& corner)
+  {
+    auto i = hash(corner) & _mask;
+    while (_slots[i] != 0)
+    {
+      if (_corners[_slots[i] - 1].index == corner.index)
+        return _slots[i] - 1;
+      i = (i + 1) & _mask;
+    }
+    _corners.emplace_back(corner);
+    _slots[i] = (uint32_t)_corners.size();
+    return _slots[i] - 1;
+  }
+
+  auto& corners() const noexcept { return _corners; }
+
+private:
+  static size_t hash(const Corner& corner)
+  {
+    uint64_t h = (uint32_t)corner.index[0];
+    h = h * 0x9E3779B97F4A7C15ull ^ (uint32_t)corner.index[1];
+    h = h * 0x9E3779B97F4A7C15ull ^ (uint32_t)corner.index[2];
+    return h ^ (h >> 32);
+  }
+
+  std::vector<uint32_t> _slots; ///< index of corner + 1, 0 is empty
+  std::vector<Corner>   _corners;
+  size_t                _mask;
+};
+
+/**
+ * Concatenate per chunk array into single array.
+ */
+template <typename T>
+auto concat(std::vector<Chunk>& chunks, std::vector<T> Chunk::* member, const std::vector<size_t>& offsets)
+{
+  std::vector<T> result(offsets.back());
+  Util::ThreadPool::instance().parallel_for(chunks.size(), [&](uint32_t i)
+  {
+    auto& src = chunks[i].*member;
+    std::copy(src.begin(), src.end(), result.begin() + offsets[i]);
+    src = {};
+  });
+  return result;
+}
+
+}
+
+namespace Mesh
+{
+
+Bounds load_obj(std::string_view filename, const MeshAllocator& allocate)
+{
+  Util::MappedFile file(filename);
+  auto& pool = Util::ThreadPool::instance();
+
+  // parse chunks in parallel
+  auto texts = split_chunks(file.text(), pool.size() * 4);
+  std::vector<Chunk> chunks(texts.size());
+  pool.parallel_for(texts.size(), [&](uint32_t i)
+  {
+    Parser parser
+    {
+      .begin    = file.text().data(),
+      .p        = texts[i].data(),
+      .end      = texts[i].data() + texts[i].size(),
+      .filename = filename,
+    };
+    parser.parse(chunks[i]);
+  });
+
+  // prefix sum of element count of chunks
+  std::array<std::vector<size_t>, 4> offsets;
+  for (auto& offset : offsets)
+    offset.assign(chunks.size() + 1, 0);
+  for (size_t i = 0; i < chunks.size(); ++i)
+  {
+    offsets[0][i + 1] = offsets[0][i] + chunks[i].positions.size();
+    offsets[1][i + 1] = offsets[1][i] + chunks[i].uvs.size();
+    offsets[2][i + 1] = offsets[2][i] + chunks[i].normals.size();
+    offsets[3][i + 1] = offsets[3][i] + chunks[i].corners.size();
+  }
+  const size_t totals[] = { offsets[0].back(), offsets[1].back(), offsets[2].back() };
+  throw_if(offsets[3].back() > std::numeric_limits<uint32_t>::max(),
+           fmt::format("{}: too many faces", filename));
+
+  // fix up relative indices and validate range
+  pool.parallel_for(chunks.size(), [&](uint32_t c)
+  {
+    for (auto& corner : chunks[c].corners)
+      for (uint32_t i = 0; i < 3; ++i)
+      {
+        if (corner.index[i] == Missing_Index)
+          continue;
+        if (corner.relative & (1 << i))
+          corner.index[i] += (int32_t)offsets[i][c];
+        throw_if(corner.index[i] < 0 || (size_t)corner.index[i] >= totals[i],
+                 fmt::format("{}: face index out of range", filename));
+      }
+  });
+
+  auto positions = concat(chunks, &Chunk::positions, offsets[0]);
+  auto colors    = concat(chunks, &Chunk::colors,    offsets[0]);
+  auto uvs       = concat(chunks, &Chunk::uvs,       offsets[1]);
+  auto normals   = concat(chunks, &Chunk::normals,   offsets[2]);
+
+  // deduplicate corners
+  std::vector<uint32_t> indices(offsets[3].back());
+  CornerMap map(indices.size());
+  for (size_t c = 0, n = 0; c < chunks.size(); ++c)
+  {
+    for (const auto& corner : chunks[c].corners)
+      indices[n++] = map.insert(corner);
+    chunks[c].corners = {};
+  }
+
+  // write vertices and indices to destination
+  auto& corners = map.corners();
+  auto dst = allocate((uint32_t)corners.size(), (uint32_t)indices.size());
+  throw_if(dst.vertices.size() < corners.size() || dst.indices.size() < indices.size(),
+           "mesh allocator returned too small destination");
+
+  auto task_count = pool.size();
+  pool.parallel_for(task_count, [&](uint32_t t)
+  {
+    auto begin = corners.size() * t / task_count;
+    auto end   = corners.size() * (t + 1) / task_count;
+    for (auto i = begin; i < end; ++i)
+    {
+      const auto& index = corners[i].index;
+      dst.vertices[i] = Vertex
+      {
+        .position = positions[index[0]],
+        .color    = colors[index[0]],
+        .normal   = index[2] == Missing_Index ? glm::vec3(0.f) : normals[index[2]],
+        .uv       = index[1] == Missing_Index ? glm::vec2(0.f) : uvs[index[1]],
+      };
+    }
+
+    begin = indices.size() * t / task_count;
+    end   = indices.size() * (t + 1) / task_count;
+    std::copy(indices.begin() + begin, indices.begin() + end, dst.indices.begin() + begin);
+  });
+
+  Bounds bounds
+  {
+    .min = glm::vec3( std::numeric_limits<float>::max()),
+    .max = glm::vec3(-std::numeric_limits<float>::max()),
+  };
+  for (const auto& position : positions)
+  {
+    bounds.min = glm::min(bounds.min, position);
+    bounds.max = glm::max(bounds.max, position);
+  }
+  return bounds;
+}
+
+}
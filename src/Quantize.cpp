@@ -0,0 +1,295 @@
+/*===-- src/Quantize.cpp ------- Quantize ---------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the quantization of vertices into packed vertex        *|
+|* formats.                                                                   *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Mesh.hpp"
+#include "ThreadPool.hpp"
+#include "Util.hpp"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+
+using namespace Mesh;
+
+/**
+ * Size and Vulkan format of attribute.
+ * Three component 16-bit and 8-bit formats are rarely supported as vertex input,
+ * so these are padded to four components.
+ */
+struct AttributeFormat
+{
+  uint32_t size;
+  VkFormat format;
+};
+
+auto get_attribute_format(PositionFormat format)
+{
+  switch (format)
+  {
+  case PositionFormat::Float16: return AttributeFormat{ 8,  VK_FORMAT_R16G16B16A16_SFLOAT };
+  case PositionFormat::SNorm16: return AttributeFormat{ 8,  VK_FORMAT_R16G16B16A16_SNORM  };
+  default:                      return AttributeFormat{ 12, VK_FORMAT_R32G32B32_SFLOAT    };
+  }
+}
+
+auto get_attribute_format(ColorFormat format)
+{
+  switch (format)
+  {
+  case ColorFormat::UNorm8: return AttributeFormat{ 4,  VK_FORMAT_R8G8B8A8_UNORM   };
+  default:                  return AttributeFormat{ 12, VK_FORMAT_R32G32B32_SFLOAT };
+  }
+}
+
+auto get_attribute_format(NormalFormat format)
+{
+  switch (format)
+  {
+  case NormalFormat::Octahedral16: return AttributeFormat{ 4,  VK_FORMAT_R16G16_SNORM     };
+  case NormalFormat::Octahedral8:  return AttributeFormat{ 2,  VK_FORMAT_R8G8_SNORM       };
+  default:                         return AttributeFormat{ 12, VK_FORMAT_R32G32B32_SFLOAT };
+  }
+}
+
+auto get_attribute_format(UVFormat format)
+{
+  switch (format)
+  {
+  case UVFormat::Float16: return AttributeFormat{ 4, VK_FORMAT_R16G16_SFLOAT };
+  default:                return AttributeFormat{ 8, VK_FORMAT_R32G32_SFLOAT };
+  }
+}
+
+template <typename T>
+auto quantize_snorm(float v)
+{
+  constexpr float Max = std::numeric_limits<T>::max();
+  return (T)std::round(std::clamp(v, -1.f, 1.f) * Max);
+}
+
+auto quantize_unorm8(float v)
+{
+  return (uint8_t)std::round(std::clamp(v, 0.f, 1.f) * 255.f);
+}
+
+/**
+ * Map unit vector onto octahedron, then unfold lower hemisphere onto square.
+ */
+auto encode_octahedral(glm::vec3 n)
+{
+  auto sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+  if (sum == 0.f)
+    return glm::vec2(0.f);
+  n /= sum;
+  glm::vec2 p(n.x, n.y);
+  if (n.z < 0.f)
+    p = glm::vec2((1.f - std::abs(n.y)) * (n.x >= 0.f ? 1.f : -1.f),
+                  (1.f - std::abs(n.x)) * (n.y >= 0.f ? 1.f : -1.f));
+  return p;
+}
+
+template <typename T, size_t N>
+void write(std::byte* dst, const std::array<T, N>& values)
+{
+  memcpy(dst, values.data(), sizeof(T) * N);
+}
+
+}
+
+namespace Mesh
+{
+
+Bounds compute_bounds(std::span<const Vertex> vertices)
+{
+  Bounds bounds
+  {
+    .min = glm::vec3( std::numeric_limits<float>::max()),
+    .max = glm::vec3(-std::numeric_limits<float>::max()),
+  };
+  for (const auto& vertex : vertices)
+  {
+    bounds.min = glm::min(bounds.min, vertex.position);
+    bounds.max = glm::max(bounds.max, vertex.position);
+  }
+  return bounds;
+}
+
+VkDeviceSize PackedLayout::get_stream_offset(uint32_t binding, uint32_t vertex_count) const
+{
+  VkDeviceSize offset = 0;
+  for (uint32_t i = 0; i < binding; ++i)
+    offset = Util::align_up<VkDeviceSize>(offset + (VkDeviceSize)strides[i] * vertex_count, 16);
+  return offset;
+}
+
+VkDeviceSize PackedLayout::get_size(uint32_t vertex_count) const
+{
+  return get_stream_offset(strides.size() - 1, vertex_count) + (VkDeviceSize)strides.back() * vertex_count;
+}
+
+PackedLayout get_packed_layout(const VertexFormat& format)
+{
+  const AttributeFormat formats[] =
+  {
+    get_attribute_format(format.position),
+    get_attribute_format(format.color),
+    get_attribute_format(format.normal),
+    get_attribute_format(format.uv),
+  };
+
+  PackedLayout layout
+  {
+    .format  = format,
+    .stride  = 0,
+    .offsets = {},
+    .strides = {},
+    .layout  = {},
+  };
+  layout.strides.emplace_back(0);
+  for (uint32_t location = 0; location < 4; ++location)
+  {
+    // depth only passes fetch positions alone, other attributes follow in the next stream
+    if (location == 1 && format.split_position)
+      layout.strides.emplace_back(0);
+    auto  binding = (uint32_t)layout.strides.size() - 1;
+    auto& stride  = layout.strides.back();
+
+    // keep every attribute aligned to 4 bytes
+    layout.offsets[location] = stride;
+    layout.layout.attributes.emplace_back(VkVertexInputAttributeDescription
+    {
+      .location = location,
+      .binding  = binding,
+      .format   = formats[location].format,
+      .offset   = stride,
+    });
+    stride += Util::align_up(formats[location].size, 4u);
+  }
+
+  layout.stride = 0;
+  for (uint32_t binding = 0; binding < layout.strides.size(); ++binding)
+  {
+    layout.stride += layout.strides[binding];
+    layout.layout.bindings.emplace_back(VkVertexInputBindingDescription
+    {
+      .binding   = binding,
+      .stride    = layout.strides[binding],
+      .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+    });
+  }
+  return layout;
+}
+
+glm::mat4 quantize(std::span<const Vertex> vertices, const PackedLayout& layout, std::byte* dst)
+{
+  const auto& format = layout.format;
+
+  // normalized positions are relative to center of bounds
+  glm::vec3 center(0.f), extent(1.f);
+  if (format.position == PositionFormat::SNorm16 && !vertices.empty())
+  {
+    auto bounds = compute_bounds(vertices);
+    center = (bounds.min + bounds.max) * .5f;
+    extent = glm::max((bounds.max - bounds.min) * .5f, glm::vec3(std::numeric_limits<float>::min()));
+  }
+
+  // start of stream of each attribute
+  std::array<std::byte*, 4> streams;
+  std::array<uint32_t, 4>   strides;
+  for (const auto& attribute : layout.layout.attributes)
+  {
+    streams[attribute.location] = dst + layout.get_stream_offset(attribute.binding, vertices.size()) + attribute.offset;
+    strides[attribute.location] = layout.strides[attribute.binding];
+  }
+
+  auto& pool = Util::ThreadPool::instance();
+  pool.parallel_for(pool.size(), [&](uint32_t t)
+  {
+    auto begin = vertices.size() * t / pool.size();
+    auto end   = vertices.size() * (t + 1) / pool.size();
+    for (auto i = begin; i < end; ++i)
+    {
+      const auto& vertex = vertices[i];
+
+      auto position = streams[0] + strides[0] * i;
+      switch (format.position)
+      {
+      case PositionFormat::Float32:
+        write(position, std::array{ vertex.position.x, vertex.position.y, vertex.position.z });
+        break;
+      case PositionFormat::Float16:
+        write(position, std::array{ glm::packHalf1x16(vertex.position.x), glm::packHalf1x16(vertex.position.y),
+                                    glm::packHalf1x16(vertex.position.z), glm::packHalf1x16(1.f) });
+        break;
+      case PositionFormat::SNorm16:
+      {
+        auto p = (vertex.position - center) / extent;
+        write(position, std::array{ quantize_snorm<int16_t>(p.x), quantize_snorm<int16_t>(p.y),
+                                    quantize_snorm<int16_t>(p.z), quantize_snorm<int16_t>(1.f) });
+        break;
+      }
+      }
+
+      auto color = streams[1] + strides[1] * i;
+      if (format.color == ColorFormat::UNorm8)
+        write(color, std::array{ quantize_unorm8(vertex.color.x), quantize_unorm8(vertex.color.y),
+                                 quantize_unorm8(vertex.color.z), (uint8_t)255 });
+      else
+        write(color, std::array{ vertex.color.x, vertex.color.y, vertex.color.z });
+
+      // inverse transpose of dequantize scales normals by 1 / extent in shader, storing them scaled
+      // by extent cancels it, octahedral mapping and shader normalize length away
+      auto normal = streams[2] + strides[2] * i;
+      auto scaled = vertex.normal * extent;
+      switch (format.normal)
+      {
+      case NormalFormat::Float32:
+        write(normal, std::array{ scaled.x, scaled.y, scaled.z });
+        break;
+      case NormalFormat::Octahedral16:
+      {
+        auto n = encode_octahedral(scaled);
+        write(normal, std::array{ quantize_snorm<int16_t>(n.x), quantize_snorm<int16_t>(n.y) });
+        break;
+      }
+      case NormalFormat::Octahedral8:
+      {
+        auto n = encode_octahedral(scaled);
+        write(normal, std::array{ quantize_snorm<int8_t>(n.x), quantize_snorm<int8_t>(n.y), (int8_t)0, (int8_t)0 });
+        break;
+      }
+      }
+
+      auto uv = streams[3] + strides[3] * i;
+      if (format.uv == UVFormat::Float16)
+        write(uv, std::array{ glm::packHalf1x16(vertex.uv.x), glm::packHalf1x16(vertex.uv.y) });
+      else
+        write(uv, std::array{ vertex.uv.x, vertex.uv.y });
+    }
+  });
+
+  // p = center + extent * stored
+  glm::mat4 dequantize(1.f);
+  dequantize[0][0] = extent.x;
+  dequantize[1][1] = extent.y;
+  dequantize[2][2] = extent.z;
+  dequantize[3]    = glm::vec4(center, 1.f);
+  return dequantize;
+}
+
+}
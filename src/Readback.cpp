@@ -0,0 +1,144 @@
+/*===-- src/Readback.cpp ------- Readback ---------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement copies of rendered images into the readback ring and   *|
+|* their delivery.                                                            *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Readback.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+
+using Util::throw_if;
+
+namespace
+{
+
+/**
+ * Get size of texel of color formats of swapchain and render targets.
+ */
+auto get_texel_size(VkFormat format) -> uint32_t
+{
+  switch (format)
+  {
+  case VK_FORMAT_B8G8R8A8_UNORM:
+  case VK_FORMAT_B8G8R8A8_SRGB:
+  case VK_FORMAT_R8G8B8A8_UNORM:
+  case VK_FORMAT_R8G8B8A8_SRGB:
+  case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+  case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+    return 4;
+  default:
+    return 0;
+  }
+}
+
+}
+
+namespace Vulkan
+{
+
+Readback::Readback(VmaAllocator allocator, VkFormat format, VkExtent2D max_extent, uint32_t frames, ReadbackCallback callback)
+  : _allocator(allocator),
+    _format(format),
+    _callback(std::move(callback)),
+    _slots(frames)
+{
+  auto texel_size = get_texel_size(format);
+  throw_if(texel_size == 0, fmt::format("readback of format {} is unsupported", (int)format));
+
+  // host reads every byte, so cached memory is preferred over write combined one
+  VkBufferCreateInfo buffer_info
+  {
+    .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+    .size  = (VkDeviceSize)max_extent.width * max_extent.height * texel_size,
+    .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+  };
+  VmaAllocationCreateInfo alloc_info
+  {
+    .flags          = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+    .usage          = VMA_MEMORY_USAGE_AUTO,
+    .preferredFlags = VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+  };
+  for (auto& slot : _slots)
+  {
+    VmaAllocationInfo info;
+    throw_if(vmaCreateBuffer(_allocator, &buffer_info, &alloc_info, &slot.buffer, &slot.allocation, &info) != VK_SUCCESS,
+             "failed to create readback buffer");
+    slot.mapped = info.pMappedData;
+  }
+}
+
+Readback::~Readback()
+{
+  for (const auto& slot : _slots)
+    vmaDestroyBuffer(_allocator, slot.buffer, slot.allocation);
+}
+
+void Readback::record(VkCommandBuffer command_buffer, uint32_t slot, VkImage image, VkExtent2D extent, uint64_t frame)
+{
+  auto& target = _slots[slot];
+  VkBufferImageCopy2 region
+  {
+    .sType            = VK_STRUCTURE_TYPE_BUFFER_IMAGE_COPY_2,
+    .imageSubresource = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1 },
+    .imageExtent      = { extent.width, extent.height, 1 },
+  };
+  VkCopyImageToBufferInfo2 copy
+  {
+    .sType          = VK_STRUCTURE_TYPE_COPY_IMAGE_TO_BUFFER_INFO_2,
+    .srcImage       = image,
+    .srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+    .dstBuffer      = target.buffer,
+    .regionCount    = 1,
+    .pRegions       = &region,
+  };
+  vkCmdCopyImageToBuffer2(command_buffer, &copy);
+
+  // fence only makes writes available, host domain needs its own barrier
+  VkMemoryBarrier2 barrier
+  {
+    .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+    .srcStageMask  = VK_PIPELINE_STAGE_2_COPY_BIT,
+    .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+    .dstStageMask  = VK_PIPELINE_STAGE_2_HOST_BIT,
+    .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT,
+  };
+  VkDependencyInfo dependency
+  {
+    .sType              = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+    .memoryBarrierCount = 1,
+    .pMemoryBarriers    = &barrier,
+  };
+  vkCmdPipelineBarrier2(command_buffer, &dependency);
+
+  target.extent  = extent;
+  target.frame   = frame;
+  target.pending = true;
+}
+
+void Readback::deliver(uint32_t slot)
+{
+  auto& source = _slots[slot];
+  if (!source.pending)
+    return;
+  source.pending = false;
+
+  auto size = (VkDeviceSize)source.extent.width * source.extent.height * get_texel_size(_format);
+  vmaInvalidateAllocation(_allocator, source.allocation, 0, size);
+  _callback(
+  {
+    .data   = { static_cast<const std::byte*>(source.mapped), size },
+    .extent = source.extent,
+    .format = _format,
+    .frame  = source.frame,
+  });
+}
+
+}
@@ -0,0 +1,663 @@
+/*===-- src/RenderGraph.cpp ----- Render Graph ----------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement pass culling, barrier derivation, memory aliasing of   *|
+|* transient images and parallel recording of the render graph.               *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "RenderGraph.hpp"
+#include "Log.hpp"
+#include "ThreadPool.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <numeric>
+
+using Util::throw_if;
+
+namespace
+{
+
+auto is_write(const Vulkan::Access& access)
+{
+  return (access.access & Vulkan::Write_Access) != 0;
+}
+
+/**
+ * Get aspects of format, barriers of depth stencil images must cover both.
+ */
+auto get_aspect(VkFormat format) -> VkImageAspectFlags
+{
+  switch (format)
+  {
+  case VK_FORMAT_D16_UNORM:
+  case VK_FORMAT_X8_D24_UNORM_PACK32:
+  case VK_FORMAT_D32_SFLOAT:
+    return VK_IMAGE_ASPECT_DEPTH_BIT;
+  case VK_FORMAT_D16_UNORM_S8_UINT:
+  case VK_FORMAT_D24_UNORM_S8_UINT:
+  case VK_FORMAT_D32_SFLOAT_S8_UINT:
+    return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+  case VK_FORMAT_S8_UINT:
+    return VK_IMAGE_ASPECT_STENCIL_BIT;
+  default:
+    return VK_IMAGE_ASPECT_COLOR_BIT;
+  }
+}
+
+}
+
+namespace Vulkan
+{
+
+/****************************\
+|*           Pass           *|
+\****************************/
+
+RenderGraph::Pass& RenderGraph::Pass::read(ResourceId resource, const Access& access)
+{
+  _uses.emplace_back(resource, access);
+  return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::write(ResourceId resource, const Access& access)
+{
+  _uses.emplace_back(resource, access);
+  return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::color(const Attachment& attachment)
+{
+  _colors.emplace_back(attachment);
+  _uses.emplace_back(attachment.image, Access
+  {
+    .stage  = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+    .access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+              (attachment.load == VK_ATTACHMENT_LOAD_OP_LOAD ? VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT : VK_ACCESS_2_NONE),
+    .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+  });
+  // resolve is written at end of rendering in the same stage
+  if (attachment.resolve != No_Resource)
+    _uses.emplace_back(attachment.resolve, Access
+    {
+      .stage  = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+      .access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+      .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    });
+  return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::depth(const Attachment& attachment)
+{
+  _depth = attachment;
+  _uses.emplace_back(attachment.image, Access
+  {
+    .stage  = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+    .access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+    .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+  });
+  return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::render_area(const VkExtent2D* extent)
+{
+  _area = extent;
+  return *this;
+}
+
+/****************************\
+|*       Render Graph       *|
+\****************************/
+
+RenderGraph::RenderGraph(VkDevice device, VmaAllocator allocator, uint32_t queue_family, uint32_t frames)
+  : _device(device),
+    _allocator(allocator),
+    _queue_family(queue_family),
+    _frames(frames)
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+  for (const auto& pass : _passes)
+    for (auto pool : pass._command_pools)
+      vkDestroyCommandPool(_device, pool, nullptr);
+
+  for (const auto& resource : _resources)
+  {
+    if (resource.imported)
+      continue;
+    vkDestroyImageView(_device, resource.view, nullptr);
+    if (resource.allocation)
+      vmaDestroyImage(_allocator, resource.image, resource.allocation);
+    else
+      vkDestroyImage(_device, resource.image, nullptr);
+  }
+  vmaFreeMemory(_allocator, _memory);
+}
+
+auto RenderGraph::create_image(std::string_view name, const ImageDesc& desc) -> ResourceId
+{
+  _resources.emplace_back(Resource
+  {
+    .name     = std::string(name),
+    .is_image = true,
+    .imported = false,
+    .desc     = desc,
+    .initial  = {},
+    .final    = {},
+  });
+  return _resources.size() - 1;
+}
+
+auto RenderGraph::import_image(std::string_view name, VkFormat format, VkExtent2D extent, const Access& initial, const Access& final) -> ResourceId
+{
+  _resources.emplace_back(Resource
+  {
+    .name     = std::string(name),
+    .is_image = true,
+    .imported = true,
+    .desc     = { .format = format, .extent = extent, .levels = 1, .samples = VK_SAMPLE_COUNT_1_BIT, .usage = 0 },
+    .initial  = initial,
+    .final    = final,
+  });
+  return _resources.size() - 1;
+}
+
+auto RenderGraph::import_buffer(std::string_view name) -> ResourceId
+{
+  _resources.emplace_back(Resource
+  {
+    .name     = std::string(name),
+    .is_image = false,
+    .imported = true,
+    .desc     = {},
+    .initial  = {},
+    .final    = {},
+  });
+  return _resources.size() - 1;
+}
+
+void RenderGraph::set_image(ResourceId resource, VkImage image, VkImageView view)
+{
+  _resources[resource].image = image;
+  _resources[resource].view  = view;
+}
+
+auto RenderGraph::add_pass(std::string_view name, Record record) -> Pass&
+{
+  auto& pass = _passes.emplace_back();
+  pass._name   = name;
+  pass._record = std::move(record);
+  return pass;
+}
+
+void RenderGraph::compile()
+{
+  cull();
+  for (uint32_t i = 0; i < _passes.size(); ++i)
+    if (!_passes[i]._culled)
+      _live.emplace_back(i);
+
+  // lifetime in passes decides which images can share memory
+  for (auto i : _live)
+    for (const auto& use : _passes[i]._uses)
+    {
+      auto& resource = _resources[use.resource];
+      resource.first = std::min(resource.first, i);
+      resource.last  = std::max(resource.last, i);
+    }
+  allocate();
+
+  // frames repeat, so first simulation finds states at end of frame, which are states at start of next one.
+  // Owned image starts undefined after the last use of every image sharing its memory
+  std::vector<SyncState> initial(_resources.size());
+  for (uint32_t i = 0; i < _resources.size(); ++i)
+    if (const auto& access = _resources[i].initial)
+      initial[i] = { .write_stage = access->stage, .write_access = access->access, .layout = access->layout };
+  auto end = simulate(initial);
+  for (uint32_t i = 0; i < _resources.size(); ++i)
+  {
+    const auto& resource = _resources[i];
+    if (resource.initial)
+      continue;
+    if (resource.imported)
+    {
+      initial[i] = end[i];
+      continue;
+    }
+    for (uint32_t j = 0; j < _resources.size(); ++j)
+    {
+      const auto& other = _resources[j];
+      auto aliased = i == j || (!other.imported && !resource.allocation && !other.allocation &&
+                                resource.offset < other.offset + other.size && other.offset < resource.offset + resource.size);
+      if (!aliased)
+        continue;
+      initial[i].write_stage  |= end[j].write_stage | end[j].read_stage;
+      initial[i].write_access |= end[j].write_access;
+    }
+    initial[i].layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  }
+  simulate(initial);
+
+  create_command_buffers();
+
+  auto batches = std::ranges::count_if(_live, [&](auto i)
+  {
+    const auto& pass = _passes[i];
+    return pass._memory_barrier.srcStageMask || pass._memory_barrier.dstStageMask || !pass._image_barriers.empty();
+  });
+  Log::info(fmt::format("render graph: {} passes, {} culled, {} barrier batches", _live.size(), _passes.size() - _live.size(), batches));
+}
+
+void RenderGraph::cull()
+{
+  // a resource nobody reads makes its writers useless, and their reads in turn,
+  // imported resources are read after the frame
+  std::vector<uint32_t> readers(_resources.size());
+  std::vector<uint32_t> writes(_passes.size());
+  for (uint32_t i = 0; i < _resources.size(); ++i)
+    readers[i] = _resources[i].imported;
+  for (uint32_t i = 0; i < _passes.size(); ++i)
+    for (const auto& use : _passes[i]._uses)
+      is_write(use.access) ? ++writes[i] : ++readers[use.resource];
+
+  std::vector<ResourceId> unused;
+  auto cull_pass = [&](Pass& pass)
+  {
+    pass._culled = true;
+    for (const auto& use : pass._uses)
+      if (!is_write(use.access) && --readers[use.resource] == 0)
+        unused.emplace_back(use.resource);
+  };
+  for (uint32_t i = 0; i < _resources.size(); ++i)
+    if (readers[i] == 0)
+      unused.emplace_back(i);
+  for (uint32_t i = 0; i < _passes.size(); ++i)
+    if (writes[i] == 0)
+      cull_pass(_passes[i]);
+
+  while (!unused.empty())
+  {
+    auto resource = unused.back();
+    unused.pop_back();
+    for (uint32_t i = 0; i < _passes.size(); ++i)
+    {
+      auto& pass = _passes[i];
+      if (pass._culled)
+        continue;
+      for (const auto& use : pass._uses)
+        if (use.resource == resource && is_write(use.access) && --writes[i] == 0)
+        {
+          cull_pass(pass);
+          break;
+        }
+    }
+  }
+}
+
+void RenderGraph::allocate()
+{
+  // transient attachments are backed on demand by tile-based GPUs and take no part in aliasing,
+  // other GPUs have no lazily allocated memory and get device local one
+  VkMemoryRequirements requirements
+  {
+    .alignment      = 1,
+    .memoryTypeBits = ~0u,
+  };
+  std::vector<ResourceId>   aliased;
+  std::vector<VkDeviceSize> alignments(_resources.size(), 1);
+  for (uint32_t i = 0; i < _resources.size(); ++i)
+  {
+    auto& resource = _resources[i];
+    if (!resource.is_image || resource.imported)
+      continue;
+
+    // unused image is kept valid for descriptors, alive the whole frame
+    if (resource.first > resource.last)
+    {
+      resource.first = 0;
+      resource.last  = _passes.size();
+    }
+
+    VkImageCreateInfo info
+    {
+      .sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .imageType     = VK_IMAGE_TYPE_2D,
+      .format        = resource.desc.format,
+      .extent        = { resource.desc.extent.width, resource.desc.extent.height, 1 },
+      .mipLevels     = resource.desc.levels,
+      .arrayLayers   = 1,
+      .samples       = resource.desc.samples,
+      .tiling        = VK_IMAGE_TILING_OPTIMAL,
+      .usage         = resource.desc.usage,
+      .sharingMode   = VK_SHARING_MODE_EXCLUSIVE,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    if (resource.desc.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+    {
+      VmaAllocationCreateInfo alloc_info
+      {
+        .usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED,
+      };
+      auto result = vmaCreateImage(_allocator, &info, &alloc_info, &resource.image, &resource.allocation, nullptr);
+      if (result != VK_SUCCESS)
+      {
+        alloc_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+        result = vmaCreateImage(_allocator, &info, &alloc_info, &resource.image, &resource.allocation, nullptr);
+      }
+      throw_if(result != VK_SUCCESS, fmt::format("failed to create image {}", resource.name));
+      continue;
+    }
+
+    throw_if(vkCreateImage(_device, &info, nullptr, &resource.image) != VK_SUCCESS,
+             fmt::format("failed to create image {}", resource.name));
+    VkMemoryRequirements image_requirements;
+    vkGetImageMemoryRequirements(_device, resource.image, &image_requirements);
+    resource.size                = image_requirements.size;
+    alignments[i]                = image_requirements.alignment;
+    requirements.alignment       = std::max(requirements.alignment, image_requirements.alignment);
+    requirements.memoryTypeBits &= image_requirements.memoryTypeBits;
+    aliased.emplace_back(i);
+  }
+
+  // largest first at lowest offset not overlapping images alive at the same time
+  std::ranges::sort(aliased, std::greater{}, [&](auto i) { return _resources[i].size; });
+  for (uint32_t i = 0; i < aliased.size(); ++i)
+  {
+    auto& resource = _resources[aliased[i]];
+    for (bool moved = true; moved;)
+    {
+      moved = false;
+      for (uint32_t j = 0; j < i; ++j)
+      {
+        const auto& other = _resources[aliased[j]];
+        auto alive  = resource.first <= other.last && other.first <= resource.last;
+        auto memory = resource.offset < other.offset + other.size && other.offset < resource.offset + resource.size;
+        if (alive && memory)
+        {
+          resource.offset = Util::align_up(other.offset + other.size, alignments[aliased[i]]);
+          moved = true;
+        }
+      }
+    }
+    requirements.size = std::max(requirements.size, resource.offset + resource.size);
+  }
+
+  if (!aliased.empty())
+  {
+    throw_if(requirements.memoryTypeBits == 0, "images of render graph have no common memory type");
+    VmaAllocationCreateInfo alloc_info
+    {
+      .requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    };
+    throw_if(vmaAllocateMemory(_allocator, &requirements, &alloc_info, &_memory, nullptr) != VK_SUCCESS,
+             "failed to allocate memory of render graph");
+    for (auto i : aliased)
+      throw_if(vmaBindImageMemory2(_allocator, _memory, _resources[i].offset, _resources[i].image, nullptr) != VK_SUCCESS,
+               fmt::format("failed to bind memory of image {}", _resources[i].name));
+
+    auto total = std::transform_reduce(aliased.begin(), aliased.end(), VkDeviceSize(0), std::plus{}, [&](auto i) { return _resources[i].size; });
+    Log::info(fmt::format("render graph: {} images in {} KiB, {} KiB without aliasing", aliased.size(), requirements.size / 1024, total / 1024));
+  }
+
+  // views sample only depth of depth stencil formats
+  for (auto& resource : _resources)
+  {
+    if (!resource.is_image || resource.imported)
+      continue;
+    auto aspect = get_aspect(resource.desc.format);
+    VkImageViewCreateInfo info
+    {
+      .sType    = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .image    = resource.image,
+      .viewType = VK_IMAGE_VIEW_TYPE_2D,
+      .format   = resource.desc.format,
+      .subresourceRange =
+      {
+        .aspectMask = aspect & ~VK_IMAGE_ASPECT_STENCIL_BIT,
+        .levelCount = resource.desc.levels,
+        .layerCount = 1,
+      },
+    };
+    throw_if(vkCreateImageView(_device, &info, nullptr, &resource.view) != VK_SUCCESS,
+             fmt::format("failed to create view of image {}", resource.name));
+  }
+}
+
+auto RenderGraph::simulate(std::vector<SyncState> states) -> std::vector<SyncState>
+{
+  // image changing layout gets its own barrier, everything else is merged into one memory barrier
+  auto image_barrier = [&](ResourceId id, VkImageLayout old_layout, const VkMemoryBarrier2& scopes, VkImageLayout new_layout)
+  {
+    const auto& resource = _resources[id];
+    return Pass::ImageBarrier
+    {
+      .resource = id,
+      .barrier  =
+      {
+        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask        = scopes.srcStageMask,
+        .srcAccessMask       = scopes.srcAccessMask,
+        .dstStageMask        = scopes.dstStageMask,
+        .dstAccessMask       = scopes.dstAccessMask,
+        .oldLayout           = old_layout,
+        .newLayout           = new_layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .subresourceRange    =
+        {
+          .aspectMask = get_aspect(resource.desc.format),
+          .levelCount = resource.desc.levels,
+          .layerCount = 1,
+        },
+      },
+    };
+  };
+
+  for (auto i : _live)
+  {
+    auto& pass = _passes[i];
+    auto& memory = pass._memory_barrier;
+    memory = { .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+    pass._image_barriers.clear();
+    for (const auto& [id, access] : pass._uses)
+    {
+      auto& state      = states[id];
+      auto  old_layout = state.layout;
+      auto  transition = _resources[id].is_image && access.layout != old_layout;
+      auto  scopes     = state.use(access, transition);
+      if (transition)
+        pass._image_barriers.emplace_back(image_barrier(id, old_layout, scopes, access.layout));
+      else if (scopes.dstStageMask)
+      {
+        memory.srcStageMask  |= scopes.srcStageMask;
+        memory.srcAccessMask |= scopes.srcAccessMask;
+        memory.dstStageMask  |= scopes.dstStageMask;
+        memory.dstAccessMask |= scopes.dstAccessMask;
+      }
+    }
+  }
+
+  _final_barriers.clear();
+  for (uint32_t i = 0; i < _resources.size(); ++i)
+  {
+    const auto& final = _resources[i].final;
+    if (!_resources[i].is_image || final.layout == VK_IMAGE_LAYOUT_UNDEFINED || final.layout == states[i].layout)
+      continue;
+    auto old_layout = states[i].layout;
+    auto scopes     = states[i].use(final, true);
+    _final_barriers.emplace_back(image_barrier(i, old_layout, scopes, final.layout));
+  }
+  return states;
+}
+
+void RenderGraph::create_command_buffers()
+{
+  // pool per pass and frame, so passes are recorded concurrently and reset as a whole
+  for (auto i : _live)
+  {
+    auto& pass = _passes[i];
+    pass._command_pools.resize(_frames);
+    pass._command_buffers.resize(_frames);
+    for (uint32_t frame = 0; frame < _frames; ++frame)
+    {
+      VkCommandPoolCreateInfo pool_info
+      {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = _queue_family,
+      };
+      throw_if(vkCreateCommandPool(_device, &pool_info, nullptr, &pass._command_pools[frame]) != VK_SUCCESS,
+               fmt::format("failed to create command pool of pass {}", pass._name));
+      VkCommandBufferAllocateInfo allocate_info
+      {
+        .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool        = pass._command_pools[frame],
+        .level              = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+        .commandBufferCount = 1,
+      };
+      throw_if(vkAllocateCommandBuffers(_device, &allocate_info, &pass._command_buffers[frame]) != VK_SUCCESS,
+               fmt::format("failed to create command buffer of pass {}", pass._name));
+    }
+
+    if (!pass.is_graphics())
+      continue;
+    const auto& first = pass._colors.empty() ? *pass._depth : pass._colors.front();
+    pass._extent  = _resources[first.image].desc.extent;
+    pass._samples = _resources[first.image].desc.samples;
+    for (const auto& color : pass._colors)
+      pass._color_formats.emplace_back(_resources[color.image].desc.format);
+    if (pass._depth)
+      pass._depth_format = _resources[pass._depth->image].desc.format;
+  }
+}
+
+void RenderGraph::execute(VkCommandBuffer command_buffer, uint32_t frame)
+{
+  Util::ThreadPool::instance().parallel_for(_live.size(), [&](uint32_t i)
+  {
+    auto& pass = _passes[_live[i]];
+    auto  secondary = pass._command_buffers[frame];
+    vkResetCommandPool(_device, pass._command_pools[frame], 0);
+
+    // secondary command buffer of graphics pass continues rendering begun by primary
+    VkCommandBufferInheritanceRenderingInfo rendering
+    {
+      .sType                   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+      .colorAttachmentCount    = (uint32_t)pass._color_formats.size(),
+      .pColorAttachmentFormats = pass._color_formats.data(),
+      .depthAttachmentFormat   = pass._depth_format,
+      .rasterizationSamples    = pass._samples,
+    };
+    VkCommandBufferInheritanceInfo inheritance
+    {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+      .pNext = pass.is_graphics() ? &rendering : nullptr,
+    };
+    VkCommandBufferUsageFlags flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (pass.is_graphics())
+      flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    VkCommandBufferBeginInfo begin
+    {
+      .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags            = flags,
+      .pInheritanceInfo = &inheritance,
+    };
+    throw_if(vkBeginCommandBuffer(secondary, &begin) != VK_SUCCESS,
+             fmt::format("failed to begin command buffer of pass {}", pass._name));
+    pass._record(secondary);
+    throw_if(vkEndCommandBuffer(secondary) != VK_SUCCESS,
+             fmt::format("failed to end command buffer of pass {}", pass._name));
+  });
+
+  for (auto i : _live)
+  {
+    const auto& pass = _passes[i];
+    record_barriers(command_buffer, pass._memory_barrier, pass._image_barriers);
+    if (!pass.is_graphics())
+    {
+      vkCmdExecuteCommands(command_buffer, 1, &pass._command_buffers[frame]);
+      continue;
+    }
+
+    _attachments.clear();
+    for (const auto& color : pass._colors)
+      _attachments.emplace_back(attachment_info(color, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+    VkRenderingAttachmentInfo depth;
+    if (pass._depth)
+      depth = attachment_info(*pass._depth, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    VkRenderingInfo rendering
+    {
+      .sType                = VK_STRUCTURE_TYPE_RENDERING_INFO,
+      .flags                = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT,
+      .renderArea           = { .extent = pass._area ? *pass._area : pass._extent },
+      .layerCount           = 1,
+      .colorAttachmentCount = (uint32_t)_attachments.size(),
+      .pColorAttachments    = _attachments.data(),
+      .pDepthAttachment     = pass._depth ? &depth : nullptr,
+    };
+    vkCmdBeginRendering(command_buffer, &rendering);
+    vkCmdExecuteCommands(command_buffer, 1, &pass._command_buffers[frame]);
+    vkCmdEndRendering(command_buffer);
+  }
+
+  VkMemoryBarrier2 none
+  {
+    .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+  };
+  record_barriers(command_buffer, none, _final_barriers);
+}
+
+void RenderGraph::record_barriers(VkCommandBuffer command_buffer, const VkMemoryBarrier2& memory_barrier,
+                                  const std::vector<Pass::ImageBarrier>& image_barriers)
+{
+  auto has_memory_barrier = memory_barrier.srcStageMask || memory_barrier.dstStageMask;
+  if (!has_memory_barrier && image_barriers.empty())
+    return;
+
+  _barriers.clear();
+  for (const auto& [resource, barrier] : image_barriers)
+  {
+    _barriers.emplace_back(barrier);
+    _barriers.back().image = _resources[resource].image;
+  }
+  VkDependencyInfo dependency
+  {
+    .sType                   = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+    .memoryBarrierCount      = has_memory_barrier ? 1u : 0u,
+    .pMemoryBarriers         = &memory_barrier,
+    .imageMemoryBarrierCount = (uint32_t)_barriers.size(),
+    .pImageMemoryBarriers    = _barriers.data(),
+  };
+  vkCmdPipelineBarrier2(command_buffer, &dependency);
+}
+
+auto RenderGraph::attachment_info(const Attachment& attachment, VkImageLayout layout) const -> VkRenderingAttachmentInfo
+{
+  VkRenderingAttachmentInfo info
+  {
+    .sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+    .imageView   = _resources[attachment.image].view,
+    .imageLayout = layout,
+    .loadOp      = attachment.load,
+    .storeOp     = attachment.store,
+    .clearValue  = attachment.clear,
+  };
+  if (attachment.resolve != No_Resource)
+  {
+    info.resolveMode        = VK_RESOLVE_MODE_AVERAGE_BIT;
+    info.resolveImageView   = _resources[attachment.resolve].view;
+    info.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  }
+  return info;
+}
+
+}
@@ -0,0 +1,316 @@
+/*===-- src/Simplify.cpp ------- Mesh Simplifier --------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the quadric error edge collapse simplification and LOD *|
+|* chain generation.                                                          *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Mesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace
+{
+
+using namespace Mesh;
+
+/**
+ * Sum of squared distances to planes, weighted by triangle area.
+ */
+struct Quadric
+{
+  double a00, a11, a22, a01, a02, a12;
+  double b0, b1, b2, c;
+  double w;
+
+  void add_plane(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2)
+  {
+    auto n    = glm::cross(p1 - p0, p2 - p0);
+    auto area = glm::length(n);
+    if (area == 0.f)
+      return;
+    n /= area;
+    double x = n.x, y = n.y, z = n.z, d = -glm::dot(n, p0);
+    double weight = area * 0.5;
+    a00 += weight * x * x; a11 += weight * y * y; a22 += weight * z * z;
+    a01 += weight * x * y; a02 += weight * x * z; a12 += weight * y * z;
+    b0  += weight * x * d; b1  += weight * y * d; b2  += weight * z * d;
+    c   += weight * d * d;
+    w   += weight;
+  }
+
+  auto operator+(const Quadric& q) const
+  {
+    return Quadric
+    {
+      a00 + q.a00, a11 + q.a11, a22 + q.a22, a01 + q.a01, a02 + q.a02, a12 + q.a12,
+      b0 + q.b0, b1 + q.b1, b2 + q.b2, c + q.c, w + q.w,
+    };
+  }
+
+  /**
+   * @return weighted mean of squared distances.
+   */
+  auto error(const glm::vec3& p) const
+  {
+    double x = p.x, y = p.y, z = p.z;
+    auto e = a00 * x * x + a11 * y * y + a22 * z * z
+           + 2 * (a01 * x * y + a02 * x * z + a12 * y * z)
+           + 2 * (b0 * x + b1 * y + b2 * z) + c;
+    return w == 0 ? 0.f : (float)(std::abs(e) / w);
+  }
+};
+
+struct Collapse
+{
+  uint32_t from, to;
+  float    error;
+};
+
+auto edge_key(uint32_t a, uint32_t b)
+{
+  return (uint64_t)a << 32 | b;
+}
+
+/**
+ * Find vertices that can be collapsed: the only wedge of their position,
+ * and every half edge around them has exactly one opposite.
+ */
+auto find_collapsible(std::span<const Vertex> vertices, std::span<const uint32_t> indices)
+{
+  std::vector<bool> collapsible(vertices.size(), true);
+
+  struct PositionHash
+  {
+    auto operator()(const glm::vec3& p) const
+    {
+      uint32_t h[3];
+      memcpy(h, &p, sizeof(h));
+      return (size_t)((h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u));
+    }
+  };
+  std::unordered_map<glm::vec3, uint32_t, PositionHash> wedges;
+  for (auto index : indices)
+  {
+    auto [it, inserted] = wedges.try_emplace(vertices[index].position, index);
+    if (!inserted && it->second != index)
+      collapsible[index] = collapsible[it->second] = false;
+  }
+  for (auto index : indices)
+    if (wedges[vertices[index].position] != index)
+      collapsible[index] = false;
+
+  std::unordered_map<uint64_t, uint32_t> half_edges;
+  half_edges.reserve(indices.size());
+  for (size_t i = 0; i < indices.size(); i += 3)
+    for (uint32_t e = 0; e < 3; ++e)
+      ++half_edges[edge_key(indices[i + e], indices[i + (e + 1) % 3])];
+  for (const auto& [key, count] : half_edges)
+  {
+    uint32_t a = key >> 32, b = (uint32_t)key;
+    auto it = half_edges.find(edge_key(b, a));
+    if (count != 1 || it == half_edges.end() || it->second != 1)
+      collapsible[a] = collapsible[b] = false;
+  }
+  return collapsible;
+}
+
+}
+
+namespace Mesh
+{
+
+std::vector<uint32_t> simplify(std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+                               uint32_t target_index_count, float target_error, float* result_error)
+{
+  std::vector<uint32_t> result(indices.begin(), indices.end());
+  auto collapsible = find_collapsible(vertices, indices);
+
+  std::vector<Quadric> quadrics(vertices.size());
+  for (size_t i = 0; i < indices.size(); i += 3)
+  {
+    const auto& p0 = vertices[indices[i]].position;
+    const auto& p1 = vertices[indices[i + 1]].position;
+    const auto& p2 = vertices[indices[i + 2]].position;
+    for (uint32_t j = 0; j < 3; ++j)
+      quadrics[indices[i + j]].add_plane(p0, p1, p2);
+  }
+
+  auto max_error   = target_error < std::sqrt(std::numeric_limits<float>::max()) ? target_error * target_error
+                                                                                 : std::numeric_limits<float>::max();
+  auto error       = 0.f;
+  auto remap       = std::vector<uint32_t>(vertices.size());
+  auto locked      = std::vector<uint8_t>(vertices.size());
+  auto offsets     = std::vector<uint32_t>(vertices.size() + 1);
+  auto triangles   = std::vector<uint32_t>();
+  auto candidates  = std::vector<Collapse>();
+  auto ring_u      = std::vector<uint32_t>();
+  auto ring_v      = std::vector<uint32_t>();
+
+  // every pass collapses a set of independent edges, cheapest first
+  while (result.size() > target_index_count)
+  {
+    candidates.clear();
+    for (size_t i = 0; i < result.size(); i += 3)
+      for (uint32_t e = 0; e < 3; ++e)
+      {
+        auto u = result[i + e], v = result[i + (e + 1) % 3];
+        if (collapsible[u])
+          candidates.emplace_back(u, v, (quadrics[u] + quadrics[v]).error(vertices[v].position));
+        if (collapsible[v])
+          candidates.emplace_back(v, u, (quadrics[u] + quadrics[v]).error(vertices[u].position));
+      }
+    std::ranges::sort(candidates, {}, &Collapse::error);
+
+    // vertex to triangles adjacency
+    std::ranges::fill(offsets, 0);
+    for (auto index : result)
+      ++offsets[index + 1];
+    for (size_t i = 1; i < offsets.size(); ++i)
+      offsets[i] += offsets[i - 1];
+    triangles.resize(result.size());
+    {
+      auto fill = offsets;
+      for (uint32_t i = 0; i < result.size(); ++i)
+        triangles[fill[result[i]]++] = i / 3;
+    }
+    auto gather_ring = [&](uint32_t vertex, std::vector<uint32_t>& ring)
+    {
+      ring.clear();
+      for (auto i = offsets[vertex]; i < offsets[vertex + 1]; ++i)
+        for (uint32_t j = 0; j < 3; ++j)
+          if (auto n = result[triangles[i] * 3 + j]; n != vertex)
+            ring.emplace_back(n);
+      std::ranges::sort(ring);
+      ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+    };
+
+    // each collapse removes two triangles
+    auto max_collapses = (result.size() - target_index_count) / 6 + 1;
+    uint32_t collapses = 0;
+    std::iota(remap.begin(), remap.end(), 0);
+    std::ranges::fill(locked, 0);
+    for (const auto& [u, v, cost] : candidates)
+    {
+      if (cost > max_error || collapses == max_collapses)
+        break;
+      if (locked[u] || locked[v])
+        continue;
+
+      // link condition, shared neighbours of an interior edge are the two opposite vertices
+      gather_ring(u, ring_u);
+      gather_ring(v, ring_v);
+      auto shared = 0;
+      for (auto n : ring_u)
+        shared += std::ranges::binary_search(ring_v, n);
+      if (shared != 2)
+        continue;
+
+      // reject collapse flipping any remaining triangle
+      auto flipped = false;
+      for (auto i = offsets[u]; i < offsets[u + 1] && !flipped; ++i)
+      {
+        auto t = &result[triangles[i] * 3];
+        if (t[0] == v || t[1] == v || t[2] == v)
+          continue;
+        glm::vec3 p[3], q[3];
+        for (uint32_t j = 0; j < 3; ++j)
+        {
+          p[j] = vertices[t[j]].position;
+          q[j] = t[j] == u ? vertices[v].position : p[j];
+        }
+        auto n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+        auto n1 = glm::cross(q[1] - q[0], q[2] - q[0]);
+        flipped = glm::dot(n0, n1) <= 0.f;
+      }
+      if (flipped)
+        continue;
+
+      remap[u]     = v;
+      quadrics[v]  = quadrics[u] + quadrics[v];
+      error        = std::max(error, cost);
+      ++collapses;
+      // neighbourhood is locked so flip checks of later collapses stay valid
+      locked[u] = locked[v] = true;
+      for (auto n : ring_u)
+        locked[n] = true;
+    }
+    if (collapses == 0)
+      break;
+
+    size_t count = 0;
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+      auto a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+      if (a == b || b == c || c == a)
+        continue;
+      result[count++] = a;
+      result[count++] = b;
+      result[count++] = c;
+    }
+    result.resize(count);
+  }
+
+  if (result_error)
+    *result_error = std::sqrt(error);
+  return result;
+}
+
+std::vector<Lod> generate_lods(MeshData& mesh, uint32_t max_lods, float ratio)
+{
+  // every level has at most 90% of the previous one, so max_lods copies of the original fit all of them
+  auto count = (uint32_t)mesh.indices.size();
+  mesh.indices.resize((size_t)count * std::max(max_lods, 1u));
+  auto lods = generate_lods(mesh.vertices, mesh.indices, count, max_lods, ratio);
+  mesh.indices.resize(lods.back().first_index + lods.back().index_count);
+  return lods;
+}
+
+std::vector<Lod> generate_lods(std::span<const Vertex> vertices, std::span<uint32_t> indices, uint32_t index_count,
+                               uint32_t max_lods, float ratio)
+{
+  std::vector<Lod> lods
+  {
+    {
+      .first_index = 0,
+      .index_count = index_count,
+      .error       = 0.f,
+    },
+  };
+
+  while (lods.size() < max_lods)
+  {
+    const auto& last = lods.back();
+    auto target = (uint32_t)(last.index_count * ratio) / 3 * 3;
+    auto error  = 0.f;
+    auto level = simplify(vertices, indices.subspan(last.first_index, last.index_count),
+                          target, std::numeric_limits<float>::max(), &error);
+    // locked vertices stop simplification, not worth a level
+    auto first = last.first_index + last.index_count;
+    if (level.empty() || level.size() > last.index_count * 0.9f || level.size() > indices.size() - first)
+      break;
+    optimize_vertex_cache(level, vertices.size());
+
+    // errors of levels accumulate as each is simplified from the previous one
+    lods.emplace_back(Lod
+    {
+      .first_index = first,
+      .index_count = (uint32_t)level.size(),
+      .error       = last.error + error,
+    });
+    std::ranges::copy(level, indices.begin() + first);
+  }
+  return lods;
+}
+
+}
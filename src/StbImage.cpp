@@ -0,0 +1,16 @@
+/*===-- src/StbImage.cpp ------- stb_image --------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the stb_image decoders.                                *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+// textures are decoded from memory, file IO goes through MappedFile
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_NO_STDIO
+
+#include <stb_image.h>
@@ -0,0 +1,725 @@
+/*===-- src/Texture.cpp -------- Texture ----------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the textures decoded on the thread pool and uploaded   *|
+|* with their mip levels by command buffers of frames.                        *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Texture.hpp"
+#include "ImageTracker.hpp"
+#include "Log.hpp"
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <memory>
+#include <ranges>
+
+namespace
+{
+
+using Util::throw_if;
+
+// bytes copied by one frame, about a millisecond of PCIe bandwidth,
+// a larger texture is still uploaded alone
+constexpr VkDeviceSize Upload_Budget = 16 << 20;
+
+// textures uploaded by one frame, bounds sets and counters of compute downsample
+constexpr uint32_t Max_Uploads = 64;
+
+// compute downsample writes 12 levels below level 0 in one dispatch while level 6 fits one 64x64 tile,
+// larger textures get the 6 levels of first pass
+constexpr uint32_t Max_Compute_Levels = 13;
+constexpr uint32_t Max_Compute_Size   = 4096;
+
+auto is_sampled(VkPhysicalDevice device, VkFormat format)
+{
+  constexpr VkFormatFeatureFlags Sampled = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(device, format, &properties);
+  return (properties.optimalTilingFeatures & Sampled) == Sampled;
+}
+
+struct MipConstants
+{
+  uint32_t levels;
+  uint32_t srgb;
+  uint32_t counter;
+};
+
+constexpr uint32_t White = 0xffffffff;
+
+}
+
+namespace Vulkan
+{
+
+Textures::Textures(VkPhysicalDevice physical_device, VkDevice device, VmaAllocator allocator, uint32_t capacity, uint32_t frames)
+  : _physical_device(physical_device),
+    _device(device),
+    _allocator(allocator),
+    _capacity(capacity),
+    _written(frames, -1),
+    _frames(frames)
+{
+  throw_if(capacity == 0, "textures need at least one slot");
+
+  // blit needs linear filter of format, compute downsample writes unorm views of either format
+  auto mip_mode = [&](VkFormat format)
+  {
+    constexpr VkFormatFeatureFlags Blit = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                          VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+    if ((properties.optimalTilingFeatures & Blit) == Blit)
+      return MipMode::Blit;
+    vkGetPhysicalDeviceFormatProperties(physical_device, VK_FORMAT_R8G8B8A8_UNORM, &properties);
+    if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)
+      return MipMode::Compute;
+    Log::error(fmt::format("textures of format {} have no mip levels", (int)format));
+    return MipMode::None;
+  };
+  _mip_modes = { mip_mode(VK_FORMAT_R8G8B8A8_UNORM), mip_mode(VK_FORMAT_R8G8B8A8_SRGB) };
+  if (std::ranges::find(_mip_modes, MipMode::Compute) != _mip_modes.end())
+    create_mip_pipeline();
+
+  // Basis Universal textures are transcoded to best format device samples, RGBA8 at worst
+  for (auto target : { Ktx2::Target::BC7, Ktx2::Target::ASTC_4x4, Ktx2::Target::ETC2, Ktx2::Target::BC3 })
+    if (is_sampled(physical_device, Ktx2::get_format(target, false)) && is_sampled(physical_device, Ktx2::get_format(target, true)))
+    {
+      _transcode_target = target;
+      break;
+    }
+
+  VkSamplerCreateInfo sampler_info
+  {
+    .sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+    .magFilter    = VK_FILTER_LINEAR,
+    .minFilter    = VK_FILTER_LINEAR,
+    .mipmapMode   = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+    .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+    .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+    .addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+    .maxLod       = VK_LOD_CLAMP_NONE,
+  };
+  throw_if(vkCreateSampler(_device, &sampler_info, nullptr, &_sampler) != VK_SUCCESS,
+           "failed to create texture sampler");
+
+  // white is staged at once, so first frame uploads it before any draw samples a slot
+  auto white = stage(std::span(reinterpret_cast<const uint8_t*>(&White), 4), { 1, 1 }, false);
+  _white = white.view;
+  std::promise<Staged> staged;
+  staged.set_value(white);
+  _textures.emplace_back();
+  _pending.emplace_back(0, staged.get_future());
+  _load_start = std::chrono::steady_clock::now();
+}
+
+Textures::~Textures()
+{
+  for (auto& [slot, staged] : _pending)
+  {
+    try
+    {
+      destroy(staged.get());
+    }
+    catch (...) {}
+  }
+  for (const auto& frame : _frames)
+  {
+    for (const auto& staged : frame.uploads)
+      release(staged);
+    vkDestroyDescriptorPool(_device, frame.pool, nullptr);
+    vmaDestroyBuffer(_allocator, frame.counters, frame.counters_allocation);
+  }
+  for (const auto& texture : _textures)
+  {
+    vkDestroyImageView(_device, texture.view, nullptr);
+    vmaDestroyImage(_allocator, texture.image, texture.allocation);
+  }
+  vkDestroyPipeline(_device, _mip_pipeline, nullptr);
+  vkDestroyPipelineLayout(_device, _mip_pipeline_layout, nullptr);
+  vkDestroyDescriptorSetLayout(_device, _mip_set_layout, nullptr);
+  vkDestroySampler(_device, _sampler, nullptr);
+}
+
+void Textures::create_mip_pipeline()
+{
+  // every level of one image and counters of all images, index of counter is a push constant
+  std::array<VkDescriptorSetLayoutBinding, 2> bindings
+  {{
+    { .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  .descriptorCount = Max_Compute_Levels, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+    { .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1,                  .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+  }};
+  VkDescriptorSetLayoutCreateInfo set_info
+  {
+    .sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+    .bindingCount = (uint32_t)bindings.size(),
+    .pBindings    = bindings.data(),
+  };
+  throw_if(vkCreateDescriptorSetLayout(_device, &set_info, nullptr, &_mip_set_layout) != VK_SUCCESS,
+           "failed to create mip descriptor set layout");
+
+  VkPushConstantRange push_constant
+  {
+    .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+    .offset     = 0,
+    .size       = sizeof(MipConstants),
+  };
+  VkPipelineLayoutCreateInfo layout_info
+  {
+    .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+    .setLayoutCount         = 1,
+    .pSetLayouts            = &_mip_set_layout,
+    .pushConstantRangeCount = 1,
+    .pPushConstantRanges    = &push_constant,
+  };
+  throw_if(vkCreatePipelineLayout(_device, &layout_info, nullptr, &_mip_pipeline_layout) != VK_SUCCESS,
+           "failed to create mip pipeline layout");
+
+  Util::MappedFile file("shader/mip.spv");
+  VkShaderModuleCreateInfo module_info
+  {
+    .sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+    .codeSize = file.bytes().size(),
+    .pCode    = reinterpret_cast<const uint32_t*>(file.bytes().data()),
+  };
+  VkShaderModule module;
+  throw_if(vkCreateShaderModule(_device, &module_info, nullptr, &module) != VK_SUCCESS,
+           "failed to create shader from shader/mip.spv");
+  VkComputePipelineCreateInfo info
+  {
+    .sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+    .stage  =
+    {
+      .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+      .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+      .module = module,
+      .pName  = "main",
+    },
+    .layout = _mip_pipeline_layout,
+  };
+  auto result = vkCreateComputePipelines(_device, VK_NULL_HANDLE, 1, &info, nullptr, &_mip_pipeline);
+  vkDestroyShaderModule(_device, module, nullptr);
+  throw_if(result != VK_SUCCESS, "failed to create compute pipeline from shader/mip.spv");
+}
+
+bool Textures::reserve()
+{
+  if (_textures.size() == _capacity)
+  {
+    Log::error(fmt::format("all {} texture slots are used", _capacity));
+    return false;
+  }
+  if (_pending.empty())
+    _load_start = std::chrono::steady_clock::now();
+  _textures.emplace_back();
+  return true;
+}
+
+uint32_t Textures::load(std::string_view filename, bool srgb)
+{
+  if (!reserve())
+    return 0;
+  auto slot = (uint32_t)_textures.size() - 1;
+  _pending.emplace_back(slot, Util::ThreadPool::instance().submit([this, filename = std::string(filename), srgb]
+  {
+    Util::MappedFile file(filename);
+    return stage(file.bytes(), filename, srgb);
+  }));
+  return slot;
+}
+
+uint32_t Textures::load(std::span<const std::byte> encoded, std::string_view name, bool srgb)
+{
+  if (!reserve())
+    return 0;
+  auto slot = (uint32_t)_textures.size() - 1;
+  _pending.emplace_back(slot, Util::ThreadPool::instance().submit(
+    [this, encoded = std::vector<std::byte>(encoded.begin(), encoded.end()), name = std::string(name), srgb]
+    {
+      return stage(encoded, name, srgb);
+    }));
+  return slot;
+}
+
+auto Textures::stage(std::span<const std::byte> encoded, std::string_view name, bool srgb) -> Staged
+{
+  if (Ktx2::is_ktx2(encoded))
+    return stage(Ktx2::Reader(encoded, name, _transcode_target, srgb), name, srgb);
+
+  int width, height, channels;
+  std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> pixels(
+    stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(encoded.data()), (int)encoded.size(), &width, &height, &channels, 4),
+    stbi_image_free);
+  throw_if(pixels == nullptr, fmt::format("failed to decode {}: {}", name, stbi_failure_reason()));
+  return stage(std::span(pixels.get(), (size_t)width * height * 4), { (uint32_t)width, (uint32_t)height }, srgb);
+}
+
+auto Textures::stage(std::span<const uint8_t> pixels, VkExtent2D extent, bool srgb) -> Staged
+{
+  // VMA and creation of vulkan objects are thread safe, workers create everything upload needs
+  auto mode = _mip_modes[srgb];
+  Staged staged
+  {
+    .extent      = extent,
+    .levels      = get_levels(mode, extent),
+    .mode        = mode,
+    .srgb        = srgb,
+    .size        = pixels.size(),
+    .offsets     = { 0 },
+    .level_views = {},
+  };
+  try
+  {
+    std::memcpy(create_staging_buffer(staged, pixels.size()).data(), pixels.data(), pixels.size());
+    vmaFlushAllocation(_allocator, staged.buffer_allocation, 0, VK_WHOLE_SIZE);
+    create_image(staged, srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM);
+  }
+  catch (...)
+  {
+    destroy(staged);
+    throw;
+  }
+  return staged;
+}
+
+auto Textures::stage(const Ktx2::Reader& reader, std::string_view name, bool srgb) -> Staged
+{
+  // stored levels are uploaded as they are, block compressed ones can't be blitted,
+  // RGBA8 files without levels get theirs generated like decoded images of their format
+  throw_if(!is_sampled(_physical_device, reader.format()),
+           fmt::format("{}: format {} is not supported by device", name, (int)reader.format()));
+  auto generate = reader.generate_levels();
+  if (generate)
+    srgb = reader.format() == VK_FORMAT_R8G8B8A8_SRGB;
+  auto mode = generate ? _mip_modes[srgb] : MipMode::None;
+  Staged staged
+  {
+    .extent      = reader.extent(),
+    .levels      = generate ? get_levels(mode, reader.extent()) : reader.levels(),
+    .mode        = mode,
+    .srgb        = srgb,
+    .size        = reader.size(),
+    .offsets     = {},
+    .level_views = {},
+  };
+  for (uint32_t level = 0; level < reader.levels(); ++level)
+    staged.offsets.emplace_back(reader.offset(level));
+  try
+  {
+    reader.read(create_staging_buffer(staged, reader.size()));
+    vmaFlushAllocation(_allocator, staged.buffer_allocation, 0, VK_WHOLE_SIZE);
+    create_image(staged, reader.format());
+  }
+  catch (...)
+  {
+    destroy(staged);
+    throw;
+  }
+  return staged;
+}
+
+auto Textures::get_levels(MipMode mode, VkExtent2D extent) -> uint32_t
+{
+  auto size   = std::max(extent.width, extent.height);
+  auto levels = mode == MipMode::None ? 1 : (uint32_t)std::bit_width(size);
+  if (mode == MipMode::Compute)
+    levels = std::min(levels, size > Max_Compute_Size ? 7 : Max_Compute_Levels);
+  return levels;
+}
+
+auto Textures::create_staging_buffer(Staged& staged, VkDeviceSize size) -> std::span<std::byte>
+{
+  VkBufferCreateInfo buffer_info
+  {
+    .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+    .size  = size,
+    .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+  };
+  VmaAllocationCreateInfo alloc_info
+  {
+    .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+    .usage = VMA_MEMORY_USAGE_AUTO,
+  };
+  VmaAllocationInfo info;
+  throw_if(vmaCreateBuffer(_allocator, &buffer_info, &alloc_info, &staged.buffer, &staged.buffer_allocation, &info) != VK_SUCCESS,
+           "failed to create texture staging buffer");
+  return { static_cast<std::byte*>(info.pMappedData), (size_t)size };
+}
+
+void Textures::create_image(Staged& staged, VkFormat format)
+{
+  // srgb images are written through unorm views, storage is only supported by that format
+  VkImageCreateFlags flags = 0;
+  VkImageUsageFlags  usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  if (staged.mode == MipMode::Blit)
+    usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  else if (staged.mode == MipMode::Compute)
+  {
+    usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    if (staged.srgb)
+      flags = VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
+  }
+  VkImageCreateInfo image_info
+  {
+    .sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+    .flags         = flags,
+    .imageType     = VK_IMAGE_TYPE_2D,
+    .format        = format,
+    .extent        = { staged.extent.width, staged.extent.height, 1 },
+    .mipLevels     = staged.levels,
+    .arrayLayers   = 1,
+    .samples       = VK_SAMPLE_COUNT_1_BIT,
+    .tiling        = VK_IMAGE_TILING_OPTIMAL,
+    .usage         = usage,
+    .sharingMode   = VK_SHARING_MODE_EXCLUSIVE,
+    .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+  VmaAllocationCreateInfo alloc_info
+  {
+    .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+  };
+  throw_if(vmaCreateImage(_allocator, &image_info, &alloc_info, &staged.image, &staged.image_allocation, nullptr) != VK_SUCCESS,
+           fmt::format("failed to create {}x{} texture", staged.extent.width, staged.extent.height));
+
+  VkImageViewCreateInfo view_info
+  {
+    .sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+    .image            = staged.image,
+    .viewType         = VK_IMAGE_VIEW_TYPE_2D,
+    .format           = format,
+    .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, staged.levels, 0, 1 },
+  };
+  throw_if(vkCreateImageView(_device, &view_info, nullptr, &staged.view) != VK_SUCCESS,
+           "failed to create texture view");
+
+  if (staged.mode == MipMode::Compute && staged.levels > 1)
+  {
+    view_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+    for (uint32_t level = 0; level < staged.levels; ++level)
+    {
+      view_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+      throw_if(vkCreateImageView(_device, &view_info, nullptr, &staged.level_views.emplace_back()) != VK_SUCCESS,
+               "failed to create texture level view");
+    }
+  }
+}
+
+void Textures::destroy(const Staged& staged)
+{
+  release(staged);
+  vkDestroyImageView(_device, staged.view, nullptr);
+  vmaDestroyImage(_allocator, staged.image, staged.image_allocation);
+}
+
+void Textures::release(const Staged& staged)
+{
+  for (auto view : staged.level_views)
+    vkDestroyImageView(_device, view, nullptr);
+  vmaDestroyBuffer(_allocator, staged.buffer, staged.buffer_allocation);
+}
+
+void Textures::upload(VkCommandBuffer command_buffer, uint32_t frame)
+{
+  auto& current = _frames[frame];
+  for (const auto& staged : current.uploads)
+    release(staged);
+  current.uploads.clear();
+  if (current.pool)
+    vkResetDescriptorPool(_device, current.pool, 0);
+
+  // take finished decodes in load order without waiting for the others,
+  // failed ones keep showing white, uploads retire with this frame
+  auto& uploads = current.uploads;
+  std::vector<uint32_t> slots;
+  VkDeviceSize bytes = 0;
+  std::erase_if(_pending, [&](auto& pending)
+  {
+    auto& [slot, staged] = pending;
+    if (bytes >= Upload_Budget || uploads.size() == Max_Uploads ||
+        staged.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+      return false;
+    try
+    {
+      uploads.emplace_back(staged.get());
+      slots.emplace_back(slot);
+      bytes += uploads.back().size;
+    }
+    catch (const std::exception& e)
+    {
+      Log::error(e.what());
+    }
+    return true;
+  });
+  if (uploads.empty())
+    return;
+
+  // one barrier into transfer layout for all images, copies, mip levels of all images together,
+  // one barrier for fragment shaders
+  ImageTracker tracker;
+  for (const auto& staged : uploads)
+  {
+    tracker.track(staged.image, VK_IMAGE_ASPECT_COLOR_BIT, staged.levels, 1);
+    tracker.use(staged.image, { VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL });
+  }
+  tracker.flush(command_buffer);
+
+  // every stored level in one copy, extents of block compressed levels reach edge of level
+  std::vector<VkBufferImageCopy2> regions;
+  for (const auto& staged : uploads)
+  {
+    regions.clear();
+    for (uint32_t level = 0; level < staged.offsets.size(); ++level)
+      regions.emplace_back(VkBufferImageCopy2
+      {
+        .sType            = VK_STRUCTURE_TYPE_BUFFER_IMAGE_COPY_2,
+        .bufferOffset     = staged.offsets[level],
+        .imageSubresource = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = level, .layerCount = 1 },
+        .imageExtent      = { std::max(staged.extent.width >> level, 1u), std::max(staged.extent.height >> level, 1u), 1 },
+      });
+    VkCopyBufferToImageInfo2 copy
+    {
+      .sType          = VK_STRUCTURE_TYPE_COPY_BUFFER_TO_IMAGE_INFO_2,
+      .srcBuffer      = staged.buffer,
+      .dstImage       = staged.image,
+      .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .regionCount    = (uint32_t)regions.size(),
+      .pRegions       = regions.data(),
+    };
+    vkCmdCopyBufferToImage2(command_buffer, &copy);
+  }
+
+  for (const auto& staged : uploads)
+    if (staged.mode == MipMode::Compute && staged.levels > 1)
+      tracker.use(staged.image, { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                                  VK_IMAGE_LAYOUT_GENERAL });
+  tracker.flush(command_buffer);
+  record_downsample(command_buffer, current, uploads);
+  record_blits(command_buffer, uploads, tracker);
+
+  for (const auto& staged : uploads)
+    tracker.use(staged.image, { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+  tracker.flush(command_buffer);
+
+  // staging buffers stay retired until fence of this frame signals again
+  for (uint32_t i = 0; i < uploads.size(); ++i)
+  {
+    _textures[slots[i]] = { uploads[i].image, uploads[i].image_allocation, uploads[i].view };
+    _uploaded.emplace_back(slots[i]);
+  }
+
+  if (_pending.empty())
+    Log::info(fmt::format("uploaded {} textures in {:.1f}ms", _uploaded.size(),
+                          std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - _load_start).count()));
+}
+
+void Textures::record_blits(VkCommandBuffer command_buffer, std::span<const Staged> uploads, ImageTracker& tracker)
+{
+  // level by level across images, so each level waits on one barrier for all of them
+  auto blits = uploads | std::views::filter([](const auto& staged) { return staged.mode == MipMode::Blit; });
+  uint32_t levels = 1;
+  for (const auto& staged : blits)
+    levels = std::max(levels, staged.levels);
+
+  for (uint32_t level = 1; level < levels; ++level)
+  {
+    for (const auto& staged : blits)
+      if (level < staged.levels)
+      {
+        tracker.use(staged.image, { VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,  VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL }, level - 1, 1);
+        tracker.use(staged.image, { VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL }, level, 1);
+      }
+    tracker.flush(command_buffer);
+
+    for (const auto& staged : blits)
+    {
+      if (level >= staged.levels)
+        continue;
+      auto corner = [&](uint32_t level)
+      {
+        return VkOffset3D{ (int32_t)std::max(staged.extent.width >> level, 1u), (int32_t)std::max(staged.extent.height >> level, 1u), 1 };
+      };
+      VkImageBlit2 region
+      {
+        .sType          = VK_STRUCTURE_TYPE_IMAGE_BLIT_2,
+        .srcSubresource = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = level - 1, .layerCount = 1 },
+        .srcOffsets     = { VkOffset3D{ 0, 0, 0 }, corner(level - 1) },
+        .dstSubresource = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = level, .layerCount = 1 },
+        .dstOffsets     = { VkOffset3D{ 0, 0, 0 }, corner(level) },
+      };
+      VkBlitImageInfo2 info
+      {
+        .sType          = VK_STRUCTURE_TYPE_BLIT_IMAGE_INFO_2,
+        .srcImage       = staged.image,
+        .srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .dstImage       = staged.image,
+        .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .regionCount    = 1,
+        .pRegions       = &region,
+        .filter         = VK_FILTER_LINEAR,
+      };
+      vkCmdBlitImage2(command_buffer, &info);
+    }
+  }
+}
+
+void Textures::record_downsample(VkCommandBuffer command_buffer, Frame& frame, std::span<const Staged> uploads)
+{
+  std::vector<const Staged*> downsamples;
+  for (const auto& staged : uploads)
+    if (staged.mode == MipMode::Compute && staged.levels > 1)
+      downsamples.emplace_back(&staged);
+  if (downsamples.empty())
+    return;
+
+  // pool and zeroed counters of frame are created on first use, last workgroup of a dispatch
+  // resets its counter so they stay zeroed
+  if (frame.pool == VK_NULL_HANDLE)
+  {
+    std::array<VkDescriptorPoolSize, 2> sizes
+    {{
+      { .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  .descriptorCount = Max_Uploads * Max_Compute_Levels },
+      { .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = Max_Uploads },
+    }};
+    VkDescriptorPoolCreateInfo info
+    {
+      .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .maxSets       = Max_Uploads,
+      .poolSizeCount = (uint32_t)sizes.size(),
+      .pPoolSizes    = sizes.data(),
+    };
+    throw_if(vkCreateDescriptorPool(_device, &info, nullptr, &frame.pool) != VK_SUCCESS,
+             "failed to create mip descriptor pool");
+  }
+  if (frame.counters == VK_NULL_HANDLE)
+  {
+    VkBufferCreateInfo buffer_info
+    {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size  = Max_Uploads * sizeof(uint32_t),
+      .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    };
+    VmaAllocationCreateInfo alloc_info
+    {
+      .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+      .usage = VMA_MEMORY_USAGE_AUTO,
+    };
+    VmaAllocationInfo info;
+    throw_if(vmaCreateBuffer(_allocator, &buffer_info, &alloc_info, &frame.counters, &frame.counters_allocation, &info) != VK_SUCCESS,
+             "failed to create mip counters");
+    std::memset(info.pMappedData, 0, buffer_info.size);
+    vmaFlushAllocation(_allocator, frame.counters_allocation, 0, VK_WHOLE_SIZE);
+  }
+
+  std::vector<VkDescriptorSetLayout> layouts(downsamples.size(), _mip_set_layout);
+  std::vector<VkDescriptorSet>       sets(downsamples.size());
+  VkDescriptorSetAllocateInfo allocate_info
+  {
+    .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+    .descriptorPool     = frame.pool,
+    .descriptorSetCount = (uint32_t)sets.size(),
+    .pSetLayouts        = layouts.data(),
+  };
+  throw_if(vkAllocateDescriptorSets(_device, &allocate_info, sets.data()) != VK_SUCCESS,
+           "failed to allocate mip descriptor sets");
+
+  // views past smallest level repeat it, shader never writes them but they must be valid
+  VkDescriptorBufferInfo             counters{ frame.counters, 0, VK_WHOLE_SIZE };
+  std::vector<VkDescriptorImageInfo> infos;
+  std::vector<VkWriteDescriptorSet>  writes;
+  infos.reserve(downsamples.size() * Max_Compute_Levels);
+  for (uint32_t i = 0; i < downsamples.size(); ++i)
+  {
+    const auto& views = downsamples[i]->level_views;
+    for (uint32_t level = 0; level < Max_Compute_Levels; ++level)
+      infos.emplace_back(VkDescriptorImageInfo{ VK_NULL_HANDLE, views[std::min<size_t>(level, views.size() - 1)], VK_IMAGE_LAYOUT_GENERAL });
+    writes.emplace_back(VkWriteDescriptorSet
+    {
+      .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .dstSet          = sets[i],
+      .dstBinding      = 0,
+      .descriptorCount = Max_Compute_Levels,
+      .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+      .pImageInfo      = infos.data() + i * Max_Compute_Levels,
+    });
+    writes.emplace_back(VkWriteDescriptorSet
+    {
+      .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .dstSet          = sets[i],
+      .dstBinding      = 1,
+      .descriptorCount = 1,
+      .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .pBufferInfo     = &counters,
+    });
+  }
+  vkUpdateDescriptorSets(_device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+
+  // dispatches of different images are independent, nothing between them
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _mip_pipeline);
+  for (uint32_t i = 0; i < downsamples.size(); ++i)
+  {
+    const auto& staged = *downsamples[i];
+    MipConstants constants{ staged.levels, staged.srgb, i };
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _mip_pipeline_layout, 0, 1, &sets[i], 0, nullptr);
+    vkCmdPushConstants(command_buffer, _mip_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(command_buffer, (staged.extent.width + 63) / 64, (staged.extent.height + 63) / 64, 1);
+  }
+}
+
+void Textures::write_descriptors(VkDescriptorSet set, uint32_t binding, uint32_t frame)
+{
+  // slots not uploaded yet show white, which first frame uploads before any draw
+  std::vector<VkDescriptorImageInfo> infos;
+  std::vector<VkWriteDescriptorSet>  writes;
+  auto info = [&](uint32_t slot)
+  {
+    auto view = slot < _textures.size() && _textures[slot].view ? _textures[slot].view : _white;
+    infos.emplace_back(VkDescriptorImageInfo{ _sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+  };
+  auto write = [&](uint32_t slot, uint32_t count)
+  {
+    writes.emplace_back(VkWriteDescriptorSet
+    {
+      .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .dstSet          = set,
+      .dstBinding      = binding,
+      .dstArrayElement = slot,
+      .descriptorCount = count,
+      .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+    });
+  };
+
+  if (_written[frame] == (uint32_t)-1)
+  {
+    for (uint32_t slot = 0; slot < _capacity; ++slot)
+      info(slot);
+    write(0, _capacity);
+  }
+  else
+    for (auto i = _written[frame]; i < _uploaded.size(); ++i)
+    {
+      info(_uploaded[i]);
+      write(_uploaded[i], 1);
+    }
+  _written[frame] = (uint32_t)_uploaded.size();
+
+  // infos are complete, so writes can point into them
+  for (uint32_t i = 0, offset = 0; i < writes.size(); offset += writes[i++].descriptorCount)
+    writes[i].pImageInfo = infos.data() + offset;
+  if (!writes.empty())
+    vkUpdateDescriptorSets(_device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+}
+
+}
@@ -0,0 +1,131 @@
+/*===-- src/ThreadPool.cpp ----- Thread Pool ------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the thread pool.                                       *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace Util
+{
+
+ThreadPool::ThreadPool(uint32_t count)
+{
+  if (count == 0)
+    count = std::max(std::thread::hardware_concurrency(), 1u);
+  _workers.reserve(count);
+  for (uint32_t i = 0; i < count; ++i)
+    _workers.emplace_back([this] { work(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard lock(_mutex);
+    _stop = true;
+  }
+  _condition.notify_all();
+
+  // join before queue, mutex and condition are destroyed, workers still use them while draining
+  _workers.clear();
+}
+
+ThreadPool& ThreadPool::instance()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+void ThreadPool::push(std::function<void()> task)
+{
+  {
+    std::lock_guard lock(_mutex);
+    _tasks.emplace(std::move(task));
+  }
+  _condition.notify_one();
+}
+
+void ThreadPool::work()
+{
+  while (true)
+  {
+    std::function<void()> task;
+    {
+      std::unique_lock lock(_mutex);
+      _condition.wait(lock, [this] { return _stop || !_tasks.empty(); });
+      if (_stop && _tasks.empty())
+        return;
+      task = std::move(_tasks.front());
+      _tasks.pop();
+    }
+    task();
+  }
+}
+
+void ThreadPool::parallel_for(uint32_t count, const std::function<void(uint32_t)>& func)
+{
+  if (count == 0)
+    return;
+
+  // indices are claimed by caller and helper tasks from one counter, helpers starting
+  // after all are claimed return at once, so they never touch func after it returns
+  struct State
+  {
+    const std::function<void(uint32_t)>* func;
+    uint32_t                count;
+    std::atomic_uint32_t    next = 0;
+    std::atomic_uint32_t    done = 0;
+    std::mutex              mutex;
+    std::condition_variable condition;
+    std::exception_ptr      exception;
+  };
+  auto state   = std::make_shared<State>();
+  state->func  = &func;
+  state->count = count;
+
+  auto run = [](State& state)
+  {
+    for (uint32_t i; (i = state.next.fetch_add(1)) < state.count;)
+    {
+      try
+      {
+        (*state.func)(i);
+      }
+      catch (...)
+      {
+        std::lock_guard lock(state.mutex);
+        if (!state.exception)
+          state.exception = std::current_exception();
+      }
+      if (state.done.fetch_add(1) + 1 == state.count)
+      {
+        std::lock_guard lock(state.mutex);
+        state.condition.notify_all();
+      }
+    }
+  };
+
+  // caller takes a share too, nested calls progress even if every worker is busy
+  auto helpers = std::min(count - 1, size());
+  for (uint32_t i = 0; i < helpers; ++i)
+    push([state, run] { run(*state); });
+  run(*state);
+
+  // wait indices still running on workers before rethrow, they reference func
+  std::unique_lock lock(state->mutex);
+  state->condition.wait(lock, [&] { return state->done == state->count; });
+  if (state->exception)
+    std::rethrow_exception(state->exception);
+}
+
+}
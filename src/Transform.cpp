@@ -0,0 +1,156 @@
+/*===-- src/Transform.cpp ------ Transform Hierarchy ----------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the dirty propagation and reordering of the transform  *|
+|* hierarchy.                                                                 *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Transform.hpp"
+#include "Math.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <numeric>
+
+using Util::throw_if;
+
+namespace Scene
+{
+
+uint32_t Transforms::create(const glm::mat4& local, uint32_t parent)
+{
+  throw_if(parent != No_Parent && parent >= _index.size(), fmt::format("invalid parent transform {}", parent));
+
+  uint32_t id    = _index.size();
+  uint32_t index = _local.size();
+  _local.emplace_back(local);
+  _world.emplace_back(local);
+  _parent.emplace_back(parent == No_Parent ? No_Parent : _index[parent]);
+  _dirty.emplace_back();
+  _id.emplace_back(id);
+  _index.emplace_back(index);
+  mark_dirty(index);
+  return id;
+}
+
+void Transforms::set_local(uint32_t id, const glm::mat4& local)
+{
+  _local[_index[id]] = local;
+  mark_dirty(_index[id]);
+}
+
+void Transforms::set_parent(uint32_t id, uint32_t parent)
+{
+  auto index = _index[id];
+  if (parent == No_Parent)
+  {
+    _parent[index] = No_Parent;
+    mark_dirty(index);
+    return;
+  }
+
+  // walk up from new parent to reject cycle
+  auto parent_index = _index[parent];
+  for (auto i = parent_index; i != No_Parent; i = _parent[i])
+    throw_if(i == index, fmt::format("transform {} can't be parent of its ancestor {}", parent, id));
+
+  _parent[index] = parent_index;
+  mark_dirty(index);
+  if (parent_index > index)
+    sort();
+}
+
+void Transforms::sort()
+{
+  // children of each transform, roots are children of virtual node at count
+  auto count = size();
+  std::vector<uint32_t> offsets(count + 2), children(count);
+  for (auto parent : _parent)
+    ++offsets[(parent == No_Parent ? count : parent) + 1];
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  auto cursors = offsets;
+  for (uint32_t i = 0; i < count; ++i)
+    children[cursors[_parent[i] == No_Parent ? count : _parent[i]]++] = i;
+
+  // preorder, children keep their relative order
+  std::vector<uint32_t> order, stack{ count };
+  order.reserve(count);
+  while (!stack.empty())
+  {
+    auto node = stack.back();
+    stack.pop_back();
+    if (node != count)
+      order.emplace_back(node);
+    for (auto i = offsets[node + 1]; i-- > offsets[node];)
+      stack.emplace_back(children[i]);
+  }
+
+  std::vector<uint32_t> new_index(count);
+  for (uint32_t i = 0; i < count; ++i)
+    new_index[order[i]] = i;
+
+  auto permute = [&](auto& values)
+  {
+    std::remove_reference_t<decltype(values)> result(count);
+    for (uint32_t i = 0; i < count; ++i)
+      result[i] = values[order[i]];
+    values = std::move(result);
+  };
+  permute(_local);
+  permute(_world);
+  permute(_parent);
+  permute(_id);
+  for (auto& parent : _parent)
+    if (parent != No_Parent)
+      parent = new_index[parent];
+  for (uint32_t i = 0; i < count; ++i)
+    _index[_id[i]] = i;
+
+  // every world matrix may have moved, so all are rewritten by next update
+  std::ranges::fill(_dirty, true);
+  _first_dirty = 0;
+}
+
+auto Transforms::update() -> std::pair<uint32_t, uint32_t>
+{
+  auto count = size();
+  if (_first_dirty >= count)
+    return { 0, 0 };
+
+  // parent is visited before child, so dirty flag propagates down within the pass
+  auto first = _first_dirty, last = first;
+  auto changed = [&](uint32_t i) { return _dirty[i] || (_parent[i] != No_Parent && _dirty[_parent[i]]); };
+  for (auto i = first; i < count; ++i)
+  {
+    if (!changed(i))
+      continue;
+
+    // adjacent changed siblings are multiplied by their parent in one batch
+    auto parent = _parent[i];
+    auto end    = i + 1;
+    while (end < count && _parent[end] == parent && changed(end))
+      ++end;
+    if (parent == No_Parent)
+      std::copy(_local.begin() + i, _local.begin() + end, _world.begin() + i);
+    else if (end - i == 1)
+      _world[i] = _world[parent] * _local[i];
+    else
+      Math::multiply(_world[parent], std::span(_local).subspan(i, end - i), std::span(_world).subspan(i, end - i));
+    std::fill(_dirty.begin() + i, _dirty.begin() + end, 1);
+    last = end;
+    i    = end - 1;
+  }
+
+  std::fill(_dirty.begin() + first, _dirty.begin() + last, 0);
+  _first_dirty = No_Parent;
+  return { first, last };
+}
+
+}
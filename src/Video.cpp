@@ -0,0 +1,367 @@
+/*===-- src/Video.cpp ---------- Video ------------------------------------===*\
+|*                                                                            *|
+|* Copyright (c) 2025 Ma Yuncong                                              *|
+|* Licensed under the MIT License.                                            *|
+|*                                                                            *|
+|*===----------------------------------------------------------------------===*|
+|*                                                                            *|
+|* This file implement the YUV 4:2:0 conversion kernels and the Y4M writer.   *|
+|*                                                                            *|
+\*===----------------------------------------------------------------------===*/
+
+#include "Video.hpp"
+#include "Log.hpp"
+
+#include <fmt/format.h>
+
+#include <cstring>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define VIDEO_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define VIDEO_NEON 1
+#endif
+
+namespace
+{
+
+using Video::Isa;
+using Video::PixelOrder;
+
+/*
+ * BT.601 limited range in 8 bit fixed point,
+ * Y = (66R + 129G + 25B + 128) >> 8 + 16 and chroma likewise with signed weights.
+ * Chroma of a 2x2 block sums the weighted rounded vertical averages of its two
+ * columns, so every kernel produces the same bytes.
+ */
+
+struct Weights
+{
+  int r, g, b;
+};
+
+constexpr Weights Y_Weights = {  66,  129,  25 };
+constexpr Weights U_Weights = { -38,  -74, 112 };
+constexpr Weights V_Weights = { 112,  -94, -18 };
+
+/**
+ * Rows of a 2x2 block row, row1 equals row0 and luma1 is null for last row of odd height.
+ */
+struct RowPair
+{
+  const uint8_t* row0;
+  const uint8_t* row1;
+  uint8_t*       luma0;
+  uint8_t*       luma1;
+  uint8_t*       u;
+  uint8_t*       v;
+};
+
+auto dot(const uint8_t* pixel, Weights w, PixelOrder order)
+{
+  auto [r, b] = order == PixelOrder::BGRA ? std::pair{ pixel[2], pixel[0] } : std::pair{ pixel[0], pixel[2] };
+  return w.r * r + w.g * pixel[1] + w.b * b;
+}
+
+auto luma(const uint8_t* pixel, PixelOrder order)
+{
+  return (uint8_t)(((dot(pixel, Y_Weights, order) + 128) >> 8) + 16);
+}
+
+auto chroma(int sum)
+{
+  return (uint8_t)(((sum + 256) >> 9) + 128);
+}
+
+/**
+ * Convert columns from begin, which is even, to width.
+ */
+void convert_scalar(const RowPair& rows, uint32_t begin, uint32_t width, PixelOrder order)
+{
+  for (auto x = begin; x < width; ++x)
+  {
+    rows.luma0[x] = luma(rows.row0 + 4 * x, order);
+    if (rows.luma1)
+      rows.luma1[x] = luma(rows.row1 + 4 * x, order);
+  }
+
+  for (auto x = begin; x < width; x += 2)
+  {
+    // last column of odd width pairs with itself
+    int u = 0, v = 0;
+    for (auto column : { x, std::min(x + 1, width - 1) })
+    {
+      uint8_t average[4];
+      for (uint32_t c = 0; c < 3; ++c)
+        average[c] = (uint8_t)((rows.row0[4 * column + c] + rows.row1[4 * column + c] + 1) >> 1);
+      u += dot(average, U_Weights, order);
+      v += dot(average, V_Weights, order);
+    }
+    rows.u[x / 2] = chroma(u);
+    rows.v[x / 2] = chroma(v);
+  }
+}
+
+#ifdef VIDEO_X86
+
+/**
+ * Weights of four channels repeated for four pixels of 16 bit channels.
+ */
+__attribute__((target("avx2")))
+auto weights_avx2(Weights w, PixelOrder order)
+{
+  auto [first, last] = order == PixelOrder::BGRA ? std::pair{ w.b, w.r } : std::pair{ w.r, w.b };
+  return _mm256_set1_epi64x((int64_t)(uint16_t)first | (int64_t)(uint16_t)w.g << 16 | (int64_t)(uint16_t)last << 32);
+}
+
+/**
+ * Weighted sums of 8 pixels in order 0, 1, 4, 5, 2, 3, 6, 7.
+ */
+__attribute__((target("avx2")))
+auto dot_avx2(__m256i pixels, __m256i weights)
+{
+  auto low  = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(pixels));
+  auto high = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(pixels, 1));
+  return _mm256_hadd_epi32(_mm256_madd_epi16(low, weights), _mm256_madd_epi16(high, weights));
+}
+
+__attribute__((target("avx2")))
+void luma_avx2(__m256i pixels, __m256i weights, uint8_t* luma)
+{
+  auto y = _mm256_srai_epi32(_mm256_add_epi32(dot_avx2(pixels, weights), _mm256_set1_epi32(128)), 8);
+  y = _mm256_permutevar8x32_epi32(_mm256_add_epi32(y, _mm256_set1_epi32(16)), _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7));
+  auto words = _mm_packus_epi32(_mm256_castsi256_si128(y), _mm256_extracti128_si256(y, 1));
+  _mm_storel_epi64((__m128i*)luma, _mm_packus_epi16(words, words));
+}
+
+/**
+ * Convert 8 pixels at a time, return first column left.
+ */
+__attribute__((target("avx2")))
+uint32_t convert_avx2(const RowPair& rows, uint32_t width, PixelOrder order)
+{
+  auto y_weights = weights_avx2(Y_Weights, order);
+  auto u_weights = weights_avx2(U_Weights, order);
+  auto v_weights = weights_avx2(V_Weights, order);
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8)
+  {
+    auto pixels0 = _mm256_loadu_si256((const __m256i*)(rows.row0 + 4 * x));
+    auto pixels1 = _mm256_loadu_si256((const __m256i*)(rows.row1 + 4 * x));
+    luma_avx2(pixels0, y_weights, rows.luma0 + x);
+    if (rows.luma1)
+      luma_avx2(pixels1, y_weights, rows.luma1 + x);
+
+    // pairs summed from order 0, 1, 4, 5, 2, 3, 6, 7 leave u01, u45, v01, v45, u23, u67, v23, v67
+    auto average = _mm256_avg_epu8(pixels0, pixels1);
+    auto sums = _mm256_hadd_epi32(dot_avx2(average, u_weights), dot_avx2(average, v_weights));
+    sums = _mm256_permutevar8x32_epi32(sums, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+    sums = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(sums, _mm256_set1_epi32(256)), 9), _mm256_set1_epi32(128));
+    auto words = _mm_packus_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+    auto bytes = _mm_packus_epi16(words, words);
+    auto u = _mm_cvtsi128_si32(bytes), v = _mm_extract_epi32(bytes, 1);
+    std::memcpy(rows.u + x / 2, &u, 4);
+    std::memcpy(rows.v + x / 2, &v, 4);
+  }
+  return x;
+}
+
+#endif
+
+#ifdef VIDEO_NEON
+
+auto luma_neon(uint8x8x4_t pixels, uint32_t r, uint32_t b)
+{
+  auto y = vmull_u8(pixels.val[r], vdup_n_u8(Y_Weights.r));
+  y = vmlal_u8(y, pixels.val[1], vdup_n_u8(Y_Weights.g));
+  y = vmlal_u8(y, pixels.val[b], vdup_n_u8(Y_Weights.b));
+  return vadd_u8(vshrn_n_u16(vaddq_u16(y, vdupq_n_u16(128)), 8), vdup_n_u8(16));
+}
+
+/**
+ * Sums of weighted column pairs, starting from the positive weight keeps 16 bit partial sums within 112 * 255.
+ */
+auto chroma_neon(int16x8_t r, int16x8_t g, int16x8_t b, Weights w)
+{
+  auto sum = w.b > 0 ? vmulq_n_s16(b, w.b) : vmulq_n_s16(r, w.r);
+  sum = vmlaq_n_s16(sum, g, w.g);
+  sum = w.b > 0 ? vmlaq_n_s16(sum, r, w.r) : vmlaq_n_s16(sum, b, w.b);
+  auto pairs = vshrq_n_s32(vaddq_s32(vpaddlq_s16(sum), vdupq_n_s32(256)), 9);
+  return vmovn_s32(vaddq_s32(pairs, vdupq_n_s32(128)));
+}
+
+/**
+ * Convert 8 pixels at a time, return first column left.
+ */
+uint32_t convert_neon(const RowPair& rows, uint32_t width, PixelOrder order)
+{
+  auto [r, b] = order == PixelOrder::BGRA ? std::pair{ 2u, 0u } : std::pair{ 0u, 2u };
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8)
+  {
+    auto pixels0 = vld4_u8(rows.row0 + 4 * x);
+    auto pixels1 = vld4_u8(rows.row1 + 4 * x);
+    vst1_u8(rows.luma0 + x, luma_neon(pixels0, r, b));
+    if (rows.luma1)
+      vst1_u8(rows.luma1 + x, luma_neon(pixels1, r, b));
+
+    auto average = [&](uint32_t c) { return vreinterpretq_s16_u16(vmovl_u8(vrhadd_u8(pixels0.val[c], pixels1.val[c]))); };
+    auto red = average(r), green = average(1), blue = average(b);
+    auto bytes = vqmovun_s16(vcombine_s16(chroma_neon(red, green, blue, U_Weights), chroma_neon(red, green, blue, V_Weights)));
+    vst1_lane_u32((uint32_t*)(rows.u + x / 2), vreinterpret_u32_u8(bytes), 0);
+    vst1_lane_u32((uint32_t*)(rows.v + x / 2), vreinterpret_u32_u8(bytes), 1);
+  }
+  return x;
+}
+
+#endif
+
+}
+
+namespace Video
+{
+
+void convert_yuv420(std::span<const std::byte> pixels, uint32_t width, uint32_t height, PixelOrder order,
+                    std::span<uint8_t> result, Isa isa)
+{
+  Util::throw_if(pixels.size() != (size_t)width * height * 4,
+                 fmt::format("{} bytes are not {}x{} pixels", pixels.size(), width, height));
+  Util::throw_if(result.size() != get_yuv420_size(width, height),
+                 fmt::format("{} bytes are not YUV 4:2:0 of {}x{}", result.size(), width, height));
+
+  auto chroma_width = (width + 1) / 2;
+  auto u = result.data() + (size_t)width * height;
+  auto v = u + (size_t)chroma_width * ((height + 1) / 2);
+  auto source = reinterpret_cast<const uint8_t*>(pixels.data());
+  for (uint32_t y = 0; y < height; y += 2)
+  {
+    auto last = y + 1 == height;
+    RowPair rows
+    {
+      .row0  = source + (size_t)y * width * 4,
+      .row1  = source + (size_t)(last ? y : y + 1) * width * 4,
+      .luma0 = result.data() + (size_t)y * width,
+      .luma1 = last ? nullptr : result.data() + (size_t)(y + 1) * width,
+      .u     = u + (size_t)y / 2 * chroma_width,
+      .v     = v + (size_t)y / 2 * chroma_width,
+    };
+
+    uint32_t x = 0;
+#ifdef VIDEO_X86
+    if (isa == Isa::AVX2)
+      x = convert_avx2(rows, width, order);
+#endif
+#ifdef VIDEO_NEON
+    if (isa == Isa::NEON)
+      x = convert_neon(rows, width, order);
+#endif
+    convert_scalar(rows, x, width, order);
+  }
+}
+
+Y4mWriter::Y4mWriter(std::string_view path, uint32_t width, uint32_t height, uint32_t fps, PixelOrder order, uint32_t capacity)
+  : _output(&std::cout),
+    _width(width),
+    _height(height),
+    _order(order),
+    _capacity(capacity)
+{
+  Util::throw_if(width == 0 || height == 0, fmt::format("invalid video size {}x{}", width, height));
+  Util::throw_if(fps == 0, "frame rate of video must be positive");
+  Util::throw_if(capacity == 0, "video queue must hold at least one frame");
+
+  if (path != "-")
+  {
+    _file.open(std::string(path), std::ios::binary | std::ios::trunc);
+    Util::throw_if(!_file, fmt::format("failed to open video file {}", path));
+    _output = &_file;
+  }
+
+  // C420jpeg sites chroma at center of each 2x2 block, as averaging does
+  *_output << fmt::format("YUV4MPEG2 W{} H{} F{}:1 Ip A1:1 C420jpeg\n", width, height, fps);
+  Util::throw_if(!*_output, fmt::format("failed to write video header to {}", path));
+
+  _thread = std::jthread([this] { write(); });
+}
+
+Y4mWriter::~Y4mWriter()
+{
+  {
+    std::lock_guard lock(_mutex);
+    _stop = true;
+  }
+  _queued.notify_one();
+  _thread.join();
+  _output->flush();
+  Log::info(fmt::format("recorded {} frames", frames()));
+}
+
+void Y4mWriter::push(std::span<const std::byte> pixels)
+{
+  Util::throw_if(pixels.size() != (size_t)_width * _height * 4,
+                 fmt::format("{} bytes are not a {}x{} video frame", pixels.size(), _width, _height));
+  if (_failed.load(std::memory_order_relaxed))
+    return;
+
+  // copy outside of lock, so writer can take queued frames meanwhile
+  std::vector<std::byte> frame;
+  {
+    std::lock_guard lock(_mutex);
+    if (!_free.empty())
+    {
+      frame = std::move(_free.back());
+      _free.pop_back();
+    }
+  }
+  frame.assign(pixels.begin(), pixels.end());
+
+  {
+    std::unique_lock lock(_mutex);
+    _freed.wait(lock, [this] { return _queue.size() < _capacity; });
+    _queue.push_back(std::move(frame));
+  }
+  _queued.notify_one();
+}
+
+void Y4mWriter::write()
+{
+  std::vector<uint8_t> yuv(get_yuv420_size(_width, _height));
+  while (true)
+  {
+    std::vector<std::byte> frame;
+    {
+      std::unique_lock lock(_mutex);
+      _queued.wait(lock, [this] { return _stop || !_queue.empty(); });
+      if (_queue.empty())
+        return;
+      frame = std::move(_queue.front());
+      _queue.pop_front();
+    }
+    _freed.notify_one();
+
+    // after a failed write the queue is still drained, so push never blocks forever
+    if (!_failed.load(std::memory_order_relaxed))
+    {
+      convert_yuv420(frame, _width, _height, _order, yuv);
+      _output->write("FRAME\n", 6);
+      _output->write(reinterpret_cast<const char*>(yuv.data()), yuv.size());
+      if (*_output)
+        _written.fetch_add(1, std::memory_order_relaxed);
+      else
+      {
+        Log::error(fmt::format("failed to write video frame {}, recording stopped", frames()));
+        _failed.store(true, std::memory_order_relaxed);
+      }
+    }
+
+    std::lock_guard lock(_mutex);
+    _free.push_back(std::move(frame));
+  }
+}
+
+}
@@ -10,7 +10,16 @@
 \*===----------------------------------------------------------------------===*/
 
 #include "Vulkan.hpp"
+#include "Batch.hpp"
 #include "Log.hpp"
+#include "Mesh.hpp"
+#include "Culling.hpp"
+#include "Gltf.hpp"
+#include "ImageTracker.hpp"
+#include "Math.hpp"
+#include "MeshCache.hpp"
+#include "ThreadPool.hpp"
+#include "Util.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -19,9 +28,13 @@
 #include <stdexcept>
 #include <map>
 #include <ranges>
+#include <algorithm>
 #include <set>
 #include <fstream>
 #include <chrono>
+#include <limits>
+#include <cmath>
+#include <bit>
 
 namespace
 {
@@ -30,10 +43,7 @@ using namespace Vulkan;
 
 uint32_t Vulkan_Version = -1;
 
-inline auto throw_if(bool b, std::string_view msg)
-{
-  if (b) throw std::runtime_error(msg.data());
-}
+using Util::throw_if;
 
 auto to_vk_app_info(const ApplicationInfo& info)
 {
@@ -56,6 +66,13 @@ auto check_create_info(const VulkanCreateInfo& info)
   throw_if(info.height <= 0, "height of window is invalid value!");
   throw_if(info.title.empty(), "title not specified!");
   throw_if(!info.app_info.has_value() && info.app_info->app_version == -1, "vulkan api version not specified!");
+  throw_if(info.samples == 0 || info.samples > 8 || !std::has_single_bit(info.samples),
+           fmt::format("invalid sample count {}, must be 1, 2, 4 or 8", info.samples));
+  throw_if(info.target_frame_time < 0.f, fmt::format("invalid target frame time {}", info.target_frame_time));
+  throw_if(info.target_frame_time > 0.f && !(0.f < info.min_render_scale && info.min_render_scale <= info.max_render_scale && info.max_render_scale <= 2.f),
+           fmt::format("invalid render scale bounds [{}, {}], must be in (0, 2]", info.min_render_scale, info.max_render_scale));
+  throw_if(!info.record.empty() && info.readback_scene, "recording needs presented images, which readback scene replaces");
+  throw_if(!info.record.empty() && info.record_fps == 0, "frame rate of recording must be positive");
 }
 
 auto get_supported_instance_layers()
@@ -356,6 +373,65 @@ auto get_surface_format(const std::vector<VkSurfaceFormatKHR>& formats)
   return formats[0];
 }
 
+/**
+ * Get fastest depth format usable as attachment and sampled by Hi-Z downsample.
+ * 32-bit float is native depth of desktop GPUs, packed 24-bit takes the same memory,
+ * 16-bit loses precision, formats with stencil are last since stencil is unused.
+ */
+auto get_depth_format(VkPhysicalDevice device)
+{
+  constexpr VkFormat Candidates[] =
+  {
+    VK_FORMAT_D32_SFLOAT,
+    VK_FORMAT_X8_D24_UNORM_PACK32,
+    VK_FORMAT_D16_UNORM,
+    VK_FORMAT_D24_UNORM_S8_UINT,
+    VK_FORMAT_D32_SFLOAT_S8_UINT,
+  };
+  constexpr VkFormatFeatureFlags Features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+  for (auto format : Candidates)
+  {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(device, format, &properties);
+    if ((properties.optimalTilingFeatures & Features) == Features)
+      return format;
+  }
+  throw std::runtime_error("failed to find supported depth format");
+}
+
+/**
+ * Get highest sample count not above requested one that both color and depth attachments support.
+ *
+ * @param device  physical device.
+ * @param samples requested sample count.
+ * @return sample count.
+ */
+auto get_sample_count(VkPhysicalDevice device, uint32_t samples)
+{
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(device, &properties);
+  auto supported = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+  while (samples > 1 && !(supported & samples))
+    samples >>= 1;
+  return (VkSampleCountFlagBits)samples;
+}
+
+/**
+ * Scale extent, each side is at least one pixel.
+ *
+ * @param extent extent.
+ * @param scale  scale.
+ * @return scaled extent.
+ */
+auto scale_extent(VkExtent2D extent, float scale) -> VkExtent2D
+{
+  return
+  {
+    .width  = std::max((uint32_t)std::lround(extent.width  * scale), 1u),
+    .height = std::max((uint32_t)std::lround(extent.height * scale), 1u),
+  };
+}
+
 auto get_present_mode(const std::vector<VkPresentModeKHR>& present_modes)
 {
   auto it = std::find_if(present_modes.begin(), present_modes.end(),
@@ -430,63 +506,69 @@ private:
   VkDevice _device;
 };
 
-struct Vertex
+auto check_vertex_layout_support(VkPhysicalDevice device, const Mesh::VertexLayout& layout)
 {
-  glm::vec2 position;
-  glm::vec3 color;
-
-  static constexpr auto get_attribute_descriptions() -> std::array<VkVertexInputAttributeDescription, 2>
+  VkFormatProperties properties;
+  for (const auto& attribute : layout.attributes)
   {
-    return
-    {
-      VkVertexInputAttributeDescription
-      {
-        .location = 0,
-        .binding  = 0,
-        .format   = VK_FORMAT_R32G32_SFLOAT,
-        .offset   = offsetof(Vertex, position),
-      },
-      VkVertexInputAttributeDescription
-      {
-        .location = 1,
-        .binding  = 0,
-        .format   = VK_FORMAT_R32G32B32_SFLOAT,
-        .offset   = offsetof(Vertex, color),
-      },
-    };
+    vkGetPhysicalDeviceFormatProperties(device, attribute.format, &properties);
+    throw_if(!(properties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT),
+             fmt::format("unsupported vertex format {}", (uint32_t)attribute.format));
   }
+}
 
-  static constexpr auto get_binding_description()
-  {
-    return VkVertexInputBindingDescription
-    {
-      .binding   = 0,
-      .stride    = sizeof(Vertex),
-      .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-    };
-  }
+/**
+ * Get offset of each vertex stream in geometry buffer.
+ */
+auto get_stream_offsets(const Mesh::PackedLayout& packed, uint32_t vertex_count)
+{
+  std::vector<VkDeviceSize> offsets;
+  for (uint32_t binding = 0; binding < packed.strides.size(); ++binding)
+    offsets.emplace_back(packed.get_stream_offset(binding, vertex_count));
+  return offsets;
+}
+
+/**
+ * Get box around bounding sphere, as BVH of submeshes stores boxes.
+ */
+auto get_sphere_bounds(const glm::vec4& sphere)
+{
+  return Mesh::Bounds{ glm::vec3(sphere) - sphere.w, glm::vec3(sphere) + sphere.w };
+}
 
+struct UniformBufferObject
+{
+  alignas(16) glm::mat4 view;
+  alignas(16) glm::mat4 proj;
+  alignas(16) glm::mat4 model_view;     ///< view of draw bounding spheres, only read by occlusion test
+  alignas(16) uint32_t  instance_count; ///< inverse world matrices follow this many clip matrices in instance buffer
 };
 
-const std::vector<Vertex> Vertices =
+/**
+ * Push constant of occlusion test.
+ */
+struct OcclusionConstants
 {
-  { { -.5f, -.5f }, { 1.f, 0.f, 0.f } },
-  { {  .5f, -.5f }, { 0.f, 1.f, 0.f } },
-  { {  .5f,  .5f }, { 0.f, 0.f, 1.f } },
-  { { -.5f,  .5f }, { 1.f, 1.f, 1.f } },
+  glm::vec2 extent; ///< render extent in pixels
+  uint32_t  phase;
 };
 
-const std::vector<uint16_t> Indices =
+/**
+ * Push constant of draws, texture is only read by color pass.
+ */
+struct DrawConstants
 {
-  0, 1, 2,
-  0, 2, 3,
+  uint32_t instance; ///< index of clip matrix in instance buffer, inverse world matrix is instance_count after it
+  uint32_t texture;  ///< slot of base color texture
 };
 
-struct UniformBufferObject
+/**
+ * Push constant of Hi-Z downsample.
+ */
+struct HizConstants
 {
-  alignas(16) glm::mat4 model;
-  alignas(16) glm::mat4 view;
-  alignas(16) glm::mat4 proj;
+  glm::ivec2 extent; ///< valid area of level below, rendered area of depth for level 0
+  uint32_t   level;
 };
 
 }
@@ -495,8 +577,23 @@ namespace Vulkan
 {
 
 Vulkan::Vulkan(const VulkanCreateInfo& info)
+  : _target_frame_time(info.target_frame_time),
+    _min_render_scale(info.min_render_scale),
+    _max_render_scale(info.max_render_scale),
+    _readback_callback(info.readback),
+    _readback_scene(info.readback_scene),
+    _record(info.record),
+    _record_fps(info.record_fps),
+    _mesh_filename(info.mesh),
+    _optimize_mesh(info.optimize_mesh),
+    _vertex_format(info.vertex_format),
+    _max_lods(info.max_lods),
+    _lod_error(info.lod_error),
+    _depth_prepass(info.depth_prepass)
 {
   check_create_info(info);
+  if (_record == "-")
+    Log::use_stderr();
   init_window(info.width, info.height, info.title);
   init_vulkan(info);
 }
@@ -509,27 +606,51 @@ Vulkan::~Vulkan()
     vkDestroySemaphore(_device, _render_finished_semaphores[i], nullptr);
     vkDestroyFence(_device, _in_flight_fences[i], nullptr);
   }
+  vkDestroyQueryPool(_device, _timestamp_pool, nullptr);
 
   vkDestroyDescriptorPool(_device, _descriptor_pool, nullptr);
 
+  vmaDestroyBuffer(_vma_allocator, _visibility_buffer, _visibility_buffer_allocation);
+  for (uint32_t i = 0; i < Max_Frame_Number; ++i)
+  {
+    vmaDestroyBuffer(_vma_allocator, _sphere_buffers[i], _sphere_buffer_allocations[i]);
+    vmaDestroyBuffer(_vma_allocator, _indirect_buffers[i], _indirect_buffer_allocations[i]);
+  }
+
   for (uint32_t i = 0; i < Max_Frame_Number; ++i)
     vkDestroyBuffer(_device, _uniform_buffers[i], nullptr);
   vkFreeMemory(_device, _uniform_buffers_memory, nullptr);
 
-  vmaDestroyBuffer(_vma_allocator, _index_buffer, _index_buffer_allocation);
-  vmaDestroyBuffer(_vma_allocator, _vertex_buffer, _vertex_buffer_allocation);
+  for (uint32_t i = 0; i < Max_Frame_Number; ++i)
+    vmaDestroyBuffer(_vma_allocator, _instance_buffers[i], _instance_buffer_allocations[i]);
+
+  vmaDestroyBuffer(_vma_allocator, _geometry_buffer, _geometry_buffer_allocation);
 
   vkDestroyCommandPool(_device, _command_pool, nullptr);
 
-  for (auto framebuffer : _swapchain_framebuffers)
-    vkDestroyFramebuffer(_device, framebuffer, nullptr);
-
   vkDestroyPipelineLayout(_device, _pipeline_layout, nullptr);
-  vkDestroyPipeline(_device, _pipeline, nullptr);
+  for (const auto& [layout, pipeline] : _pipelines)
+    vkDestroyPipeline(_device, pipeline, nullptr);
+  for (const auto& [layout, pipeline] : _depth_pipelines)
+    vkDestroyPipeline(_device, pipeline, nullptr);
+  for (auto pipeline : _prepass_pipelines)
+    vkDestroyPipeline(_device, pipeline, nullptr);
+  vkDestroyPipeline(_device, _hiz_pipeline, nullptr);
+  vkDestroyPipeline(_device, _occlusion_pipeline, nullptr);
+  vkDestroyPipelineLayout(_device, _hiz_pipeline_layout, nullptr);
+  vkDestroyPipelineLayout(_device, _occlusion_pipeline_layout, nullptr);
 
   vkDestroyDescriptorSetLayout(_device, _descriptor_set_layout, nullptr);
+  vkDestroyDescriptorSetLayout(_device, _hiz_descriptor_set_layout, nullptr);
+  vkDestroyDescriptorSetLayout(_device, _occlusion_descriptor_set_layout, nullptr);
 
-  vkDestroyRenderPass(_device, _render_pass, nullptr);
+  vkDestroySampler(_device, _hiz_sampler, nullptr);
+  for (auto view : _hiz_level_views)
+    vkDestroyImageView(_device, view, nullptr);
+  _graph.reset();
+  _readback.reset();
+  _recorder.reset();
+  _textures.reset();
 
   for (auto view : _swapchain_image_views)
     vkDestroyImageView(_device, view, nullptr);
@@ -570,15 +691,19 @@ void Vulkan::init_vulkan(const VulkanCreateInfo& info)
   create_surface();
   select_physical_device();
   create_logical_device();
+  create_timestamp_pool();
   create_swapchain();
   create_image_views();
-  create_render_pass();
+  if (!_record.empty())
+    create_recorder();
+  _samples = get_sample_count(_physical_device, info.samples);
+  create_depth_resources();
   create_destriptor_set_layout();
   create_pipeline();
-  create_framebuffer();
   create_command_pool();
   create_command_buffers();
   create_buffers();
+  create_render_graph();
   create_descriptor_pool();
   create_descriptor_sets();
   create_sync_objects();
@@ -692,13 +817,53 @@ void Vulkan::create_logical_device()
       .pQueuePriorities = &priority,
     });
 
-  // TODO: currently empty
-  VkPhysicalDeviceFeatures features{};
+  // submeshes of static batch are drawn by one indirect call if supported,
+  // fragment shader indexes texture array by push constant,
+  // block compressed texture formats are enabled where supported
+  VkPhysicalDeviceFeatures supported_features;
+  vkGetPhysicalDeviceFeatures(_physical_device, &supported_features);
+  throw_if(!supported_features.shaderSampledImageArrayDynamicIndexing,
+           "device doesn't support dynamic indexing of sampled image arrays");
+  VkPhysicalDeviceFeatures features
+  {
+    .multiDrawIndirect                      = supported_features.multiDrawIndirect,
+    .textureCompressionETC2                 = supported_features.textureCompressionETC2,
+    .textureCompressionASTC_LDR             = supported_features.textureCompressionASTC_LDR,
+    .textureCompressionBC                   = supported_features.textureCompressionBC,
+    .shaderSampledImageArrayDynamicIndexing = VK_TRUE,
+  };
+  if (features.multiDrawIndirect)
+  {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(_physical_device, &properties);
+    _max_draw_indirect_count = properties.limits.maxDrawIndirectCount;
+  }
+
+  // render graph records passes with dynamic rendering and synchronization2 barriers
+  VkPhysicalDeviceVulkan13Features supported_features13
+  {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+  };
+  VkPhysicalDeviceFeatures2 supported_features2
+  {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+    .pNext = &supported_features13,
+  };
+  vkGetPhysicalDeviceFeatures2(_physical_device, &supported_features2);
+  throw_if(!supported_features13.synchronization2 || !supported_features13.dynamicRendering,
+           "device doesn't support synchronization2 or dynamic rendering");
+  VkPhysicalDeviceVulkan13Features features13
+  {
+    .sType            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+    .synchronization2 = VK_TRUE,
+    .dynamicRendering = VK_TRUE,
+  };
 
   // device info 
   VkDeviceCreateInfo create_info
   {
     .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+    .pNext = &features13,
     .queueCreateInfoCount = (uint32_t)queue_infos.size(),
     .pQueueCreateInfos = queue_infos.data(),
     .enabledExtensionCount = (uint32_t)Device_Extensions.size(),
@@ -734,6 +899,15 @@ void Vulkan::create_swapchain()
   auto present_mode = get_present_mode(details.present_modes);
   auto extent = get_swap_extent(details.capabilities, _window);
   uint32_t image_count = details.capabilities.minImageCount + 1;
+
+  // scaled scene is blitted to swapchain, readback copies from it
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  if (_target_frame_time > 0.f)
+    usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  if (_readback_callback)
+    usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  throw_if((details.capabilities.supportedUsageFlags & usage) != usage,
+           "swapchain doesn't support usage of transfers");
   if (details.capabilities.maxImageCount > 0 &&
       image_count > details.capabilities.maxImageCount)
     image_count = details.capabilities.maxImageCount;
@@ -747,7 +921,7 @@ void Vulkan::create_swapchain()
     .imageColorSpace = surface_format.colorSpace,
     .imageExtent = extent,
     .imageArrayLayers = 1,
-    .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+    .imageUsage = usage,
     .preTransform = details.capabilities.currentTransform,
     .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
     .presentMode = present_mode,
@@ -810,110 +984,541 @@ void Vulkan::create_image_views()
   }
 }
 
-void Vulkan::create_render_pass()
-{
-  VkAttachmentDescription color_attachment
+void Vulkan::create_recorder()
+{
+  Video::PixelOrder order;
+  switch (_swapchain_image_format)
+  {
+  case VK_FORMAT_B8G8R8A8_UNORM:
+  case VK_FORMAT_B8G8R8A8_SRGB:
+    order = Video::PixelOrder::BGRA;
+    break;
+  case VK_FORMAT_R8G8B8A8_UNORM:
+  case VK_FORMAT_R8G8B8A8_SRGB:
+    order = Video::PixelOrder::RGBA;
+    break;
+  default:
+    throw_if(true, fmt::format("can not record swapchain format {}", (int)_swapchain_image_format));
+    return;
+  }
+  _recorder = std::make_unique<Video::Y4mWriter>(_record, _swapchain_image_extent.width, _swapchain_image_extent.height,
+                                                  _record_fps, order);
+
+  // recorder copies frames out of readback buffers, conversion and writing run on its thread
+  _readback_callback = [callback = std::move(_readback_callback), recorder = _recorder.get()](const ReadbackFrame& frame)
   {
-    .format         = _swapchain_image_format,
-    .samples        = VK_SAMPLE_COUNT_1_BIT,
-    .loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR,
-    .storeOp        = VK_ATTACHMENT_STORE_OP_STORE,
-    .stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-    .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-    .initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED,
-    .finalLayout    = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+    if (callback)
+      callback(frame);
+    recorder->push(frame.data);
   };
+  Log::info(fmt::format("recording {}x{} at {}fps to {}", _swapchain_image_extent.width, _swapchain_image_extent.height,
+                        _record_fps, _record == "-" ? "standard output" : _record));
+}
+
+void Vulkan::create_timestamp_pool()
+{
+  // without dynamic resolution scene is rendered at window resolution
+  if (_target_frame_time == 0.f)
+  {
+    _min_render_scale = _max_render_scale = 1.f;
+    return;
+  }
+
+  // frame time is measured on graphics queue, resolution stays at highest scale if it has no timestamps
+  auto family = get_queue_family_indices(_physical_device, _surface).graphics_family.value();
+  uint32_t count;
+  vkGetPhysicalDeviceQueueFamilyProperties(_physical_device, &count, nullptr);
+  std::vector<VkQueueFamilyProperties> families(count);
+  vkGetPhysicalDeviceQueueFamilyProperties(_physical_device, &count, families.data());
+  auto bits = families[family].timestampValidBits;
+  if (bits == 0)
+  {
+    Log::info("graphics queue has no timestamps, render scale is fixed");
+    _min_render_scale = _max_render_scale;
+    return;
+  }
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(_physical_device, &properties);
+  _timestamp_period = properties.limits.timestampPeriod;
+  _timestamp_mask   = bits >= 64 ? ~0ull : (1ull << bits) - 1;
 
-  VkAttachmentReference attach_reference
+  VkQueryPoolCreateInfo info
   {
-    .attachment = 0,
-    .layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    .sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+    .queryType  = VK_QUERY_TYPE_TIMESTAMP,
+    .queryCount = 2 * Max_Frame_Number,
   };
+  throw_if(vkCreateQueryPool(_device, &info, nullptr, &_timestamp_pool) != VK_SUCCESS,
+           "failed to create query pool");
+}
 
-  VkSubpassDescription subpass
+void Vulkan::create_depth_resources()
+{
+  // images are created by render graph, depth is sampled by downsample of Hi-Z pyramid
+  _depth_format = get_depth_format(_physical_device);
+
+  // scene images are allocated for highest scale, rendering starts there
+  _render_scale      = _max_render_scale;
+  _max_render_extent = scale_extent(_swapchain_image_extent, _max_render_scale);
+  _render_extent     = _max_render_extent;
+
+  // texel of level 0 covers 2x2 pixels, power of two extent halves exactly down to 1x1
+  _hiz_extent =
   {
-    .pipelineBindPoint    = VK_PIPELINE_BIND_POINT_GRAPHICS,
-    .colorAttachmentCount = 1,
-    .pColorAttachments    = &attach_reference,
+    .width  = std::bit_ceil((_max_render_extent.width  + 1) / 2),
+    .height = std::bit_ceil((_max_render_extent.height + 1) / 2),
+  };
+  _hiz_levels = std::bit_width(std::max(_hiz_extent.width, _hiz_extent.height));
+
+  // shaders only fetch texels, sampler is required by sampled image descriptors
+  VkSamplerCreateInfo sampler_info
+  {
+    .sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+    .magFilter    = VK_FILTER_NEAREST,
+    .minFilter    = VK_FILTER_NEAREST,
+    .mipmapMode   = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+    .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    .maxLod       = VK_LOD_CLAMP_NONE,
   };
+  throw_if(vkCreateSampler(_device, &sampler_info, nullptr, &_hiz_sampler) != VK_SUCCESS,
+           "failed to create sampler");
+}
 
-  VkSubpassDependency dependency 
+void Vulkan::create_render_graph()
+{
+  auto queue_families = get_queue_family_indices(_physical_device, _surface);
+  _graph = std::make_unique<RenderGraph>(_device, _vma_allocator, queue_families.graphics_family.value(), Max_Frame_Number);
+  auto& graph = *_graph;
+
+  // swapchain image is acquired before color output, visibility and commands persist across frames
+  _swapchain_resource = graph.import_image("swapchain", _swapchain_image_format, _swapchain_image_extent,
+    { .stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, .layout = VK_IMAGE_LAYOUT_UNDEFINED },
+    { .layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR });
+  auto visibility = graph.import_buffer("visibility");
+  auto commands   = graph.import_buffer("indirect commands");
+
+  _depth_resource = graph.create_image("depth",
+  {
+    .format = _depth_format,
+    .extent = _max_render_extent,
+    .usage  = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+  });
+  _hiz_resource = graph.create_image("hiz",
+  {
+    .format = VK_FORMAT_R32_SFLOAT,
+    .extent = _hiz_extent,
+    .levels = _hiz_levels,
+    .usage  = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+  });
+
+  constexpr Access Indirect_Read
+  {
+    .stage  = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+    .access = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+  };
+  VkClearValue depth_clear
   {
-    .srcSubpass    = VK_SUBPASS_EXTERNAL,
-    .dstSubpass    = 0,
-    .srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-    .dstStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-    .srcAccessMask = 0,
-    .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+    .depthStencil = { .depth = 1.f },
   };
 
-  VkRenderPassCreateInfo create_info
+  // phase one draws depth of what phase two of last frame found visible
+  graph.add_pass("occlusion phase one", [this](VkCommandBuffer command_buffer)
+  {
+    record_occlusion(command_buffer, 0);
+  })
+  .read(visibility, { .stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT })
+  .write(commands, { .stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, .access = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT });
+
+  graph.add_pass("occlusion depth", [this](VkCommandBuffer command_buffer)
+  {
+    record_draw_state(command_buffer);
+    record_draws(command_buffer, _visible_draws, 0, DrawPass::Occlusion);
+  })
+  .read(commands, Indirect_Read)
+  .depth({ .image = _depth_resource, .clear = depth_clear })
+  .render_area(&_render_extent);
+
+  // phase two tests draws against depth of phase one
+  graph.add_pass("hiz", [this](VkCommandBuffer command_buffer)
+  {
+    record_hiz(command_buffer);
+  })
+  .read(_depth_resource,
+  {
+    .stage  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    .access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+    .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+  })
+  .write(_hiz_resource,
+  {
+    .stage  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+    .layout = VK_IMAGE_LAYOUT_GENERAL,
+  });
+
+  graph.add_pass("occlusion phase two", [this](VkCommandBuffer command_buffer)
   {
-    .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-    .attachmentCount = 1,
-    .pAttachments    = &color_attachment,
-    .subpassCount    = 1,
-    .pSubpasses      = &subpass,
-    .dependencyCount = 1,
-    .pDependencies   = &dependency,
+    record_occlusion(command_buffer, 1);
+  })
+  .read(_hiz_resource,
+  {
+    .stage  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    .access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+    .layout = VK_IMAGE_LAYOUT_GENERAL,
+  })
+  .write(visibility,
+  {
+    .stage  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+  })
+  .write(commands, { .stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, .access = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT });
+
+  // main pass shades both phases, multisampled depth has no depth of phase one and needs its prepass too
+  auto& main = graph.add_pass("main", [this](VkCommandBuffer command_buffer)
+  {
+    record_draw_state(command_buffer);
+    if (_depth_prepass)
+    {
+      if (_samples != VK_SAMPLE_COUNT_1_BIT)
+        record_draws(command_buffer, _visible_draws, 0, DrawPass::Prepass);
+      record_draws(command_buffer, _visible_draws, 1, DrawPass::Prepass);
+    }
+    record_draws(command_buffer, _visible_draws, 0, DrawPass::Color);
+    record_draws(command_buffer, _visible_draws, 1, DrawPass::Color);
+  });
+  main.read(commands, Indirect_Read)
+      .render_area(&_render_extent);
+
+  // with dynamic resolution scene is rendered to its own image and blitted to swapchain
+  auto target = _swapchain_resource;
+  if (_target_frame_time > 0.f)
+  {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(_physical_device, _swapchain_image_format, &properties);
+    auto features = properties.optimalTilingFeatures;
+    throw_if(!(features & VK_FORMAT_FEATURE_BLIT_SRC_BIT) || !(features & VK_FORMAT_FEATURE_BLIT_DST_BIT),
+             "swapchain format doesn't support blit");
+    _upscale_filter = features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+    _scene_resource = target = graph.create_image("scene color",
+    {
+      .format = _swapchain_image_format,
+      .extent = _max_render_extent,
+      .usage  = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+    });
+  }
+
+  VkClearValue color_clear
+  {
+    .color = { (float)32/255, (float)33/255, (float)36/255, 1.f },
   };
+  if (_samples == VK_SAMPLE_COUNT_1_BIT)
+  {
+    main.color({ .image = target, .clear = color_clear })
+        .depth({ .image = _depth_resource, .load = VK_ATTACHMENT_LOAD_OP_LOAD, .store = VK_ATTACHMENT_STORE_OP_DONT_CARE });
+  }
+  else
+  {
+    // multisampled attachments are never stored, color is resolved to target at end of rendering
+    auto color = graph.create_image("msaa color",
+    {
+      .format  = _swapchain_image_format,
+      .extent  = _max_render_extent,
+      .samples = _samples,
+      .usage   = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+    });
+    auto depth = graph.create_image("msaa depth",
+    {
+      .format  = _depth_format,
+      .extent  = _max_render_extent,
+      .samples = _samples,
+      .usage   = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+    });
+    main.color({ .image = color, .store = VK_ATTACHMENT_STORE_OP_DONT_CARE, .clear = color_clear, .resolve = target })
+        .depth({ .image = depth, .store = VK_ATTACHMENT_STORE_OP_DONT_CARE, .clear = depth_clear });
+  }
+
+  if (_target_frame_time > 0.f)
+  {
+    graph.add_pass("upscale", [this](VkCommandBuffer command_buffer)
+    {
+      record_upscale(command_buffer);
+    })
+    .read(_scene_resource,
+    {
+      .stage  = VK_PIPELINE_STAGE_2_BLIT_BIT,
+      .access = VK_ACCESS_2_TRANSFER_READ_BIT,
+      .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+    })
+    .write(_swapchain_resource,
+    {
+      .stage  = VK_PIPELINE_STAGE_2_BLIT_BIT,
+      .access = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+      .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    });
+  }
+
+  // readback writes its ring buffer, which is imported so the pass is never culled
+  if (_readback_callback)
+  {
+    auto source = _readback_scene && _target_frame_time > 0.f ? _scene_resource : _swapchain_resource;
+    auto extent = source == _swapchain_resource ? _swapchain_image_extent : _max_render_extent;
+    auto buffer = graph.import_buffer("readback");
+    _readback   = std::make_unique<Readback>(_vma_allocator, _swapchain_image_format, extent, Max_Frame_Number, _readback_callback);
+    graph.add_pass("readback", [this, source](VkCommandBuffer command_buffer)
+    {
+      record_readback(command_buffer, source);
+    })
+    .read(source,
+    {
+      .stage  = VK_PIPELINE_STAGE_2_COPY_BIT,
+      .access = VK_ACCESS_2_TRANSFER_READ_BIT,
+      .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+    })
+    .write(buffer, { .stage = VK_PIPELINE_STAGE_2_COPY_BIT, .access = VK_ACCESS_2_TRANSFER_WRITE_BIT });
+  }
+
+  graph.compile();
 
-  throw_if(vkCreateRenderPass(_device, &create_info, nullptr, &_render_pass) != VK_SUCCESS,
-           "failed to create render pass");
+  for (uint32_t level = 0; level < _hiz_levels; ++level)
+  {
+    VkImageViewCreateInfo info
+    {
+      .sType    = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .image    = graph.image(_hiz_resource),
+      .viewType = VK_IMAGE_VIEW_TYPE_2D,
+      .format   = VK_FORMAT_R32_SFLOAT,
+      .subresourceRange =
+      {
+        .aspectMask   = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel = level,
+        .levelCount   = 1,
+        .layerCount   = 1,
+      },
+    };
+    throw_if(vkCreateImageView(_device, &info, nullptr, &_hiz_level_views.emplace_back()) != VK_SUCCESS,
+             "failed to create image view");
+  }
 }
 
 void Vulkan::create_destriptor_set_layout()
 {
-  VkDescriptorSetLayoutBinding layout
-  {
-    .binding         = 0,
-    .descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-    .descriptorCount = 1,
-    .stageFlags      = VK_SHADER_STAGE_VERTEX_BIT,
-  };
+  // texture array is bounded by samplers a stage and a set may access, fragment stage has no other one
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(_physical_device, &properties);
+  const auto& limits = properties.limits;
+  _texture_capacity = std::min({ Max_Textures, limits.maxPerStageDescriptorSamplers, limits.maxPerStageDescriptorSampledImages,
+                                 limits.maxDescriptorSetSamplers, limits.maxDescriptorSetSampledImages });
+
+  // camera uniform, matrices of instances and base color textures
+  std::array<VkDescriptorSetLayoutBinding, 3> layouts
+  {{
+    {
+      .binding         = 0,
+      .descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+      .descriptorCount = 1,
+      .stageFlags      = VK_SHADER_STAGE_VERTEX_BIT,
+    },
+    {
+      .binding         = 1,
+      .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = 1,
+      .stageFlags      = VK_SHADER_STAGE_VERTEX_BIT,
+    },
+    {
+      .binding         = 2,
+      .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      .descriptorCount = _texture_capacity,
+      .stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT,
+    },
+  }};
 
   VkDescriptorSetLayoutCreateInfo info
   {
     .sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-    .bindingCount = 1,
-    .pBindings    = &layout,
+    .bindingCount = (uint32_t)layouts.size(),
+    .pBindings    = layouts.data(),
   };
 
   throw_if(vkCreateDescriptorSetLayout(_device, &info, nullptr, &_descriptor_set_layout) != VK_SUCCESS,
            "failed to create descriptor set layout");
+
+  // Hi-Z downsample reads depth or level below and writes one level
+  std::array<VkDescriptorSetLayoutBinding, 3> hiz_layouts
+  {{
+    { .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+    { .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+    { .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+  }};
+  info.bindingCount = (uint32_t)hiz_layouts.size();
+  info.pBindings    = hiz_layouts.data();
+  throw_if(vkCreateDescriptorSetLayout(_device, &info, nullptr, &_hiz_descriptor_set_layout) != VK_SUCCESS,
+           "failed to create descriptor set layout");
+
+  // occlusion test reads camera, spheres and pyramid, writes visibility and indirect commands
+  std::array<VkDescriptorSetLayoutBinding, 5> occlusion_layouts
+  {{
+    { .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+    { .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+    { .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+    { .binding = 3, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+    { .binding = 4, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+  }};
+  info.bindingCount = (uint32_t)occlusion_layouts.size();
+  info.pBindings    = occlusion_layouts.data();
+  throw_if(vkCreateDescriptorSetLayout(_device, &info, nullptr, &_occlusion_descriptor_set_layout) != VK_SUCCESS,
+           "failed to create descriptor set layout");
 }
 
 void Vulkan::create_pipeline()
 {
-  // shader stages
+  // pipeline layout, the instance index and texture slot of draw are push constants
+  VkPushConstantRange push_constant
+  {
+    .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+    .offset     = 0,
+    .size       = sizeof(DrawConstants),
+  };
+  VkPipelineLayoutCreateInfo layout_info
+  {
+    .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+    .setLayoutCount         = 1,
+    .pSetLayouts            = &_descriptor_set_layout,
+    .pushConstantRangeCount = 1,
+    .pPushConstantRanges    = &push_constant,
+  };
+  throw_if(vkCreatePipelineLayout(_device, &layout_info, nullptr, &_pipeline_layout) != VK_SUCCESS,
+           "failed to create pipeline layout");
+
+  // compute pipelines of occlusion culling, level of downsample and phase of test are push constants
+  push_constant =
+  {
+    .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+    .offset     = 0,
+    .size       = sizeof(HizConstants),
+  };
+  layout_info.pSetLayouts = &_hiz_descriptor_set_layout;
+  throw_if(vkCreatePipelineLayout(_device, &layout_info, nullptr, &_hiz_pipeline_layout) != VK_SUCCESS,
+           "failed to create pipeline layout");
+
+  push_constant.size      = sizeof(OcclusionConstants);
+  layout_info.pSetLayouts = &_occlusion_descriptor_set_layout;
+  throw_if(vkCreatePipelineLayout(_device, &layout_info, nullptr, &_occlusion_pipeline_layout) != VK_SUCCESS,
+           "failed to create pipeline layout");
+
+  _hiz_pipeline       = create_compute_pipeline("shader/hiz.spv", _hiz_pipeline_layout);
+  _occlusion_pipeline = create_compute_pipeline("shader/occlusion.spv", _occlusion_pipeline_layout);
+}
+
+auto Vulkan::create_compute_pipeline(std::string_view filename, VkPipelineLayout layout) -> VkPipeline
+{
+  Shader shader(_device, filename);
+  VkComputePipelineCreateInfo info
+  {
+    .sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+    .stage  =
+    {
+      .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+      .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+      .module = shader.shader,
+      .pName  = "main",
+    },
+    .layout = layout,
+  };
+
+  VkPipeline pipeline;
+  throw_if(vkCreateComputePipelines(_device, VK_NULL_HANDLE, 1, &info, nullptr, &pipeline) != VK_SUCCESS,
+           fmt::format("failed to create compute pipeline from {}", filename));
+  return pipeline;
+}
+
+auto Vulkan::get_pipeline(const Mesh::VertexLayout& layout, bool depth_only) -> uint32_t
+{
+  // depth only layouts get pipelines of occlusion pass and of prepass at the same index
+  auto& pipelines = depth_only ? _depth_pipelines : _pipelines;
+  auto it = std::ranges::find(pipelines, layout, &decltype(_pipelines)::value_type::first);
+  if (it != pipelines.end())
+    return it - pipelines.begin();
+  if (depth_only)
+  {
+    pipelines.emplace_back(layout, create_graphics_pipeline(layout, DrawPass::Occlusion));
+    _prepass_pipelines.emplace_back(_depth_prepass ? create_graphics_pipeline(layout, DrawPass::Prepass) : VK_NULL_HANDLE);
+  }
+  else
+    pipelines.emplace_back(layout, create_graphics_pipeline(layout, DrawPass::Color));
+  return pipelines.size() - 1;
+}
+
+auto Vulkan::create_graphics_pipeline(const Mesh::VertexLayout& layout, DrawPass pass) -> VkPipeline
+{
+  // shader stages, depth only pipeline has no fragment shader
+  auto depth_only = pass != DrawPass::Color;
   std::vector<VkPipelineShaderStageCreateInfo> shader_stages;
 
-  Shader vertex_shader(_device, "shader/vertex.spv");
-  Shader fragment_shader(_device, "shader/fragment.spv");
+  Shader vertex_shader(_device, depth_only ? "shader/depth.spv" : "shader/vertex.spv");
+  std::optional<Shader> fragment_shader;
 
+  // whether normals are octahedral is specialization constant 0 of vertex shader
+  auto normal = std::ranges::find(layout.attributes, 2u, &VkVertexInputAttributeDescription::location);
+  VkBool32 octahedral = normal != layout.attributes.end() &&
+                        (normal->format == VK_FORMAT_R16G16_SNORM || normal->format == VK_FORMAT_R8G8_SNORM);
+  VkSpecializationMapEntry octahedral_entry
+  {
+    .constantID = 0,
+    .offset     = 0,
+    .size       = sizeof(VkBool32),
+  };
+  VkSpecializationInfo vertex_specialization
+  {
+    .mapEntryCount = 1,
+    .pMapEntries   = &octahedral_entry,
+    .dataSize      = sizeof(VkBool32),
+    .pData         = &octahedral,
+  };
   VkPipelineShaderStageCreateInfo shader_info
   {
     .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
     .stage = VK_SHADER_STAGE_VERTEX_BIT,
     .module = vertex_shader.shader,
     .pName = "main",
+    .pSpecializationInfo = depth_only ? nullptr : &vertex_specialization,
   };
   shader_stages.emplace_back(shader_info);
 
-  shader_info.stage  = VK_SHADER_STAGE_FRAGMENT_BIT;
-  shader_info.module = fragment_shader.shader;
-  shader_stages.emplace_back(shader_info);
+  // size of texture array is specialization constant 0 of fragment shader
+  VkSpecializationMapEntry texture_count
+  {
+    .constantID = 0,
+    .offset     = 0,
+    .size       = sizeof(uint32_t),
+  };
+  VkSpecializationInfo specialization
+  {
+    .mapEntryCount = 1,
+    .pMapEntries   = &texture_count,
+    .dataSize      = sizeof(uint32_t),
+    .pData         = &_texture_capacity,
+  };
+  if (!depth_only)
+  {
+    fragment_shader.emplace(_device, "shader/fragment.spv");
+    shader_info.stage               = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shader_info.module              = fragment_shader->shader;
+    shader_info.pSpecializationInfo = &specialization;
+    shader_stages.emplace_back(shader_info);
+  }
 
   // vertex input info
-  auto binding_desc = Vertex::get_binding_description();
-  auto attribute_descs = Vertex::get_attribute_descriptions();
   VkPipelineVertexInputStateCreateInfo vertex_input_info
   {
     .sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-    .vertexBindingDescriptionCount   = 1,
-    .pVertexBindingDescriptions      = &binding_desc,
-    .vertexAttributeDescriptionCount = (uint32_t)attribute_descs.size(),
-    .pVertexAttributeDescriptions    = attribute_descs.data(),
+    .vertexBindingDescriptionCount   = (uint32_t)layout.bindings.size(),
+    .pVertexBindingDescriptions      = layout.bindings.data(),
+    .vertexAttributeDescriptionCount = (uint32_t)layout.attributes.size(),
+    .pVertexAttributeDescriptions    = layout.attributes.data(),
   };
 
   // input assembly
@@ -949,26 +1554,37 @@ void Vulkan::create_pipeline()
   VkPipelineMultisampleStateCreateInfo multisample_state
   {
     .sType                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-    .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+    .rasterizationSamples = pass == DrawPass::Occlusion ? VK_SAMPLE_COUNT_1_BIT : _samples,
     .sampleShadingEnable  = VK_FALSE,
     .minSampleShading     = 1.f,
   };
 
+  // depth, after prepass color pipelines only shade the nearest surface and don't write it,
+  // otherwise they pass on equal depth since main pass without MSAA already has depth of phase one
+  auto after_prepass = _depth_prepass && !depth_only;
+  VkPipelineDepthStencilStateCreateInfo depth_stencil
+  {
+    .sType            = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+    .depthTestEnable  = VK_TRUE,
+    .depthWriteEnable = after_prepass ? VK_FALSE : VK_TRUE,
+    .depthCompareOp   = after_prepass ? VK_COMPARE_OP_EQUAL : depth_only ? VK_COMPARE_OP_LESS : VK_COMPARE_OP_LESS_OR_EQUAL,
+  };
+
   // color blend
   VkPipelineColorBlendAttachmentState color_blend_attachment
   {
     .blendEnable = VK_FALSE,
-    .colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
-                      VK_COLOR_COMPONENT_G_BIT |
-                      VK_COLOR_COMPONENT_B_BIT |
-                      VK_COLOR_COMPONENT_A_BIT,
+    .colorWriteMask = depth_only ? 0u : VK_COLOR_COMPONENT_R_BIT |
+                                        VK_COLOR_COMPONENT_G_BIT |
+                                        VK_COLOR_COMPONENT_B_BIT |
+                                        VK_COLOR_COMPONENT_A_BIT,
   };
   VkPipelineColorBlendStateCreateInfo color_blend
   {
     .sType           = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
     .logicOpEnable   = VK_FALSE,
     .logicOp         = VK_LOGIC_OP_COPY,
-    .attachmentCount = 1,
+    .attachmentCount = pass == DrawPass::Occlusion ? 0u : 1u,
     .pAttachments    = &color_blend_attachment,
   };
 
@@ -985,57 +1601,38 @@ void Vulkan::create_pipeline()
     .pDynamicStates    = dynamics.data(),
   };
 
-  // pipeline layout
-  VkPipelineLayoutCreateInfo layout_info
+  // formats of attachments of pass, occlusion pass has only depth
+  VkPipelineRenderingCreateInfo rendering
   {
-    .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-    .setLayoutCount = 1,
-    .pSetLayouts    = &_descriptor_set_layout,
+    .sType                   = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+    .colorAttachmentCount    = pass == DrawPass::Occlusion ? 0u : 1u,
+    .pColorAttachmentFormats = &_swapchain_image_format,
+    .depthAttachmentFormat   = _depth_format,
   };
-  throw_if(vkCreatePipelineLayout(_device, &layout_info, nullptr, &_pipeline_layout) != VK_SUCCESS,
-           "failed to create pipeline layout");
 
   VkGraphicsPipelineCreateInfo create_info
   {
     .sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-    .stageCount          = 2,
+    .pNext               = &rendering,
+    .stageCount          = (uint32_t)shader_stages.size(),
     .pStages             = shader_stages.data(),
     .pVertexInputState   = &vertex_input_info,
     .pInputAssemblyState = &input_assembly,
     .pViewportState      = &viewport_state,
     .pRasterizationState = &rasterization_state,
     .pMultisampleState   = &multisample_state,
+    .pDepthStencilState  = &depth_stencil,
     .pColorBlendState    = &color_blend,
     .pDynamicState       = &dynamic,
     .layout              = _pipeline_layout,
-    .renderPass          = _render_pass,
-    .subpass             = 0,
     .basePipelineHandle  = VK_NULL_HANDLE,
     .basePipelineIndex   = -1,
   };
 
-  throw_if(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &create_info, nullptr, &_pipeline) != VK_SUCCESS,
+  VkPipeline pipeline;
+  throw_if(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline) != VK_SUCCESS,
            "failed to create pipeline");
-}
-
-void Vulkan::create_framebuffer()
-{
-  _swapchain_framebuffers.resize(_swapchain_images.size());
-  for (uint32_t i = 0; i < _swapchain_images.size(); ++i)
-  {
-    VkFramebufferCreateInfo info
-    {
-      .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-      .renderPass = _render_pass,
-      .attachmentCount = 1,
-      .pAttachments    = &_swapchain_image_views[i],
-      .width           = _swapchain_image_extent.width,
-      .height          = _swapchain_image_extent.height,
-      .layers          = 1,
-    };
-    throw_if(vkCreateFramebuffer(_device, &info, nullptr, &_swapchain_framebuffers[i]) != VK_SUCCESS,
-            "failed to create framebuffer");
-  }
+  return pipeline;
 }
 
 void Vulkan::create_command_pool()
@@ -1066,17 +1663,21 @@ void Vulkan::create_command_buffers()
 
 void Vulkan::create_descriptor_pool()
 {
-  VkDescriptorPoolSize size
-  {
-    .type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-    .descriptorCount = Max_Frame_Number,
-  };
+  // graphics and occlusion test sets per frame, downsample set per Hi-Z level,
+  // graphics sets hold whole texture array
+  std::array<VkDescriptorPoolSize, 4> sizes
+  {{
+    { .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         .descriptorCount = Max_Frame_Number * 2 },
+    { .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         .descriptorCount = Max_Frame_Number * 4 },
+    { .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = Max_Frame_Number * (_texture_capacity + 1) + _hiz_levels },
+    { .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          .descriptorCount = _hiz_levels * 2 },
+  }};
   VkDescriptorPoolCreateInfo info
   {
     .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-    .maxSets       = Max_Frame_Number,
-    .poolSizeCount = 1,
-    .pPoolSizes    = &size,
+    .maxSets       = Max_Frame_Number * 2 + _hiz_levels,
+    .poolSizeCount = (uint32_t)sizes.size(),
+    .pPoolSizes    = sizes.data(),
   };
   throw_if(vkCreateDescriptorPool(_device, &info, nullptr, &_descriptor_pool) != VK_SUCCESS,
            "failed to create descriptor pool");
@@ -1095,23 +1696,78 @@ void Vulkan::create_descriptor_sets()
   throw_if(vkAllocateDescriptorSets(_device, &info, _descriptor_sets.data()) != VK_SUCCESS,
            "failed to create descriptor sets");
 
-  std::array<VkWriteDescriptorSet, Max_Frame_Number> writes;
-  for (uint32_t i = 0; i < Max_Frame_Number; ++i)
+  layouts.assign(Max_Frame_Number, _occlusion_descriptor_set_layout);
+  throw_if(vkAllocateDescriptorSets(_device, &info, _occlusion_descriptor_sets.data()) != VK_SUCCESS,
+           "failed to create descriptor sets");
+
+  _hiz_descriptor_sets.resize(_hiz_levels);
+  layouts.assign(_hiz_levels, _hiz_descriptor_set_layout);
+  info.descriptorSetCount = _hiz_levels;
+  throw_if(vkAllocateDescriptorSets(_device, &info, _hiz_descriptor_sets.data()) != VK_SUCCESS,
+           "failed to create descriptor sets");
+
+  // infos are reserved so writes can point into them
+  std::vector<VkDescriptorBufferInfo> buffer_infos;
+  std::vector<VkDescriptorImageInfo>  image_infos;
+  std::vector<VkWriteDescriptorSet>   writes;
+  buffer_infos.reserve(Max_Frame_Number * 6);
+  image_infos.reserve(Max_Frame_Number + _hiz_levels * 3);
+  auto write_buffer = [&](VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize range)
   {
-    VkDescriptorBufferInfo info
+    buffer_infos.emplace_back(VkDescriptorBufferInfo
     {
-      .buffer = _uniform_buffers[i],
-      .range  = sizeof(UniformBufferObject),
-    };
-    writes[i] = VkWriteDescriptorSet
+      .buffer = buffer,
+      .range  = range,
+    });
+    writes.emplace_back(VkWriteDescriptorSet
     {
       .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-      .dstSet          = _descriptor_sets[i],
-      .dstBinding      = 0,
+      .dstSet          = set,
+      .dstBinding      = binding,
       .descriptorCount = 1,
-      .descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-      .pBufferInfo     = &info,
-    };
+      .descriptorType  = type,
+      .pBufferInfo     = &buffer_infos.back(),
+    });
+  };
+  auto write_image = [&](VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkImageView view, VkImageLayout layout)
+  {
+    image_infos.emplace_back(VkDescriptorImageInfo
+    {
+      .sampler     = _hiz_sampler,
+      .imageView   = view,
+      .imageLayout = layout,
+    });
+    writes.emplace_back(VkWriteDescriptorSet
+    {
+      .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .dstSet          = set,
+      .dstBinding      = binding,
+      .descriptorCount = 1,
+      .descriptorType  = type,
+      .pImageInfo      = &image_infos.back(),
+    });
+  };
+
+  for (uint32_t i = 0; i < Max_Frame_Number; ++i)
+  {
+    write_buffer(_descriptor_sets[i], 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, _uniform_buffers[i], sizeof(UniformBufferObject));
+    write_buffer(_descriptor_sets[i], 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _instance_buffers[i], VK_WHOLE_SIZE);
+
+    auto set = _occlusion_descriptor_sets[i];
+    write_buffer(set, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, _uniform_buffers[i], sizeof(UniformBufferObject));
+    write_buffer(set, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _sphere_buffers[i], VK_WHOLE_SIZE);
+    write_buffer(set, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _visibility_buffer, VK_WHOLE_SIZE);
+    write_buffer(set, 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _indirect_buffers[i], VK_WHOLE_SIZE);
+    write_image(set, 4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _graph->view(_hiz_resource), VK_IMAGE_LAYOUT_GENERAL);
+  }
+
+  // level 0 reads depth, source of it is unused but must be valid
+  for (uint32_t level = 0; level < _hiz_levels; ++level)
+  {
+    auto set = _hiz_descriptor_sets[level];
+    write_image(set, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _graph->view(_depth_resource), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    write_image(set, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, _hiz_level_views[level == 0 ? 0 : level - 1], VK_IMAGE_LAYOUT_GENERAL);
+    write_image(set, 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, _hiz_level_views[level], VK_IMAGE_LAYOUT_GENERAL);
   }
   vkUpdateDescriptorSets(_device, writes.size(), writes.data(), 0, nullptr);
 }
@@ -1148,6 +1804,11 @@ void Vulkan::run()
   }
 
   vkDeviceWaitIdle(_device);
+
+  // images of last frames are delivered oldest first
+  if (_readback)
+    for (uint32_t i = 0; i < Max_Frame_Number; ++i)
+      _readback->deliver((_current_frame + i) % Max_Frame_Number);
 }
 
 void Vulkan::update_uniform_buffers(uint32_t current_frame)
@@ -1157,11 +1818,60 @@ void Vulkan::update_uniform_buffers(uint32_t current_frame)
   float time = std::chrono::duration<float, std::chrono::seconds::period>(current_time - start_time).count();
 
   UniformBufferObject ubo;
-  ubo.model = glm::rotate(glm::mat4(1.f), time * glm::radians(90.f), glm::vec3(0.f, 0.f, 1.f));
   ubo.view  = glm::lookAt(glm::vec3(2.f, 2.f, 2.f), glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 0.f, 1.f));
   ubo.proj  = glm::perspective(glm::radians(45.f), _swapchain_image_extent.width / (float)_swapchain_image_extent.height, 1.f, 10.f);
   ubo.proj[1][1] *= -1;
 
+  // rotating model moves every draw, only changed world matrices are written
+  _transforms.set_local(_model_transform, glm::rotate(glm::mat4(1.f), time * glm::radians(90.f), glm::vec3(0.f, 0.f, 1.f)));
+  auto [first, last] = _transforms.update();
+  if (first < last)
+  {
+    for (auto& [begin, end] : _instance_dirty)
+    {
+      begin = begin < end ? std::min(begin, first) : first;
+      end   = std::max(end, last);
+    }
+    refit_submeshes(first, last);
+  }
+
+  // clip matrices are premultiplied by view projection, so vertex shaders transform by one matrix,
+  // all of them are rewritten when camera changed since last use of frame,
+  // inverse world matrices transform normals as row vectors, which is by their transpose
+  auto view_projection = ubo.proj * ubo.view;
+  auto count           = _transforms.size();
+  if (view_projection != _instance_view_projections[current_frame])
+  {
+    _instance_view_projections[current_frame] = view_projection;
+    _instance_dirty[current_frame]            = { 0, count };
+  }
+  if (auto& [begin, end] = _instance_dirty[current_frame]; begin < end)
+  {
+    auto mapped = static_cast<glm::mat4*>(_instance_buffers_mapped[current_frame]);
+    auto worlds = _transforms.worlds().subspan(begin, end - begin);
+    auto size   = worlds.size_bytes();
+    Math::multiply(view_projection, worlds, { mapped + begin, worlds.size() });
+    Math::inverse_affine(worlds, { mapped + count + begin, worlds.size() });
+    vmaFlushAllocation(_vma_allocator, _instance_buffer_allocations[current_frame], begin * sizeof(glm::mat4), size);
+    vmaFlushAllocation(_vma_allocator, _instance_buffer_allocations[current_frame], (count + begin) * sizeof(glm::mat4), size);
+    begin = end = 0;
+  }
+  if (auto& [begin, end] = _sphere_dirty[current_frame]; begin < end)
+  {
+    auto spheres = static_cast<glm::vec4*>(_sphere_buffers_mapped[current_frame]);
+    std::ranges::transform(std::span(_submeshes).subspan(begin, end - begin), spheres + begin, &Submesh::sphere);
+    vmaFlushAllocation(_vma_allocator, _sphere_buffer_allocations[current_frame], begin * sizeof(glm::vec4), (end - begin) * sizeof(glm::vec4));
+    begin = end = 0;
+  }
+
+  // scale of model view is the longest axis, error of LOD is projected by vertical focal length
+  _camera_view       = ubo.view * _transforms.world(_model_transform);
+  _camera_projection = ubo.proj;
+  auto scale = std::max({ glm::length(glm::vec3(_camera_view[0])), glm::length(glm::vec3(_camera_view[1])), glm::length(glm::vec3(_camera_view[2])) });
+  _camera_pixel_scale = scale * std::abs(ubo.proj[1][1]) * _render_extent.height * 0.5f;
+  ubo.model_view      = _camera_view;
+  ubo.instance_count  = count;
+
   // TODO: use vma to presently mapped, and vma's copy memory function
   memcpy(_uniform_buffers_mapped[current_frame], &ubo, sizeof(ubo));
 }
@@ -1170,12 +1880,18 @@ void Vulkan::draw()
 {
   // TODO: use frame resources to replace every xxx[_current_frame]
 
-  update_uniform_buffers(_current_frame);
-
+  // buffers of frame are rewritten only after GPU finished reading them
   vkWaitForFences(_device, 1, &_in_flight_fences[_current_frame], VK_TRUE, UINT64_MAX);
 
-  uint32_t image_index;
-  throw_if(vkAcquireNextImageKHR(_device, _swapchain, UINT64_MAX, _image_available_semaphores[_current_frame], VK_NULL_HANDLE, &image_index) != VK_SUCCESS,
+  // slot of frame was copied to by its last submission
+  if (_readback)
+    _readback->deliver(_current_frame);
+
+  update_render_extent();
+  update_uniform_buffers(_current_frame);
+
+  uint32_t image_index;
+  throw_if(vkAcquireNextImageKHR(_device, _swapchain, UINT64_MAX, _image_available_semaphores[_current_frame], VK_NULL_HANDLE, &image_index) != VK_SUCCESS,
            "failed to acquire swap chain image");
 
   vkResetFences(_device, 1, &_in_flight_fences[_current_frame]);
@@ -1213,8 +1929,41 @@ void Vulkan::draw()
            "failed to present swapchain image");
 
   _current_frame = ++_current_frame % Max_Frame_Number;
+  ++_frame_number;
 }
     
+void Vulkan::update_render_extent()
+{
+  // fence of frame was waited, so timestamps of its last submission are available
+  if (!_timestamp_pool || !_timestamps_written[_current_frame])
+    return;
+  std::array<uint64_t, 2> ticks;
+  if (vkGetQueryPoolResults(_device, _timestamp_pool, 2 * _current_frame, 2, sizeof(ticks), ticks.data(), sizeof(uint64_t),
+                            VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+    return;
+  auto time = ((ticks[1] - ticks[0]) & _timestamp_mask) * _timestamp_period * 1e-6f;
+
+  // average of recent frames ignores single slow frames
+  _gpu_frame_time = _gpu_frame_time == 0.f ? time : std::lerp(_gpu_frame_time, time, 0.1f);
+
+  // GPU time is about proportional to pixels, so scale follows square root of time ratio,
+  // band around target and bounded steps keep resolution from oscillating
+  auto ratio = _target_frame_time / _gpu_frame_time;
+  if (ratio > 0.95f && ratio < 1.1f)
+    return;
+  auto scale = std::clamp(_render_scale * std::clamp(std::sqrt(ratio), 0.9f, 1.05f), _min_render_scale, _max_render_scale);
+
+  // average is moved to expected time at new scale, so it doesn't keep reacting to frames of old one
+  _gpu_frame_time *= (scale * scale) / (_render_scale * _render_scale);
+  _render_scale    = scale;
+  auto extent      = scale_extent(_swapchain_image_extent, _render_scale);
+  _render_extent   =
+  {
+    .width  = std::min(extent.width,  _max_render_extent.width),
+    .height = std::min(extent.height, _max_render_extent.height),
+  };
+}
+
 void Vulkan::record_command_buffer(VkCommandBuffer command_buffer, uint32_t image_index)
 {
   VkCommandBufferBeginInfo begin
@@ -1224,34 +1973,77 @@ void Vulkan::record_command_buffer(VkCommandBuffer command_buffer, uint32_t imag
   throw_if(vkBeginCommandBuffer(command_buffer, &begin) != VK_SUCCESS,
            "failed to begin command buffer");
 
-  VkClearValue clear
+  // GPU time of frame drives dynamic resolution
+  if (_timestamp_pool)
   {
-    (float)32/255,
-    (float)33/255,
-    (float)36/255,
-    1.f,
-  };
-  VkRenderPassBeginInfo render_pass_begin_info
-  {
-    .sType       = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-    .renderPass  = _render_pass,
-    .framebuffer = _swapchain_framebuffers[image_index],
-    .renderArea  =
+    vkCmdResetQueryPool(command_buffer, _timestamp_pool, 2 * _current_frame, 2);
+    vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, _timestamp_pool, 2 * _current_frame);
+  }
+
+  // textures decoded so far are uploaded ahead of every pass, set of frame is not in use and sees them at once
+  _textures->upload(command_buffer, _current_frame);
+  _textures->write_descriptors(_descriptor_sets[_current_frame], 2, _current_frame);
+
+  // frustum in model space, same as bounding spheres of submeshes,
+  // submeshes of a draw are adjacent, so visible ones are sorted to group them by draw
+  auto frustum = Culling::extract_frustum(_camera_projection * _camera_view);
+  _visible_submeshes.clear();
+  _submesh_bvh.cull(frustum, _visible_submeshes);
+  std::ranges::sort(_visible_submeshes);
+
+  // host writes LOD ranges of both phases, compute writes their instance counts,
+  // culled submeshes of visible draws keep empty commands
+  auto commands = static_cast<VkDrawIndexedIndirectCommand*>(_indirect_buffers_mapped[_current_frame]);
+  std::fill_n(commands, 2 * _submeshes.size(), VkDrawIndexedIndirectCommand{});
+  _visible_draws.clear();
+  for (auto i : _visible_submeshes)
+  {
+    const auto& submesh  = _submeshes[i];
+    auto        distance = glm::length(glm::vec3(_camera_view * glm::vec4(glm::vec3(submesh.sphere), 1.f)));
+    if (_visible_draws.empty() || _visible_draws.back() != submesh.draw)
     {
-      .offset = { 0, 0 },
-      .extent = _swapchain_image_extent,
-    },
-    .clearValueCount = 1,
-    .pClearValues    = &clear,
-  };
-  vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+      _visible_draws.emplace_back(submesh.draw);
+      _draw_distances[submesh.draw] = distance;
+    }
+    else
+      _draw_distances[submesh.draw] = std::min(_draw_distances[submesh.draw], distance);
+    if (_draws[submesh.draw].indexed)
+    {
+      auto lod = select_lod(submesh);
+      commands[i] = commands[_submeshes.size() + i] = VkDrawIndexedIndirectCommand
+      {
+        .indexCount = lod.index_count,
+        .firstIndex = lod.first_index,
+      };
+    }
+  }
+  vmaFlushAllocation(_vma_allocator, _indirect_buffer_allocations[_current_frame], 0, VK_WHOLE_SIZE);
+
+  // opaque draws front to back, so early depth test rejects fragments behind drawn ones,
+  // it costs pipeline rebinds but saves shading of overdraw
+  std::ranges::sort(_visible_draws, {}, [&](auto i) { return _draw_distances[i]; });
+
+  // passes and their barriers are recorded by render graph
+  _graph->set_image(_swapchain_resource, _swapchain_images[image_index], _swapchain_image_views[image_index]);
+  _graph->execute(command_buffer, _current_frame);
 
-  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline);
+  if (_timestamp_pool)
+  {
+    vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, _timestamp_pool, 2 * _current_frame + 1);
+    _timestamps_written[_current_frame] = true;
+  }
+
+  throw_if(vkEndCommandBuffer(command_buffer) != VK_SUCCESS,
+           "failed to end command buffer");
+}
 
+void Vulkan::record_draw_state(VkCommandBuffer command_buffer)
+{
+  // secondary command buffers inherit no state
   VkViewport viewport
   {
-    .width    = (float)_swapchain_image_extent.width,
-    .height   = (float)_swapchain_image_extent.height,
+    .width    = (float)_render_extent.width,
+    .height   = (float)_render_extent.height,
     .maxDepth = 1.f,
   };
   vkCmdSetViewport(command_buffer, 0, 1, &viewport);
@@ -1259,22 +2051,170 @@ void Vulkan::record_command_buffer(VkCommandBuffer command_buffer, uint32_t imag
   VkRect2D scissor
   {
     .offset = { 0, 0 },
-    .extent = _swapchain_image_extent,
+    .extent = _render_extent,
   };
   vkCmdSetScissor(command_buffer, 0, 1, &scissor);
 
-  VkDeviceSize offsets[] = { 0 };
-  vkCmdBindVertexBuffers(command_buffer, 0, 1, &_vertex_buffer, offsets);
-  vkCmdBindIndexBuffer(command_buffer, _index_buffer, 0, VK_INDEX_TYPE_UINT16);
-
   vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline_layout, 0, 1, &_descriptor_sets[_current_frame], 0, nullptr);
+}
 
-  vkCmdDrawIndexed(command_buffer, (uint32_t)Indices.size(), 1, 0, 0, 0);
+void Vulkan::record_draws(VkCommandBuffer command_buffer, std::span<const uint32_t> draws, uint32_t phase, DrawPass pass)
+{
+  // same geometry buffer is bound to every binding with different offsets, depth only binds position stream,
+  // instance count of indexed draws is written by occlusion test
+  std::vector<VkBuffer> buffers;
+  VkPipeline bound_pipeline = VK_NULL_HANDLE;
+  for (auto i : draws)
+  {
+    const auto& draw = _draws[i];
+    // non-indexed draws are never occlusion culled, they are all drawn in phase one
+    if (!draw.indexed && phase == 1)
+      continue;
 
-  vkCmdEndRenderPass(command_buffer);
+    auto pipeline = pass == DrawPass::Color   ? _pipelines[draw.pipeline].second :
+                    pass == DrawPass::Prepass ? _prepass_pipelines[draw.depth_pipeline] :
+                                                _depth_pipelines[draw.depth_pipeline].second;
+    if (pipeline != bound_pipeline)
+    {
+      vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+      bound_pipeline = pipeline;
+    }
+    DrawConstants constants
+    {
+      .instance = _transforms.index(draw.transform),
+      .texture  = draw.texture,
+    };
+    vkCmdPushConstants(command_buffer, _pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                       sizeof(constants), &constants);
 
-  throw_if(vkEndCommandBuffer(command_buffer) != VK_SUCCESS,
-           "failed to end command buffer");
+    auto binding_count = pass == DrawPass::Color ? (uint32_t)draw.vertex_offsets.size() : 1;
+    buffers.resize(binding_count, _geometry_buffer);
+    vkCmdBindVertexBuffers(command_buffer, 0, binding_count, buffers.data(), draw.vertex_offsets.data());
+    if (draw.indexed)
+    {
+      // submeshes of batch are drawn by one call when multi draw indirect is supported
+      auto first = phase * _submeshes.size() + draw.first_submesh;
+      vkCmdBindIndexBuffer(command_buffer, _geometry_buffer, draw.index_offset, draw.index_type);
+      for (uint32_t offset = 0; offset < draw.submesh_count; offset += _max_draw_indirect_count)
+        vkCmdDrawIndexedIndirect(command_buffer, _indirect_buffers[_current_frame], (first + offset) * sizeof(VkDrawIndexedIndirectCommand),
+                                 std::min(_max_draw_indirect_count, draw.submesh_count - offset), sizeof(VkDrawIndexedIndirectCommand));
+    }
+    else
+      vkCmdDraw(command_buffer, _submeshes[draw.first_submesh].count, 1, 0, 0);
+  }
+}
+
+void Vulkan::record_occlusion(VkCommandBuffer command_buffer, uint32_t phase)
+{
+  // visibility, pyramid and indirect commands are synchronized by render graph
+  OcclusionConstants constants
+  {
+    .extent = { (float)_render_extent.width, (float)_render_extent.height },
+    .phase  = phase,
+  };
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _occlusion_pipeline);
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _occlusion_pipeline_layout, 0, 1,
+                          &_occlusion_descriptor_sets[_current_frame], 0, nullptr);
+  vkCmdPushConstants(command_buffer, _occlusion_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+  vkCmdDispatch(command_buffer, (_submeshes.size() + 63) / 64, 1, 1);
+}
+
+void Vulkan::record_hiz(VkCommandBuffer command_buffer)
+{
+  // depth and pyramid are made visible by render graph, each level only waits for write of the one below
+  constexpr Access Storage_Read
+  {
+    .stage  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+    .layout = VK_IMAGE_LAYOUT_GENERAL,
+  };
+  constexpr Access Storage_Write
+  {
+    .stage  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    .access = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+    .layout = VK_IMAGE_LAYOUT_GENERAL,
+  };
+  auto image = _graph->image(_hiz_resource);
+  ImageTracker tracker;
+  tracker.track(image, VK_IMAGE_ASPECT_COLOR_BIT, _hiz_levels, 1,
+  {
+    .stage  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+    .layout = VK_IMAGE_LAYOUT_GENERAL,
+  });
+
+  HizConstants constants
+  {
+    .extent = { (int32_t)_render_extent.width, (int32_t)_render_extent.height },
+  };
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _hiz_pipeline);
+  for (uint32_t level = 0; level < _hiz_levels; ++level)
+  {
+    if (level > 0)
+      tracker.use(image, Storage_Read, level - 1, 1);
+    tracker.use(image, Storage_Write, level, 1);
+    tracker.flush(command_buffer);
+
+    // only texels covering rendered area are reduced, reads past valid area below are clamped to its edge
+    auto width  = (constants.extent.x + 1) / 2;
+    auto height = (constants.extent.y + 1) / 2;
+    constants.level = level;
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _hiz_pipeline_layout, 0, 1,
+                            &_hiz_descriptor_sets[level], 0, nullptr);
+    vkCmdPushConstants(command_buffer, _hiz_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(command_buffer, (width + 7) / 8, (height + 7) / 8, 1);
+    constants.extent = { width, height };
+  }
+}
+
+void Vulkan::record_upscale(VkCommandBuffer command_buffer)
+{
+  VkImageBlit2 region
+  {
+    .sType          = VK_STRUCTURE_TYPE_IMAGE_BLIT_2,
+    .srcSubresource = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1 },
+    .srcOffsets     = {{ { 0, 0, 0 }, { (int32_t)_render_extent.width, (int32_t)_render_extent.height, 1 } }},
+    .dstSubresource = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1 },
+    .dstOffsets     = {{ { 0, 0, 0 }, { (int32_t)_swapchain_image_extent.width, (int32_t)_swapchain_image_extent.height, 1 } }},
+  };
+  VkBlitImageInfo2 info
+  {
+    .sType          = VK_STRUCTURE_TYPE_BLIT_IMAGE_INFO_2,
+    .srcImage       = _graph->image(_scene_resource),
+    .srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+    .dstImage       = _graph->image(_swapchain_resource),
+    .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    .regionCount    = 1,
+    .pRegions       = &region,
+    .filter         = _upscale_filter,
+  };
+  vkCmdBlitImage2(command_buffer, &info);
+}
+
+void Vulkan::record_readback(VkCommandBuffer command_buffer, ResourceId source)
+{
+  auto extent = source == _swapchain_resource ? _swapchain_image_extent : _render_extent;
+  _readback->record(command_buffer, _current_frame, _graph->image(source), extent, _frame_number);
+}
+
+Mesh::Lod Vulkan::select_lod(const Submesh& submesh) const
+{
+  const auto& draw = _draws[submesh.draw];
+  if (draw.lods.empty())
+    return { .first_index = submesh.first_index, .index_count = submesh.count, .error = 0.f };
+
+  // nearest point of bounding sphere, camera inside sphere uses finest level
+  auto center   = glm::vec3(_camera_view * glm::vec4(glm::vec3(submesh.sphere), 1.f));
+  auto distance = glm::length(center) - submesh.sphere.w;
+  if (distance <= 0.f)
+    return draw.lods.front();
+
+  // coarsest level within the screen space error
+  auto it = std::ranges::find_if(draw.lods | std::views::reverse, [&](const auto& lod)
+  {
+    return lod.error * _camera_pixel_scale / distance <= _lod_error;
+  });
+  return it == draw.lods.rend() ? draw.lods.front() : *it;
 }
 
 /****************************\
@@ -1523,16 +2463,17 @@ void Vulkan::test()
 {
   print_memory_information(_physical_device);
 
+  auto quad = Mesh::quad();
   VkBuffer vertex_buffer, index_buffer;
   VkBuffer buffers[] = { vertex_buffer, index_buffer };
   std::vector<BufferCreateInfo> infos
   {
     {
-      .size  = static_cast<uint32_t>(sizeof(Vertices[0]) * Vertices.size()),
+      .size  = static_cast<uint32_t>(sizeof(quad.vertices[0]) * quad.vertices.size()),
       .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
     },
     {
-      .size  = static_cast<uint32_t>(sizeof(Indices[0]) * Indices.size()),
+      .size  = static_cast<uint32_t>(sizeof(quad.indices[0]) * quad.indices.size()),
       .usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
     },
   };
@@ -1553,9 +2494,8 @@ void Vulkan::test()
   vkFreeMemory(_device, memory, nullptr);
 }
 
-void* Vulkan::bad_create_buffer(VkBuffer& buf, VmaAllocation& al, uint32_t size, const void* dst, VkBufferUsageFlags usage, bool use_gpu)
+auto Vulkan::create_stage_buffer(VkDeviceSize size, bool random_access) -> StageBuffer
 {
-  // create stage buffer
   VkBufferCreateInfo buffer_create_info
   {
     .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
@@ -1565,47 +2505,575 @@ void* Vulkan::bad_create_buffer(VkBuffer& buf, VmaAllocation& al, uint32_t size,
 
   VmaAllocationCreateInfo alloc_create_info
   {
-    .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+    .flags = (random_access ? VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT : VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT) |
+             VMA_ALLOCATION_CREATE_MAPPED_BIT,
     .usage = VMA_MEMORY_USAGE_AUTO,
   };
 
-  if (!use_gpu)
+  StageBuffer stage;
+  VmaAllocationInfo info;
+  throw_if(vmaCreateBuffer(_vma_allocator, &buffer_create_info, &alloc_create_info, &stage.buffer, &stage.allocation, &info) != VK_SUCCESS,
+           "failed to create stage buffer");
+  stage.mapped = info.pMappedData;
+  return stage;
+}
+
+void Vulkan::destroy_stage_buffer(const StageBuffer& stage)
+{
+  vmaDestroyBuffer(_vma_allocator, stage.buffer, stage.allocation);
+}
+
+void Vulkan::create_device_buffer(VkBuffer& buffer, VmaAllocation& allocation, VkDeviceSize size, VkBufferUsageFlags usage)
+{
+  VkBufferCreateInfo buffer_create_info
   {
-    buffer_create_info.usage = usage;
-    alloc_create_info.flags |= VMA_ALLOCATION_CREATE_MAPPED_BIT;
-    VmaAllocationInfo info;
-    throw_if(vmaCreateBuffer(_vma_allocator, &buffer_create_info, &alloc_create_info, &buf, &al, &info) != VK_SUCCESS,
-             "failed to create buffer");
-    return info.pMappedData;
-  }
+    .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+    .size  = size,
+    .usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+  };
+
+  VmaAllocationCreateInfo alloc_create_info
+  {
+    .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+  };
 
-  VkBuffer          stage_buffer;
-  VmaAllocation     alloc;
-  throw_if(vmaCreateBuffer(_vma_allocator, &buffer_create_info, &alloc_create_info, &stage_buffer, &alloc, nullptr) != VK_SUCCESS,
+  throw_if(vmaCreateBuffer(_vma_allocator, &buffer_create_info, &alloc_create_info, &buffer, &allocation, nullptr) != VK_SUCCESS,
            "failed to create buffer");
+}
 
-  // copy data to stage buffer
-  throw_if(vmaCopyMemoryToAllocation(_vma_allocator, dst, alloc, 0, size) != VK_SUCCESS,
-           "failed to copy data to stage buffer");
+void Vulkan::create_mesh_buffers()
+{
+  auto start = std::chrono::high_resolution_clock::now();
 
-  // create vertex buffer
-  buffer_create_info.usage = usage |
-                             VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-  alloc_create_info.flags  = 0;
-  throw_if(vmaCreateBuffer(_vma_allocator, &buffer_create_info, &alloc_create_info, &buf, &al, nullptr) != VK_SUCCESS,
-           "failed to create buffer");
-  // copy stage buffer data to vertex buffer
-  copy_buffer(stage_buffer, buf, size);
+  _model_transform = _transforms.create();
+  if (_mesh_filename.ends_with(".glb"))
+    load_glb();
+  else if (_mesh_filename.ends_with(".mesh"))
+    load_cache();
+  else
+    load_obj();
+
+  auto duration = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start);
+  Log::info(fmt::format("loaded {}: {} draws in {:.1f}ms",
+                        _mesh_filename.empty() ? "builtin quad" : _mesh_filename, _draws.size(), duration.count()));
+
+  // spheres are placed in model space by local transforms of draws at load, tree is refitted when they change
+  for (const auto& draw : _draws)
+  {
+    _draw_locals.emplace_back(_transforms.local(draw.transform));
+    _draw_placements.emplace_back(glm::inverse(_draw_locals.back()));
+  }
+  for (const auto& submesh : _submeshes)
+  {
+    _submesh_spheres.emplace_back(submesh.sphere);
+    _submesh_bvh.insert(get_sphere_bounds(submesh.sphere));
+  }
+  _submesh_bvh.build();
+  _visible_submeshes.reserve(_submeshes.size());
+  _visible_draws.reserve(_draws.size());
+  _draw_distances.resize(_draws.size());
+}
+
+void Vulkan::add_draw(DrawCommand&& draw, std::span<const Submesh> submeshes)
+{
+  draw.first_submesh = _submeshes.size();
+  draw.submesh_count = submeshes.size();
+  for (auto submesh : submeshes)
+  {
+    submesh.draw = _draws.size();
+    _submeshes.emplace_back(submesh);
+  }
+  _draws.emplace_back(std::move(draw));
+}
+
+void Vulkan::refit_submeshes(uint32_t first, uint32_t last)
+{
+  constexpr float Max_Bvh_Degradation = 1.5f; ///< SAH cost of refitted tree over built one that starts a rebuild
+
+  // spheres are moved from their load placement, so repeated moves don't accumulate error
+  auto changed_begin = (uint32_t)_submeshes.size(), changed_end = 0u;
+  for (uint32_t i = 0; i < _draws.size(); ++i)
+  {
+    const auto& draw  = _draws[i];
+    auto        index = _transforms.index(draw.transform);
+    const auto& local = _transforms.local(draw.transform);
+    if (index < first || index >= last || local == _draw_locals[i])
+      continue;
+    _draw_locals[i] = local;
+
+    auto placement = local * _draw_placements[i];
+    auto scale     = std::max({ glm::length(glm::vec3(placement[0])), glm::length(glm::vec3(placement[1])), glm::length(glm::vec3(placement[2])) });
+    for (auto j = draw.first_submesh; j < draw.first_submesh + draw.submesh_count; ++j)
+    {
+      const auto& sphere = _submesh_spheres[j];
+      _submeshes[j].sphere = glm::vec4(glm::vec3(placement * glm::vec4(glm::vec3(sphere), 1.f)), sphere.w * scale);
+      _submesh_bvh.update(j, get_sphere_bounds(_submeshes[j].sphere));
+    }
+    changed_begin = std::min(changed_begin, draw.first_submesh);
+    changed_end   = std::max(changed_end, draw.first_submesh + draw.submesh_count);
+  }
+  // refit also installs a finished rebuild, which is started once moves made tree notably worse
+  _submesh_bvh.refit();
+  if (_submesh_bvh.degradation() > Max_Bvh_Degradation)
+    _submesh_bvh.rebuild_async();
+  if (changed_begin >= changed_end)
+    return;
+
+  for (auto& [begin, end] : _sphere_dirty)
+  {
+    begin = begin < end ? std::min(begin, changed_begin) : changed_begin;
+    end   = std::max(end, changed_end);
+  }
+}
+
+void Vulkan::load_obj()
+{
+  auto packed = Mesh::get_packed_layout(_vertex_format);
+  check_vertex_layout_support(_physical_device, packed.layout);
+
+  // indices follow vertices in the geometry buffer, 16-bit when vertex count allows
+  StageBuffer stage{};
+  VkDeviceSize size = 0, index_offset = 0;
+  uint32_t vertex_count = 0, index_count = 0;
+  auto index_type = VK_INDEX_TYPE_UINT32;
+  auto set_layout = [&](uint32_t vertices, uint32_t count)
+  {
+    vertex_count = vertices;
+    index_type   = Mesh::get_index_type(vertex_count);
+    index_offset = Util::align_up<VkDeviceSize>(packed.get_size(vertex_count), 16);
+    size         = index_offset + (VkDeviceSize)Mesh::get_index_size(index_type) * count;
+    index_count  = count;
+  };
+
+  // final vertices and indices are packed at start of stage buffer
+  auto pack = [&](std::span<const Mesh::Vertex> vertices, std::span<const uint32_t> indices)
+  {
+    set_layout((uint32_t)vertices.size(), (uint32_t)indices.size());
+    auto mapped    = static_cast<std::byte*>(stage.mapped);
+    auto transform = Mesh::quantize(vertices, packed, mapped);
+    Mesh::pack_indices(indices, index_type, mapped + index_offset);
+    Log::info(fmt::format("vertices {}B -> {}B, {}B per vertex, {}-bit indices",
+                          sizeof(Mesh::Vertex) * vertices.size(), packed.get_size(vertices.size()), packed.stride,
+                          8 * Mesh::get_index_size(index_type)));
+    return transform;
+  };
 
-  vmaDestroyBuffer(_vma_allocator, stage_buffer, alloc);
-  return nullptr;
+  auto transform = glm::mat4(1.f);
+  auto lods      = std::vector<Mesh::Lod>();
+  auto sphere    = glm::vec4();
+  try
+  {
+    if (_mesh_filename.empty())
+    {
+      auto mesh = Mesh::quad();
+      set_layout((uint32_t)mesh.vertices.size(), (uint32_t)mesh.indices.size());
+      stage = create_stage_buffer(size);
+      auto bounds = Mesh::compute_bounds(mesh.vertices);
+      sphere    = glm::vec4((bounds.min + bounds.max) * 0.5f, glm::length(bounds.max - bounds.min) * 0.5f);
+      transform = pack(mesh.vertices, mesh.indices);
+    }
+    else if (!_optimize_mesh && _vertex_format == Mesh::VertexFormat{ .split_position = false })
+    {
+      // packed layout of interleaved float formats is same as Mesh::Vertex, loader writes final vertices,
+      // 16-bit indices are narrowed from a CPU copy after loading
+      std::vector<uint32_t> indices;
+      auto bounds = Mesh::load_obj(_mesh_filename, [&](uint32_t vertices, uint32_t count)
+      {
+        set_layout(vertices, count);
+        stage = create_stage_buffer(size);
+        auto mapped = static_cast<std::byte*>(stage.mapped);
+        if (index_type != VK_INDEX_TYPE_UINT32)
+          indices.resize(count);
+        return Mesh::MeshSpans
+        {
+          .vertices = { reinterpret_cast<Mesh::Vertex*>(mapped), vertices },
+          .indices  = index_type == VK_INDEX_TYPE_UINT32 ? std::span(reinterpret_cast<uint32_t*>(mapped + index_offset), count)
+                                                         : std::span(indices),
+        };
+      });
+      sphere = glm::vec4((bounds.min + bounds.max) * 0.5f, glm::length(bounds.max - bounds.min) * 0.5f);
+      if (index_type != VK_INDEX_TYPE_UINT32)
+        Mesh::pack_indices(indices, index_type, static_cast<std::byte*>(stage.mapped) + index_offset);
+    }
+    else
+    {
+      // loader writes into host cached stage memory behind room of the packed result, optimization and
+      // LOD generation run there in place, then vertices are packed in front of them and only the front is copied,
+      // LODs get as many indices again as the original, a chain needing more ends early
+      Mesh::MeshSpans loaded;
+      uint32_t loaded_indices = 0;
+      auto bounds = Mesh::load_obj(_mesh_filename, [&](uint32_t vertices, uint32_t count)
+      {
+        auto capacity = 2 * (VkDeviceSize)count;
+        auto room     = Util::align_up<VkDeviceSize>(packed.get_size(vertices), 16) +
+                        (VkDeviceSize)Mesh::get_index_size(Mesh::get_index_type(vertices)) * capacity;
+        auto offset   = Util::align_up<VkDeviceSize>(room, 16);
+        stage = create_stage_buffer(offset + sizeof(Mesh::Vertex) * vertices + sizeof(uint32_t) * capacity, true);
+        auto mapped = static_cast<std::byte*>(stage.mapped) + offset;
+        loaded_indices = count;
+        loaded =
+        {
+          .vertices = { reinterpret_cast<Mesh::Vertex*>(mapped), vertices },
+          .indices  = { reinterpret_cast<uint32_t*>(mapped + sizeof(Mesh::Vertex) * vertices), (size_t)capacity },
+        };
+        return loaded;
+      });
+      sphere = glm::vec4((bounds.min + bounds.max) * 0.5f, glm::length(bounds.max - bounds.min) * 0.5f);
+
+      Mesh::MeshSpans mesh{ loaded.vertices, loaded.indices.first(loaded_indices) };
+      if (_optimize_mesh)
+      {
+        auto [before, after] = Mesh::optimize(mesh);
+        Log::info(fmt::format("optimized {}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}",
+                              _mesh_filename, before.acmr, after.acmr, before.atvr, after.atvr));
+
+        // levels share vertices, their indices follow the original ones
+        if (_max_lods > 1)
+        {
+          lods = Mesh::generate_lods(mesh.vertices, loaded.indices, loaded_indices, _max_lods);
+          for (const auto& lod : lods)
+            Log::info(fmt::format("LOD {} triangles, error {}", lod.index_count / 3, lod.error));
+          mesh.indices = loaded.indices.first(lods.back().first_index + lods.back().index_count);
+          if (lods.size() == 1)
+            lods.clear();
+        }
+      }
+      transform = pack(mesh.vertices, mesh.indices);
+    }
+  }
+  catch (...)
+  {
+    if (stage.buffer != VK_NULL_HANDLE)
+      destroy_stage_buffer(stage);
+    throw;
+  }
+
+  // stage memory may be non coherent, writes are flushed before copy reads them
+  vmaFlushAllocation(_vma_allocator, stage.allocation, 0, VK_WHOLE_SIZE);
+  create_device_buffer(_geometry_buffer, _geometry_buffer_allocation, size,
+                       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+  copy_buffer(stage.buffer, _geometry_buffer, size);
+  destroy_stage_buffer(stage);
+
+  Submesh submesh
+  {
+    .first_index = 0,
+    .count       = lods.empty() ? index_count : lods.front().index_count,
+    .sphere      = sphere,
+  };
+  add_draw(DrawCommand
+  {
+    .pipeline       = get_pipeline(packed.layout),
+    .depth_pipeline = get_pipeline(packed.layout.get_position_layout(), true),
+    .vertex_offsets = get_stream_offsets(packed, vertex_count),
+    .index_offset   = index_offset,
+    .index_type     = index_type,
+    .indexed        = true,
+    .transform      = _transforms.create(transform, _model_transform),
+    .material       = -1,
+    .lods           = std::move(lods),
+  }, { &submesh, 1 });
+}
+
+void Vulkan::load_cache()
+{
+  Mesh::MeshCache cache(_mesh_filename);
+  const auto& header = cache.header();
+  auto packed = Mesh::get_packed_layout(header.format());
+  check_vertex_layout_support(_physical_device, packed.layout);
+
+  // sections are already in upload layout, copy vertices while indices are decoded
+  auto vertices     = cache.section(Mesh::SectionType::Vertices);
+  auto index_offset = Util::align_up<VkDeviceSize>(vertices.size(), 16);
+  auto size         = index_offset + (VkDeviceSize)Mesh::get_index_size(header.get_index_type()) * header.index_count;
+  auto stage        = create_stage_buffer(size);
+  auto mapped       = static_cast<std::byte*>(stage.mapped);
+  auto copy = Util::ThreadPool::instance().submit([&]
+  {
+    std::ranges::copy(vertices, mapped);
+  });
+  try
+  {
+    cache.read_indices(mapped + index_offset);
+  }
+  catch (...)
+  {
+    copy.wait();
+    destroy_stage_buffer(stage);
+    throw;
+  }
+  copy.get();
+
+  // stage memory may be non coherent, writes are flushed before copy reads them
+  vmaFlushAllocation(_vma_allocator, stage.allocation, 0, VK_WHOLE_SIZE);
+  create_device_buffer(_geometry_buffer, _geometry_buffer_allocation, size,
+                       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+  copy_buffer(stage.buffer, _geometry_buffer, size);
+  destroy_stage_buffer(stage);
+
+  auto lods = cache.lods();
+  if (lods.size() == 1)
+    lods.clear();
+  Submesh submesh
+  {
+    .first_index = 0,
+    .count       = lods.empty() ? header.index_count : lods.front().index_count,
+    .sphere      = glm::vec4((header.bounds.min + header.bounds.max) * 0.5f, glm::length(header.bounds.max - header.bounds.min) * 0.5f),
+  };
+  add_draw(DrawCommand
+  {
+    .pipeline       = get_pipeline(packed.layout),
+    .depth_pipeline = get_pipeline(packed.layout.get_position_layout(), true),
+    .vertex_offsets = get_stream_offsets(packed, header.vertex_count),
+    .index_offset   = index_offset,
+    .index_type     = header.get_index_type(),
+    .indexed        = true,
+    .transform      = _transforms.create(header.transform, _model_transform),
+    .material       = -1,
+    .lods           = std::move(lods),
+  }, { &submesh, 1 });
+}
+
+void Vulkan::load_glb()
+{
+  Mesh::GlbFile file(_mesh_filename);
+
+  // small static primitives are merged into batches, others are drawn from their buffer views
+  auto batches = Mesh::merge_static(file);
+
+  // constant value of missing attributes, bound with zero stride
+  struct DefaultAttributes
+  {
+    glm::vec3 color  = glm::vec3(1.f);
+    glm::vec3 normal = glm::vec3(0.f, 0.f, 1.f);
+    glm::vec2 uv     = glm::vec2(0.f);
+  };
+  constexpr VkDeviceSize Default_Offsets[] = { 0, offsetof(DefaultAttributes, color), offsetof(DefaultAttributes, normal), offsetof(DefaultAttributes, uv) };
+  constexpr VkFormat     Default_Formats[] = { VK_FORMAT_UNDEFINED, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32_SFLOAT };
+
+  // place used buffer views after default attributes, 8-bit indices need to be widened
+  constexpr auto Unused = std::numeric_limits<VkDeviceSize>::max();
+  std::vector<VkDeviceSize> view_offsets(file.buffer_view_count(), Unused);
+  std::vector<std::pair<const Mesh::Primitive*, VkDeviceSize>> widened_indices;
+  for (const auto& mesh : file.meshes())
+    for (const auto& primitive : mesh.primitives)
+    {
+      if (Mesh::is_batchable(primitive))
+        continue;
+      for (const auto& attribute : primitive.attributes)
+        if (attribute)
+          view_offsets[attribute->buffer_view] = 0;
+      if (primitive.indices && primitive.index_type != VK_INDEX_TYPE_UINT8_EXT)
+        view_offsets[primitive.indices->buffer_view] = 0;
+    }
+
+  VkDeviceSize size = sizeof(DefaultAttributes);
+  for (uint32_t i = 0; i < view_offsets.size(); ++i)
+    if (view_offsets[i] != Unused)
+    {
+      view_offsets[i] = Util::align_up<VkDeviceSize>(size, 16);
+      size = view_offsets[i] + file.buffer_view(i).size();
+    }
+  for (const auto& mesh : file.meshes())
+    for (const auto& primitive : mesh.primitives)
+      if (primitive.indices && primitive.index_type == VK_INDEX_TYPE_UINT8_EXT && !Mesh::is_batchable(primitive))
+      {
+        widened_indices.emplace_back(&primitive, Util::align_up<VkDeviceSize>(size, 16));
+        size = widened_indices.back().second + sizeof(uint16_t) * primitive.indices->count;
+      }
+
+  // vertex streams of batches follow, then their indices
+  struct BatchOffsets
+  {
+    std::array<VkDeviceSize, 4> streams;
+    VkDeviceSize                indices;
+    VkIndexType                 index_type;
+  };
+  std::vector<BatchOffsets> batch_offsets(batches.size());
+  for (uint32_t i = 0; i < batches.size(); ++i)
+  {
+    auto& offsets = batch_offsets[i];
+    for (uint32_t location = 0; location < offsets.streams.size(); ++location)
+      if (!batches[i].streams[location].empty())
+      {
+        offsets.streams[location] = Util::align_up<VkDeviceSize>(size, 16);
+        size = offsets.streams[location] + batches[i].streams[location].size();
+      }
+    offsets.index_type = Mesh::get_index_type(batches[i].vertex_count);
+    offsets.indices    = Util::align_up<VkDeviceSize>(size, 16);
+    size = offsets.indices + (VkDeviceSize)Mesh::get_index_size(offsets.index_type) * batches[i].indices.size();
+  }
+
+  // copy buffer views from mapped file to stage buffer
+  auto stage  = create_stage_buffer(size);
+  auto mapped = static_cast<std::byte*>(stage.mapped);
+  new (mapped) DefaultAttributes();
+  Util::ThreadPool::instance().parallel_for(view_offsets.size(), [&](uint32_t i)
+  {
+    if (view_offsets[i] != Unused)
+      std::ranges::copy(file.buffer_view(i), mapped + view_offsets[i]);
+  });
+  for (const auto& [primitive, offset] : widened_indices)
+  {
+    auto& indices = *primitive->indices;
+    auto  src     = file.buffer_view(indices.buffer_view).subspan(indices.offset);
+    auto  dst     = reinterpret_cast<uint16_t*>(mapped + offset);
+    for (uint32_t i = 0; i < indices.count; ++i)
+      dst[i] = (uint16_t)src[i * indices.stride];
+  }
+  Util::ThreadPool::instance().parallel_for(batches.size(), [&](uint32_t i)
+  {
+    for (uint32_t location = 0; location < batches[i].streams.size(); ++location)
+      std::ranges::copy(batches[i].streams[location], mapped + batch_offsets[i].streams[location]);
+    Mesh::pack_indices(batches[i].indices, batch_offsets[i].index_type, mapped + batch_offsets[i].indices);
+  });
+
+  // stage memory may be non coherent, writes are flushed before copy reads them
+  vmaFlushAllocation(_vma_allocator, stage.allocation, 0, VK_WHOLE_SIZE);
+  create_device_buffer(_geometry_buffer, _geometry_buffer_allocation, size,
+                       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+  copy_buffer(stage.buffer, _geometry_buffer, size);
+  destroy_stage_buffer(stage);
+
+  // binding of each location is a stream or the default attribute
+  auto add_location = [&](Mesh::VertexLayout& layout, DrawCommand& draw, uint32_t location, uint32_t stride, VkFormat format, VkDeviceSize offset)
+  {
+    layout.bindings.emplace_back(VkVertexInputBindingDescription
+    {
+      .binding   = location,
+      .stride    = stride,
+      .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+    });
+    layout.attributes.emplace_back(VkVertexInputAttributeDescription
+    {
+      .location = location,
+      .binding  = location,
+      .format   = format == VK_FORMAT_UNDEFINED ? Default_Formats[location] : format,
+      .offset   = 0,
+    });
+    draw.vertex_offsets.emplace_back(format == VK_FORMAT_UNDEFINED ? Default_Offsets[location] : offset);
+  };
+
+  // base color images are decoded in background, each once however many materials use it
+  std::vector<std::optional<uint32_t>> image_textures(file.images().size());
+  auto get_texture = [&](int32_t material) -> uint32_t
+  {
+    if (material < 0 || material >= (int32_t)file.material_count())
+      return 0;
+    auto image = file.materials()[material].base_color_image;
+    if (image < 0)
+      return 0;
+    auto& texture = image_textures[image];
+    if (!texture)
+    {
+      const auto& source = file.images()[image];
+      if (source.buffer_view)
+        texture = _textures->load(file.buffer_view(*source.buffer_view), fmt::format("image {} of {}", image, _mesh_filename), true);
+      else
+        texture = source.path.empty() ? 0 : _textures->load(source.path, true);
+    }
+    return *texture;
+  };
+
+  // draw every primitive of every node that isn't batched
+  for (const auto& node : file.nodes())
+    for (const auto& primitive : file.meshes()[node.mesh].primitives)
+    {
+      if (Mesh::is_batchable(primitive))
+        continue;
+
+      Mesh::VertexLayout layout;
+      DrawCommand draw
+      {
+        .index_type = primitive.index_type,
+        .indexed    = primitive.indices.has_value(),
+        .transform  = _transforms.create(node.transform, _model_transform),
+        .material   = primitive.material,
+        .texture    = get_texture(primitive.material),
+      };
+
+      // sphere of primitive bounds is moved to model space by node transform, radius grows by its largest scale
+      const auto& bounds = primitive.bounds;
+      auto scale = std::max({ glm::length(glm::vec3(node.transform[0])), glm::length(glm::vec3(node.transform[1])),
+                              glm::length(glm::vec3(node.transform[2])) });
+      Submesh submesh
+      {
+        .first_index = 0,
+        .count       = primitive.attributes[0]->count,
+        .sphere      = glm::vec4(glm::vec3(node.transform * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.f)),
+                                 glm::length(bounds.max - bounds.min) * 0.5f * scale),
+      };
+
+      for (uint32_t location = 0; location < primitive.attributes.size(); ++location)
+      {
+        const auto& attribute = primitive.attributes[location];
+        add_location(layout, draw, location, attribute ? attribute->stride : 0, attribute ? attribute->format : VK_FORMAT_UNDEFINED,
+                     attribute ? view_offsets[attribute->buffer_view] + attribute->offset : 0);
+      }
+
+      if (primitive.indices)
+      {
+        submesh.count = primitive.indices->count;
+        if (primitive.index_type == VK_INDEX_TYPE_UINT8_EXT)
+        {
+          draw.index_type   = VK_INDEX_TYPE_UINT16;
+          draw.index_offset = std::ranges::find(widened_indices, &primitive, &decltype(widened_indices)::value_type::first)->second;
+        }
+        else
+          draw.index_offset = view_offsets[primitive.indices->buffer_view] + primitive.indices->offset;
+      }
+
+      draw.pipeline       = get_pipeline(layout);
+      draw.depth_pipeline = get_pipeline(layout.get_position_layout(), true);
+      add_draw(std::move(draw), { &submesh, 1 });
+    }
+
+  // vertices of batches are already transformed by their nodes, every submesh is culled on its own
+  if (batches.empty())
+    return;
+  auto transform = _transforms.create(glm::mat4(1.f), _model_transform);
+  uint32_t primitive_count = 0;
+  std::vector<Submesh> submeshes;
+  for (uint32_t i = 0; i < batches.size(); ++i)
+  {
+    const auto& batch = batches[i];
+    Mesh::VertexLayout layout;
+    DrawCommand draw
+    {
+      .index_offset = batch_offsets[i].indices,
+      .index_type   = batch_offsets[i].index_type,
+      .indexed      = true,
+      .transform    = transform,
+      .material     = batch.material,
+      .texture      = get_texture(batch.material),
+    };
+    for (uint32_t location = 0; location < batch.streams.size(); ++location)
+      add_location(layout, draw, location, batch.streams[location].size() / batch.vertex_count, batch.formats[location],
+                   batch_offsets[i].streams[location]);
+    draw.pipeline       = get_pipeline(layout);
+    draw.depth_pipeline = get_pipeline(layout.get_position_layout(), true);
+
+    submeshes.clear();
+    for (const auto& submesh : batch.submeshes)
+      submeshes.emplace_back(Submesh
+      {
+        .first_index = submesh.first_index,
+        .count       = submesh.index_count,
+        .sphere      = submesh.sphere,
+      });
+    primitive_count += submeshes.size();
+    add_draw(std::move(draw), submeshes);
+  }
+  Log::info(fmt::format("merged {} static primitives into {} batches", primitive_count, batches.size()));
 }
 
 void Vulkan::create_buffers()
 {
+  // meshes load their textures in background
+  _textures = std::make_unique<Textures>(_physical_device, _device, _vma_allocator, _texture_capacity, Max_Frame_Number);
+
   // TODO: vertex, index and uniform use single buffer(sub-allocation)
-  bad_create_buffer(_vertex_buffer, _vertex_buffer_allocation, sizeof(Vertices[0]) * Vertices.size(), Vertices.data(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-  bad_create_buffer(_index_buffer, _index_buffer_allocation, sizeof(Indices[0]) * Indices.size(), Indices.data(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+  create_mesh_buffers();
 
   // TODO: use my allocator to alloc once memory for all uniform buffers
   // I need to implement a memory allocator to manage memory
@@ -1634,6 +3102,101 @@ void Vulkan::create_buffers()
   vkMapMemory(_device, _uniform_buffers_memory, 0, size, 0, (void**)&mapped);
   for (uint32_t i = 0; i < Max_Frame_Number; ++i)
     _uniform_buffers_mapped[i] = mapped + buffer_infos[i].offset;
+
+  // instance buffers are read by vertex shader directly from host memory
+  VkBufferCreateInfo instance_info
+  {
+    .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+    .size  = 2 * _transforms.size() * sizeof(glm::mat4),
+    .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+  };
+  VmaAllocationCreateInfo alloc_info
+  {
+    .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+             VMA_ALLOCATION_CREATE_MAPPED_BIT,
+    .usage = VMA_MEMORY_USAGE_AUTO,
+  };
+  for (uint32_t i = 0; i < Max_Frame_Number; ++i)
+  {
+    VmaAllocationInfo info;
+    throw_if(vmaCreateBuffer(_vma_allocator, &instance_info, &alloc_info, &_instance_buffers[i], &_instance_buffer_allocations[i], &info) != VK_SUCCESS,
+             "failed to create instance buffer");
+    _instance_buffers_mapped[i] = info.pMappedData;
+    _instance_dirty[i]          = { 0, _transforms.size() };
+  }
+
+  // bounding spheres of occlusion test change only when draws move, visibility never leaves device
+  VkBufferCreateInfo sphere_info
+  {
+    .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+    .size  = _submeshes.size() * sizeof(glm::vec4),
+    .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+  };
+  for (uint32_t i = 0; i < Max_Frame_Number; ++i)
+  {
+    VmaAllocationInfo info;
+    throw_if(vmaCreateBuffer(_vma_allocator, &sphere_info, &alloc_info, &_sphere_buffers[i], &_sphere_buffer_allocations[i], &info) != VK_SUCCESS,
+             "failed to create sphere buffer");
+    _sphere_buffers_mapped[i] = info.pMappedData;
+    _sphere_dirty[i]          = { 0, (uint32_t)_submeshes.size() };
+  }
+
+  create_device_buffer(_visibility_buffer, _visibility_buffer_allocation, _submeshes.size() * sizeof(uint32_t),
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+  VkBufferCreateInfo indirect_info
+  {
+    .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+    .size  = 2 * _submeshes.size() * sizeof(VkDrawIndexedIndirectCommand),
+    .usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+  };
+  for (uint32_t i = 0; i < Max_Frame_Number; ++i)
+  {
+    VmaAllocationInfo info;
+    throw_if(vmaCreateBuffer(_vma_allocator, &indirect_info, &alloc_info, &_indirect_buffers[i], &_indirect_buffer_allocations[i], &info) != VK_SUCCESS,
+             "failed to create indirect buffer");
+    _indirect_buffers_mapped[i] = info.pMappedData;
+  }
+
+  // nothing was visible before first frame
+  submit_commands([&](VkCommandBuffer command_buffer)
+  {
+    vkCmdFillBuffer(command_buffer, _visibility_buffer, 0, VK_WHOLE_SIZE, 0);
+  });
+}
+
+void Vulkan::submit_commands(const std::function<void(VkCommandBuffer)>& record)
+{
+  VkCommandBufferAllocateInfo allocate_info
+  {
+    .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+    .commandPool        = _command_pool,
+    .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+    .commandBufferCount = 1,
+  };
+  VkCommandBuffer command_buffer;
+  throw_if(vkAllocateCommandBuffers(_device, &allocate_info, &command_buffer) != VK_SUCCESS,
+           "failed to create command buffer");
+
+  VkCommandBufferBeginInfo begin_info
+  {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+  vkBeginCommandBuffer(command_buffer, &begin_info);
+  record(command_buffer);
+  vkEndCommandBuffer(command_buffer);
+
+  VkSubmitInfo submit_info
+  {
+    .sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+    .commandBufferCount = 1,
+    .pCommandBuffers    = &command_buffer,
+  };
+  vkQueueSubmit(_graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
+  vkQueueWaitIdle(_graphics_queue);
+
+  vkFreeCommandBuffers(_device, _command_pool, 1, &command_buffer);
 }
 
 }
@@ -6,7 +6,7 @@
 
 using namespace Vulkan;
 
-int main()
+int main(int argc, char** argv)
 {
   try 
   {
@@ -25,6 +25,7 @@ int main()
       .height   = 600,
       .title    = "test",
       .app_info = app_info,
+      .mesh     = argc > 1 ? argv[1] : "",
     };
 
     auto vulkan = std::make_unique<class Vulkan>(create_info);